@@ -67,6 +67,12 @@ static inline void choose_mul_shift(float M, int32_t *mul, int *shift){
     *mul = (int32_t)m; *shift = s;
 }
 
+// output scale taken from the int32 accumulator range, so requantization never saturates
+static inline float out_scale(int32_t amax, float sxw){
+#pragma HLS INLINE
+    return (float)(amax > 0 ? amax : 1) * sxw / 127.0f;
+}
+
 static inline float maxabs_f(const float *p, int n){
 #pragma HLS INLINE
     float m = 0.0f;
@@ -102,11 +108,6 @@ void Conv1_28x28x1_5x5x20_1_0(
 
     const float sx  = maxabs_f(&input[0][0][0], n_in) / 127.0f;      // input scale
     const float sw  = maxabs_f(&kernel[0][0][0][0], n_w1) / 127.0f;  // weight scale
-    const float sy  = sx; // keep same dynamic as input for simplicity
-
-    int32_t rq_mul; int rq_shift;
-    // M = (sx * sw) / sy
-    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
 
     // ---- Quantize input/weights/bias once (int8/int32) ----
     static int8_t in_q[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
@@ -114,6 +115,8 @@ void Conv1_28x28x1_5x5x20_1_0(
     static int8_t w_q[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM];
 #pragma HLS ARRAY_PARTITION variable=w_q complete dim=2
     static int32_t b_q[CONV1_NBOUTPUT];
+    static int32_t acc_q[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+    int32_t amax = 0;
 
     // quantize input
     {
@@ -147,7 +150,7 @@ void Conv1_28x28x1_5x5x20_1_0(
         }
     }
 
-    // ---- Int8 conv core (pad + stride) -> int32 acc -> int8 via requant ----
+    // ---- Int8 conv core (pad + stride) -> int32 acc ----
     for (int m = 0; m < CONV1_NBOUTPUT; m++){
         for (int y = 0; y < CONV1_HEIGHT; y++){
             for (int x = 0; x < CONV1_WIDTH; x++){
@@ -170,12 +173,25 @@ void Conv1_28x28x1_5x5x20_1_0(
                         }
                     }
                 }
+                acc_q[m][y][x] = acc;
+                if (acc > amax) amax = acc;
+                if (-acc > amax) amax = -acc;
+            }
+        }
+    }
 
-                // Requantize to int8 (no activation here)
-                int32_t z_q = (rq_shift>0) ? mul_shift_round(acc, rq_mul, rq_shift) : acc;
-                int8_t  y_q = clamp_i8(z_q);
+    // ---- Requantize to int8 (no activation here), then dequantize to float ----
+    // M = (sx * sw) / sy
+    const float sy = out_scale(amax, sx * sw);
+    int32_t rq_mul; int rq_shift;
+    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
 
-                // Dequantize to float for output tensor
+    for (int m = 0; m < CONV1_NBOUTPUT; m++){
+        for (int y = 0; y < CONV1_HEIGHT; y++){
+            for (int x = 0; x < CONV1_WIDTH; x++){
+#pragma HLS PIPELINE II=1
+                int32_t z_q = (rq_shift>0) ? mul_shift_round(acc_q[m][y][x], rq_mul, rq_shift) : acc_q[m][y][x];
+                int8_t  y_q = clamp_i8(z_q);
                 output[m][y][x] = (float)y_q * sy;
             }
         }
@@ -200,10 +216,6 @@ void Conv2_12x12x20_5x5x40_1_0(
 
     const float sx  = maxabs_f(&input[0][0][0], n_in) / 127.0f;
     const float sw  = maxabs_f(&kernel[0][0][0][0], n_w2) / 127.0f;
-    const float sy  = sx; // keep same dynamic across layers
-
-    int32_t rq_mul; int rq_shift;
-    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
 
     // ---- Quantize operands ----
     static int8_t in_q[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
@@ -211,6 +223,8 @@ void Conv2_12x12x20_5x5x40_1_0(
     static int8_t w_q[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM];
 #pragma HLS ARRAY_PARTITION variable=w_q complete dim=2
     static int32_t b_q[CONV2_NBOUTPUT];
+    static int32_t acc_q[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+    int32_t amax = 0;
 
     {
         const float inv_sx = 1.0f / sx;
@@ -264,8 +278,22 @@ void Conv2_12x12x20_5x5x40_1_0(
                         }
                     }
                 }
+                acc_q[m][y][x] = acc;
+                if (acc > amax) amax = acc;
+                if (-acc > amax) amax = -acc;
+            }
+        }
+    }
+
+    const float sy = out_scale(amax, sx * sw);
+    int32_t rq_mul; int rq_shift;
+    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
 
-                int32_t z_q = (rq_shift>0) ? mul_shift_round(acc, rq_mul, rq_shift) : acc;
+    for (int m = 0; m < CONV2_NBOUTPUT; m++){
+        for (int y = 0; y < CONV2_HEIGHT; y++){
+            for (int x = 0; x < CONV2_WIDTH; x++){
+#pragma HLS PIPELINE II=1
+                int32_t z_q = (rq_shift>0) ? mul_shift_round(acc_q[m][y][x], rq_mul, rq_shift) : acc_q[m][y][x];
                 int8_t  y_q = clamp_i8(z_q);
                 output[m][y][x] = (float)y_q * sy; // back to float
             }
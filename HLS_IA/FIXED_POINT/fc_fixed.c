@@ -37,6 +37,12 @@ static inline void choose_mul_shift(float M, int32_t *mul, int *shift){
     *mul = (int32_t)m; *shift = s;
 }
 
+// output scale taken from the int32 accumulator range, so requantization never saturates
+static inline float out_scale(int32_t amax, float sxw){
+#pragma HLS INLINE
+    return (float)(amax > 0 ? amax : 1) * sxw / 127.0f;
+}
+
 static inline float maxabs_f(const float *p, int n){
 #pragma HLS INLINE
     float m = 0.0f;
@@ -63,16 +69,14 @@ void Fc1_40_400(
 
     const float sx = maxabs_f(&input[0][0][0], n_in) / 127.0f;
     const float sw = maxabs_f(&weight[0][0][0][0], n_w) / 127.0f;
-    const float sy = sx;
-
-    int32_t rq_mul; int rq_shift;
-    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
 
     static int8_t in_q[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
 #pragma HLS ARRAY_PARTITION variable=in_q complete dim=1
     static int8_t w_q[400][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
 #pragma HLS ARRAY_PARTITION variable=w_q complete dim=2
     static int32_t b_q[400];
+    static int32_t acc_q[400];
+    int32_t amax = 0;
 
     // quantize input
     {
@@ -121,7 +125,19 @@ void Fc1_40_400(
                 }
             }
         }
-        int32_t z_q = (rq_shift>0) ? mul_shift_round(acc, rq_mul, rq_shift) : acc;
+        acc_q[o] = acc;
+        if (acc > amax) amax = acc;
+        if (-acc > amax) amax = -acc;
+    }
+
+    // requantize + dequantize
+    const float sy = out_scale(amax, sx * sw);
+    int32_t rq_mul; int rq_shift;
+    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
+
+    for (int o = 0; o < 400; o++){
+#pragma HLS PIPELINE II=1
+        int32_t z_q = (rq_shift>0) ? mul_shift_round(acc_q[o], rq_mul, rq_shift) : acc_q[o];
         int8_t y_q = clamp_i8(z_q);
         output[o] = relu((float)y_q * sy);
     }
@@ -142,14 +158,12 @@ void Fc2_400_10(
 
     const float sx = maxabs_f(input, n_in) / 127.0f;
     const float sw = maxabs_f(&weight[0][0], n_w) / 127.0f;
-    const float sy = sx;
-
-    int32_t rq_mul; int rq_shift;
-    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
 
     static int8_t in_q[400];
     static int8_t w_q[10][400];
     static int32_t b_q[10];
+    static int32_t acc_q[10];
+    int32_t amax = 0;
 
     {
         const float inv_sx = 1.0f / sx;
@@ -184,7 +198,18 @@ void Fc2_400_10(
 #pragma HLS PIPELINE II=1
             acc += (int32_t)in_q[i] * (int32_t)w_q[o][i];
         }
-        int32_t z_q = (rq_shift>0) ? mul_shift_round(acc, rq_mul, rq_shift) : acc;
+        acc_q[o] = acc;
+        if (acc > amax) amax = acc;
+        if (-acc > amax) amax = -acc;
+    }
+
+    const float sy = out_scale(amax, sx * sw);
+    int32_t rq_mul; int rq_shift;
+    choose_mul_shift((sx * sw) / sy, &rq_mul, &rq_shift);
+
+    for (int o=0;o<10;o++){
+#pragma HLS PIPELINE II=1
+        int32_t z_q = (rq_shift>0) ? mul_shift_round(acc_q[o], rq_mul, rq_shift) : acc_q[o];
         int8_t y_q = clamp_i8(z_q);
         output[o] = (float)y_q * sy; // no activation, softmax later
     }
@@ -0,0 +1,178 @@
+// lenet_apfixed.c — LeNet with every tensor in an emulated ap_[u]fixed<W,I,Q,O> (ap_fixed_emu.h)
+// Strategy:
+//   - One format per layer for the input, the weights and the accumulator (ApFixedConfig),
+//     chosen at run time: a single build sweeps every width
+//   - Bit-accurate to the HLS loop  acc = bias; for (...) acc += x * w;  with acc an
+//     ap_fixed: each += is an exact add followed by an assignment (quantization of the
+//     dropped LSBs, then overflow of the MSBs)
+//   - Fast path, still exact: with AP_WRAP on the accumulator and a quantization that only
+//     depends on the product's own dropped bits (none dropped, AP_TRN, AP_RND, AP_RND_MIN_INF),
+//     the per-add wraps commute with the sum, so the dot product runs in uint64 modular
+//     arithmetic and wraps once at the end
+//   - ReLU on the accumulator, then assignment to the next layer's input format; max-pool
+//     on raw values (assignments are monotonic)
+
+#include "lenet_cnn_float.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -------- Helpers (local to this TU) --------
+
+#define CONV1_PATCH	(IMG_DEPTH * CONV1_DIM * CONV1_DIM)
+#define CONV2_PATCH	(POOL1_NBOUTPUT * CONV2_DIM * CONV2_DIM)
+
+static void check_fmt(const ApFixedFmt *f, int maxw, const char *what){
+    if (f->w < 1 || f->w > maxw - (f->sign ? 0 : 1)) {     // ufixed raw values live in int32 / int64 too
+        printf("Error: %s width %d out of range (1..%d)\n", what, f->w, maxw - (f->sign ? 0 : 1));
+        exit(1);
+    }
+}
+
+// product rounding of the fast path: acc + ((p + add) >> shift), or p << -shift
+static int fast_path(const ApFixedFmt *x, const ApFixedFmt *w, const ApFixedFmt *acc, int *shift, int64_t *add){
+    *shift = ApFrac(x) + ApFrac(w) - ApFrac(acc);
+    *add = 0;
+    if (acc->o != AP_WRAP || *shift > 62 || *shift < -62) return 0;
+    if (*shift <= 0) return 1;
+    if (acc->q == AP_TRN) return 1;
+    if (acc->q == AP_RND) { *add = 1LL << (*shift - 1); return 1; }
+    if (acc->q == AP_RND_MIN_INF) { *add = (1LL << (*shift - 1)) - 1; return 1; }
+    return 0;
+}
+
+// acc = bias; acc += x[k] * w[k], k = 0..n-1, acc in the layer's accumulator format
+static int64_t dot(const int32_t *x, const int32_t *w, int n, int64_t bias, const LenetApFixed *m, int l){
+    const ApFixedFmt *acc = &m->c.acc[l];
+    int k;
+
+    if (m->fast[l]) {
+        uint64_t s = (uint64_t)bias;
+        const int sh = m->shift[l];
+        const int64_t add = m->add[l];
+        if (sh <= 0) {
+            for (k = 0; k < n; k++) s += (uint64_t)((int64_t)x[k] * w[k]) << -sh;
+        } else {
+            for (k = 0; k < n; k++) s += (uint64_t)(((int64_t)x[k] * w[k] + add) >> sh);
+        }
+        return ApOverflow((ap_wide)(int64_t)s, acc);   // wrap of the modular sum
+    } else {
+        const int fp = ApFrac(&m->c.in[l]) + ApFrac(&m->c.w[l]);
+        int64_t a = bias;
+        int frac;
+        for (k = 0; k < n; k++) {
+            ap_wide s = ApAdd(a, ApFrac(acc), (ap_wide)((int64_t)x[k] * w[k]), fp, &frac);
+            a = ApAssign(s, frac, acc);
+        }
+        return a;
+    }
+}
+
+// ReLU, then assignment to the next layer's input format
+static inline int32_t relu_out(int64_t a, const LenetApFixed *m, int l){
+    if (a < 0) a = 0;
+    return (int32_t)ApAssign(a, ApFrac(&m->c.acc[l]), &m->c.in[l + 1]);
+}
+
+static void quantize(const float *src, int32_t *dst, int n, const ApFixedFmt *f){
+    int k;
+    for (k = 0; k < n; k++) dst[k] = (int32_t)ApFromDouble(src[k], f);
+}
+
+static void quantize_bias(const float *src, int64_t *dst, int n, const ApFixedFmt *f){
+    int k;
+    for (k = 0; k < n; k++) dst[k] = ApFromDouble(src[k], f);
+}
+
+// -------- Preparation --------
+
+void PrepareApFixed(LenetApFixed *m, LenetWeights *w, ApFixedConfig *c){
+    int l;
+
+    m->c = *c;
+    for (l = 0; l < APF_NB_LAYERS; l++) {
+        check_fmt(&c->in[l], AP_FIXED_MAX_W, "input");
+        check_fmt(&c->w[l], AP_FIXED_MAX_W, "weight");
+        check_fmt(&c->acc[l], AP_FIXED_MAX_ACC_W, "accumulator");
+        m->fast[l] = fast_path(&c->in[l], &c->w[l], &c->acc[l], &m->shift[l], &m->add[l]);
+    }
+    quantize(&w->conv1_kernel[0][0][0][0], &m->conv1_w[0][0], CONV1_NBOUTPUT * CONV1_PATCH, &c->w[0]);
+    quantize(&w->conv2_kernel[0][0][0][0], &m->conv2_w[0][0], CONV2_NBOUTPUT * CONV2_PATCH, &c->w[1]);
+    quantize(&w->fc1_kernel[0][0][0][0], &m->fc1_w[0][0], FC1_NBOUTPUT * FC1_NBINPUT, &c->w[2]);
+    quantize(&w->fc2_kernel[0][0], &m->fc2_w[0][0], FC2_NBOUTPUT * FC1_NBOUTPUT, &c->w[3]);
+    quantize_bias(w->conv1_bias, m->conv1_b, CONV1_NBOUTPUT, &c->acc[0]);
+    quantize_bias(w->conv2_bias, m->conv2_b, CONV2_NBOUTPUT, &c->acc[1]);
+    quantize_bias(w->fc1_bias, m->fc1_b, FC1_NBOUTPUT, &c->acc[2]);
+    quantize_bias(w->fc2_bias, m->fc2_b, FC2_NBOUTPUT, &c->acc[3]);
+}
+
+// -------- Layers --------
+
+static void conv1_apfixed(int32_t input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], const LenetApFixed *m,
+                          int32_t output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]){
+    int32_t patch[CONV1_PATCH];
+    int y, x, c, ky, kx, o, k;
+
+    for (y = 0; y < CONV1_HEIGHT; y++)
+        for (x = 0; x < CONV1_WIDTH; x++) {
+            k = 0;
+            for (c = 0; c < IMG_DEPTH; c++)
+                for (ky = 0; ky < CONV1_DIM; ky++)
+                    for (kx = 0; kx < CONV1_DIM; kx++)
+                        patch[k++] = input[c][y + ky][x + kx];
+            for (o = 0; o < CONV1_NBOUTPUT; o++)
+                output[o][y][x] = relu_out(dot(patch, m->conv1_w[o], CONV1_PATCH, m->conv1_b[o], m, 0), m, 0);
+        }
+}
+
+static void conv2_apfixed(int32_t input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], const LenetApFixed *m,
+                          int32_t output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]){
+    int32_t patch[CONV2_PATCH];
+    int y, x, c, ky, kx, o, k;
+
+    for (y = 0; y < CONV2_HEIGHT; y++)
+        for (x = 0; x < CONV2_WIDTH; x++) {
+            k = 0;
+            for (c = 0; c < POOL1_NBOUTPUT; c++)
+                for (ky = 0; ky < CONV2_DIM; ky++)
+                    for (kx = 0; kx < CONV2_DIM; kx++)
+                        patch[k++] = input[c][y + ky][x + kx];
+            for (o = 0; o < CONV2_NBOUTPUT; o++)
+                output[o][y][x] = relu_out(dot(patch, m->conv2_w[o], CONV2_PATCH, m->conv2_b[o], m, 1), m, 1);
+        }
+}
+
+// 2x2 stride 2 max-pool on raw values, nb planes of h x w
+static void pool_apfixed(const int32_t *input, int nb, int h, int w, int32_t *output){
+    int c, y, x;
+    for (c = 0; c < nb; c++)
+        for (y = 0; y < h / 2; y++)
+            for (x = 0; x < w / 2; x++) {
+                const int32_t *p = input + (c * h + 2 * y) * w + 2 * x;
+                int32_t v = p[0];
+                if (p[1] > v) v = p[1];
+                if (p[w] > v) v = p[w];
+                if (p[w + 1] > v) v = p[w + 1];
+                output[(c * (h / 2) + y) * (w / 2) + x] = v;
+            }
+}
+
+void lenet_cnn_apfixed(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], const LenetApFixed *m, float output[FC2_NBOUTPUT]){
+    int32_t img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+    int32_t conv1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+    int32_t pool1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+    int32_t conv2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+    int32_t pool2[FC1_NBINPUT];
+    int32_t fc1[FC1_NBOUTPUT];
+    int o;
+
+    quantize(&input[0][0][0], &img[0][0][0], IMG_DEPTH * IMG_HEIGHT * IMG_WIDTH, &m->c.in[0]);
+    conv1_apfixed(img, m, conv1);
+    pool_apfixed(&conv1[0][0][0], CONV1_NBOUTPUT, CONV1_HEIGHT, CONV1_WIDTH, &pool1[0][0][0]);
+    conv2_apfixed(pool1, m, conv2);
+    pool_apfixed(&conv2[0][0][0], CONV2_NBOUTPUT, CONV2_HEIGHT, CONV2_WIDTH, pool2);
+    for (o = 0; o < FC1_NBOUTPUT; o++)
+        fc1[o] = relu_out(dot(pool2, m->fc1_w[o], FC1_NBINPUT, m->fc1_b[o], m, 2), m, 2);
+    for (o = 0; o < FC2_NBOUTPUT; o++)
+        output[o] = (float)ApToDouble(dot(fc1, m->fc2_w[o], FC1_NBOUTPUT, m->fc2_b[o], m, 3), &m->c.acc[3]);
+}
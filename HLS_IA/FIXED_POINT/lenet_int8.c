@@ -0,0 +1,302 @@
+// lenet_int8.c — integer-native LeNet pipeline (int8 activations end to end)
+// Strategy:
+//   - Weights quantized once at load time (int8, per-output-channel scale)
+//   - Activation scales fixed by calibration on float reference activations
+//   - Requantization fused with ReLU (clamp at 0) and max-pool (max over the int32
+//     accumulators, valid because requantization is monotonic per channel)
+//   - Conv1 reads raw uint8 pixels (u8 x s8 products, input scale 1/255), only the
+//     logits are dequantized (before Softmax)
+// Unlike conv_fixed.c/fc_fixed.c/pool_fixed.c, no float tensor between layers.
+
+#include "lenet_cnn_float.h"
+#include <stdint.h>
+#include <math.h>
+
+// -------- Fixed-point helpers (local to this TU) --------
+
+static inline int8_t clamp_relu_i8(int32_t v){
+#pragma HLS INLINE
+    if (v > 127) return 127;
+    if (v < 0) return 0;
+    return (int8_t)v;
+}
+
+static inline int32_t mul_shift_round(int32_t x, int32_t mul, int shift){
+#pragma HLS INLINE
+    long long t = (long long)x * (long long)mul;
+    long long add = (t >= 0) ? (1LL<<(shift-1)) : -(1LL<<(shift-1));
+    return (int32_t)((t + add) >> shift);
+}
+
+// scale M ~= mul / 2^shift with mul in [2^30, 2^31) for full precision
+static void choose_mul_shift(float M, int32_t *mul, int8_t *shift){
+    int e;
+    float f = frexpf(M, &e);                 // M = f * 2^e, f in [0.5, 1)
+    long long m = llroundf(f * 2147483648.0f);
+    if (m == (1LL<<31)) { m >>= 1; e++; }
+    if (31 - e > 62) { *mul = 0; *shift = 1; return; }
+    if (31 - e < 1)  { *mul = 0x7fffffff; *shift = 1; return; } // saturating scale
+    *mul = (int32_t)m; *shift = (int8_t)(31 - e);
+}
+
+static float maxabs_f(const float *p, int n){
+    float m = 0.0f;
+    for (int i=0;i<n;i++){
+        float a = fabsf(p[i]);
+        if (a > m) m = a;
+    }
+    if (m < 1e-8f) m = 1e-8f;
+    return m;
+}
+
+// per-output-channel int8 weights, int32 bias in the accumulator scale, requant mul/shift
+static void quantize_layer(const float *w, const float *b, int nout, int nin,
+                           float s_in, float s_out,
+                           int8_t *w_q, int32_t *b_q, int32_t *mul, int8_t *shift, float *s_acc){
+    for (int o = 0; o < nout; o++){
+        const float sw = maxabs_f(&w[o*nin], nin) / 127.0f;
+        for (int i = 0; i < nin; i++){
+            long v = lrintf(w[o*nin + i] / sw);
+            w_q[o*nin + i] = (int8_t)(v > 127 ? 127 : (v < -127 ? -127 : v));
+        }
+        b_q[o] = (int32_t)lrintf(b[o] / (s_in * sw));
+        if (mul) choose_mul_shift((s_in * sw) / s_out, &mul[o], &shift[o]);
+        if (s_acc) s_acc[o] = s_in * sw;
+    }
+}
+
+static inline float relu(float x){ return x > 0.0f ? x : 0.0f; }
+
+// ---------------- Calibration (float reference, host only) ----------------
+
+void CalibrateInt8(	float 	input[][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n,
+					float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+					float 	conv1_bias[CONV1_NBOUTPUT],
+					float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
+					float 	conv2_bias[CONV2_NBOUTPUT],
+					float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],
+					float 	fc1_bias[FC1_NBOUTPUT],
+					float 	act_max[INT8_NB_ACT]){
+    float conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+    float pool1_output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+    float conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+    float pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+    float fc1_output[FC1_NBOUTPUT];
+
+    act_max[0] = 1.0f; // NormalizeImg range, the int8 pipeline reads the raw 0..255 pixels
+    act_max[1] = act_max[2] = act_max[3] = 0.0f;
+    for (int k = 0; k < n; k++){
+        Conv1_28x28x1_5x5x20_1_0(input[k], conv1_kernel, conv1_bias, conv1_output);
+        for (int i = 0; i < CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH; i++){
+            float v = relu((&conv1_output[0][0][0])[i]);
+            (&conv1_output[0][0][0])[i] = v;
+            if (v > act_max[1]) act_max[1] = v;
+        }
+        Pool1_24x24x20_2x2x20_2_0(conv1_output, pool1_output);
+
+        Conv2_12x12x20_5x5x40_1_0(pool1_output, conv2_kernel, conv2_bias, conv2_output);
+        for (int i = 0; i < CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH; i++){
+            float v = relu((&conv2_output[0][0][0])[i]);
+            (&conv2_output[0][0][0])[i] = v;
+            if (v > act_max[2]) act_max[2] = v;
+        }
+        Pool2_8x8x40_2x2x40_2_0(conv2_output, pool2_output);
+
+        Fc1_40_400(pool2_output, fc1_kernel, fc1_bias, fc1_output);
+        for (int i = 0; i < FC1_NBOUTPUT; i++)
+            if (fc1_output[i] > act_max[3]) act_max[3] = fc1_output[i];
+    }
+    for (int i = 0; i < INT8_NB_ACT; i++)
+        if (act_max[i] < 1e-8f) act_max[i] = 1e-8f;
+}
+
+// ---------------- Weight preparation (once, at load time) ----------------
+
+void PrepareInt8(	LenetInt8 *q,
+					float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+					float 	conv1_bias[CONV1_NBOUTPUT],
+					float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
+					float 	conv2_bias[CONV2_NBOUTPUT],
+					float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],
+					float 	fc1_bias[FC1_NBOUTPUT],
+					float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT],
+					float 	fc2_bias[FC2_NBOUTPUT],
+					float 	act_max[INT8_NB_ACT]){
+    q->act_scale[0] = act_max[0] / 255.0f; // uint8 input
+    for (int i = 1; i < INT8_NB_ACT; i++)
+        q->act_scale[i] = act_max[i] / 127.0f;
+
+    quantize_layer(&conv1_kernel[0][0][0][0], conv1_bias, CONV1_NBOUTPUT, IMG_DEPTH*CONV1_DIM*CONV1_DIM,
+                   q->act_scale[0], q->act_scale[1],
+                   &q->conv1_w[0][0][0][0], q->conv1_b, q->conv1_mul, q->conv1_shift, 0);
+    quantize_layer(&conv2_kernel[0][0][0][0], conv2_bias, CONV2_NBOUTPUT, POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM,
+                   q->act_scale[1], q->act_scale[2],
+                   &q->conv2_w[0][0][0][0], q->conv2_b, q->conv2_mul, q->conv2_shift, 0);
+    quantize_layer(&fc1_kernel[0][0][0][0], fc1_bias, FC1_NBOUTPUT, POOL2_NBOUTPUT*POOL2_HEIGHT*POOL2_WIDTH,
+                   q->act_scale[2], q->act_scale[3],
+                   &q->fc1_w[0][0][0][0], q->fc1_b, q->fc1_mul, q->fc1_shift, 0);
+    quantize_layer(&fc2_kernel[0][0], fc2_bias, FC2_NBOUTPUT, FC1_NBOUTPUT,
+                   q->act_scale[3], 1.0f,
+                   &q->fc2_w[0][0], q->fc2_b, 0, 0, q->fc2_scale);
+}
+
+// ---------------- Layers ----------------
+
+// Conv1 + ReLU + Pool1: [1][28][28] uint8 pixels -> [20][12][12] int8
+// The conv output plane of each channel is kept as int32 accumulators (x innermost,
+// vectorizes on the host), max-pooled on the accumulators and requantized once.
+void Conv1Pool1_28x28x1_5x5x20_int8(
+    uint8_t input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH],
+    int8_t kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+    int32_t bias[CONV1_NBOUTPUT], int32_t mul[CONV1_NBOUTPUT], int8_t shift[CONV1_NBOUTPUT],
+    int8_t output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]
+){
+#pragma HLS INLINE off
+    for (int m = 0; m < CONV1_NBOUTPUT; m++){
+        int32_t acc[CONV1_HEIGHT][CONV1_WIDTH];
+#pragma HLS ARRAY_PARTITION variable=acc complete dim=2
+
+        for (int y = 0; y < CONV1_HEIGHT; y++)
+            for (int x = 0; x < CONV1_WIDTH; x++)
+                acc[y][x] = bias[m];
+
+        for (int c = 0; c < IMG_DEPTH; c++){
+            for (int ky = 0; ky < CONV1_DIM; ky++){
+                for (int kx = 0; kx < CONV1_DIM; kx++){
+                    const int32_t w = kernel[m][c][ky][kx];
+                    for (int y = 0; y < CONV1_HEIGHT; y++){
+#pragma HLS PIPELINE II=1
+                        for (int x = 0; x < CONV1_WIDTH; x++)
+                            acc[y][x] += (int32_t)input[c][y + ky][x + kx] * w;
+                    }
+                }
+            }
+        }
+
+        // ReLU + max-pool + requantize
+        for (int py = 0; py < POOL1_HEIGHT; py++){
+            for (int px = 0; px < POOL1_WIDTH; px++){
+#pragma HLS PIPELINE II=1
+                int32_t best = INT32_MIN;
+                for (int dy = 0; dy < POOL1_DIM; dy++)
+                    for (int dx = 0; dx < POOL1_DIM; dx++){
+                        const int32_t v = acc[py * POOL1_STRIDE + dy][px * POOL1_STRIDE + dx];
+                        if (v > best) best = v;
+                    }
+                output[m][py][px] = clamp_relu_i8(mul_shift_round(best, mul[m], shift[m]));
+            }
+        }
+    }
+}
+
+// Conv2 + ReLU + Pool2: [20][12][12] int8 -> [40][4][4] int8
+// The conv output plane of each channel is kept as int32 accumulators (x innermost,
+// vectorizes on the host), max-pooled on the accumulators and requantized once.
+void Conv2Pool2_12x12x20_5x5x40_int8(
+    int8_t input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH],
+    int8_t kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
+    int32_t bias[CONV2_NBOUTPUT], int32_t mul[CONV2_NBOUTPUT], int8_t shift[CONV2_NBOUTPUT],
+    int8_t output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]
+){
+#pragma HLS INLINE off
+    for (int m = 0; m < CONV2_NBOUTPUT; m++){
+        int32_t acc[CONV2_HEIGHT][CONV2_WIDTH];
+#pragma HLS ARRAY_PARTITION variable=acc complete dim=2
+
+        for (int y = 0; y < CONV2_HEIGHT; y++)
+            for (int x = 0; x < CONV2_WIDTH; x++)
+                acc[y][x] = bias[m];
+
+        for (int c = 0; c < POOL1_NBOUTPUT; c++){
+            for (int ky = 0; ky < CONV2_DIM; ky++){
+                for (int kx = 0; kx < CONV2_DIM; kx++){
+                    const int32_t w = kernel[m][c][ky][kx];
+                    for (int y = 0; y < CONV2_HEIGHT; y++){
+#pragma HLS PIPELINE II=1
+                        for (int x = 0; x < CONV2_WIDTH; x++)
+                            acc[y][x] += (int32_t)input[c][y + ky][x + kx] * w;
+                    }
+                }
+            }
+        }
+
+        // ReLU + max-pool + requantize
+        for (int py = 0; py < POOL2_HEIGHT; py++){
+            for (int px = 0; px < POOL2_WIDTH; px++){
+#pragma HLS PIPELINE II=1
+                int32_t best = INT32_MIN;
+                for (int dy = 0; dy < POOL2_DIM; dy++)
+                    for (int dx = 0; dx < POOL2_DIM; dx++){
+                        const int32_t v = acc[py * POOL2_STRIDE + dy][px * POOL2_STRIDE + dx];
+                        if (v > best) best = v;
+                    }
+                output[m][py][px] = clamp_relu_i8(mul_shift_round(best, mul[m], shift[m]));
+            }
+        }
+    }
+}
+
+// Fc1 + ReLU: [40][4][4] int8 -> [400] int8
+void Fc1_40_400_int8(
+    int8_t input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],
+    int8_t weight[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],
+    int32_t bias[FC1_NBOUTPUT], int32_t mul[FC1_NBOUTPUT], int8_t shift[FC1_NBOUTPUT],
+    int8_t output[FC1_NBOUTPUT]
+){
+#pragma HLS INLINE off
+    for (int o = 0; o < FC1_NBOUTPUT; o++){
+        int32_t acc = bias[o];
+        for (int c = 0; c < POOL2_NBOUTPUT; c++){
+#pragma HLS PIPELINE II=1
+            for (int y = 0; y < POOL2_HEIGHT; y++)
+                for (int x = 0; x < POOL2_WIDTH; x++)
+                    acc += (int32_t)input[c][y][x] * (int32_t)weight[o][c][y][x];
+        }
+        output[o] = clamp_relu_i8(mul_shift_round(acc, mul[o], shift[o]));
+    }
+}
+
+// Fc2: [400] int8 -> [10] float logits (the only dequantization)
+void Fc2_400_10_int8(
+    int8_t input[FC1_NBOUTPUT],
+    int8_t weight[FC2_NBOUTPUT][FC1_NBOUTPUT],
+    int32_t bias[FC2_NBOUTPUT], float scale[FC2_NBOUTPUT],
+    float output[FC2_NBOUTPUT]
+){
+#pragma HLS INLINE off
+    for (int o = 0; o < FC2_NBOUTPUT; o++){
+        int32_t acc = bias[o];
+        for (int i = 0; i < FC1_NBOUTPUT; i++){
+#pragma HLS PIPELINE II=1
+            acc += (int32_t)input[i] * (int32_t)weight[o][i];
+        }
+        output[o] = (float)acc * scale[o];
+    }
+}
+
+// Top level: raw uint8 pixels -> float logits
+void lenet_cnn_int8_u8(unsigned char input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetInt8 *q, float output[FC2_NBOUTPUT]){
+    int8_t pool1_q[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+    int8_t pool2_q[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+    int8_t fc1_q[FC1_NBOUTPUT];
+
+    Conv1Pool1_28x28x1_5x5x20_int8(input, q->conv1_w, q->conv1_b, q->conv1_mul, q->conv1_shift, pool1_q);
+    Conv2Pool2_12x12x20_5x5x40_int8(pool1_q, q->conv2_w, q->conv2_b, q->conv2_mul, q->conv2_shift, pool2_q);
+    Fc1_40_400_int8(pool2_q, q->fc1_w, q->fc1_b, q->fc1_mul, q->fc1_shift, fc1_q);
+    Fc2_400_10_int8(fc1_q, q->fc2_w, q->fc2_b, q->fc2_scale, output);
+}
+
+// Top level: normalized float input [0,1] -> float logits
+void lenet_cnn_int8(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetInt8 *q, float output[FC2_NBOUTPUT]){
+    uint8_t input_q[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+    const float inv_s = 1.0f / q->act_scale[0];
+
+    for (int c = 0; c < IMG_DEPTH; c++)
+        for (int y = 0; y < IMG_HEIGHT; y++)
+            for (int x = 0; x < IMG_WIDTH; x++){
+                long v = lrintf(input[c][y][x] * inv_s);
+                input_q[c][y][x] = (uint8_t)(v > 255 ? 255 : (v < 0 ? 0 : v));
+            }
+
+    lenet_cnn_int8_u8(input_q, q, output);
+}
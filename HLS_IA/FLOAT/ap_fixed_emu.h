@@ -0,0 +1,144 @@
+/**
+  ******************************************************************************
+  * @file    ap_fixed_emu.h
+  * @brief   Header-only, bit-accurate host emulation of Vivado HLS ap_[u]fixed<W,I,Q,O>
+  * @brief   A value is a raw two's complement integer (int64_t) with F = W - I fractional
+  * @brief   bits; the format (ApFixedFmt) is a run-time value, so one build sweeps every
+  * @brief   width. Semantics follow UG902: products and sums are exact (full width), the
+  * @brief   assignment to a format applies the quantization mode on the dropped LSBs, then
+  * @brief   the overflow mode on the W kept bits.
+  * @brief   Host only (intermediates in __int128, GCC / Clang), C and C++.
+  */
+
+#ifndef AP_FIXED_EMU_H_
+#define AP_FIXED_EMU_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+
+#define AP_FIXED_MAX_W	32 	// operands: products fit 64 bits
+#define AP_FIXED_MAX_ACC_W	62 	// accumulators
+
+typedef enum { 		// quantization, on the LSBs dropped by an assignment
+  AP_TRN, 			// toward -inf (Vivado default)
+  AP_TRN_ZERO, 		// toward zero
+  AP_RND, 			// to nearest, ties toward +inf
+  AP_RND_ZERO, 		// to nearest, ties toward zero
+  AP_RND_MIN_INF, 	// to nearest, ties toward -inf
+  AP_RND_INF, 		// to nearest, ties away from zero
+  AP_RND_CONV 		// to nearest, ties to even (convergent)
+} ApQuantMode;
+
+typedef enum { 		// overflow, on the W kept bits
+  AP_WRAP, 			// drop the MSBs (Vivado default)
+  AP_SAT, 			// clamp to MIN / MAX
+  AP_SAT_ZERO, 		// zero on overflow
+  AP_SAT_SYM 		// clamp to -MAX / MAX (signed)
+} ApOverflowMode;
+
+typedef struct {
+  int 				w, i; 		// total and integer bits (I may be < 0 or > W)
+  int 				sign; 		// 1: ap_fixed, 0: ap_ufixed
+  ApQuantMode 		q;
+  ApOverflowMode 	o;
+} ApFixedFmt;
+
+typedef __int128 ap_wide; 		// exact intermediates
+
+static inline ApFixedFmt ApFixed(int w, int i, ApQuantMode q, ApOverflowMode o) {
+  ApFixedFmt f = { w, i, 1, q, o };
+  return f;
+}
+
+static inline ApFixedFmt ApUFixed(int w, int i, ApQuantMode q, ApOverflowMode o) {
+  ApFixedFmt f = { w, i, 0, q, o };
+  return f;
+}
+
+static inline int ApFrac(const ApFixedFmt *f) { return f->w - f->i; }
+
+/* floor(v / 2^d) adjusted by the quantization mode, d > 0 */
+static inline ap_wide ApShiftRound(ap_wide v, int d, ApQuantMode q) {
+  const ap_wide one = 1, half = one << (d - 1), rem = v & ((one << d) - 1);
+  const ap_wide r = v >> d; 	// floor
+
+  switch (q) {
+    case AP_TRN: 		return r;
+    case AP_TRN_ZERO: 	return (v < 0 && rem) ? r + 1 : r;
+    case AP_RND: 		return rem >= half ? r + 1 : r;
+    case AP_RND_ZERO: 	return (rem > half || (rem == half && v < 0)) ? r + 1 : r;
+    case AP_RND_MIN_INF: return rem > half ? r + 1 : r;
+    case AP_RND_INF: 	return (rem > half || (rem == half && v >= 0)) ? r + 1 : r;
+    default: 			return (rem > half || (rem == half && (r & 1))) ? r + 1 : r; 	// AP_RND_CONV
+  }
+}
+
+/* overflow mode on an integer already at the format's LSB */
+static inline int64_t ApOverflow(ap_wide v, const ApFixedFmt *f) {
+  const ap_wide one = 1;
+  const ap_wide max = f->sign ? (one << (f->w - 1)) - 1 : (one << f->w) - 1;
+  const ap_wide min = f->sign ? -max - 1 : 0;
+
+  if (v >= min && v <= max) return (int64_t)v;
+  switch (f->o) {
+    case AP_SAT: 		return (int64_t)(v > max ? max : min);
+    case AP_SAT_ZERO: 	return 0;
+    case AP_SAT_SYM: 	return (int64_t)(v > max ? max : (f->sign ? -max : 0));
+    default: { 			// AP_WRAP: keep the W LSBs
+      unsigned __int128 u = (unsigned __int128)v & (((unsigned __int128)1 << f->w) - 1);
+      if (f->sign && (u >> (f->w - 1))) return (int64_t)((ap_wide)u - (one << f->w));
+      return (int64_t)u;
+    }
+  }
+}
+
+/* assignment of an exact value v * 2^-frac to the format */
+static inline int64_t ApAssign(ap_wide v, int frac, const ApFixedFmt *f) {
+  const int d = frac - ApFrac(f);
+  if (d > 0) v = ApShiftRound(v, d, f->q);
+  else if (d < 0) v = v * ((ap_wide)1 << -d);
+  return ApOverflow(v, f);
+}
+
+/* exact a + b (fractional bits fa, fb), result with max(fa, fb) fractional bits */
+static inline ap_wide ApAdd(ap_wide a, int fa, ap_wide b, int fb, int *frac) {
+  *frac = fa > fb ? fa : fb;
+  return a * ((ap_wide)1 << (*frac - fa)) + b * ((ap_wide)1 << (*frac - fb));
+}
+
+/* double -> format, quantization and overflow as an assignment from double */
+static inline int64_t ApFromDouble(double x, const ApFixedFmt *f) {
+  double 	s = ldexp(x, ApFrac(f)), r = floor(s), rem = s - r; 	// exact
+  ap_wide 	v;
+  int 		tie = rem == 0.5, up;
+
+  switch (f->q) {
+    case AP_TRN: 		up = 0; break;
+    case AP_TRN_ZERO: 	up = x < 0 && rem > 0; break;
+    case AP_RND: 		up = rem >= 0.5; break;
+    case AP_RND_ZERO: 	up = rem > 0.5 || (tie && x < 0); break;
+    case AP_RND_MIN_INF: up = rem > 0.5; break;
+    case AP_RND_INF: 	up = rem > 0.5 || (tie && x >= 0); break;
+    default: 			up = rem > 0.5 || (tie && fmod(r, 2.0) != 0.0); break;
+  }
+  r += up;
+  if (r > 0x1p120) r = 0x1p120; 	// far out of any W <= 64: overflow mode decides
+  if (r < -0x1p120) r = -0x1p120;
+  v = (ap_wide)r;
+  return ApOverflow(v, f);
+}
+
+static inline double ApToDouble(int64_t v, const ApFixedFmt *f) {
+  return ldexp((double)v, -ApFrac(f));
+}
+
+/* "ap_fixed<8,3>", "ap_ufixed<6,2,AP_RND,AP_SAT>" */
+static inline void ApFixedName(const ApFixedFmt *f, char *name, int size) {
+  static const char *q[] = { "AP_TRN", "AP_TRN_ZERO", "AP_RND", "AP_RND_ZERO", "AP_RND_MIN_INF", "AP_RND_INF", "AP_RND_CONV" };
+  static const char *o[] = { "AP_WRAP", "AP_SAT", "AP_SAT_ZERO", "AP_SAT_SYM" };
+  if (f->q == AP_TRN && f->o == AP_WRAP) snprintf(name, size, "%s<%d,%d>", f->sign ? "ap_fixed" : "ap_ufixed", f->w, f->i);
+  else snprintf(name, size, "%s<%d,%d,%s,%s>", f->sign ? "ap_fixed" : "ap_ufixed", f->w, f->i, q[f->q], o[f->o]);
+}
+
+#endif /* AP_FIXED_EMU_H_ */
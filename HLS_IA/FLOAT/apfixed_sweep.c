@@ -0,0 +1,257 @@
+/**
+  ******************************************************************************
+  * @file    apfixed_sweep.c
+  * @brief   Host-side ap_fixed bit-width sweep (lenet_apfixed.c, ap_fixed_emu.h)
+  * @brief   Integer bits of every tensor come from float ranges on -c calibration images
+  * @brief   (weights, inputs after ReLU as ap_ufixed, pre-ReLU accumulators plus -g guard
+  * @brief   bits); each width W of -w then sets the inputs and weights to W bits, with a
+  * @brief   full-precision accumulator, or -A bits. Accuracy is measured on -n test images
+  * @brief   against float lenet_cnn(), and the narrowest W within -e points is printed
+  * @brief   with its formats. The emulation first checks itself against the UG902 mode
+  * @brief   examples, and the fast (modular) accumulation against the per-add reference.
+  * @brief   Usage: apfixed_sweep [-w w1,w2,...] [-n images] [-e budget_points] [-c calib_images]
+  * @brief                        [-q quant] [-o overflow] [-A acc_width] [-Q acc_quant] [-O acc_overflow] [-g guard]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+#define MAX_WIDTHS	32
+#define NAME_SIZE	64
+
+static LenetWeights 	W;
+static LenetApFixed 	M, M_REF;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+
+static const char *QUANT_NAMES[] = { "AP_TRN", "AP_TRN_ZERO", "AP_RND", "AP_RND_ZERO", "AP_RND_MIN_INF", "AP_RND_INF", "AP_RND_CONV" };
+static const char *OVF_NAMES[] = { "AP_WRAP", "AP_SAT", "AP_SAT_ZERO", "AP_SAT_SYM" };
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (!(p[i] > 0.0f)) p[i] = 0.0f;
+}
+
+static float max_abs(const float *p, int n, float m) {
+  for (int i = 0; i < n; i++) if (fabsf(p[i]) > m) m = fabsf(p[i]);
+  return m;
+}
+
+static int parse_mode(const char *s, const char **names, int nb) {
+  for (int k = 0; k < nb; k++) if (!strcmp(s, names[k])) return k;
+  printf("Error: Unknown mode %s.\n", s);
+  exit(1);
+}
+
+/* smallest k with 2^k > m: integer bits of an unsigned range [0, m] */
+static int int_bits(float m) {
+  int e;
+  if (m <= 0.0f) return 1;
+  frexpf(m, &e); 	// m = f * 2^e, f in [0.5, 1)
+  return e;
+}
+
+/* UG902 examples of every quantization and overflow mode, returns the number of failures */
+static int self_check(void) {
+  static const struct { int w, i, q, o; double x, expect; } T[] = {
+    { 3, 2, AP_RND,         AP_WRAP,  1.25,  1.5 }, { 3, 2, AP_RND,         AP_WRAP, -1.25, -1.0 },
+    { 3, 2, AP_RND_ZERO,    AP_WRAP,  1.25,  1.0 }, { 3, 2, AP_RND_ZERO,    AP_WRAP, -1.25, -1.0 },
+    { 3, 2, AP_RND_MIN_INF, AP_WRAP,  1.25,  1.0 }, { 3, 2, AP_RND_MIN_INF, AP_WRAP, -1.25, -1.5 },
+    { 3, 2, AP_RND_INF,     AP_WRAP,  1.25,  1.5 }, { 3, 2, AP_RND_INF,     AP_WRAP, -1.25, -1.5 },
+    { 3, 2, AP_RND_CONV,    AP_WRAP,  0.75,  1.0 }, { 3, 2, AP_RND_CONV,    AP_WRAP, -1.25, -1.0 },
+    { 3, 2, AP_TRN,         AP_WRAP,  1.25,  1.0 }, { 3, 2, AP_TRN,         AP_WRAP, -1.25, -1.5 },
+    { 3, 2, AP_TRN_ZERO,    AP_WRAP,  1.25,  1.0 }, { 3, 2, AP_TRN_ZERO,    AP_WRAP, -1.25, -1.0 },
+    { 4, 4, AP_RND, AP_SAT,      19.0,  7.0 }, { 4, 4, AP_RND, AP_SAT,      -19.0, -8.0 },
+    { 4, 4, AP_RND, AP_SAT_ZERO, 19.0,  0.0 }, { 4, 4, AP_RND, AP_SAT_ZERO, -19.0,  0.0 },
+    { 4, 4, AP_RND, AP_SAT_SYM,  19.0,  7.0 }, { 4, 4, AP_RND, AP_SAT_SYM,  -19.0, -7.0 },
+    { 4, 4, AP_TRN, AP_WRAP,     19.0,  3.0 }, { 4, 4, AP_TRN, AP_WRAP,     -19.0, -3.0 },
+  };
+  const int nb = sizeof(T) / sizeof(T[0]);
+  int k, fail = 0;
+
+  for (k = 0; k < nb; k++) {
+    ApFixedFmt f = ApFixed(T[k].w, T[k].i, (ApQuantMode)T[k].q, (ApOverflowMode)T[k].o);
+    double got = ApToDouble(ApFromDouble(T[k].x, &f), &f);
+    // the same value built exactly with 4 fractional bits and assigned must agree
+    double got_raw = ApToDouble(ApAssign((ap_wide)llround(T[k].x * 16.0), 4, &f), &f);
+    char name[NAME_SIZE];
+    if (got != T[k].expect || got_raw != T[k].expect) {
+      ApFixedName(&f, name, NAME_SIZE);
+      printf("  %s = %g: got %g / %g, expected %g\n", name, T[k].x, got, got_raw, T[k].expect);
+      fail++;
+    }
+  }
+  printf("ap_fixed self-check (UG902 mode examples): %d / %d\n", nb - fail, nb);
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  char 			img_filename[120], name[NAME_SIZE], paths[APF_NB_LAYERS + 1];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  static float 	c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  static float 	c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], p2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+  float 		f1[FC1_NBOUTPUT], out[FC2_NBOUTPUT], ref[FC2_NBOUTPUT], budget = 0.1f, acc, acc_ref;
+  float 		in_max[APF_NB_LAYERS] = { 0 }, w_max[APF_NB_LAYERS], acc_max[APF_NB_LAYERS] = { 0 };
+  int 			widths[MAX_WIDTHS] = { 16, 14, 12, 10, 9, 8, 7, 6, 5, 4 }, nwidths = 10;
+  int 			n = MNIST_TEST_SIZE, ncal = 500, accw = 0, guard = 1, best = -1, i, k, l, ok, mismatch;
+  int 			i_in[APF_NB_LAYERS], i_w[APF_NB_LAYERS], i_acc[APF_NB_LAYERS];
+  ApQuantMode 	q = AP_RND, acc_q = AP_TRN;
+  ApOverflowMode 	o = AP_SAT, acc_o = AP_WRAP;
+  ApFixedConfig 	c, best_c;
+  double 		s, t;
+  char 			*tok;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-w") && i+1 < argc) {
+      for (nwidths = 0, tok = strtok(argv[++i], ","); tok && nwidths < MAX_WIDTHS; tok = strtok(NULL, ","))
+        widths[nwidths++] = atoi(tok);
+    }
+    else if (!strcmp(argv[i], "-n") && i+1 < argc) n = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-e") && i+1 < argc) budget = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) ncal = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-q") && i+1 < argc) q = (ApQuantMode)parse_mode(argv[++i], QUANT_NAMES, 7);
+    else if (!strcmp(argv[i], "-o") && i+1 < argc) o = (ApOverflowMode)parse_mode(argv[++i], OVF_NAMES, 4);
+    else if (!strcmp(argv[i], "-A") && i+1 < argc) accw = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-Q") && i+1 < argc) acc_q = (ApQuantMode)parse_mode(argv[++i], QUANT_NAMES, 7);
+    else if (!strcmp(argv[i], "-O") && i+1 < argc) acc_o = (ApOverflowMode)parse_mode(argv[++i], OVF_NAMES, 4);
+    else if (!strcmp(argv[i], "-g") && i+1 < argc) guard = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-w w1,w2,...] [-n images] [-e budget_points] [-c calib_images]\n"
+             "       [-q quant] [-o overflow] [-A acc_width] [-Q acc_quant] [-O acc_overflow] [-g guard]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (n < 1 || n > MNIST_TEST_SIZE) n = MNIST_TEST_SIZE;
+  if (ncal < 1 || ncal > MNIST_TEST_SIZE) ncal = MNIST_TEST_SIZE;
+
+  if (self_check()) {
+    printf("Error: ap_fixed emulation does not match the documented modes.\n");
+    exit(1);
+  }
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < MNIST_TEST_SIZE; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+
+  // ranges: weights, layer inputs (>= 0) and pre-ReLU accumulators on ncal float runs
+  w_max[0] = max_abs(&W.conv1_kernel[0][0][0][0], sizeof(W.conv1_kernel) / sizeof(float), 0.0f);
+  w_max[1] = max_abs(&W.conv2_kernel[0][0][0][0], sizeof(W.conv2_kernel) / sizeof(float), 0.0f);
+  w_max[2] = max_abs(&W.fc1_kernel[0][0][0][0], sizeof(W.fc1_kernel) / sizeof(float), 0.0f);
+  w_max[3] = max_abs(&W.fc2_kernel[0][0], sizeof(W.fc2_kernel) / sizeof(float), 0.0f);
+  for (i = 0; i < ncal; i++) {
+    in_max[0] = max_abs(&IN[i][0][0][0], IMG_DEPTH*IMG_HEIGHT*IMG_WIDTH, in_max[0]);
+    Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, c1);
+    acc_max[0] = max_abs(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH, acc_max[0]);
+    relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(c1, p1);
+    in_max[1] = max_abs(&p1[0][0][0], POOL1_NBOUTPUT*POOL1_HEIGHT*POOL1_WIDTH, in_max[1]);
+    Conv2_12x12x20_5x5x40_1_0(p1, W.conv2_kernel, W.conv2_bias, c2);
+    acc_max[1] = max_abs(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH, acc_max[1]);
+    relu(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+    Pool2_8x8x40_2x2x40_2_0(c2, p2);
+    in_max[2] = max_abs(&p2[0][0][0], FC1_NBINPUT, in_max[2]);
+    for (k = 0; k < FC1_NBOUTPUT; k++) { 	// Fc1_40_400 applies the ReLU, the accumulator range needs the sign
+      float a = W.fc1_bias[k];
+      for (l = 0; l < FC1_NBINPUT; l++) a += (&p2[0][0][0])[l] * (&W.fc1_kernel[k][0][0][0])[l];
+      if (fabsf(a) > acc_max[2]) acc_max[2] = fabsf(a);
+      f1[k] = a > 0.0f ? a : 0.0f;
+    }
+    in_max[3] = max_abs(f1, FC1_NBOUTPUT, in_max[3]);
+    Fc2_400_10(f1, W.fc2_kernel, W.fc2_bias, out);
+    acc_max[3] = max_abs(out, FC2_NBOUTPUT, acc_max[3]);
+  }
+  printf("\nInteger bits from %d calibration images (accumulators +%d guard)\n", ncal, guard);
+  printf("  %-6s \t %8s %5s \t %8s %5s \t %8s %5s\n", "layer", "max in", "I", "max |w|", "I", "max |acc|", "I");
+  for (l = 0; l < APF_NB_LAYERS; l++) {
+    i_in[l] = int_bits(in_max[l]);
+    i_w[l] = int_bits(w_max[l]) + 1;
+    i_acc[l] = int_bits(acc_max[l]) + 1 + guard;
+    printf("  %-6s \t %8.3f %5d \t %8.3f %5d \t %8.3f %5d\n", l == 0 ? "Conv1" : l == 1 ? "Conv2" : l == 2 ? "Fc1" : "Fc2",
+           in_max[l], i_in[l], w_max[l], i_w[l], acc_max[l], i_acc[l]);
+  }
+
+  s = now();
+  for (i = 0, ok = 0; i < n; i++) {
+    lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, ref);
+    ok += (argmax(ref) == LABELS[i]);
+  }
+  t = now() - s;
+  acc_ref = 100.0f * ok / n;
+  printf("\nfloat lenet_cnn: %.2f%% on %d images, %.2f s\n", acc_ref, n, t);
+  printf("Inputs %s, weights %s, accumulators %s %s %s\n", QUANT_NAMES[q], OVF_NAMES[o],
+         accw ? "ap_fixed<A>" : "full precision", QUANT_NAMES[acc_q], OVF_NAMES[acc_o]);
+  printf("%4s \t %8s \t %7s \t %6s \t %s\n", "W", "accuracy", "delta", "time", "path (F: modular fast path, S: per-add)");
+
+  for (k = 0; k < nwidths; k++) {
+    const int w = widths[k];
+    for (l = 0; l < APF_NB_LAYERS; l++) {
+      c.in[l] = ApUFixed(w, i_in[l], q, o);
+      c.w[l] = ApFixed(w, i_w[l], q, o);
+      c.acc[l] = ApFixed(accw ? accw : i_acc[l] + ApFrac(&c.in[l]) + ApFrac(&c.w[l]), i_acc[l], acc_q, acc_o);
+      if (c.acc[l].w > AP_FIXED_MAX_ACC_W) c.acc[l].w = AP_FIXED_MAX_ACC_W;
+      paths[l] = 'S';
+    }
+    PrepareApFixed(&M, &W, &c);
+    for (l = 0; l < APF_NB_LAYERS; l++) if (M.fast[l]) paths[l] = 'F';
+    paths[APF_NB_LAYERS] = 0;
+
+    // the fast path must be bit-identical to the per-add reference
+    M_REF = M;
+    for (l = 0; l < APF_NB_LAYERS; l++) M_REF.fast[l] = 0;
+    for (i = 0, mismatch = 0; i < 20; i++) {
+      lenet_cnn_apfixed(IN[i], &M, out);
+      lenet_cnn_apfixed(IN[i], &M_REF, ref);
+      mismatch += memcmp(out, ref, sizeof(out)) != 0;
+    }
+    if (mismatch) {
+      printf("Error: W=%d fast path differs from the per-add reference on %d / 20 images.\n", w, mismatch);
+      exit(1);
+    }
+
+    s = now();
+    for (i = 0, ok = 0; i < n; i++) {
+      lenet_cnn_apfixed(IN[i], &M, out);
+      ok += (argmax(out) == LABELS[i]);
+    }
+    t = now() - s;
+    acc = 100.0f * ok / n;
+    printf("%4d \t %7.2f%% \t %+7.2f \t %5.2fs \t %s\n", w, acc, acc - acc_ref, t, paths);
+    if (acc >= acc_ref - budget && (best < 0 || w < best)) { best = w; best_c = c; }
+  }
+
+  if (best < 0) printf("\nNo width within %.2f points of float.\n", budget);
+  else {
+    printf("\nNarrowest datapath within %.2f points of float: W=%d\n", budget, best);
+    for (l = 0; l < APF_NB_LAYERS; l++) {
+      printf("  %-6s \t", l == 0 ? "Conv1" : l == 1 ? "Conv2" : l == 2 ? "Fc1" : "Fc2");
+      ApFixedName(&best_c.in[l], name, NAME_SIZE); printf(" in %s", name);
+      ApFixedName(&best_c.w[l], name, NAME_SIZE); printf(", w %s", name);
+      ApFixedName(&best_c.acc[l], name, NAME_SIZE); printf(", acc %s\n", name);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+/**
+  ******************************************************************************
+  * @file    bench_axi.c
+  * @brief   Streamed Fc1 (Fc1_40_400_stream, fc.c): external memory traffic and bandwidth needs
+  * @brief   Checks that the streamed kernel matches Fc1_40_400 on the real Pool2 activations,
+  * @brief   reports the bytes, bursts and beats moved per image (host simulation counters),
+  * @brief   the on-chip buffer size against the whole weight array, then predicts the Fc1
+  * @brief   time from the memory bandwidth (-b GB/s) and the tile compute time (FC1_NBINPUT
+  * @brief   iterations at II -i, -c MHz): with and without the ping-pong overlap, and the
+  * @brief   bandwidth that keeps the compute fed, or that sustains -r images/s.
+  * @brief   Usage: bench_axi [-n images] [-b GB/s] [-c MHz] [-i II] [-r images/s]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static LenetWeights 	W;
+static float 			P2[MNIST_TEST_SIZE][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (p[i] < 0.0f) p[i] = 0.0f;
+}
+
+int main(int argc, char *argv[]) {
+  int 			nimg = 1000, ii = 1, i, mismatch = 0;
+  double 		gbs = 1.2, mhz = 100.0, rate = 0.0, s, t_dense, t_stream;
+  double 		tile_bytes, load_us, compute_us, serial_us, overlap_us, feed_gbs;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		in[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float 		c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 		a[FC1_NBOUTPUT], b[FC1_NBOUTPUT];
+  AxiWord 		*packed;
+  AxiStats 		st = {0};
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i+1 < argc) gbs = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) mhz = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-i") && i+1 < argc) ii = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i+1 < argc) rate = atof(argv[++i]);
+    else {
+      printf("Usage: %s [-n images] [-b GB/s] [-c MHz] [-i II] [-r images/s]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+  if (gbs <= 0.0 || mhz <= 0.0 || ii < 1) {
+    printf("Error: Invalid -b / -c / -i.\n");
+    exit(1);
+  }
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  packed = aligned_alloc(4096, FC1_STREAM_WORDS * sizeof(AxiWord)); 	// 4 KB aligned, as the m_axi buffer
+  if (!packed) {
+    printf("Error: Cannot allocate the packed weights.\n");
+    exit(1);
+  }
+  FcPackFc1Stream(W.fc1_kernel, packed);
+
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)in, IMG_WIDTH, IMG_HEIGHT);
+    Conv1_28x28x1_5x5x20_1_0(in, W.conv1_kernel, W.conv1_bias, c1);
+    relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(c1, p1);
+    Conv2_12x12x20_5x5x40_1_0(p1, W.conv2_kernel, W.conv2_bias, c2);
+    relu(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+    Pool2_8x8x40_2x2x40_2_0(c2, P2[i]);
+  }
+
+  for (i = 0; i < nimg; i++) {
+    Fc1_40_400(P2[i], W.fc1_kernel, W.fc1_bias, a);
+    Fc1_40_400_stream(P2[i], packed, W.fc1_bias, b, &st);
+    mismatch += memcmp(a, b, sizeof(a)) != 0;
+  }
+
+  s = now(); for (i = 0; i < nimg; i++) Fc1_40_400(P2[i], W.fc1_kernel, W.fc1_bias, a); t_dense = (now() - s) / nimg * 1e6;
+  s = now(); for (i = 0; i < nimg; i++) Fc1_40_400_stream(P2[i], packed, W.fc1_bias, b, NULL); t_stream = (now() - s) / nimg * 1e6;
+
+  printf("%d images, FC1_TILE %d (%d tiles, %d AXI words of %d bits per input)\n", nimg, FC1_TILE, FC1_NB_TILES,
+         FC1_TILE_WORDS, AXI_WORD_BITS);
+  printf("Outputs differing from Fc1_40_400: %d / %d images\n", mismatch, nimg);
+  printf("Host time: dense %.1f us, streamed %.1f us per call\n\n", t_dense, t_stream);
+
+  printf("Traffic per image: %.0f bytes, %.1f bursts, %.1f beats (%.1f beats / burst)\n",
+         (double)st.bytes / st.calls, (double)st.bursts / st.calls, (double)st.beats / st.calls,
+         (double)st.beats / st.bursts);
+  printf("On-chip: 2 tile buffers of %d bytes (%d bytes), instead of %d bytes for the whole weight array\n\n",
+         (int)(FC1_NBINPUT * FC1_TILE_WORDS * sizeof(AxiWord)), (int)(2 * FC1_NBINPUT * FC1_TILE_WORDS * sizeof(AxiWord)),
+         (int)sizeof(W.fc1_kernel));
+
+  // prediction: tile load at gbs, tile compute at FC1_NBINPUT * ii cycles
+  tile_bytes = (double)st.bytes / st.calls / FC1_NB_TILES;
+  load_us = tile_bytes / (gbs * 1e3);
+  compute_us = (double)FC1_NBINPUT * ii / mhz;
+  serial_us = FC1_NB_TILES * (load_us + compute_us);
+  overlap_us = load_us + (FC1_NB_TILES - 1) * (load_us > compute_us ? load_us : compute_us) + compute_us;
+  feed_gbs = tile_bytes / compute_us / 1e3;
+  printf("Prediction at %.2f GB/s, %.0f MHz, II %d: tile load %.2f us, tile compute %.2f us\n", gbs, mhz, ii, load_us, compute_us);
+  printf("  Fc1 without overlap %.1f us, ping-pong %.1f us (%s-bound, x%.2f)\n", serial_us, overlap_us,
+         load_us > compute_us ? "memory" : "compute", serial_us / overlap_us);
+  printf("  Bandwidth to keep the compute fed: %.2f GB/s (%.1f%% of a %d-bit port at %.0f MHz)\n", feed_gbs,
+         100.0 * feed_gbs / (AXI_WORD_BITS / 8 * mhz / 1e3), AXI_WORD_BITS, mhz);
+  if (rate > 0.0)
+    printf("  Bandwidth for %.0f images/s: %.3f GB/s (Fc1 weights only)\n", rate, (double)st.bytes / st.calls * rate / 1e9);
+
+  free(packed);
+  return mismatch != 0;
+}
@@ -0,0 +1,124 @@
+/**
+  ******************************************************************************
+  * @file    bench_cache.c
+  * @brief   Replays a trace of MNIST images with a configurable duplicate ratio
+  * @brief   through lenet_cnn(), without then with the prediction cache (cache.c)
+  * @brief   Usage: bench_cache [-n trace_len] [-d dup_ratio] [-t threads] [-m cache_entries] [-s seed]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static LenetWeights 	W;
+static unsigned char 	(*IMGS)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]; 	// distinct images, indexed by MNIST id
+static int 				*TRACE; 			                        // MNIST id of each request
+static unsigned char 	*PRED[2]; 			                        // prediction per request, per pass
+static int 				trace_len, next_req, pass;
+
+static void *worker(void *arg) {
+  float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 	logits[FC2_NBOUTPUT], prob[FC2_NBOUTPUT];
+  int 		i, k, best;
+
+  (void)arg;
+  while ((i = __sync_fetch_and_add(&next_req, 1)) < trace_len) {
+    unsigned char *img = (unsigned char *)IMGS[TRACE[i]];
+    if (!CacheLookup(img, prob)) {
+      NormalizeImg(img, (float *)input, IMG_WIDTH, IMG_HEIGHT);
+      lenet_cnn(input, W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+                W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, logits);
+      Softmax(logits, prob);
+      CacheInsert(img, prob);
+    }
+    for (best = 0, k = 1; k < FC2_NBOUTPUT; k++)
+      if (prob[k] > prob[best]) best = k;
+    PRED[pass][i] = (unsigned char)best;
+  }
+  return NULL;
+}
+
+static double run_pass(int nthreads) {
+  pthread_t 		tid[64];
+  struct timeval 	start, end;
+  int 				t;
+
+  next_req = 0;
+  gettimeofday(&start, NULL);
+  for (t = 0; t < nthreads; t++) pthread_create(&tid[t], NULL, worker, NULL);
+  for (t = 0; t < nthreads; t++) pthread_join(tid[t], NULL);
+  gettimeofday(&end, NULL);
+  return (double)(end.tv_sec-start.tv_sec) + (double)(end.tv_usec-start.tv_usec)/1000000.0;
+}
+
+int main(int argc, char *argv[]) {
+  float 	dup_ratio = 0.5f;
+  int 		nthreads = 1, cache_entries = 4096, seed = 1;
+  int 		i, fresh, mismatch;
+  char 		img_filename[120];
+  double 	t_nocache, t_cache;
+  unsigned long long hits, misses, evictions;
+
+  trace_len = MNIST_TEST_SIZE;
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) trace_len = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-d") && i+1 < argc) dup_ratio = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i+1 < argc) nthreads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && i+1 < argc) cache_entries = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) seed = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n trace_len] [-d dup_ratio] [-t threads] [-m cache_entries] [-s seed]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nthreads < 1) nthreads = 1;
+  if (nthreads > 64) nthreads = 64;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+
+  // build the trace: a duplicate re-sends any earlier request, otherwise the next unseen image
+  TRACE = (int *)malloc(trace_len * sizeof(int));
+  PRED[0] = (unsigned char *)malloc(trace_len);
+  PRED[1] = (unsigned char *)malloc(trace_len);
+  IMGS = calloc(MNIST_TEST_SIZE, sizeof(*IMGS));
+  srand(seed);
+  for (i = 0, fresh = 0; i < trace_len; i++) {
+    if (i > 0 && (float)rand() / RAND_MAX < dup_ratio)
+      TRACE[i] = TRACE[rand() % i];
+    else {
+      TRACE[i] = fresh % MNIST_TEST_SIZE;
+      if (fresh < MNIST_TEST_SIZE) {
+        MnistImgFilename(img_filename, fresh);
+        ReadPgmFile(img_filename, (unsigned char *)IMGS[fresh]);
+      }
+      fresh++;
+    }
+  }
+
+  printf("Trace: %d requests, %d distinct images (dup ratio %.2f), %d thread(s)\n",
+         trace_len, fresh < MNIST_TEST_SIZE ? fresh : MNIST_TEST_SIZE, dup_ratio, nthreads);
+
+  pass = 0;
+  t_nocache = run_pass(nthreads);
+
+  CacheInit(cache_entries);
+  pass = 1;
+  t_cache = run_pass(nthreads);
+  CacheStats(&hits, &misses, &evictions);
+  CacheFree();
+
+  for (i = 0, mismatch = 0; i < trace_len; i++)
+    if (PRED[0][i] != PRED[1][i]) mismatch++;
+
+  printf("No cache   : %f s \t %.0f img/s\n", t_nocache, trace_len / t_nocache);
+  printf("Cache %5d: %f s \t %.0f img/s \t speedup x%.2f\n", cache_entries, t_cache, trace_len / t_cache, t_nocache / t_cache);
+  printf("Hits %llu, misses %llu, evictions %llu (hit rate %.2f%%)\n", hits, misses, evictions, 100.0 * hits / (hits + misses));
+  printf("Prediction mismatches vs no cache: %d\n", mismatch);
+
+  free(TRACE); free(PRED[0]); free(PRED[1]); free(IMGS);
+  return mismatch != 0;
+}
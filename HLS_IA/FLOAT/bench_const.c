@@ -0,0 +1,111 @@
+/**
+  ******************************************************************************
+  * @file    bench_const.c
+  * @brief   Weight-specialized Conv1 / Conv2 (conv_const.c, conv_codegen) against conv.c
+  * @brief   Runs the generic kernels on the weights the generated ones were built from
+  * @brief   (conv1_const_kernel, conv2_const_kernel), counts the differing outputs, and times
+  * @brief   both on the real MNIST activations. When the generator rounded the weights
+  * @brief   (conv_codegen -b), also reports the accuracy of the network with those weights.
+  * @brief   Usage: bench_const [-n images]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static LenetWeights 	W;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static float 			P1[MNIST_TEST_SIZE][POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (p[i] < 0.0f) p[i] = 0.0f;
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+static long differ(const float *a, const float *b, int n) {
+  long d = 0;
+  for (int i = 0; i < n; i++) d += (a[i] != b[i]);
+  return d;
+}
+
+int main(int argc, char *argv[]) {
+  int 			nimg = 1000, i, ok_ref, ok_const;
+  long 			d1 = 0, d2 = 0;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  static float 	a1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], b1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+  static float 	a2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], b2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 		out[FC2_NBOUTPUT];
+  double 		s, t[4];
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n images]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+    Conv1_28x28x1_5x5x20_1_0(IN[i], conv1_const_kernel, W.conv1_bias, a1);
+    relu(&a1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(a1, P1[i]);
+  }
+
+  for (i = 0; i < nimg; i++) {
+    Conv1_28x28x1_5x5x20_1_0(IN[i], conv1_const_kernel, W.conv1_bias, a1);
+    Conv1_28x28x1_5x5x20_1_0_const(IN[i], b1);
+    d1 += differ(&a1[0][0][0], &b1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Conv2_12x12x20_5x5x40_1_0(P1[i], conv2_const_kernel, W.conv2_bias, a2);
+    Conv2_12x12x20_5x5x40_1_0_const(P1[i], b2);
+    d2 += differ(&a2[0][0][0], &b2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+  }
+
+  s = now(); for (i = 0; i < nimg; i++) Conv1_28x28x1_5x5x20_1_0(IN[i], conv1_const_kernel, W.conv1_bias, a1); t[0] = (now() - s) / nimg * 1e6;
+  s = now(); for (i = 0; i < nimg; i++) Conv1_28x28x1_5x5x20_1_0_const(IN[i], b1); t[1] = (now() - s) / nimg * 1e6;
+  s = now(); for (i = 0; i < nimg; i++) Conv2_12x12x20_5x5x40_1_0(P1[i], conv2_const_kernel, W.conv2_bias, a2); t[2] = (now() - s) / nimg * 1e6;
+  s = now(); for (i = 0; i < nimg; i++) Conv2_12x12x20_5x5x40_1_0_const(P1[i], b2); t[3] = (now() - s) / nimg * 1e6;
+
+  printf("%d images, conv_const.c generated from %s\n", nimg, conv_const_bits ? "rounded weights" : "the float weights");
+  printf("Conv1: generic %7.1f us \t specialized %7.1f us \t x%.2f \t differing outputs %ld\n", t[0], t[1], t[0] / t[1], d1);
+  printf("Conv2: generic %7.1f us \t specialized %7.1f us \t x%.2f \t differing outputs %ld\n", t[2], t[3], t[2] / t[3], d2);
+
+  if (conv_const_bits) {
+    for (i = 0, ok_ref = 0, ok_const = 0; i < nimg; i++) {
+      lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+                W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, out);
+      ok_ref += (argmax(out) == LABELS[i]);
+      lenet_cnn(IN[i], conv1_const_kernel, W.conv1_bias, conv2_const_kernel, W.conv2_bias,
+                W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, out);
+      ok_const += (argmax(out) == LABELS[i]);
+    }
+    printf("Accuracy: float weights %.2f%%, %d-bit Conv1 / Conv2 weights %.2f%%\n",
+           100.0f * ok_ref / nimg, conv_const_bits, 100.0f * ok_const / nimg);
+  }
+  return d1 || d2;
+}
@@ -0,0 +1,112 @@
+/**
+  ******************************************************************************
+  * @file    bench_delta.c
+  * @brief   Incremental inference (delta.c) vs full lenet_cnn() on near-duplicate frames
+  * @brief   Each sequence starts on an MNIST digit; every next frame changes k random
+  * @brief   pixels of the previous one. Checks the exact mode bit for bit against
+  * @brief   lenet_cnn(), reports the sparse-delta deviation, time and skipped work.
+  * @brief   Usage: bench_delta [-n sequences] [-l frames_per_sequence] [-k changed_pixels] [-s seed]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  int 			nseq = 50, len = 20, nchanged = 4, seed = 1;
+  int 			nframes, f, i, k, mismatch = 0, agree = 0;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		(*frames)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		(*ref)[FC2_NBOUTPUT], out[FC2_NBOUTPUT], maxdiff = 0.0f, layer[DELTA_NB_LAYERS];
+  double 		t_full, t_exact, t_sparse;
+  LenetWeights 	W;
+  static DeltaState 	exact, sparse;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nseq = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-l") && i+1 < argc) len = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-k") && i+1 < argc) nchanged = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) seed = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n sequences] [-l frames_per_sequence] [-k changed_pixels] [-s seed]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nseq < 1 || nseq > MNIST_TEST_SIZE) nseq = 50;
+  if (len < 1) len = 1;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+
+  // frame sequences
+  nframes = nseq * len;
+  frames = malloc(nframes * sizeof(*frames));
+  ref = malloc(nframes * sizeof(*ref));
+  srand(seed);
+  for (f = 0; f < nframes; f++) {
+    if (f % len == 0) {
+      MnistImgFilename(img_filename, f / len);
+      ReadPgmFile(img_filename, (unsigned char *)img);
+    }
+    else
+      for (k = 0; k < nchanged; k++)
+        img[0][rand() % IMG_HEIGHT][rand() % IMG_WIDTH] = (unsigned char)(rand() % 256);
+    NormalizeImg((unsigned char *)img, (float *)frames[f], IMG_WIDTH, IMG_HEIGHT);
+  }
+
+  t_full = now();
+  for (f = 0; f < nframes; f++)
+    lenet_cnn(frames[f], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, ref[f]);
+  t_full = now() - t_full;
+
+  DeltaInit(&exact, 1);
+  t_exact = now();
+  for (f = 0; f < nframes; f++) {
+    lenet_cnn_delta(&exact, frames[f], &W, out);
+    if (memcmp(out, ref[f], sizeof(out))) mismatch++;
+  }
+  t_exact = now() - t_exact;
+
+  DeltaInit(&sparse, 0);
+  t_sparse = now();
+  for (f = 0; f < nframes; f++) {
+    lenet_cnn_delta(&sparse, frames[f], &W, out);
+    if (argmax(out) == argmax(ref[f])) agree++;
+    for (k = 0; k < FC2_NBOUTPUT; k++) {
+      float d = out[k] > ref[f][k] ? out[k] - ref[f][k] : ref[f][k] - out[k];
+      if (d > maxdiff) maxdiff = d;
+    }
+  }
+  t_sparse = now() - t_sparse;
+
+  printf("%d sequences x %d frames, %d pixel(s) changed per frame\n", nseq, len, nchanged);
+  printf("Full lenet_cnn   : %8.1f us/frame\n", t_full/nframes*1e6);
+  printf("Delta, exact FC1 : %8.1f us/frame \t x%.2f \t work skipped %.1f%%",
+         t_exact/nframes*1e6, t_full/t_exact, 100*DeltaSkipped(&exact, layer));
+  printf(" (Conv1 %.1f%%, Conv2 %.1f%%, FC1 %.1f%%)\n", 100*layer[0], 100*layer[1], 100*layer[2]);
+  printf("Delta, sparse FC1: %8.1f us/frame \t x%.2f \t work skipped %.1f%%",
+         t_sparse/nframes*1e6, t_full/t_sparse, 100*DeltaSkipped(&sparse, layer));
+  printf(" (Conv1 %.1f%%, Conv2 %.1f%%, FC1 %.1f%%)\n", 100*layer[0], 100*layer[1], 100*layer[2]);
+  printf("Pool scale resets: %llu (of %d frames)\n", exact.scale_resets, nframes);
+  printf("Exact mode: %d / %d frames differ from lenet_cnn() (bit-exact logits)\n", mismatch, nframes);
+  printf("Sparse mode: argmax agreement %d / %d, max |logit diff| %g\n", agree, nframes, maxdiff);
+
+  free(frames); free(ref);
+  return mismatch != 0;
+}
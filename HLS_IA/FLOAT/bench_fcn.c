@@ -0,0 +1,135 @@
+/**
+  ******************************************************************************
+  * @file    bench_fcn.c
+  * @brief   Fully-convolutional score map (fcn.c) vs cropping every patch into lenet_cnn()
+  * @brief   Builds a page of GxG MNIST digits (one per 32x32 cell, random offset aligned
+  * @brief   to the stride), scans it both ways, and reports time, agreement of the two
+  * @brief   maps and digit accuracy read from the map at the digit positions.
+  * @brief   The maps are not expected to match exactly: fcn.c pools on the float values,
+  * @brief   lenet_cnn() on its per-tensor int8 quantization (known deviation, ~1% argmax).
+  * @brief   Usage: bench_fcn [-g grid] [-s stride] [-r x,y,w,h] [-p (skip per-patch pass)]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+#define CELL	32
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  int 			grid = 8, stride = 4, patches = 1;
+  int 			width, height, nx, ny, i, j, k, y, g, agree = 0, correct = 0, scored = 0;
+  int 			*dx, *dy;
+  char 			img_filename[120];
+  unsigned char *page, digit[IMG_HEIGHT*IMG_WIDTH], labels[MNIST_TEST_SIZE];
+  unsigned char patch[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		*map, *ref, input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], logits[FC2_NBOUTPUT];
+  float 		maxdiff = 0.0f;
+  double 		t_fcn, t_ref = 0;
+  FcnRoi 		roi = {0, 0, 0, 0};
+  LenetWeights 	W;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-g") && i+1 < argc) grid = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) stride = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i+1 < argc) sscanf(argv[++i], "%d,%d,%d,%d", &roi.x, &roi.y, &roi.width, &roi.height);
+    else if (!strcmp(argv[i], "-p")) patches = 0;
+    else {
+      printf("Usage: %s [-g grid] [-s stride] [-r x,y,w,h] [-p]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (grid < 1 || grid*grid > MNIST_TEST_SIZE) grid = 8;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", labels, MNIST_TEST_SIZE);
+
+  // page: digit g in cell (g / grid, g % grid) at a random offset, multiple of the stride
+  width = height = grid * CELL;
+  page = (unsigned char *)calloc((long)width*height, 1);
+  dx = (int *)malloc(grid*grid*sizeof(int));
+  dy = (int *)malloc(grid*grid*sizeof(int));
+  srand(1);
+  for (g = 0; g < grid*grid; g++) {
+    dx[g] = (g % grid) * CELL + ((rand() % (CELL - IMG_WIDTH + 1)) / stride) * stride;
+    dy[g] = (g / grid) * CELL + ((rand() % (CELL - IMG_HEIGHT + 1)) / stride) * stride;
+    MnistImgFilename(img_filename, g);
+    ReadPgmFile(img_filename, digit);
+    for (y = 0; y < IMG_HEIGHT; y++)
+      memcpy(page + (long)(dy[g] + y)*width + dx[g], digit + y*IMG_WIDTH, IMG_WIDTH);
+  }
+  if (roi.width == 0) { roi.width = width - roi.x; roi.height = height - roi.y; }
+  if (LenetFcnMapSize(roi.width, roi.height, stride, &nx, &ny)) {
+    printf("Error: stride must divide or be a multiple of 4, ROI at least %dx%d\n", IMG_WIDTH, IMG_HEIGHT);
+    exit(1);
+  }
+  map = (float *)malloc((long)nx*ny*FC2_NBOUTPUT*sizeof(float));
+  ref = (float *)malloc((long)nx*ny*FC2_NBOUTPUT*sizeof(float));
+
+  printf("Page %dx%d (%d digits), ROI %d,%d %dx%d, stride %d -> %dx%d score map\n",
+         width, height, grid*grid, roi.x, roi.y, roi.width, roi.height, stride, nx, ny);
+
+  t_fcn = now();
+  if (LenetFcn(page, width, height, &roi, stride, &W, map, &nx, &ny)) {
+    printf("Error: invalid ROI\n");
+    exit(1);
+  }
+  t_fcn = now() - t_fcn;
+
+  if (patches) {
+    // baseline: crop each patch, NormalizeImg, lenet_cnn, Softmax
+    t_ref = now();
+    for (i = 0; i < ny; i++)
+      for (j = 0; j < nx; j++) {
+        for (y = 0; y < IMG_HEIGHT; y++)
+          memcpy(patch[0][y], page + (long)(roi.y + i*stride + y)*width + roi.x + j*stride, IMG_WIDTH);
+        NormalizeImg((unsigned char *)patch, (float *)input, IMG_WIDTH, IMG_HEIGHT);
+        lenet_cnn(input, W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+                  W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, logits);
+        Softmax(logits, ref + ((long)i*nx + j)*FC2_NBOUTPUT);
+      }
+    t_ref = now() - t_ref;
+    for (k = 0; k < nx*ny; k++) {
+      float *a = map + (long)k*FC2_NBOUTPUT, *b = ref + (long)k*FC2_NBOUTPUT;
+      if (argmax(a) == argmax(b)) agree++;
+      for (i = 0; i < FC2_NBOUTPUT; i++) {
+        float d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        if (d > maxdiff) maxdiff = d;
+      }
+    }
+  }
+
+  // digits whose exact position is on the map
+  for (g = 0; g < grid*grid; g++) {
+    int ox = dx[g] - roi.x, oy = dy[g] - roi.y;
+    if (ox < 0 || oy < 0 || ox % stride || oy % stride || ox/stride >= nx || oy/stride >= ny) continue;
+    scored++;
+    if (argmax(map + ((long)(oy/stride)*nx + ox/stride)*FC2_NBOUTPUT) == labels[g]) correct++;
+  }
+
+  printf("Fully convolutional: %10.3f ms \t %8.1f us/patch\n", t_fcn*1000, t_fcn*1e6/(nx*ny));
+  if (patches) {
+    printf("Per-patch lenet_cnn: %10.3f ms \t %8.1f us/patch \t speedup x%.2f\n", t_ref*1000, t_ref*1e6/(nx*ny), t_ref/t_fcn);
+    printf("Map agreement: argmax %d / %d (%.2f%%), max |prob diff| %g\n", agree, nx*ny, 100.0*agree/(nx*ny), maxdiff);
+    printf("  known deviation, not an error: fcn.c max-pools the float maps, lenet_cnn() its int8-quantized ones\n");
+  }
+  printf("Digits on the map: %d / %d correct\n", correct, scored);
+
+  free(page); free(dx); free(dy); free(map); free(ref);
+  return 0;
+}
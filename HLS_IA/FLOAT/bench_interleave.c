@@ -0,0 +1,98 @@
+/**
+  ******************************************************************************
+  * @file    bench_interleave.c
+  * @brief   Image-interleaved Conv1 + Pool1 (interleave.c) against the per-image kernels
+  * @brief   Checks that Conv1Pool1_interleaved gives the Pool1 outputs of Conv1, ReLU, Pool1
+  * @brief   for every image (including a partial last group) and that lenet_cnn_interleaved
+  * @brief   matches lenet_cnn(), then times Conv1 + Pool1 and the whole network per image.
+  * @brief   Build with -DINTERLEAVE_LANES=8 for 8 lanes, add -march=native for wide vectors.
+  * @brief   Usage: bench_interleave [-n images]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static LenetWeights 	W;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static float 			P1[MNIST_TEST_SIZE][POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+static float 			Q1[MNIST_TEST_SIZE][POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+static float 			OUT_REF[MNIST_TEST_SIZE][FC2_NBOUTPUT], OUT[MNIST_TEST_SIZE][FC2_NBOUTPUT];
+static float 			IL[IMG_HEIGHT][IMG_WIDTH][INTERLEAVE_LANES];
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (p[i] < 0.0f) p[i] = 0.0f;
+}
+
+static void conv1_pool1(int i) {
+  float c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+  Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, c1);
+  relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+  Pool1_24x24x20_2x2x20_2_0(c1, P1[i]);
+}
+
+static void conv1_pool1_interleaved(int n) {
+  for (int b = 0; b < n; b += INTERLEAVE_LANES) {
+    int nb = n - b < INTERLEAVE_LANES ? n - b : INTERLEAVE_LANES;
+    InterleaveImages(IN + b, nb, IL);
+    Conv1Pool1_interleaved(IL, W.conv1_kernel, W.conv1_bias, nb, Q1 + b);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int 			nimg = 1000, i, d1 = 0, d2 = 0;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  double 		s, t[4];
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n images]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+
+  for (i = 0; i < nimg; i++) conv1_pool1(i);
+  conv1_pool1_interleaved(nimg);
+  for (i = 0; i < nimg; i++) d1 += memcmp(P1[i], Q1[i], sizeof(P1[i])) != 0;
+  for (i = 0; i < nimg; i++)
+    lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, OUT_REF[i]);
+  lenet_cnn_interleaved(IN, nimg, &W, OUT);
+  for (i = 0; i < nimg; i++) d2 += memcmp(OUT_REF[i], OUT[i], sizeof(OUT[i])) != 0;
+
+  s = now(); for (i = 0; i < nimg; i++) conv1_pool1(i); t[0] = (now() - s) / nimg * 1e6;
+  s = now(); conv1_pool1_interleaved(nimg); t[1] = (now() - s) / nimg * 1e6;
+  s = now();
+  for (i = 0; i < nimg; i++)
+    lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, OUT_REF[i]);
+  t[2] = (now() - s) / nimg * 1e6;
+  s = now(); lenet_cnn_interleaved(IN, nimg, &W, OUT); t[3] = (now() - s) / nimg * 1e6;
+
+  printf("%d images, %d lanes (%d groups, last one %d images)\n", nimg, INTERLEAVE_LANES,
+         (nimg + INTERLEAVE_LANES - 1) / INTERLEAVE_LANES, nimg % INTERLEAVE_LANES ? nimg % INTERLEAVE_LANES : INTERLEAVE_LANES);
+  printf("Images with differing Pool1 outputs: %d, differing network outputs: %d\n", d1, d2);
+  printf("Conv1 + Pool1: per image %7.1f us \t interleaved %7.1f us \t x%.2f\n", t[0], t[1], t[0] / t[1]);
+  printf("Network:       per image %7.1f us \t interleaved %7.1f us \t x%.2f\n", t[2], t[3], t[2] / t[3]);
+  return d1 || d2;
+}
@@ -0,0 +1,106 @@
+/**
+  ******************************************************************************
+  * @file    bench_latency.c
+  * @brief   Single-image latency of lenet_cnn_parallel() (lenet_par.c) vs thread count
+  * @brief   For 1..T threads: median and mean latency per image, speedup over the
+  * @brief   serial lenet_cnn(), cost of an empty team round (barrier overhead) and
+  * @brief   a bit-exactness check against lenet_cnn().
+  * @brief   Usage: bench_latency [-n images] [-t max_threads]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double d = *(const double *)a - *(const double *)b;
+  return (d > 0) - (d < 0);
+}
+
+static void empty_job(void *arg, int id, int nthreads) {
+  (void)arg; (void)id; (void)nthreads;
+}
+
+static LenetWeights 	W;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static float 			REF[MNIST_TEST_SIZE][FC2_NBOUTPUT];
+
+int main(int argc, char *argv[]) {
+  int 			nimg = 500, tmax = 2 * sysconf(_SC_NPROCESSORS_ONLN), i, t, mismatch, best_t = 1;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		out[FC2_NBOUTPUT];
+  double 		*lat, s, serial, mean, best = 1e9;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i+1 < argc) tmax = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n images] [-t max_threads]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+  if (tmax < 1) tmax = 1;
+  if (tmax > TEAM_MAX) tmax = TEAM_MAX;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+  lat = (double *)malloc(nimg * sizeof(double));
+
+  s = now();
+  for (i = 0; i < nimg; i++)
+    lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, REF[i]);
+  serial = (now() - s) / nimg * 1e6;
+
+  printf("%d images, %ld online cpu(s), serial lenet_cnn %.1f us/image\n", nimg, sysconf(_SC_NPROCESSORS_ONLN), serial);
+  printf("threads \t median us \t mean us \t speedup \t empty round us \t mismatches\n");
+  for (t = 1; t <= tmax; t++) {
+    TeamInit(t);
+    // warm up the team, then time an empty round (hand-off + one barrier)
+    for (i = 0; i < 100; i++) TeamRun(empty_job, NULL);
+    s = now();
+    for (i = 0; i < 1000; i++) TeamRun(empty_job, NULL);
+    s = (now() - s) / 1000 * 1e6;
+
+    mismatch = 0;
+    for (i = 0; i < nimg; i++) {
+      double t0 = now();
+      lenet_cnn_parallel(IN[i], &W, out);
+      lat[i] = (now() - t0) * 1e6;
+      if (memcmp(out, REF[i], sizeof(out))) mismatch++;
+    }
+    TeamFree();
+
+    for (mean = 0, i = 0; i < nimg; i++) mean += lat[i];
+    mean /= nimg;
+    qsort(lat, nimg, sizeof(double), cmp_double);
+    if (lat[nimg/2] < best) { best = lat[nimg/2]; best_t = t; }
+    printf("%3d \t\t %8.1f \t %8.1f \t x%.2f \t\t %8.2f \t %d\n", t, lat[nimg/2], mean, serial / lat[nimg/2], s, mismatch);
+  }
+  if (tmax == 1)
+    printf("Single thread tested, no scaling to report (use -t)\n");
+  else if (best_t < tmax)
+    printf("Lowest median latency with %d thread(s); beyond that, synchronization outweighs the split work\n", best_t);
+  else
+    printf("Lowest median latency with %d thread(s), the most tested: latency still improving, try a larger -t\n", best_t);
+
+  free(lat);
+  return 0;
+}
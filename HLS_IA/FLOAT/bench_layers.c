@@ -0,0 +1,279 @@
+/**
+  ******************************************************************************
+  * @file    bench_layers.c
+  * @brief   Per-layer kernel microbenchmarks, every layer in isolation on randomized inputs
+  * @brief   Backends: float reference, line-buffer Conv (conv.c), zero-skipping FC (fc.c)
+  * @brief   and the FIXED_POINT int8 drop-in kernels. Hot rows loop the call with warm
+  * @brief   weights for each repetition count, the cold row flushes the caches before
+  * @brief   every call (input re-touched, weights cold). Reports ns/call, its standard
+  * @brief   deviation over the trials and GFLOP/s (MACs count 2, pool compares 1).
+  * @brief   -w writes the results as a baseline file, -b compares against one and flags
+  * @brief   the rows slower than the baseline by more than -T percent and by more than
+  * @brief   twice the combined standard deviation (exit status 2).
+  * @brief   Usage: bench_layers [-r reps,reps,...] [-t trials] [-c flush_MB] [-s seed]
+  * @brief                       [-k kernel] [-w baseline] [-b baseline [-T percent]]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "lenet_cnn_float.h"
+
+// FIXED_POINT kernels (../FIXED_POINT, built with -DFIXED_POINT), float I/O
+void Conv1_28x28x1_5x5x20_1_0_fixed(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+                                    float bias[CONV1_NBOUTPUT], float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]);
+void Pool1_24x24x20_2x2x20_2_0_fixed(float input[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], float output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]);
+void Conv2_12x12x20_5x5x40_1_0_fixed(float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
+                                     float bias[CONV2_NBOUTPUT], float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]);
+void Pool2_8x8x40_2x2x40_2_0_fixed(float input[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], float output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]);
+void Fc1_40_400_fixed(float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], float kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],
+                      float bias[FC1_NBOUTPUT], float output[FC1_NBOUTPUT]);
+void Fc2_400_10_fixed(float input[FC1_NBOUTPUT], float kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], float bias[FC2_NBOUTPUT], float output[FC2_NBOUTPUT]);
+
+#define MAX_REPS	8
+#define MAX_ROWS	128
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t); 	// ns resolution for the single cold calls
+  return (double)t.tv_sec + (double)t.tv_nsec/1000000000.0;
+}
+
+// layer inputs, weights and outputs
+static float 	IMG[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static float 	C1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], P1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+static float 	C2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], P2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+static float 	F1[FC1_NBOUTPUT], F2[FC2_NBOUTPUT], SM[FC2_NBOUTPUT];
+static float 	C1_OUT[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], P1_OUT[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+static float 	C2_OUT[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], P2_OUT[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+static float 	F1_OUT[FC1_NBOUTPUT], F2_OUT[FC2_NBOUTPUT];
+static LenetWeights W;
+static float 	FC1_T[FC1_NBINPUT][FC1_NBOUTPUT], FC2_T[FC1_NBOUTPUT][FC2_NBOUTPUT];
+
+static void conv1_float(void)  { Conv1_28x28x1_5x5x20_1_0(IMG, W.conv1_kernel, W.conv1_bias, C1_OUT); }
+static void conv1_lb(void)     { Conv1_28x28x1_5x5x20_1_0_lb(IMG, W.conv1_kernel, W.conv1_bias, C1_OUT); }
+static void conv1_fixed(void)  { Conv1_28x28x1_5x5x20_1_0_fixed(IMG, W.conv1_kernel, W.conv1_bias, C1_OUT); }
+static void pool1_float(void)  { Pool1_24x24x20_2x2x20_2_0(C1, P1_OUT); }
+static void pool1_fixed(void)  { Pool1_24x24x20_2x2x20_2_0_fixed(C1, P1_OUT); }
+static void conv2_float(void)  { Conv2_12x12x20_5x5x40_1_0(P1, W.conv2_kernel, W.conv2_bias, C2_OUT); }
+static void conv2_lb(void)     { Conv2_12x12x20_5x5x40_1_0_lb(P1, W.conv2_kernel, W.conv2_bias, C2_OUT); }
+static void conv2_fixed(void)  { Conv2_12x12x20_5x5x40_1_0_fixed(P1, W.conv2_kernel, W.conv2_bias, C2_OUT); }
+static void pool2_float(void)  { Pool2_8x8x40_2x2x40_2_0(C2, P2_OUT); }
+static void pool2_fixed(void)  { Pool2_8x8x40_2x2x40_2_0_fixed(C2, P2_OUT); }
+static void fc1_float(void)    { Fc1_40_400(P2, W.fc1_kernel, W.fc1_bias, F1_OUT); }
+static void fc1_sparse(void)   { Fc1_40_400_sparse(P2, FC1_T, W.fc1_bias, F1_OUT, NULL); }
+static void fc1_fixed(void)    { Fc1_40_400_fixed(P2, W.fc1_kernel, W.fc1_bias, F1_OUT); }
+static void fc2_float(void)    { Fc2_400_10(F1, W.fc2_kernel, W.fc2_bias, F2_OUT); }
+static void fc2_sparse(void)   { Fc2_400_10_sparse(F1, FC2_T, W.fc2_bias, F2_OUT, NULL); }
+static void fc2_fixed(void)    { Fc2_400_10_fixed(F1, W.fc2_kernel, W.fc2_bias, F2_OUT); }
+static void softmax_float(void){ Softmax(F2, SM); }
+static void softmax_lut(void)  { SoftmaxFixed(F2, SM); }
+static void softmax_argmax(void){ SM[0] = (float)Argmax(F2); }
+
+typedef struct {
+  const char 	*kernel, *backend;
+  void 			(*call)(void);
+  double 		flops;
+  void 			*input; 		// re-touched after a cache flush
+  size_t 		input_bytes;
+} Bench;
+
+#define CONV1_FLOPS	(2.0*CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH*IMG_DEPTH*CONV1_DIM*CONV1_DIM)
+#define CONV2_FLOPS	(2.0*CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM)
+#define POOL1_FLOPS	(1.0*CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH)
+#define POOL2_FLOPS	(1.0*CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH)
+#define FC1_FLOPS	(2.0*FC1_NBOUTPUT*FC1_NBINPUT)
+#define FC2_FLOPS	(2.0*FC2_NBOUTPUT*FC1_NBOUTPUT)
+#define SOFTMAX_FLOPS	(4.0*FC2_NBOUTPUT)	// max, exp, sum, divide
+
+static Bench BENCH[] = {
+  { "Conv1_28x28x1_5x5x20_1_0",  "float",       conv1_float,   CONV1_FLOPS,   IMG, sizeof(IMG) },
+  { "Conv1_28x28x1_5x5x20_1_0",  "line-buffer", conv1_lb,      CONV1_FLOPS,   IMG, sizeof(IMG) },
+  { "Conv1_28x28x1_5x5x20_1_0",  "fixed",       conv1_fixed,   CONV1_FLOPS,   IMG, sizeof(IMG) },
+  { "Pool1_24x24x20_2x2x20_2_0", "float",       pool1_float,   POOL1_FLOPS,   C1,  sizeof(C1) },
+  { "Pool1_24x24x20_2x2x20_2_0", "fixed",       pool1_fixed,   POOL1_FLOPS,   C1,  sizeof(C1) },
+  { "Conv2_12x12x20_5x5x40_1_0", "float",       conv2_float,   CONV2_FLOPS,   P1,  sizeof(P1) },
+  { "Conv2_12x12x20_5x5x40_1_0", "line-buffer", conv2_lb,      CONV2_FLOPS,   P1,  sizeof(P1) },
+  { "Conv2_12x12x20_5x5x40_1_0", "fixed",       conv2_fixed,   CONV2_FLOPS,   P1,  sizeof(P1) },
+  { "Pool2_8x8x40_2x2x40_2_0",   "float",       pool2_float,   POOL2_FLOPS,   C2,  sizeof(C2) },
+  { "Pool2_8x8x40_2x2x40_2_0",   "fixed",       pool2_fixed,   POOL2_FLOPS,   C2,  sizeof(C2) },
+  { "Fc1_40_400",                "float",       fc1_float,     FC1_FLOPS,     P2,  sizeof(P2) },
+  { "Fc1_40_400",                "sparse",      fc1_sparse,    FC1_FLOPS,     P2,  sizeof(P2) },
+  { "Fc1_40_400",                "fixed",       fc1_fixed,     FC1_FLOPS,     P2,  sizeof(P2) },
+  { "Fc2_400_10",                "float",       fc2_float,     FC2_FLOPS,     F1,  sizeof(F1) },
+  { "Fc2_400_10",                "sparse",      fc2_sparse,    FC2_FLOPS,     F1,  sizeof(F1) },
+  { "Fc2_400_10",                "fixed",       fc2_fixed,     FC2_FLOPS,     F1,  sizeof(F1) },
+  { "Softmax",                   "float",       softmax_float, SOFTMAX_FLOPS, F2,  sizeof(F2) },
+  { "Softmax",                   "lut",         softmax_lut,   SOFTMAX_FLOPS, F2,  sizeof(F2) },
+  { "Softmax",                   "argmax",      softmax_argmax, SOFTMAX_FLOPS, F2, sizeof(F2) },
+};
+#define NB_BENCH	((int)(sizeof(BENCH) / sizeof(BENCH[0])))
+
+typedef struct {
+  char 		kernel[64], backend[32], state[16];
+  double 	ns, sd;
+} Row;
+
+/* uniform in [lo, hi), a fraction zero of the values set to 0 (post-ReLU activations) */
+static void fill(float *p, int n, float lo, float hi, float zero) {
+  for (int i = 0; i < n; i++)
+    p[i] = (float)rand() / RAND_MAX < zero ? 0.0f : lo + (hi - lo) * rand() / ((float)RAND_MAX + 1);
+}
+
+static volatile unsigned char sink;
+
+static void flush_caches(unsigned char *buf, size_t size) {
+  unsigned char s = 0;
+  for (size_t i = 0; i < size; i += 64) { buf[i]++; s += buf[i]; }
+  sink = s;
+}
+
+static void touch(void *p, size_t size) {
+  unsigned char s = 0;
+  for (size_t i = 0; i < size; i += 64) s += ((unsigned char *)p)[i];
+  sink = s;
+}
+
+static void stats(double *v, int n, double *mean, double *sd) {
+  double m = 0, q = 0;
+  int i;
+  for (i = 0; i < n; i++) m += v[i];
+  m /= n;
+  for (i = 0; i < n; i++) q += (v[i] - m) * (v[i] - m);
+  *mean = m;
+  *sd = n > 1 ? sqrt(q / (n - 1)) : 0.0;
+}
+
+int main(int argc, char *argv[]) {
+  int 			reps[MAX_REPS] = { 10, 100, 1000 }, nreps = 3, trials = 10, flush_mb = 64, seed = 1;
+  char 			*only = NULL, *save = NULL, *base = NULL, *tok, state[16];
+  double 		threshold = 10.0, *t, s, mean, sd;
+  unsigned char *flush;
+  Row 			rows[MAX_ROWS], ref;
+  int 			nrows = 0, regress = 0, compared = 0, b, r, i, k;
+  FILE 			*f;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-r") && i+1 < argc) {
+      for (nreps = 0, tok = strtok(argv[++i], ","); tok && nreps < MAX_REPS; tok = strtok(NULL, ","))
+        if (atoi(tok) > 0) reps[nreps++] = atoi(tok);
+    }
+    else if (!strcmp(argv[i], "-t") && i+1 < argc) trials = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) flush_mb = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-k") && i+1 < argc) only = argv[++i];
+    else if (!strcmp(argv[i], "-w") && i+1 < argc) save = argv[++i];
+    else if (!strcmp(argv[i], "-b") && i+1 < argc) base = argv[++i];
+    else if (!strcmp(argv[i], "-T") && i+1 < argc) threshold = atof(argv[++i]);
+    else {
+      printf("Usage: %s [-r reps,reps,...] [-t trials] [-c flush_MB] [-s seed] [-k kernel] [-w baseline] [-b baseline [-T percent]]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nreps < 1) { reps[0] = 100; nreps = 1; }
+  if (trials < 2) trials = 2;
+  if (flush_mb < 1) flush_mb = 1;
+
+  // randomized weights and inputs in the trained model's ranges, transposed FC weights
+  srand(seed);
+  fill(&W.conv1_kernel[0][0][0][0], sizeof(W.conv1_kernel)/sizeof(float), -0.5f, 0.5f, 0.0f);
+  fill(W.conv1_bias, CONV1_NBOUTPUT, -0.1f, 0.1f, 0.0f);
+  fill(&W.conv2_kernel[0][0][0][0], sizeof(W.conv2_kernel)/sizeof(float), -0.2f, 0.2f, 0.0f);
+  fill(W.conv2_bias, CONV2_NBOUTPUT, -0.1f, 0.1f, 0.0f);
+  fill(&W.fc1_kernel[0][0][0][0], sizeof(W.fc1_kernel)/sizeof(float), -0.1f, 0.1f, 0.0f);
+  fill(W.fc1_bias, FC1_NBOUTPUT, -0.1f, 0.1f, 0.0f);
+  fill(&W.fc2_kernel[0][0], sizeof(W.fc2_kernel)/sizeof(float), -0.3f, 0.3f, 0.0f);
+  fill(W.fc2_bias, FC2_NBOUTPUT, -0.1f, 0.1f, 0.0f);
+  fill(&IMG[0][0][0], sizeof(IMG)/sizeof(float), 0.0f, 1.0f, 0.8f); 		// mostly background
+  fill(&C1[0][0][0], sizeof(C1)/sizeof(float), 0.0f, 2.0f, 0.5f);
+  fill(&P1[0][0][0], sizeof(P1)/sizeof(float), 0.0f, 2.0f, 0.4f);
+  fill(&C2[0][0][0], sizeof(C2)/sizeof(float), 0.0f, 4.0f, 0.5f);
+  fill(&P2[0][0][0], sizeof(P2)/sizeof(float), 0.0f, 4.0f, 0.2f);
+  fill(F1, FC1_NBOUTPUT, 0.0f, 4.0f, 0.45f);
+  fill(F2, FC2_NBOUTPUT, -10.0f, 10.0f, 0.0f);
+  FcTransposeFc1(W.fc1_kernel, FC1_T);
+  FcTransposeFc2(W.fc2_kernel, FC2_T);
+
+  flush = calloc((size_t)flush_mb << 20, 1);
+  t = malloc(trials * sizeof(double));
+
+  printf("%d trials per row, cold rows flush %d MB before each call\n", trials, flush_mb);
+  printf("%-26s %-12s %-10s %12s %8s %9s\n", "kernel", "backend", "state", "ns/call", "sd %", "GFLOP/s");
+  for (b = 0; b < NB_BENCH; b++) {
+    if (only && !strstr(BENCH[b].kernel, only)) continue;
+
+    // hot: weights warm, the call looped reps times per trial
+    for (r = 0; r <= nreps; r++) {
+      if (r < nreps) {
+        BENCH[b].call();
+        for (k = 0; k < trials; k++) {
+          s = now();
+          for (i = 0; i < reps[r]; i++) BENCH[b].call();
+          t[k] = (now() - s) / reps[r] * 1e9;
+        }
+        snprintf(state, sizeof(state), "hot x%d", reps[r]);
+      }
+      // cold: caches flushed, input re-touched, one call per trial
+      else {
+        for (k = 0; k < trials; k++) {
+          flush_caches(flush, (size_t)flush_mb << 20);
+          touch(BENCH[b].input, BENCH[b].input_bytes);
+          s = now();
+          BENCH[b].call();
+          t[k] = (now() - s) * 1e9;
+        }
+        snprintf(state, sizeof(state), "cold");
+      }
+      stats(t, trials, &mean, &sd);
+      printf("%-26s %-12s %-10s %12.0f %7.1f%% %9.3f\n", BENCH[b].kernel, BENCH[b].backend, state, mean,
+             100 * sd / mean, BENCH[b].flops / mean);
+      if (nrows < MAX_ROWS) {
+        snprintf(rows[nrows].kernel, sizeof(rows[nrows].kernel), "%s", BENCH[b].kernel);
+        snprintf(rows[nrows].backend, sizeof(rows[nrows].backend), "%s", BENCH[b].backend);
+        snprintf(rows[nrows].state, sizeof(rows[nrows].state), "%s", state);
+        for (char *p = rows[nrows].state; *p; p++) if (*p == ' ') *p = '_';
+        rows[nrows].ns = mean;
+        rows[nrows].sd = sd;
+        nrows++;
+      }
+    }
+  }
+
+  // baseline: one "kernel backend state ns sd" line per row
+  if (save) {
+    f = fopen(save, "w");
+    if (!f) {
+      printf("Error: Unable to write baseline %s.\n", save);
+      exit(1);
+    }
+    for (i = 0; i < nrows; i++) fprintf(f, "%s %s %s %.1f %.1f\n", rows[i].kernel, rows[i].backend, rows[i].state, rows[i].ns, rows[i].sd);
+    fclose(f);
+    printf("\nBaseline written to %s (%d rows)\n", save, nrows);
+  }
+  if (base) {
+    f = fopen(base, "r");
+    if (!f) {
+      printf("Error: Unable to open baseline %s.\n", base);
+      exit(1);
+    }
+    printf("\nRegressions against %s (slower by more than %.1f%%):\n", base, threshold);
+    while (fscanf(f, "%63s %31s %15s %lf %lf", ref.kernel, ref.backend, ref.state, &ref.ns, &ref.sd) == 5)
+      for (i = 0; i < nrows; i++) {
+        if (strcmp(rows[i].kernel, ref.kernel) || strcmp(rows[i].backend, ref.backend) || strcmp(rows[i].state, ref.state)) continue;
+        compared++;
+        if (rows[i].ns > ref.ns * (1 + threshold / 100) && rows[i].ns - ref.ns > 2 * sqrt(rows[i].sd * rows[i].sd + ref.sd * ref.sd)) {
+          printf("  REGRESSION %-26s %-12s %-10s %10.0f ns -> %10.0f ns (+%.1f%%)\n", rows[i].kernel, rows[i].backend,
+                 rows[i].state, ref.ns, rows[i].ns, 100 * (rows[i].ns / ref.ns - 1));
+          regress++;
+        }
+      }
+    fclose(f);
+    printf("  %d regression(s) over %d compared rows\n", regress, compared);
+  }
+
+  free(t); free(flush);
+  return regress ? 2 : 0;
+}
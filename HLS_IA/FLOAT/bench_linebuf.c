@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file    bench_linebuf.c
+  * @brief   Direct vs streaming line-buffer Conv1/Conv2 (conv.c) on MNIST images
+  * @brief   Checks that the outputs are bit-identical, reports time per call and
+  * @brief   input-array reads per output channel of both schemes.
+  * @brief   Usage: bench_linebuf [-n images]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static LenetWeights 	W;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static float 			P1[MNIST_TEST_SIZE][POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+
+int main(int argc, char *argv[]) {
+  int 			nimg = 1000, i, k, mismatch1 = 0, mismatch2 = 0;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		c1_ref[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], c1_lb[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+  float 		c2_ref[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], c2_lb[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  double 		t, t1_ref, t1_lb, t2_ref, t2_lb;
+  long 			reads1_ref, reads1_lb, reads2_ref, reads2_lb;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n images]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+    // Conv2 inputs: Conv1, ReLU, Pool1 as in lenet_cnn
+    Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, c1_ref);
+    for (k = 0; k < CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH; k++)
+      if ((&c1_ref[0][0][0])[k] < 0) (&c1_ref[0][0][0])[k] = 0;
+    Pool1_24x24x20_2x2x20_2_0(c1_ref, P1[i]);
+  }
+
+  // correctness
+  for (i = 0; i < nimg; i++) {
+    Conv1_28x28x1_5x5x20_1_0   (IN[i], W.conv1_kernel, W.conv1_bias, c1_ref);
+    Conv1_28x28x1_5x5x20_1_0_lb(IN[i], W.conv1_kernel, W.conv1_bias, c1_lb);
+    if (memcmp(c1_ref, c1_lb, sizeof(c1_ref))) mismatch1++;
+    Conv2_12x12x20_5x5x40_1_0   (P1[i], W.conv2_kernel, W.conv2_bias, c2_ref);
+    Conv2_12x12x20_5x5x40_1_0_lb(P1[i], W.conv2_kernel, W.conv2_bias, c2_lb);
+    if (memcmp(c2_ref, c2_lb, sizeof(c2_ref))) mismatch2++;
+  }
+
+  t = now();
+  for (i = 0; i < nimg; i++) Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, c1_ref);
+  t1_ref = now() - t;
+  t = now();
+  for (i = 0; i < nimg; i++) Conv1_28x28x1_5x5x20_1_0_lb(IN[i], W.conv1_kernel, W.conv1_bias, c1_lb);
+  t1_lb = now() - t;
+  t = now();
+  for (i = 0; i < nimg; i++) Conv2_12x12x20_5x5x40_1_0(P1[i], W.conv2_kernel, W.conv2_bias, c2_ref);
+  t2_ref = now() - t;
+  t = now();
+  for (i = 0; i < nimg; i++) Conv2_12x12x20_5x5x40_1_0_lb(P1[i], W.conv2_kernel, W.conv2_bias, c2_lb);
+  t2_lb = now() - t;
+
+  // input-array reads: direct = K*K*C per output pixel and channel, streaming = each pixel once
+  reads1_ref = (long)CONV1_HEIGHT*CONV1_WIDTH*IMG_DEPTH*CONV1_DIM*CONV1_DIM;
+  reads1_lb  = (long)IMG_DEPTH*IMG_HEIGHT*IMG_WIDTH;
+  reads2_ref = (long)CONV2_HEIGHT*CONV2_WIDTH*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM;
+  reads2_lb  = (long)POOL1_NBOUTPUT*POOL1_HEIGHT*POOL1_WIDTH;
+
+  printf("%d images\n", nimg);
+  printf("Conv1 direct : %8.2f us/call \t %6ld input reads per output channel\n", t1_ref/nimg*1e6, reads1_ref);
+  printf("Conv1 stream : %8.2f us/call \t %6ld input reads for all %d channels (x%.0f per channel)\n",
+         t1_lb/nimg*1e6, reads1_lb, CONV1_NBOUTPUT, (double)reads1_ref/reads1_lb);
+  printf("Conv2 direct : %8.2f us/call \t %6ld input reads per output channel\n", t2_ref/nimg*1e6, reads2_ref);
+  printf("Conv2 stream : %8.2f us/call \t %6ld input reads for all %d channels (x%.0f per channel)\n",
+         t2_lb/nimg*1e6, reads2_lb, CONV2_NBOUTPUT, (double)reads2_ref/reads2_lb);
+  printf("Mismatching outputs: Conv1 %d, Conv2 %d\n", mismatch1, mismatch2);
+  return (mismatch1 || mismatch2);
+}
@@ -0,0 +1,172 @@
+/**
+  ******************************************************************************
+  * @file    bench_preproc.c
+  * @brief   Microbenchmark of the preprocessing stage (preprocess.c), pixels/sec
+  * @brief   Default: the MNIST 28x28 P5 files, ReadPgmFile+NormalizeImg vs fused stage.
+  * @brief   -s WxH: MNIST digits upscaled to WxH (P5, or P2 with -a), RescaleImg+normalize
+  * @brief   vs fused stage (nearest, or bilinear with -b).
+  * @brief   Usage: bench_preproc [-n images] [-s WxH] [-a] [-b]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static unsigned char *read_file(char *filename, long *len) {
+  FILE *f = fopen(filename, "rb");
+  unsigned char *buf;
+
+  if (!f) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buf = (unsigned char *)malloc(*len);
+  if (fread(buf, 1, *len, f) != (size_t)*len) *len = 0;
+  fclose(f);
+  return buf;
+}
+
+/* nearest upscale of a 28x28 digit, encoded as P5 or P2 */
+static unsigned char *encode_scaled(unsigned char *digit, int w, int h, int ascii, long *len) {
+  unsigned char *buf = (unsigned char *)malloc(32 + (long)w*h*4);
+  int n = sprintf((char *)buf, "P%c\n%d %d\n255\n", ascii ? '2' : '5', w, h);
+  int x, y;
+
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++) {
+      unsigned char v = digit[(y*IMG_HEIGHT/h)*IMG_WIDTH + x*IMG_WIDTH/w];
+      if (ascii) n += sprintf((char *)buf + n, "%d%c", v, x == w-1 ? '\n' : ' ');
+      else buf[n++] = v;
+    }
+  *len = n;
+  return buf;
+}
+
+int main(int argc, char *argv[]) {
+  int 		nimg = 1000, w = IMG_WIDTH, h = IMG_HEIGHT, ascii = 0, mode = PREPROC_NEAREST;
+  int 		i, k, mismatch = 0;
+  char 		img_filename[120];
+  unsigned char 	**enc, *scratch, *digit, ref[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  long 		*enc_len;
+  float 	legacy[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], fused[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 	*rescaled, maxdiff = 0.0f;
+  double 	t, t_legacy, t_fused, t_fused_disk = 0;
+  PreprocPlan 	plan;
+  PgmImage 	img;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) sscanf(argv[++i], "%dx%d", &w, &h);
+    else if (!strcmp(argv[i], "-a")) ascii = 1;
+    else if (!strcmp(argv[i], "-b")) mode = PREPROC_BILINEAR;
+    else {
+      printf("Usage: %s [-n images] [-s WxH] [-a] [-b]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+  if (w < 1 || h < 1 || w > PREPROC_MAX_DIM || h > PREPROC_MAX_DIM) {
+    printf("Error: source size must be within 1..%d\n", PREPROC_MAX_DIM);
+    exit(1);
+  }
+
+  // encoded inputs in memory
+  enc = (unsigned char **)malloc(nimg * sizeof(*enc));
+  enc_len = (long *)malloc(nimg * sizeof(long));
+  digit = (unsigned char *)malloc(IMG_WIDTH*IMG_HEIGHT);
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    if (w == IMG_WIDTH && h == IMG_HEIGHT && !ascii)
+      enc[i] = read_file(img_filename, &enc_len[i]);
+    else {
+      ReadPgmFile(img_filename, digit);
+      enc[i] = encode_scaled(digit, w, h, ascii, &enc_len[i]);
+    }
+  }
+  scratch = (unsigned char *)malloc((long)w*h);
+  rescaled = (float *)malloc(IMG_WIDTH*IMG_HEIGHT*sizeof(float));
+  memset(&plan, 0, sizeof(plan));
+
+  printf("%d images, source %dx%d %s, %s resize to %dx%d\n", nimg, w, h, ascii ? "P2" : "P5",
+         mode == PREPROC_NEAREST ? "nearest" : "bilinear", IMG_WIDTH, IMG_HEIGHT);
+
+  if (w == IMG_WIDTH && h == IMG_HEIGHT && !ascii) {
+    // legacy path of main: fscanf-based ReadPgmFile, then NormalizeImg
+    t = now();
+    for (i = 0; i < nimg; i++) {
+      MnistImgFilename(img_filename, i);
+      ReadPgmFile(img_filename, (unsigned char *)ref);
+      NormalizeImg((unsigned char *)ref, (float *)legacy, IMG_WIDTH, IMG_HEIGHT);
+    }
+    t_legacy = now() - t;
+
+    // fused stage from disk
+    t = now();
+    for (i = 0; i < nimg; i++) {
+      long len;
+      unsigned char *buf;
+      MnistImgFilename(img_filename, i);
+      buf = read_file(img_filename, &len);
+      if (DecodePgm(buf, len, scratch, (long)w*h, &img) == 0) PreprocessImg(&plan, &img, mode, fused);
+      free(buf);
+    }
+    t_fused_disk = now() - t;
+  }
+  else {
+    // legacy two-pass path: decode, RescaleImg (float 0..255), then normalize
+    t = now();
+    for (i = 0; i < nimg; i++) {
+      if (DecodePgm(enc[i], enc_len[i], scratch, (long)w*h, &img)) continue;
+      RescaleImg(img.pix, img.width, img.height, rescaled, IMG_WIDTH, IMG_HEIGHT);
+      for (k = 0; k < IMG_WIDTH*IMG_HEIGHT; k++) (&legacy[0][0][0])[k] = rescaled[k] / 255;
+    }
+    t_legacy = now() - t;
+  }
+
+  // fused stage from memory
+  t = now();
+  for (i = 0; i < nimg; i++)
+    if (DecodePgm(enc[i], enc_len[i], scratch, (long)w*h, &img) == 0)
+      PreprocessImg(&plan, &img, mode, fused);
+  t_fused = now() - t;
+
+  // correctness: fused (nearest) must match the legacy chain bit for bit
+  for (i = 0; i < nimg; i++) {
+    if (DecodePgm(enc[i], enc_len[i], scratch, (long)w*h, &img)) { mismatch++; continue; }
+    PreprocessImg(&plan, &img, mode, fused);
+    if (w == IMG_WIDTH && h == IMG_HEIGHT) NormalizeImg(img.pix, (float *)legacy, IMG_WIDTH, IMG_HEIGHT);
+    else {
+      RescaleImg(img.pix, img.width, img.height, rescaled, IMG_WIDTH, IMG_HEIGHT);
+      for (k = 0; k < IMG_WIDTH*IMG_HEIGHT; k++) (&legacy[0][0][0])[k] = rescaled[k] / 255;
+    }
+    for (k = 0; k < IMG_WIDTH*IMG_HEIGHT; k++) {
+      float d = (&legacy[0][0][0])[k] - (&fused[0][0][0])[k];
+      if (d < 0) d = -d;
+      if (d > maxdiff) maxdiff = d;
+      if (mode == PREPROC_NEAREST && d != 0.0f) { mismatch++; break; }
+    }
+  }
+
+  printf("Legacy      : %8.3f ms \t %8.2f Mpix/s (source)\n", t_legacy*1000, (double)nimg*w*h / t_legacy / 1e6);
+  if (t_fused_disk > 0)
+    printf("Fused (disk): %8.3f ms \t %8.2f Mpix/s (source) \t x%.2f\n", t_fused_disk*1000, (double)nimg*w*h / t_fused_disk / 1e6, t_legacy / t_fused_disk);
+  printf("Fused (mem) : %8.3f ms \t %8.2f Mpix/s (source) \t %8.2f Mpix/s (output)\n", t_fused*1000,
+         (double)nimg*w*h / t_fused / 1e6, (double)nimg*IMG_WIDTH*IMG_HEIGHT / t_fused / 1e6);
+  printf("Max |legacy - fused| = %g, mismatching images: %d\n", maxdiff, mismatch);
+
+  for (i = 0; i < nimg; i++) free(enc[i]);
+  free(enc); free(enc_len); free(digit); free(scratch); free(rescaled);
+  return mismatch != 0;
+}
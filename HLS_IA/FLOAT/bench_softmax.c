@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file    bench_softmax.c
+  * @brief   Fixed-point softmax (SoftmaxQ / SoftmaxFixed) and argmax / top-k against Softmax
+  * @brief   On the Fc2 logits of the test images: max and mean |probability error| of the
+  * @brief   table-based softmax, the images whose predicted class or top1-top2 margin (the
+  * @brief   cascade gate) changes, a check that TopK ranks the classes as the float
+  * @brief   probabilities do, then the time per call of each output stage.
+  * @brief   Usage: bench_softmax [-n images] [-k k]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+#define REPS 	50 	// timing passes over the logits
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static LenetWeights 	W;
+static float 			LOGITS[MNIST_TEST_SIZE][FC2_NBOUTPUT];
+static int32_t 			LOGITS_Q[MNIST_TEST_SIZE][FC2_NBOUTPUT];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+static volatile float 	sink;
+
+/* reference top-k: stable sort of the float probabilities, best first */
+static void topk_ref(const float *p, int k, unsigned char *c) {
+  int used[FC2_NBOUTPUT] = {0}, i, j, b;
+  for (j = 0; j < k; j++) {
+    for (b = -1, i = 0; i < FC2_NBOUTPUT; i++)
+      if (!used[i] && (b < 0 || p[i] > p[b])) b = i;
+    used[b] = 1;
+    c[j] = (unsigned char)b;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int 			nimg = MNIST_TEST_SIZE, topk = 3, i, j, r, pred_diff = 0, topk_diff = 0, ok_ref = 0, ok_lut = 0;
+  int 			gate_diff = 0;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], c_ref[FC2_NBOUTPUT], c[FC2_NBOUTPUT];
+  float 		in[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], p_ref[FC2_NBOUTPUT], p_lut[FC2_NBOUTPUT], d;
+  uint16_t 		pq[FC2_NBOUTPUT];
+  double 		max_err = 0.0, sum_err = 0.0, max_margin_err = 0.0, s, t[5];
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-k") && i+1 < argc) topk = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n images] [-k k]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+  if (topk < 1 || topk > FC2_NBOUTPUT) {
+    printf("Error: -k expects 1 .. %d classes.\n", FC2_NBOUTPUT);
+    exit(1);
+  }
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)in, IMG_WIDTH, IMG_HEIGHT);
+    lenet_cnn(in, W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, LOGITS[i]);
+    for (j = 0; j < FC2_NBOUTPUT; j++) LOGITS_Q[i][j] = (int32_t)lrintf(LOGITS[i][j] * (1 << SOFTMAX_IN_FRAC));
+  }
+
+  for (i = 0; i < nimg; i++) {
+    Softmax(LOGITS[i], p_ref);
+    SoftmaxFixed(LOGITS[i], p_lut);
+    for (j = 0; j < FC2_NBOUTPUT; j++) {
+      d = fabsf(p_lut[j] - p_ref[j]);
+      if (d > max_err) max_err = d;
+      sum_err += d;
+    }
+    d = fabsf(SoftmaxMargin(p_lut) - SoftmaxMargin(p_ref));
+    if (d > max_margin_err) max_margin_err = d;
+    gate_diff += (SoftmaxMargin(p_lut) < 0.5f) != (SoftmaxMargin(p_ref) < 0.5f);
+    pred_diff += TopK(p_lut, 1, c) != TopK(p_ref, 1, c_ref);
+    ok_ref += c_ref[0] == LABELS[i];
+    ok_lut += c[0] == LABELS[i];
+    topk_ref(p_ref, topk, c_ref);
+    TopK(LOGITS[i], topk, c);
+    topk_diff += memcmp(c, c_ref, topk) != 0 || Argmax(LOGITS[i]) != c_ref[0];
+  }
+
+  s = now(); for (r = 0; r < REPS; r++) for (i = 0; i < nimg; i++) { Softmax(LOGITS[i], p_ref); sink = p_ref[0]; } t[0] = (now() - s) / REPS / nimg * 1e9;
+  s = now(); for (r = 0; r < REPS; r++) for (i = 0; i < nimg; i++) { SoftmaxFixed(LOGITS[i], p_lut); sink = p_lut[0]; } t[1] = (now() - s) / REPS / nimg * 1e9;
+  s = now(); for (r = 0; r < REPS; r++) for (i = 0; i < nimg; i++) { SoftmaxQ(LOGITS_Q[i], pq); sink = pq[0]; } t[2] = (now() - s) / REPS / nimg * 1e9;
+  s = now(); for (r = 0; r < REPS; r++) for (i = 0; i < nimg; i++) sink = Argmax(LOGITS[i]); t[3] = (now() - s) / REPS / nimg * 1e9;
+  s = now(); for (r = 0; r < REPS; r++) for (i = 0; i < nimg; i++) sink = TopK(LOGITS[i], topk, c); t[4] = (now() - s) / REPS / nimg * 1e9;
+
+  printf("%d images, logits in Q%d, %d-entry exp table, probabilities in Q15\n", nimg, SOFTMAX_IN_FRAC, 1 << SOFTMAX_EXP_BITS);
+  printf("SoftmaxFixed vs Softmax: max |error| %.2e, mean |error| %.2e, max top1-top2 margin error %.2e\n",
+         max_err, sum_err / nimg / FC2_NBOUTPUT, max_margin_err);
+  printf("  predicted class changed on %d images (accuracy %.2f%% -> %.2f%%), margin < 0.5 gate changed on %d\n",
+         pred_diff, 100.0f * ok_ref / nimg, 100.0f * ok_lut / nimg, gate_diff);
+  printf("TopK(logits, %d) / Argmax differ from the float softmax ranking on %d images\n", topk, topk_diff);
+  printf("ns per call: Softmax %.1f, SoftmaxFixed %.1f, SoftmaxQ %.1f, Argmax %.1f, TopK(%d) %.1f\n",
+         t[0], t[1], t[2], t[3], topk, t[4]);
+  return topk_diff != 0;
+}
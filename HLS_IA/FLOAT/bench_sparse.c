@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file    bench_sparse.c
+  * @brief   Dense vs zero-skipping FC kernels (fc.c) on the real MNIST activations
+  * @brief   Reports the observed input sparsity of Fc1 / Fc2, time per call of both
+  * @brief   kernels, checks that the outputs are identical, then sweeps the density
+  * @brief   (extra inputs zeroed at random) to locate the break-even point.
+  * @brief   Usage: bench_sparse [-n images]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static LenetWeights 	W;
+static float 			FC1_T[FC1_NBINPUT][FC1_NBOUTPUT];
+static float 			FC2_T[FC1_NBOUTPUT][FC2_NBOUTPUT];
+static float 			P2[MNIST_TEST_SIZE][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+static float 			F1[MNIST_TEST_SIZE][FC1_NBOUTPUT];
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (p[i] < 0.0f) p[i] = 0.0f;
+}
+
+static float zero_fraction(float *p, long n) {
+  long z = 0;
+  for (long i = 0; i < n; i++) z += (p[i] == 0.0f);
+  return (float)z / n;
+}
+
+/* us per call of the dense and the sparse Fc1 / Fc2 over the first n activations */
+static void time_fc(int n, double t[4]) {
+  float out1[FC1_NBOUTPUT], out2[FC2_NBOUTPUT];
+  double s;
+  int i;
+
+  s = now(); for (i = 0; i < n; i++) Fc1_40_400(P2[i], W.fc1_kernel, W.fc1_bias, out1); t[0] = (now() - s) / n * 1e6;
+  s = now(); for (i = 0; i < n; i++) Fc1_40_400_sparse(P2[i], FC1_T, W.fc1_bias, out1, NULL); t[1] = (now() - s) / n * 1e6;
+  s = now(); for (i = 0; i < n; i++) Fc2_400_10(F1[i], W.fc2_kernel, W.fc2_bias, out2); t[2] = (now() - s) / n * 1e6;
+  s = now(); for (i = 0; i < n; i++) Fc2_400_10_sparse(F1[i], FC2_T, W.fc2_bias, out2, NULL); t[3] = (now() - s) / n * 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  int 			nimg = 1000, i, k, mismatch = 0, d;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		in[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float 		c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 		a1[FC1_NBOUTPUT], b1[FC1_NBOUTPUT], a2[FC2_NBOUTPUT], b2[FC2_NBOUTPUT];
+  float 		zero[2];
+  FcSparsity 	sp;
+  double 		t[4];
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n images]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  FcTransposeFc1(W.fc1_kernel, FC1_T);
+  FcTransposeFc2(W.fc2_kernel, FC2_T);
+
+  // FC inputs as in lenet_cnn: Pool2 output, and ReLU(Fc1) output
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)in, IMG_WIDTH, IMG_HEIGHT);
+    Conv1_28x28x1_5x5x20_1_0(in, W.conv1_kernel, W.conv1_bias, c1);
+    relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(c1, p1);
+    Conv2_12x12x20_5x5x40_1_0(p1, W.conv2_kernel, W.conv2_bias, c2);
+    relu(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+    Pool2_8x8x40_2x2x40_2_0(c2, P2[i]);
+    Fc1_40_400(P2[i], W.fc1_kernel, W.fc1_bias, F1[i]);
+  }
+
+  // correctness (also collects the sparsity statistics)
+  memset(&sp, 0, sizeof(sp));
+  for (i = 0; i < nimg; i++) {
+    Fc1_40_400(P2[i], W.fc1_kernel, W.fc1_bias, a1);
+    Fc1_40_400_sparse(P2[i], FC1_T, W.fc1_bias, b1, &sp);
+    Fc2_400_10(F1[i], W.fc2_kernel, W.fc2_bias, a2);
+    Fc2_400_10_sparse(F1[i], FC2_T, W.fc2_bias, b2, &sp);
+    for (k = 0; k < FC1_NBOUTPUT; k++) if (a1[k] != b1[k]) break;
+    if (k < FC1_NBOUTPUT) { mismatch++; continue; }
+    for (k = 0; k < FC2_NBOUTPUT; k++) if (a2[k] != b2[k]) break;
+    if (k < FC2_NBOUTPUT) mismatch++;
+  }
+  FcSparsityStats(&sp, zero);
+
+  time_fc(nimg, t);
+  printf("%d images\n", nimg);
+  printf("Fc1 (pool2_output): %5.1f%% zeros \t dense %7.2f us \t sparse %7.2f us \t x%.2f\n", 100*zero[0], t[0], t[1], t[0]/t[1]);
+  printf("Fc2 (fc1_output)  : %5.1f%% zeros \t dense %7.2f us \t sparse %7.2f us \t x%.2f\n", 100*zero[1], t[2], t[3], t[2]/t[3]);
+  printf("Outputs differing from the dense kernels: %d / %d images\n", mismatch, nimg);
+
+  // density sweep: each step zeroes a further 20% of the inputs at random
+  printf("\nFc1 zeros \t dense / sparse (us) \t Fc2 zeros \t dense / sparse (us)\n");
+  srand(1);
+  for (d = 0; d < 5; d++) {
+    for (i = 0; i < nimg; i++) {
+      for (k = 0; k < FC1_NBINPUT; k++) if (rand() % 100 < 20) (&P2[i][0][0][0])[k] = 0.0f;
+      for (k = 0; k < FC1_NBOUTPUT; k++) if (rand() % 100 < 20) F1[i][k] = 0.0f;
+    }
+    time_fc(nimg, t);
+    printf("%5.1f%% \t\t %6.2f / %6.2f \t %5.1f%% \t %6.2f / %6.2f\n",
+           100*zero_fraction(&P2[0][0][0][0], nimg*FC1_NBINPUT), t[0], t[1],
+           100*zero_fraction(&F1[0][0], nimg*FC1_NBOUTPUT), t[2], t[3]);
+  }
+  return mismatch != 0;
+}
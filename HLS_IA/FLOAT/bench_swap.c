@@ -0,0 +1,137 @@
+/**
+  ******************************************************************************
+  * @file    bench_swap.c
+  * @brief   Hot-swapped model versions (registry.c) under load
+  * @brief   Reader threads classify the test images without pause, each inference inside
+  * @brief   ModelAcquire / ModelRelease, while the main thread publishes new versions of
+  * @brief   the weights (alternating between the given files) every few milliseconds and
+  * @brief   once tries a missing file, which must be rejected with the old version still
+  * @brief   serving. Reports the load / prepare and grace-period times, the per-version
+  * @brief   inferences, latency and accuracy, and the readers that saw a freed version
+  * @brief   (must be 0).
+  * @brief   Usage: bench_swap [-n images] [-r readers] [-s swaps] [-p period_ms] [weights.h5 ...]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+static int 				nimg = 1000;
+static volatile int 	stop;
+static unsigned long 	violations, inferences;
+
+static void *reader_loop(void *arg) {
+  int 			r = (int)(long)arg, i = r, bad = 0, id;
+  unsigned long n = 0;
+  float 		out[FC2_NBOUTPUT];
+  ModelVersion 	*v;
+  LenetWeights 	*w;
+  double 		s;
+
+  while (!stop) {
+    s = now();
+    v = ModelAcquire(r);
+    w = &v->model.w;
+    lenet_cnn(IN[i], w->conv1_kernel, w->conv1_bias, w->conv2_kernel, w->conv2_bias,
+              w->fc1_kernel, w->fc1_bias, w->fc2_kernel, w->fc2_bias, out);
+    id = v->id;
+    bad += ModelRelease(r, v) != 0;
+    ModelRecord(r, id, (now() - s) * 1e6, Argmax(out) == LABELS[i]);
+    i = (i + 1) % nimg;
+    n++;
+  }
+  __sync_fetch_and_add(&violations, bad);
+  __sync_fetch_and_add(&inferences, n);
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  static char 	*files[16];
+  int 			nfiles = 0, readers = 2, swaps = 20, period = 20, i, failed = 0;
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  pthread_t 	tid[MODEL_MAX_READERS];
+  struct timespec pause;
+  ModelStats 	st[MODEL_MAX_VERSIONS];
+  unsigned long rejected;
+  double 		s, t, load = 0.0, grace = 0.0, grace_max = 0.0;
+  int 			n, nfreed = 0;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i+1 < argc) readers = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) swaps = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i+1 < argc) period = atoi(argv[++i]);
+    else if (argv[i][0] != '-' && nfiles < 16) files[nfiles++] = argv[i];
+    else {
+      printf("Usage: %s [-n images] [-r readers] [-s swaps] [-p period_ms] [weights.h5 ...]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+  if (readers < 1 || readers > MODEL_MAX_READERS) {
+    printf("Error: -r expects 1 .. %d readers.\n", MODEL_MAX_READERS);
+    exit(1);
+  }
+  if (!nfiles) files[nfiles++] = "lenet_weights.weights.h5";
+
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+  if (!ModelLoad(files[0])) {
+    printf("Error: Unable to load %s.\n", files[0]);
+    exit(1);
+  }
+
+  for (i = 0; i < readers; i++) pthread_create(&tid[i], NULL, reader_loop, (void *)(long)i);
+  pause.tv_sec = period / 1000;
+  pause.tv_nsec = (period % 1000) * 1000000L;
+  s = now();
+  for (i = 0; i < swaps; i++) {
+    nanosleep(&pause, NULL);
+    if (i == swaps / 2 && ModelLoad("missing.weights.h5")) failed++; 	// must be rejected
+    if (!ModelLoad(files[(i + 1) % nfiles])) failed++;
+  }
+  nanosleep(&pause, NULL);
+  stop = 1;
+  for (i = 0; i < readers; i++) pthread_join(tid[i], NULL);
+  t = now() - s;
+
+  n = ModelVersions(st, MODEL_MAX_VERSIONS, &rejected);
+  for (i = 0; i < n; i++)
+    if (st[i].state == MODEL_FREED) {
+      nfreed++;
+      load += st[i].load_ms;
+      grace += st[i].grace_ms;
+      if (st[i].grace_ms > grace_max) grace_max = st[i].grace_ms;
+    }
+  printf("%d reader(s), %d swaps over %d file(s) in %.2f s, %lu inferences (%.0f / s)\n",
+         readers, swaps, nfiles, t, inferences, inferences / t);
+  ModelPrintVersions();
+  printf("\n\nLast %d retired versions: load + prepare %.1f ms avg, grace period %.2f ms avg, %.2f ms max\n",
+         nfreed, nfreed ? load / nfreed : 0.0, nfreed ? grace / nfreed : 0.0, grace_max);
+  printf("Rejected files: %lu (1 expected), failed loads: %d, readers that saw a freed version: %lu\n",
+         rejected, failed, violations);
+  ModelRegistryFree();
+  return violations || failed || rejected != 1;
+}
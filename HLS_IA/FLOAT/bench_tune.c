@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file    bench_tune.c
+  * @brief   Startup autotuner (tune.c): tuning cost, cache reload and tuned throughput
+  * @brief   Tunes for the target batch size (or loads the cached configuration), loads
+  * @brief   it back from the cache file, then classifies the test images in batches
+  * @brief   with lenet_cnn_tuned_batch() against plain lenet_cnn(), checking the logits.
+  * @brief   Usage: bench_tune [-b batch] [-n images] [-t tune_images] [-o cache_file] [-f]
+  * @brief          -f forces re-tuning (the cache entry is replaced)
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static LenetModel 	M;
+static float 		IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static float 		REF[MNIST_TEST_SIZE][FC2_NBOUTPUT], OUT[MNIST_TEST_SIZE][FC2_NBOUTPUT];
+
+int main(int argc, char *argv[]) {
+  int 			batch = 1, nimg = 2000, ntune = 64, force = 0, i, cached, mismatch = 0;
+  char 			*path = "lenet_tune.cache", img_filename[120], cpu[200];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  double 		s, t_tune, t_load, t_ref, t_tuned;
+  TuneConfig 	c, loaded;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-b") && i+1 < argc) batch = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i+1 < argc) ntune = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-o") && i+1 < argc) path = argv[++i];
+    else if (!strcmp(argv[i], "-f")) force = 1;
+    else {
+      printf("Usage: %s [-b batch] [-n images] [-t tune_images] [-o cache_file] [-f]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+  if (batch < 1) batch = 1;
+  if (ntune < batch) ntune = batch;
+  if (ntune > nimg) ntune = nimg;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &M.w);
+  FcTransposeFc1(M.w.fc1_kernel, M.fc1_kernel_t);
+  FcTransposeFc2(M.w.fc2_kernel, M.fc2_kernel_t);
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+  TuneCpuModel(cpu, sizeof(cpu));
+  printf("CPU %s, model hash %016llx, batch %d, %d tuning images\n", cpu, ModelHash(&M.w), batch, ntune);
+
+  // first start: tune (unless cached), later starts: load
+  s = now();
+  if (force) {
+    TuneRun(&M, IN, ntune, batch, 1, &c);
+    TuneSave(path, cpu, ModelHash(&M.w), &c);
+    TuneApply(&c);
+    cached = 0;
+  }
+  else cached = LenetAutotune(path, &M, IN, ntune, batch, 1, &c);
+  t_tune = now() - s;
+  s = now();
+  if (!TuneLoad(path, cpu, ModelHash(&M.w), batch, &loaded)) {
+    printf("Error: Configuration not found in %s after tuning.\n", path);
+    exit(1);
+  }
+  t_load = now() - s;
+  printf("%s in %.3f s, reload from %s in %.1f us\n", cached ? "Loaded" : "Tuned", t_tune, path, t_load*1e6);
+  printf("Conv1 %s, Conv2 %s, Fc1 %s, Fc2 %s, %d thread(s)%s\n",
+         c.conv1 == TUNE_LINEBUF ? "line-buffer" : "direct", c.conv2 == TUNE_LINEBUF ? "line-buffer" : "direct",
+         c.fc1 == TUNE_SPARSE ? "sparse" : "dense", c.fc2 == TUNE_SPARSE ? "sparse" : "dense", c.threads,
+         c.threads > 1 ? (c.split == TUNE_SPLIT_IMAGE ? ", split image" : ", split batch") : "");
+
+  s = now();
+  for (i = 0; i < nimg; i++)
+    lenet_cnn(IN[i], M.w.conv1_kernel, M.w.conv1_bias, M.w.conv2_kernel, M.w.conv2_bias,
+              M.w.fc1_kernel, M.w.fc1_bias, M.w.fc2_kernel, M.w.fc2_bias, REF[i]);
+  t_ref = now() - s;
+  s = now();
+  for (i = 0; i < nimg; i += batch)
+    lenet_cnn_tuned_batch(&c, &M, IN + i, nimg - i < batch ? nimg - i : batch, OUT + i);
+  t_tuned = now() - s;
+  for (i = 0; i < nimg; i++) if (memcmp(OUT[i], REF[i], sizeof(OUT[i]))) mismatch++;
+
+  printf("lenet_cnn       : %8.1f us/image\n", t_ref/nimg*1e6);
+  printf("lenet_cnn_tuned : %8.1f us/image \t x%.2f \t %d / %d images differ\n", t_tuned/nimg*1e6, t_ref/t_tuned, mismatch, nimg);
+  if (TeamSize() > 1) TeamFree();
+  return mismatch != 0;
+}
@@ -0,0 +1,130 @@
+/**
+  ******************************************************************************
+  * @file    bench_winograd.c
+  * @brief   Winograd Conv1 / Conv2 (winograd.c) against the direct conv.c kernels
+  * @brief   Runs both on the real MNIST activations and reports the numerical error of
+  * @brief   the Winograd outputs (max and mean |error|, max relative to the layer's max
+  * @brief   |output|), the multiplies per image (direct, element-wise products, transforms),
+  * @brief   the time per layer, and the accuracy with Winograd on no layer, Conv1, Conv2
+  * @brief   and both. Build with -DWINO_M=4 for F(4x4,5x5).
+  * @brief   Usage: bench_winograd [-n images]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+typedef struct { double max, sum, ref_max; long n; } ErrStats;
+
+static LenetWeights 	W;
+static LenetWinograd 	G;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static float 			P1[MNIST_TEST_SIZE][POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (p[i] < 0.0f) p[i] = 0.0f;
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+static void error(ErrStats *e, const float *ref, const float *x, int n) {
+  double d;
+  for (int i = 0; i < n; i++) {
+    d = fabs((double)x[i] - ref[i]);
+    if (d > e->max) e->max = d;
+    if (fabs(ref[i]) > e->ref_max) e->ref_max = fabs(ref[i]);
+    e->sum += d;
+  }
+  e->n += n;
+}
+
+static void report(const char *name, ErrStats *e, long direct, int layer, double t_direct, double t_wino) {
+  long products, transforms;
+
+  WinogradOps(&G, layer, &products, &transforms);
+  printf("%s: max |error| %.3g (%.2g of max |output|), mean |error| %.3g\n", name, e->max, e->max / e->ref_max, e->sum / e->n);
+  printf("       multiplies: direct %ld, Winograd %ld products + %ld transforms (x%.2f products, x%.2f total)\n",
+         direct, products, transforms, (double)direct / products, (double)direct / (products + transforms));
+  printf("       direct %7.1f us \t Winograd %7.1f us \t x%.2f\n", t_direct, t_wino, t_direct / t_wino);
+}
+
+int main(int argc, char *argv[]) {
+  int 			nimg = 1000, i, l, ok[4];
+  char 			img_filename[120];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  static float 	a1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], b1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+  static float 	a2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], b2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 		out[FC2_NBOUTPUT];
+  ErrStats 		e1 = {0}, e2 = {0};
+  double 		s, t[4];
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i+1 < argc) nimg = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n images]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nimg < 1) nimg = 1;
+  if (nimg > MNIST_TEST_SIZE) nimg = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  WinogradPrepare(&W, WINO_CONV1 | WINO_CONV2, &G);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < nimg; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+    Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, a1);
+    relu(&a1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(a1, P1[i]);
+  }
+
+  for (i = 0; i < nimg; i++) {
+    Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, a1);
+    Conv1_28x28x1_5x5x20_1_0_winograd(IN[i], &G, W.conv1_bias, b1);
+    error(&e1, &a1[0][0][0], &b1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Conv2_12x12x20_5x5x40_1_0(P1[i], W.conv2_kernel, W.conv2_bias, a2);
+    Conv2_12x12x20_5x5x40_1_0_winograd(P1[i], &G, W.conv2_bias, b2);
+    error(&e2, &a2[0][0][0], &b2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+  }
+
+  s = now(); for (i = 0; i < nimg; i++) Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, a1); t[0] = (now() - s) / nimg * 1e6;
+  s = now(); for (i = 0; i < nimg; i++) Conv1_28x28x1_5x5x20_1_0_winograd(IN[i], &G, W.conv1_bias, b1); t[1] = (now() - s) / nimg * 1e6;
+  s = now(); for (i = 0; i < nimg; i++) Conv2_12x12x20_5x5x40_1_0(P1[i], W.conv2_kernel, W.conv2_bias, a2); t[2] = (now() - s) / nimg * 1e6;
+  s = now(); for (i = 0; i < nimg; i++) Conv2_12x12x20_5x5x40_1_0_winograd(P1[i], &G, W.conv2_bias, b2); t[3] = (now() - s) / nimg * 1e6;
+
+  printf("%d images, F(%dx%d,5x5), %dx%d input tiles, %d blocks per transform\n", nimg, WINO_M, WINO_M, WINO_N, WINO_N, WINO_TILES);
+  report("Conv1", &e1, (long)CONV1_NBOUTPUT*IMG_DEPTH*CONV1_DIM*CONV1_DIM*CONV1_HEIGHT*CONV1_WIDTH, WINO_CONV1, t[0], t[1]);
+  report("Conv2", &e2, (long)CONV2_NBOUTPUT*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM*CONV2_HEIGHT*CONV2_WIDTH, WINO_CONV2, t[2], t[3]);
+
+  for (l = 0; l < 4; l++) {
+    G.layers = l;
+    for (i = 0, ok[l] = 0; i < nimg; i++) {
+      lenet_cnn_winograd(IN[i], &W, &G, out);
+      ok[l] += (argmax(out) == LABELS[i]);
+    }
+  }
+  printf("Accuracy: direct %.2f%%, Winograd Conv1 %.2f%%, Conv2 %.2f%%, both %.2f%%\n",
+         100.0f * ok[0] / nimg, 100.0f * ok[WINO_CONV1] / nimg, 100.0f * ok[WINO_CONV2] / nimg,
+         100.0f * ok[WINO_CONV1 | WINO_CONV2] / nimg);
+  return 0;
+}
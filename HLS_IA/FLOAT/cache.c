@@ -0,0 +1,191 @@
+/**
+  ******************************************************************************
+  * @file    cache.c
+  * @brief   Content-addressed prediction cache in front of lenet_cnn()
+  * @brief   Key = 64-bit hash of the raw REF_IMG bytes, value = softmax vector.
+  * @brief   Sharded bounded LRU, one mutex per shard (host only, not for HLS).
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "lenet_cnn_float.h"
+
+#define CACHE_IMG_SIZE	(IMG_DEPTH*IMG_HEIGHT*IMG_WIDTH)
+
+typedef struct {
+  unsigned long long 	hash;
+  unsigned char 		img[CACHE_IMG_SIZE]; 	    // full key, hash collisions are checked
+  float 				prob[FC2_NBOUTPUT];
+  int 					prev, next; 			    // LRU list (head = most recent)
+  int 					chain; 				        // hash bucket chain
+} CacheEntry;
+
+typedef struct {
+  pthread_mutex_t 		lock;
+  CacheEntry 			*entry;
+  int 					*bucket;
+  int 					capacity, nbucket, count;
+  int 					head, tail, free;
+  unsigned long long 	hits, misses, evictions;
+} CacheShard;
+
+static CacheShard 	shard[CACHE_SHARDS];
+static int 			cache_enabled = 0;
+
+// 64-bit multiply-xorshift over 8-byte words (784 bytes = 98 words)
+unsigned long long ImgHash(unsigned char *img) {
+  unsigned long long h = 0x9E3779B97F4A7C15ULL, w;
+  int i;
+
+  for (i = 0; i < CACHE_IMG_SIZE; i += 8) {
+    memcpy(&w, &img[i], 8);
+    h ^= w * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 31)) * 0x94D049BB133111EBULL;
+  }
+  return h ^ (h >> 29);
+}
+
+void CacheInit(unsigned int capacity) {
+  int s, i, per_shard;
+
+  per_shard = (capacity + CACHE_SHARDS - 1) / CACHE_SHARDS;
+  if (per_shard < 1) per_shard = 1;
+
+  for (s = 0; s < CACHE_SHARDS; s++) {
+    CacheShard *sh = &shard[s];
+    pthread_mutex_init(&sh->lock, NULL);
+    sh->capacity = per_shard;
+    sh->nbucket = 1;
+    while (sh->nbucket < 2*per_shard) sh->nbucket <<= 1;
+    sh->entry = (CacheEntry *)malloc(per_shard * sizeof(CacheEntry));
+    sh->bucket = (int *)malloc(sh->nbucket * sizeof(int));
+    if (!sh->entry || !sh->bucket) {
+      printf("Error: Unable to allocate prediction cache (%u entries).\n", capacity);
+      exit(1);
+    }
+    for (i = 0; i < sh->nbucket; i++) sh->bucket[i] = -1;
+    for (i = 0; i < per_shard; i++) sh->entry[i].next = i+1 < per_shard ? i+1 : -1;
+    sh->free = 0;
+    sh->head = sh->tail = -1;
+    sh->count = 0;
+    sh->hits = sh->misses = sh->evictions = 0;
+  }
+  cache_enabled = 1;
+}
+
+void CacheFree(void) {
+  int s;
+
+  if (!cache_enabled) return;
+  for (s = 0; s < CACHE_SHARDS; s++) {
+    free(shard[s].entry);
+    free(shard[s].bucket);
+    pthread_mutex_destroy(&shard[s].lock);
+  }
+  cache_enabled = 0;
+}
+
+static void lru_unlink(CacheShard *sh, int e) {
+  CacheEntry *p = &sh->entry[e];
+  if (p->prev >= 0) sh->entry[p->prev].next = p->next; else sh->head = p->next;
+  if (p->next >= 0) sh->entry[p->next].prev = p->prev; else sh->tail = p->prev;
+}
+
+static void lru_push_front(CacheShard *sh, int e) {
+  CacheEntry *p = &sh->entry[e];
+  p->prev = -1;
+  p->next = sh->head;
+  if (sh->head >= 0) sh->entry[sh->head].prev = e;
+  sh->head = e;
+  if (sh->tail < 0) sh->tail = e;
+}
+
+static int *chain_slot(CacheShard *sh, unsigned long long hash, unsigned char *img) {
+  int *slot = &sh->bucket[(hash >> 8) & (sh->nbucket - 1)];
+  while (*slot >= 0) {
+    CacheEntry *p = &sh->entry[*slot];
+    if (p->hash == hash && !memcmp(p->img, img, CACHE_IMG_SIZE)) break;
+    slot = &p->chain;
+  }
+  return slot;
+}
+
+/* Returns 1 and copies the cached softmax vector on hit, 0 on miss */
+int CacheLookup(unsigned char *img, float prob[FC2_NBOUTPUT]) {
+  unsigned long long hash;
+  CacheShard *sh;
+  int *slot, hit = 0;
+
+  if (!cache_enabled) return 0;
+  hash = ImgHash(img);
+  sh = &shard[hash & (CACHE_SHARDS - 1)];
+
+  pthread_mutex_lock(&sh->lock);
+  slot = chain_slot(sh, hash, img);
+  if (*slot >= 0) {
+    memcpy(prob, sh->entry[*slot].prob, FC2_NBOUTPUT * sizeof(float));
+    lru_unlink(sh, *slot);
+    lru_push_front(sh, *slot);
+    sh->hits++;
+    hit = 1;
+  }
+  else sh->misses++;
+  pthread_mutex_unlock(&sh->lock);
+
+  return hit;
+}
+
+void CacheInsert(unsigned char *img, float prob[FC2_NBOUTPUT]) {
+  unsigned long long hash;
+  CacheShard *sh;
+  int *slot, e;
+
+  if (!cache_enabled) return;
+  hash = ImgHash(img);
+  sh = &shard[hash & (CACHE_SHARDS - 1)];
+
+  pthread_mutex_lock(&sh->lock);
+  slot = chain_slot(sh, hash, img);
+  if (*slot < 0) { // another worker may have inserted it meanwhile
+    if (sh->free < 0) { // evict least recently used
+      int *victim;
+      e = sh->tail;
+      lru_unlink(sh, e);
+      victim = &sh->bucket[(sh->entry[e].hash >> 8) & (sh->nbucket - 1)];
+      while (*victim != e) victim = &sh->entry[*victim].chain;
+      *victim = sh->entry[e].chain;
+      sh->evictions++;
+      sh->count--;
+      slot = chain_slot(sh, hash, img); // the eviction may have moved our slot
+    }
+    else {
+      e = sh->free;
+      sh->free = sh->entry[e].next;
+    }
+    sh->entry[e].hash = hash;
+    memcpy(sh->entry[e].img, img, CACHE_IMG_SIZE);
+    memcpy(sh->entry[e].prob, prob, FC2_NBOUTPUT * sizeof(float));
+    sh->entry[e].chain = -1;
+    *slot = e;
+    lru_push_front(sh, e);
+    sh->count++;
+  }
+  pthread_mutex_unlock(&sh->lock);
+}
+
+void CacheStats(unsigned long long *hits, unsigned long long *misses, unsigned long long *evictions) {
+  int s;
+
+  *hits = *misses = *evictions = 0;
+  if (!cache_enabled) return;
+  for (s = 0; s < CACHE_SHARDS; s++) {
+    pthread_mutex_lock(&shard[s].lock);
+    *hits += shard[s].hits;
+    *misses += shard[s].misses;
+    *evictions += shard[s].evictions;
+    pthread_mutex_unlock(&shard[s].lock);
+  }
+}
@@ -86,6 +86,51 @@ void Conv1_28x28x1_5x5x20_1_0(
     }
 }
 
+// Conv1 on raw 8-bit pixels: NormalizeImg's 1/255 is folded into the kernel at load
+// time (FoldInputScale), so the input never exists as a float tensor
+void Conv1_28x28x1_5x5x20_1_0_u8(
+    unsigned char input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH],
+    float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+    float bias[CONV1_NBOUTPUT],
+    float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]
+){
+#pragma HLS INLINE off
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=2
+#if (CONV1_UNROLL_K > 1)
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=3
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=4
+#endif
+
+    const int pad = CONV1_SAME ? (CONV1_DIM - 1) / 2 : CONV1_PAD;
+
+    for (int m = 0; m < CONV1_NBOUTPUT; m++){
+        for (int y = 0; y < CONV1_HEIGHT; y++){
+            for (int x = 0; x < CONV1_WIDTH; x++){
+#pragma HLS PIPELINE II=1
+                float acc = bias[m];
+
+                for (int c = 0; c < IMG_DEPTH; c++){
+#if (CONV1_UNROLL_C > 1)
+#pragma HLS UNROLL
+#endif
+                    for (int ky = 0; ky < CONV1_DIM; ky++){
+                        PRAGMA_UNROLL_K1;
+                        const int in_y = y * CONV1_STRIDE + ky - pad;
+                        if ((in_y < 0) || (in_y >= IMG_HEIGHT)) continue;
+                        for (int kx = 0; kx < CONV1_DIM; kx++){
+                            PRAGMA_UNROLL_K1;
+                            const int in_x = x * CONV1_STRIDE + kx - pad;
+                            if ((in_x < 0) || (in_x >= IMG_WIDTH)) continue;
+                            acc += (float)input[c][in_y][in_x] * kernel[m][c][ky][kx];
+                        }
+                    }
+                }
+                output[m][y][x] = acc;
+            }
+        }
+    }
+}
+
 void Conv2_12x12x20_5x5x40_1_0(
     float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH],
     float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
@@ -128,3 +173,222 @@ void Conv2_12x12x20_5x5x40_1_0(
         }
     }
 }
+
+// ---------------------------------------------------------------------------
+// Streaming (line-buffer) variants: the input is consumed once, in raster order.
+// Each input channel keeps its last K-1 rows in a line buffer and a KxK sliding
+// window; every window position produces all output channels. Same summation
+// order as the direct kernels (c, ky, kx), so the outputs are bit-identical.
+// Valid convolution only (stride 1, no SAME padding). Meant for HLS
+// (-DCONV_LINE_BUFFER): on a CPU, Conv1 runs several times slower than direct.
+// ---------------------------------------------------------------------------
+
+void Conv1_28x28x1_5x5x20_1_0_lb(
+    float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH],
+    float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+    float bias[CONV1_NBOUTPUT],
+    float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]
+){
+#pragma HLS INLINE off
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=2
+#if (CONV1_UNROLL_K > 1)
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=3
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=4
+#endif
+    float line_buf[IMG_DEPTH][CONV1_DIM-1][IMG_WIDTH] = {{{0}}};   // rows y-K+1 .. y-1
+    float window[IMG_DEPTH][CONV1_DIM][CONV1_DIM] = {{{0}}};
+#pragma HLS ARRAY_PARTITION variable=line_buf complete dim=1
+#pragma HLS ARRAY_PARTITION variable=line_buf complete dim=2
+#pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+    for (int y = 0; y < IMG_HEIGHT; y++){
+        for (int x = 0; x < IMG_WIDTH; x++){
+            for (int c = 0; c < IMG_DEPTH; c++){
+#pragma HLS UNROLL
+                const float px = input[c][y][x];   // the only read of this pixel
+                for (int ky = 0; ky < CONV1_DIM; ky++){
+#pragma HLS UNROLL
+                    for (int kx = 0; kx < CONV1_DIM-1; kx++){
+#pragma HLS UNROLL
+                        window[c][ky][kx] = window[c][ky][kx+1];
+                    }
+                }
+                for (int ky = 0; ky < CONV1_DIM-1; ky++){
+#pragma HLS UNROLL
+                    window[c][ky][CONV1_DIM-1] = line_buf[c][ky][x];
+                }
+                window[c][CONV1_DIM-1][CONV1_DIM-1] = px;
+                for (int ky = 0; ky < CONV1_DIM-2; ky++){
+#pragma HLS UNROLL
+                    line_buf[c][ky][x] = line_buf[c][ky+1][x];
+                }
+                line_buf[c][CONV1_DIM-2][x] = px;
+            }
+            if (y < CONV1_DIM-1 || x < CONV1_DIM-1) continue;
+
+            for (int m = 0; m < CONV1_NBOUTPUT; m++){
+#pragma HLS PIPELINE II=1
+                float acc = bias[m];
+                for (int c = 0; c < IMG_DEPTH; c++){
+#if (CONV1_UNROLL_C > 1)
+#pragma HLS UNROLL
+#endif
+                    for (int ky = 0; ky < CONV1_DIM; ky++){
+                        PRAGMA_UNROLL_K1;
+                        for (int kx = 0; kx < CONV1_DIM; kx++){
+                            PRAGMA_UNROLL_K1;
+                            acc += window[c][ky][kx] * kernel[m][c][ky][kx];
+                        }
+                    }
+                }
+                output[m][y-CONV1_DIM+1][x-CONV1_DIM+1] = acc;
+            }
+        }
+    }
+}
+
+void Conv2_12x12x20_5x5x40_1_0_lb(
+    float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH],
+    float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
+    float bias[CONV2_NBOUTPUT],
+    float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]
+){
+#pragma HLS INLINE off
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=2
+#if (CONV2_UNROLL_K > 1)
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=3
+#pragma HLS ARRAY_PARTITION variable=kernel complete dim=4
+#endif
+    float line_buf[POOL1_NBOUTPUT][CONV2_DIM-1][POOL1_WIDTH] = {{{0}}};   // rows y-K+1 .. y-1
+    float window[POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM] = {{{0}}};
+#pragma HLS ARRAY_PARTITION variable=line_buf complete dim=1
+#pragma HLS ARRAY_PARTITION variable=line_buf complete dim=2
+#pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+    for (int y = 0; y < POOL1_HEIGHT; y++){
+        for (int x = 0; x < POOL1_WIDTH; x++){
+            for (int c = 0; c < POOL1_NBOUTPUT; c++){
+#pragma HLS UNROLL
+                const float px = input[c][y][x];
+                for (int ky = 0; ky < CONV2_DIM; ky++){
+#pragma HLS UNROLL
+                    for (int kx = 0; kx < CONV2_DIM-1; kx++){
+#pragma HLS UNROLL
+                        window[c][ky][kx] = window[c][ky][kx+1];
+                    }
+                }
+                for (int ky = 0; ky < CONV2_DIM-1; ky++){
+#pragma HLS UNROLL
+                    window[c][ky][CONV2_DIM-1] = line_buf[c][ky][x];
+                }
+                window[c][CONV2_DIM-1][CONV2_DIM-1] = px;
+                for (int ky = 0; ky < CONV2_DIM-2; ky++){
+#pragma HLS UNROLL
+                    line_buf[c][ky][x] = line_buf[c][ky+1][x];
+                }
+                line_buf[c][CONV2_DIM-2][x] = px;
+            }
+            if (y < CONV2_DIM-1 || x < CONV2_DIM-1) continue;
+
+            for (int m = 0; m < CONV2_NBOUTPUT; m++){
+#pragma HLS PIPELINE II=1
+                float acc = bias[m];
+                for (int c = 0; c < POOL1_NBOUTPUT; c++){
+#if (CONV2_UNROLL_C > 1)
+#pragma HLS UNROLL
+#endif
+                    for (int ky = 0; ky < CONV2_DIM; ky++){
+                        PRAGMA_UNROLL_K2;
+                        for (int kx = 0; kx < CONV2_DIM; kx++){
+                            PRAGMA_UNROLL_K2;
+                            acc += window[c][ky][kx] * kernel[m][c][ky][kx];
+                        }
+                    }
+                }
+                output[m][y-CONV2_DIM+1][x-CONV2_DIM+1] = acc;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Channel-range variants: output channels [m0, m1) over nb_input input channels,
+// run-time counts. Same summation order as the direct kernels (valid convolution,
+// stride 1). The channel-pruned model (prune tool) compacts the kept channels at
+// the front of the full-size arrays (_pruned); lenet_par.c splits the output
+// channels across threads.
+// ---------------------------------------------------------------------------
+
+void Conv1_28x28x1_5x5x20_1_0_range(
+    float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH],
+    float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+    float bias[CONV1_NBOUTPUT],
+    int   m0,
+    int   m1,
+    float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]
+){
+#pragma HLS INLINE off
+    for (int m = m0; m < m1; m++){
+#pragma HLS LOOP_TRIPCOUNT min=1 max=20
+        for (int y = 0; y < CONV1_HEIGHT; y++){
+            for (int x = 0; x < CONV1_WIDTH; x++){
+#pragma HLS PIPELINE II=1
+                float acc = bias[m];
+                for (int c = 0; c < IMG_DEPTH; c++)
+                    for (int ky = 0; ky < CONV1_DIM; ky++)
+                        for (int kx = 0; kx < CONV1_DIM; kx++)
+                            acc += input[c][y + ky][x + kx] * kernel[m][c][ky][kx];
+                output[m][y][x] = acc;
+            }
+        }
+    }
+}
+
+void Conv2_12x12x20_5x5x40_1_0_range(
+    float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH],
+    float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
+    float bias[CONV2_NBOUTPUT],
+    int   nb_input,
+    int   m0,
+    int   m1,
+    float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]
+){
+#pragma HLS INLINE off
+    for (int m = m0; m < m1; m++){
+#pragma HLS LOOP_TRIPCOUNT min=1 max=40
+        for (int y = 0; y < CONV2_HEIGHT; y++){
+            for (int x = 0; x < CONV2_WIDTH; x++){
+#pragma HLS PIPELINE II=1
+                float acc = bias[m];
+                for (int c = 0; c < nb_input; c++){
+#pragma HLS LOOP_TRIPCOUNT min=1 max=20
+                    for (int ky = 0; ky < CONV2_DIM; ky++)
+                        for (int kx = 0; kx < CONV2_DIM; kx++)
+                            acc += input[c][y + ky][x + kx] * kernel[m][c][ky][kx];
+                }
+                output[m][y][x] = acc;
+            }
+        }
+    }
+}
+
+void Conv1_28x28x1_5x5x20_1_0_pruned(
+    float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH],
+    float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+    float bias[CONV1_NBOUTPUT],
+    int   nb_output,
+    float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]
+){
+    Conv1_28x28x1_5x5x20_1_0_range(input, kernel, bias, 0, nb_output, output);
+}
+
+void Conv2_12x12x20_5x5x40_1_0_pruned(
+    float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH],
+    float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM],
+    float bias[CONV2_NBOUTPUT],
+    int   nb_input,
+    int   nb_output,
+    float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]
+){
+    Conv2_12x12x20_5x5x40_1_0_range(input, kernel, bias, nb_input, 0, nb_output, output);
+}
@@ -0,0 +1,209 @@
+/**
+  ******************************************************************************
+  * @file    conv_codegen.c
+  * @brief   Weight-specialized Conv1 / Conv2 generator: emits C source (default conv_const.c)
+  * @brief   for Conv1_28x28x1_5x5x20_1_0_const and Conv2_12x12x20_5x5x40_1_0_const, every
+  * @brief   weight an immediate, the channels and 5x5 windows fully unrolled in the pixel loop.
+  * @brief   Zero weights are dropped, +-1 weights become adds / subtracts, powers of two are
+  * @brief   marked (exponent-only multiplies, shifts on an ap_fixed datapath), and every
+  * @brief   product input x |w| is computed once per pixel and shared by all the output
+  * @brief   channels that use it (the sign goes to the add). Each output keeps the summation
+  * @brief   order of conv.c (bias, then c, ky, kx).
+  * @brief   -b bits (default 8) first rounds each layer's weights to bits-bit fixed point
+  * @brief   (power-of-two step), which creates the zeros, powers of two and shared products.
+  * @brief   -b 0 keeps the float weights: the kernels are then bit-identical to
+  * @brief   Conv1_28x28x1_5x5x20_1_0 / Conv2_12x12x20_5x5x40_1_0, but the trained weights
+  * @brief   have no zero, +-1 or power-of-two values, so nothing is strength-reduced.
+  * @brief   The generated file also exports the weights it was built from (conv1_const_kernel, ...).
+  * @brief   Usage: conv_codegen [-o file.c] [-b bits] [-w weights.h5]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lenet_cnn_float.h"
+
+#define MAX_TAPS	(POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM)
+#define MAX_OUT		CONV2_NBOUTPUT
+
+typedef struct { 			// generation statistics of one layer
+  long 		weights, zeros, ones, pow2, products, pow2_products;
+} GenStats;
+
+static LenetWeights W;
+
+/* round to bits-bit signed fixed point, step a power of two covering max |w| */
+static void quantize(float *w, int n, int bits) {
+  float 	m = 0.0f, step;
+  int 		e, i;
+  long 		q, qmax = (1L << (bits - 1)) - 1;
+
+  for (i = 0; i < n; i++) if (fabsf(w[i]) > m) m = fabsf(w[i]);
+  if (m == 0.0f) return;
+  frexpf(m, &e); 			// m < 2^e
+  step = ldexpf(1.0f, e - (bits - 1));
+  for (i = 0; i < n; i++) {
+    q = lrintf(w[i] / step);
+    if (q > qmax) q = qmax;
+    if (q < -qmax - 1) q = -qmax - 1;
+    w[i] = (float)q * step;
+  }
+}
+
+static int is_pow2(float a, int *e) {
+  float f = frexpf(a, e); 	// a = f * 2^e
+  (*e)--;
+  return f == 0.5f;
+}
+
+/* kernel [nm][nc][k][k], braced per dimension */
+static void emit_kernel(FILE *f, const char *decl, const float *v, int nm, int nc, int k) {
+  int m, c, y, x;
+  fprintf(f, "%s = {\n", decl);
+  for (m = 0; m < nm; m++) {
+    fprintf(f, "  {\n");
+    for (c = 0; c < nc; c++) {
+      fprintf(f, "    {");
+      for (y = 0; y < k; y++) {
+        fprintf(f, "%s{", y ? ", " : " ");
+        for (x = 0; x < k; x++) fprintf(f, "%s%a", x ? ", " : " ", *v++);
+        fprintf(f, " }");
+      }
+      fprintf(f, " }%s\n", c < nc - 1 ? "," : "");
+    }
+    fprintf(f, "  }%s\n", m < nm - 1 ? "," : "");
+  }
+  fprintf(f, "};\n\n");
+}
+
+/* one convolution: input [nc][ih][iw], kernel [nm][nc][k][k], output [nm][oh][ow] */
+static void emit_conv(FILE *f, const char *name, int nc, int ih, int iw, int k, int nm, int oh, int ow,
+                      const float *kernel, const float *bias, GenStats *st) {
+  static int 	prod[MAX_TAPS][MAX_OUT]; 	// product index of (tap, output), -1: none
+  static float 	val[MAX_TAPS][MAX_OUT]; 	// |w| of each product of a tap
+  int 			nval[MAX_TAPS], used[MAX_TAPS];
+  const int 	ntaps = nc * k * k;
+  int 			t, m, j, e;
+  float 		w, a;
+
+  memset(st, 0, sizeof(*st));
+  for (t = 0; t < ntaps; t++) {
+    nval[t] = 0; used[t] = 0;
+    for (m = 0; m < nm; m++) {
+      w = kernel[m * ntaps + t]; a = fabsf(w);
+      st->weights++;
+      prod[t][m] = -1;
+      if (w == 0.0f) { st->zeros++; continue; }
+      used[t] = 1;
+      if (a == 1.0f) { st->ones++; continue; }
+      if (is_pow2(a, &e)) st->pow2++;
+      for (j = 0; j < nval[t] && val[t][j] != a; j++) ;
+      if (j == nval[t]) {
+        val[t][nval[t]++] = a;
+        st->products++;
+        if (is_pow2(a, &e)) st->pow2_products++;
+      }
+      prod[t][m] = j;
+    }
+  }
+
+  fprintf(f, "void %s(\n    float input[%d][%d][%d],\n    float output[%d][%d][%d]\n){\n", name, nc, ih, iw, nm, oh, ow);
+  fprintf(f, "#pragma HLS INLINE off\n#if CONV_CONST_PIXEL\n");
+  fprintf(f, "    for (int y = 0; y < %d; y++){\n        for (int x = 0; x < %d; x++){\n#pragma HLS PIPELINE II=1\n", oh, ow);
+  for (t = 0; t < ntaps; t++)
+    if (used[t])
+      fprintf(f, "            const float i%d = input[%d][y + %d][x + %d];\n", t, t / (k * k), t / k % k, t % k);
+  for (t = 0; t < ntaps; t++)
+    for (j = 0; j < nval[t]; j++) {
+      if (is_pow2(val[t][j], &e)) fprintf(f, "            const float p%d_%d = i%d * %af; \t// 2^%d\n", t, j, t, val[t][j], e);
+      else fprintf(f, "            const float p%d_%d = i%d * %af;\n", t, j, t, val[t][j]);
+    }
+  for (m = 0; m < nm; m++) {
+    fprintf(f, "            output[%d][y][x] = %af", m, bias[m]);
+    for (t = 0; t < ntaps; t++) {
+      w = kernel[m * ntaps + t];
+      if (w == 0.0f) continue;
+      if (prod[t][m] < 0) fprintf(f, " %c i%d", w > 0.0f ? '+' : '-', t);
+      else fprintf(f, " %c p%d_%d", w > 0.0f ? '+' : '-', t, prod[t][m]);
+    }
+    fprintf(f, ";\n");
+  }
+  fprintf(f, "        }\n    }\n#else\n");
+  // row form: one x loop per output channel, immediates inline
+  fprintf(f, "    for (int y = 0; y < %d; y++){\n", oh);
+  for (m = 0; m < nm; m++) {
+    fprintf(f, "        for (int x = 0; x < %d; x++)\n            output[%d][y][x] = %af", ow, m, bias[m]);
+    for (t = 0; t < ntaps; t++) {
+      w = kernel[m * ntaps + t]; a = fabsf(w);
+      if (w == 0.0f) continue;
+      if (a == 1.0f) fprintf(f, "\n                %c input[%d][y + %d][x + %d]", w > 0.0f ? '+' : '-', t / (k * k), t / k % k, t % k);
+      else fprintf(f, "\n                %c input[%d][y + %d][x + %d] * %af", w > 0.0f ? '+' : '-', t / (k * k), t / k % k, t % k, a);
+    }
+    fprintf(f, ";\n");
+  }
+  fprintf(f, "    }\n#endif\n}\n\n");
+}
+
+static void print_stats(const char *name, int npix, const GenStats *st) {
+  printf("%-6s %6ld weights: %5ld zero, %5ld +-1, %5ld power of two; multiplies per pixel %ld -> %ld "
+         "(%ld exponent-only), adds %ld -> %ld, %.2f M multiplies per image\n",
+         name, st->weights, st->zeros, st->ones, st->pow2, st->weights, st->products, st->pow2_products,
+         st->weights, st->weights - st->zeros, (double)st->products * npix / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+  char 		*out = "conv_const.c", *weights = "lenet_weights.weights.h5";
+  int 		bits = 8, i;
+  FILE 		*f;
+  GenStats 	s1, s2;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-o") && i+1 < argc) out = argv[++i];
+    else if (!strcmp(argv[i], "-b") && i+1 < argc) bits = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && i+1 < argc) weights = argv[++i];
+    else {
+      printf("Usage: %s [-o file.c] [-b bits] [-w weights.h5]\n", argv[0]);
+      printf("  -b bits  fixed-point weights (default 8); -b 0: float weights, bit-identical, no strength reduction\n");
+      exit(1);
+    }
+  }
+  if (bits < 0 || bits == 1 || bits > 24) {
+    printf("Error: -b expects 0 (float weights) or 2 .. 24 bits.\n");
+    exit(1);
+  }
+
+  ReadLenetWeights(weights, &W);
+  if (bits) {
+    quantize(&W.conv1_kernel[0][0][0][0], sizeof(W.conv1_kernel) / sizeof(float), bits);
+    quantize(&W.conv2_kernel[0][0][0][0], sizeof(W.conv2_kernel) / sizeof(float), bits);
+  }
+
+  f = fopen(out, "w");
+  if (!f) {
+    printf("Error: Cannot write %s.\n", out);
+    exit(1);
+  }
+  fprintf(f, "// %s — generated by conv_codegen from %s (%s), do not edit\n", out, weights,
+          bits ? "weights rounded to fixed point, see -b" : "float weights");
+  fprintf(f, "// Weight-specialized Conv1 / Conv2: immediates, unrolled windows, shared products (conv_codegen.c)\n\n");
+  fprintf(f, "#include \"lenet_cnn_float.h\"\n\n");
+  fprintf(f, "// 1: pixel-pipelined body, products shared by the output channels (HLS); 0: one x loop\n");
+  fprintf(f, "// per output channel (host SIMD)\n#ifndef CONV_CONST_PIXEL\n#define CONV_CONST_PIXEL 0\n#endif\n\n");
+  fprintf(f, "const int conv_const_bits = %d;\n\n", bits);
+  emit_kernel(f, "float conv1_const_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]",
+              &W.conv1_kernel[0][0][0][0], CONV1_NBOUTPUT, IMG_DEPTH, CONV1_DIM);
+  emit_kernel(f, "float conv2_const_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM]",
+              &W.conv2_kernel[0][0][0][0], CONV2_NBOUTPUT, POOL1_NBOUTPUT, CONV2_DIM);
+  emit_conv(f, "Conv1_28x28x1_5x5x20_1_0_const", IMG_DEPTH, IMG_HEIGHT, IMG_WIDTH, CONV1_DIM, CONV1_NBOUTPUT,
+            CONV1_HEIGHT, CONV1_WIDTH, &W.conv1_kernel[0][0][0][0], W.conv1_bias, &s1);
+  emit_conv(f, "Conv2_12x12x20_5x5x40_1_0_const", POOL1_NBOUTPUT, POOL1_HEIGHT, POOL1_WIDTH, CONV2_DIM, CONV2_NBOUTPUT,
+            CONV2_HEIGHT, CONV2_WIDTH, &W.conv2_kernel[0][0][0][0], W.conv2_bias, &s2);
+  fclose(f);
+
+  printf("%s: %s\n", out, bits ? "weights rounded to fixed point" : "float weights, bit-identical kernels");
+  print_stats("Conv1", CONV1_HEIGHT * CONV1_WIDTH, &s1);
+  print_stats("Conv2", CONV2_HEIGHT * CONV2_WIDTH, &s2);
+  return 0;
+}
@@ -0,0 +1,212 @@
+/**
+  ******************************************************************************
+  * @file    delta.c
+  * @brief   Incremental inference for near-duplicate consecutive frames
+  * @brief   Keeps the previous frame's activations, diffs the new input and only
+  * @brief   recomputes the Conv1/Pool1/Conv2/Pool2 outputs whose receptive field
+  * @brief   covers a change. FC1 is then updated from the changed Pool2 values.
+  * @brief   Host only, not for HLS.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lenet_cnn_float.h"
+
+// per-layer MACs of a full pass
+static const unsigned long long full_macs[DELTA_NB_LAYERS] = {
+  (unsigned long long)CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH*IMG_DEPTH*CONV1_DIM*CONV1_DIM,
+  (unsigned long long)CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM,
+  (unsigned long long)FC1_NBOUTPUT*POOL2_NBOUTPUT*POOL2_HEIGHT*POOL2_WIDTH,
+  (unsigned long long)FC2_NBOUTPUT*FC1_NBOUTPUT
+};
+
+/* Same per-tensor int8 scale as pool.c */
+static float pool_scale(const float *p, int n) {
+  float m = 0.0f;
+  for (int i = 0; i < n; i++) {
+    float a = p[i]; if (a < 0) a = -a;
+    if (a > m) m = a;
+  }
+  if (m < 1e-8f) m = 1e-8f;
+  return m / 127.0f;
+}
+
+/* One 2x2 window of pool.c: quantize, max in int8, dequantize */
+static float pool_window(const float *r0, const float *r1, float sx) {
+  const float inv_sx = 1.0f / sx;
+  int m = -128, v, k;
+  float in[4] = {r0[0], r0[1], r1[0], r1[1]};
+
+  for (k = 0; k < 4; k++) {
+    v = (int)lrintf(in[k] * inv_sx);
+    if (v > 127) v = 127;
+    if (v < -128) v = -128;
+    if (v > m) m = v;
+  }
+  return (float)((int8_t)m) * sx;
+}
+
+void DeltaInit(DeltaState *s, int exact_fc1) {
+  memset(s, 0, sizeof(*s));
+  s->exact_fc1 = exact_fc1;
+}
+
+/* Full FC1 accumulation, order of Fc1_40_400, kept before ReLU */
+static void fc1_full(DeltaState *s, LenetWeights *w) {
+  for (int o = 0; o < FC1_NBOUTPUT; o++) {
+    float acc = w->fc1_bias[o];
+    for (int c = 0; c < POOL2_NBOUTPUT; c++)
+      for (int y = 0; y < POOL2_HEIGHT; y++)
+        for (int x = 0; x < POOL2_WIDTH; x++)
+          acc += s->pool2[c][y][x] * w->fc1_kernel[o][c][y][x];
+    s->fc1_acc[o] = acc;
+  }
+}
+
+/**
+  * lenet_cnn() on a frame, reusing the previous frame's activations.
+  * Conv/pool outputs are recomputed with the summation order of conv.c / pool.c, so
+  * everything up to Pool2 is bit-identical to the full path. A change of a pool's
+  * per-tensor scale invalidates that whole pool (and what follows).
+  * FC1: exact_fc1 = 1 re-runs the dense FC1 when any Pool2 value changed (bit-exact
+  * logits); exact_fc1 = 0 adds the sparse delta product sum(dv * w) to the kept
+  * accumulators (float rounding drift, reset by a dense pass after DELTA_REFRESH sparse updates).
+  */
+void lenet_cnn_delta(DeltaState *s, float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetWeights *w,
+                     float output[FC2_NBOUTPUT]) {
+  unsigned char 	d_in[IMG_HEIGHT][IMG_WIDTH], d_c1[CONV1_HEIGHT][CONV1_WIDTH];
+  unsigned char 	d_p1[POOL1_HEIGHT][POOL1_WIDTH], d_c2[CONV2_HEIGHT][CONV2_WIDTH];
+  float 			fc1_out[FC1_NBOUTPUT];
+  int 				full = !s->valid, c, m, y, x, ky, kx, n_c1 = 0, n_c2 = 0, n_fc1 = 0;
+  float 			sx;
+
+  // 1. changed input pixels
+  memset(d_in, full, sizeof(d_in));
+  if (!full)
+    for (y = 0; y < IMG_HEIGHT; y++)
+      for (x = 0; x < IMG_WIDTH; x++)
+        for (c = 0; c < IMG_DEPTH; c++)
+          if (input[c][y][x] != s->input[c][y][x]) d_in[y][x] = 1;
+  memcpy(s->input, input, sizeof(s->input));
+
+  // 2. Conv1 (+ReLU) at the outputs whose 5x5 window covers a changed pixel
+  memset(d_c1, 0, sizeof(d_c1));
+  for (y = 0; y < IMG_HEIGHT; y++)
+    for (x = 0; x < IMG_WIDTH; x++) {
+      if (!d_in[y][x]) continue;
+      for (ky = 0; ky < CONV1_DIM; ky++)
+        for (kx = 0; kx < CONV1_DIM; kx++)
+          if (y-ky >= 0 && y-ky < CONV1_HEIGHT && x-kx >= 0 && x-kx < CONV1_WIDTH) d_c1[y-ky][x-kx] = 1;
+    }
+  for (y = 0; y < CONV1_HEIGHT; y++)
+    for (x = 0; x < CONV1_WIDTH; x++) {
+      if (!d_c1[y][x]) continue;
+      n_c1++;
+      for (m = 0; m < CONV1_NBOUTPUT; m++) {
+        float acc = w->conv1_bias[m];
+        for (c = 0; c < IMG_DEPTH; c++)
+          for (ky = 0; ky < CONV1_DIM; ky++)
+            for (kx = 0; kx < CONV1_DIM; kx++)
+              acc += input[c][y+ky][x+kx] * w->conv1_kernel[m][c][ky][kx];
+        s->conv1[m][y][x] = acc > 0.0f ? acc : 0.0f;
+      }
+    }
+
+  // 3. Pool1: all windows if the scale moved, else the windows over a recomputed output
+  sx = pool_scale(&s->conv1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+  if (sx != s->sx1) { if (s->valid) s->scale_resets++; full = 1; }
+  s->sx1 = sx;
+  memset(d_p1, 0, sizeof(d_p1));
+  for (y = 0; y < POOL1_HEIGHT; y++)
+    for (x = 0; x < POOL1_WIDTH; x++) {
+      if (!full && !d_c1[2*y][2*x] && !d_c1[2*y][2*x+1] && !d_c1[2*y+1][2*x] && !d_c1[2*y+1][2*x+1]) continue;
+      for (c = 0; c < POOL1_NBOUTPUT; c++) {
+        float v = pool_window(&s->conv1[c][2*y][2*x], &s->conv1[c][2*y+1][2*x], sx);
+        if (full || v != s->pool1[c][y][x]) d_p1[y][x] = 1;
+        s->pool1[c][y][x] = v;
+      }
+    }
+
+  // 4. Conv2 (+ReLU) over the changed Pool1 positions
+  memset(d_c2, 0, sizeof(d_c2));
+  for (y = 0; y < POOL1_HEIGHT; y++)
+    for (x = 0; x < POOL1_WIDTH; x++) {
+      if (!d_p1[y][x]) continue;
+      for (ky = 0; ky < CONV2_DIM; ky++)
+        for (kx = 0; kx < CONV2_DIM; kx++)
+          if (y-ky >= 0 && y-ky < CONV2_HEIGHT && x-kx >= 0 && x-kx < CONV2_WIDTH) d_c2[y-ky][x-kx] = 1;
+    }
+  for (y = 0; y < CONV2_HEIGHT; y++)
+    for (x = 0; x < CONV2_WIDTH; x++) {
+      if (!d_c2[y][x]) continue;
+      n_c2++;
+      for (m = 0; m < CONV2_NBOUTPUT; m++) {
+        float acc = w->conv2_bias[m];
+        for (c = 0; c < POOL1_NBOUTPUT; c++)
+          for (ky = 0; ky < CONV2_DIM; ky++)
+            for (kx = 0; kx < CONV2_DIM; kx++)
+              acc += s->pool1[c][y+ky][x+kx] * w->conv2_kernel[m][c][ky][kx];
+        s->conv2[m][y][x] = acc > 0.0f ? acc : 0.0f;
+      }
+    }
+
+  // 5. Pool2, collecting the changed values for FC1
+  full = !s->valid;
+  sx = pool_scale(&s->conv2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+  if (sx != s->sx2) { if (s->valid) s->scale_resets++; full = 1; }
+  s->sx2 = sx;
+  for (y = 0; y < POOL2_HEIGHT; y++)
+    for (x = 0; x < POOL2_WIDTH; x++) {
+      if (!full && !d_c2[2*y][2*x] && !d_c2[2*y][2*x+1] && !d_c2[2*y+1][2*x] && !d_c2[2*y+1][2*x+1]) continue;
+      for (c = 0; c < POOL2_NBOUTPUT; c++) {
+        float v = pool_window(&s->conv2[c][2*y][2*x], &s->conv2[c][2*y+1][2*x], sx);
+        if (v != s->pool2[c][y][x]) {
+          s->fc1_idx[n_fc1] = (c*POOL2_HEIGHT + y)*POOL2_WIDTH + x;
+          s->fc1_dv[n_fc1++] = v - s->pool2[c][y][x];
+        }
+        s->pool2[c][y][x] = v;
+      }
+    }
+
+  // 6. FC1: dense re-run or sparse delta product, then ReLU and the (small) FC2
+  if (!s->valid || (n_fc1 && (s->exact_fc1 || s->fc1_updates >= DELTA_REFRESH))) {
+    fc1_full(s, w);
+    n_fc1 = POOL2_NBOUTPUT*POOL2_HEIGHT*POOL2_WIDTH;
+    s->fc1_updates = 0;
+  }
+  else if (n_fc1) {
+    s->fc1_updates++;
+    float *wflat = &w->fc1_kernel[0][0][0][0];
+    for (int o = 0; o < FC1_NBOUTPUT; o++) {
+      const float *row = wflat + (long)o*POOL2_NBOUTPUT*POOL2_HEIGHT*POOL2_WIDTH;
+      float acc = 0.0f;
+      for (int i = 0; i < n_fc1; i++) acc += s->fc1_dv[i] * row[s->fc1_idx[i]];
+      s->fc1_acc[o] += acc;
+    }
+  }
+  for (int o = 0; o < FC1_NBOUTPUT; o++) fc1_out[o] = s->fc1_acc[o] > 0.0f ? s->fc1_acc[o] : 0.0f;
+  Fc2_400_10(fc1_out, w->fc2_kernel, w->fc2_bias, output);
+
+  s->valid = 1;
+  s->frames++;
+  s->macs[0] += (unsigned long long)n_c1 * CONV1_NBOUTPUT*IMG_DEPTH*CONV1_DIM*CONV1_DIM;
+  s->macs[1] += (unsigned long long)n_c2 * CONV2_NBOUTPUT*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM;
+  s->macs[2] += (unsigned long long)n_fc1 * FC1_NBOUTPUT;
+  s->macs[3] += full_macs[3];
+}
+
+/* Fraction of the full-pass MACs skipped so far, per layer (Conv1, Conv2, FC1, FC2) and overall */
+float DeltaSkipped(DeltaState *s, float layer[DELTA_NB_LAYERS]) {
+  unsigned long long done = 0, total = 0;
+
+  for (int l = 0; l < DELTA_NB_LAYERS; l++) {
+    unsigned long long f = full_macs[l] * s->frames;
+    if (layer) layer[l] = f ? 1.0f - (float)s->macs[l] / f : 0.0f;
+    done += s->macs[l];
+    total += f;
+  }
+  return total ? 1.0f - (float)done / total : 0.0f;
+}
@@ -30,6 +30,80 @@ void Fc1_40_400(
     }
 }
 
+// Fc1_40_400_lowrank: weight ~ u v (rank <= FC1_RANK_MAX, fc1_lowrank tool),
+// two back-to-back GEMVs: t = v input (rank), output = ReLU(u t + bias)
+void Fc1_40_400_lowrank(
+    float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],                               // IN  [40][4][4]
+    float v[FC1_RANK_MAX][FC1_NBINPUT],                                                    // IN  [rank][640]
+    float u[FC1_NBOUTPUT][FC1_RANK_MAX],                                                   // IN  [400][rank]
+    int   rank,                                                                            // IN
+    float bias[FC1_NBOUTPUT],                                                              // IN  [400]
+    float output[FC1_NBOUTPUT]                                                             // OUT [400]
+){
+#pragma HLS INLINE off
+    const float *in = &input[0][0][0];
+    float t[FC1_RANK_MAX];
+
+    for (int k = 0; k < rank; k++){
+        float acc = 0.0f;
+        for (int i = 0; i < FC1_NBINPUT; i++){
+#pragma HLS PIPELINE II=1
+            acc += v[k][i] * in[i];
+        }
+        t[k] = acc;
+    }
+    for (int o = 0; o < FC1_NBOUTPUT; o++){
+        float acc = bias[o];
+        for (int k = 0; k < rank; k++){
+#pragma HLS PIPELINE II=1
+            acc += u[o][k] * t[k];
+        }
+        output[o] = relu(acc);
+    }
+}
+
+// Fc1_40_400_range: neurons [o0, o1), over the first nb_channels Pool2 channels, same
+// summation order as Fc1_40_400 (lenet_par.c splits the neurons across threads)
+void Fc1_40_400_range(
+    float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],                               // IN  [nb_channels][4][4]
+    float weight[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],                // IN  [400][nb_channels][4][4]
+    float bias[FC1_NBOUTPUT],                                                              // IN  [400]
+    int   nb_channels,                                                                     // IN
+    int   o0,                                                                              // IN
+    int   o1,                                                                              // IN
+    float output[FC1_NBOUTPUT]                                                             // OUT [o0 .. o1-1]
+){
+#pragma HLS INLINE off
+    for (int o = o0; o < o1; o++){
+#pragma HLS LOOP_TRIPCOUNT min=1 max=400
+        float acc = bias[o];
+        for (int c = 0; c < nb_channels; c++){
+#pragma HLS LOOP_TRIPCOUNT min=1 max=40
+#pragma HLS PIPELINE II=1
+            for (int y = 0; y < POOL2_HEIGHT; y++){
+#pragma HLS UNROLL
+                for (int x = 0; x < POOL2_WIDTH; x++){
+#pragma HLS UNROLL
+                    acc += input[c][y][x] * weight[o][c][y][x];
+                }
+            }
+        }
+        output[o] = relu(acc);
+    }
+}
+
+// Fc1_40_400_pruned: only the first nb_channels Pool2 channels exist (prune tool),
+// the kernel's input slices are compacted the same way
+void Fc1_40_400_pruned(
+    float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],                               // IN  [nb_channels][4][4]
+    float weight[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],                // IN  [400][nb_channels][4][4]
+    float bias[FC1_NBOUTPUT],                                                              // IN  [400]
+    int   nb_channels,                                                                     // IN
+    float output[FC1_NBOUTPUT]                                                             // OUT [400]
+){
+    Fc1_40_400_range(input, weight, bias, nb_channels, 0, FC1_NBOUTPUT, output);
+}
+
 // Fc2_400_10: classic fully connected
 void Fc2_400_10(
     float input[400],            // IN
@@ -47,3 +121,188 @@ void Fc2_400_10(
         output[o] = acc; // softmax applied later
     }
 }
+
+// ---------------------------------------------------------------------------
+// Input-sparsity path: after ReLU many FC inputs are exactly zero. The nonzero
+// inputs are compacted into an index list and only their weight columns are
+// accumulated. Weights are stored input-major (FcTranspose*) so that each
+// column is contiguous. Per output the nonzero terms are added in the same
+// order as the dense kernels, so the results are identical (0 * w adds +-0).
+// ---------------------------------------------------------------------------
+
+void FcTransposeFc1(
+    float weight[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],
+    float weight_t[FC1_NBINPUT][FC1_NBOUTPUT]
+){
+    const float *w = &weight[0][0][0][0];
+    for (int o = 0; o < FC1_NBOUTPUT; o++)
+        for (int i = 0; i < FC1_NBINPUT; i++)
+            weight_t[i][o] = w[o*FC1_NBINPUT + i];
+}
+
+void FcTransposeFc2(
+    float weight[FC2_NBOUTPUT][FC1_NBOUTPUT],
+    float weight_t[FC1_NBOUTPUT][FC2_NBOUTPUT]
+){
+    for (int o = 0; o < FC2_NBOUTPUT; o++)
+        for (int i = 0; i < FC1_NBOUTPUT; i++)
+            weight_t[i][o] = weight[o][i];
+}
+
+static int compact_nonzero(const float *in, int n, int *idx, int layer, FcSparsity *stats){
+    int nz = 0;
+    for (int i = 0; i < n; i++){
+#pragma HLS PIPELINE II=1
+        if (in[i] != 0.0f) idx[nz++] = i;
+    }
+    if (stats){
+        stats->nonzero[layer] += nz;
+        stats->inputs[layer] += n;
+    }
+    return nz;
+}
+
+void Fc1_40_400_sparse(
+    float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],     // IN  [40][4][4]
+    float weight_t[FC1_NBINPUT][FC1_NBOUTPUT],                  // IN  [640][400], input-major
+    float bias[FC1_NBOUTPUT],                                   // IN
+    float output[FC1_NBOUTPUT],                                 // OUT
+    FcSparsity *stats                                           // OUT host statistics, or NULL
+){
+#pragma HLS INLINE off
+    const float *in = &input[0][0][0];
+    int idx[FC1_NBINPUT];
+    float acc[FC1_NBOUTPUT];
+    const int nz = compact_nonzero(in, FC1_NBINPUT, idx, 0, stats);
+
+    for (int o = 0; o < FC1_NBOUTPUT; o++) acc[o] = bias[o];
+    for (int k = 0; k < nz; k++){
+        const float v = in[idx[k]];
+        const float *col = weight_t[idx[k]];
+        for (int o = 0; o < FC1_NBOUTPUT; o++){
+#pragma HLS PIPELINE II=1
+            acc[o] += v * col[o];
+        }
+    }
+    for (int o = 0; o < FC1_NBOUTPUT; o++) output[o] = relu(acc[o]);
+}
+
+void Fc2_400_10_sparse(
+    float input[FC1_NBOUTPUT],                                  // IN
+    float weight_t[FC1_NBOUTPUT][FC2_NBOUTPUT],                 // IN  [400][10], input-major
+    float bias[FC2_NBOUTPUT],                                   // IN
+    float output[FC2_NBOUTPUT],                                 // OUT
+    FcSparsity *stats                                           // OUT host statistics, or NULL
+){
+#pragma HLS INLINE off
+    int idx[FC1_NBOUTPUT];
+    float acc[FC2_NBOUTPUT];
+    const int nz = compact_nonzero(input, FC1_NBOUTPUT, idx, 1, stats);
+
+    for (int o = 0; o < FC2_NBOUTPUT; o++) acc[o] = bias[o];
+    for (int k = 0; k < nz; k++){
+        const float v = input[idx[k]];
+        for (int o = 0; o < FC2_NBOUTPUT; o++){
+#pragma HLS UNROLL
+            acc[o] += v * weight_t[idx[k]][o];
+        }
+    }
+    for (int o = 0; o < FC2_NBOUTPUT; o++) output[o] = acc[o];
+}
+
+// Fraction of zero inputs counted in s by the Fc1 (layer 0) and Fc2 (layer 1) sparse kernels
+void FcSparsityStats(const FcSparsity *s, float zero_fraction[2]){
+    for (int l = 0; l < 2; l++)
+        zero_fraction[l] = s->inputs[l] ? 1.0f - (float)s->nonzero[l] / s->inputs[l] : 0.0f;
+}
+
+// ---------------------------------------------------------------------------
+// Streamed Fc1: the [400][640] weights stay in external memory as 512-bit AXI
+// words, packed host-side in consumption order (FcPackFc1Stream): tile after
+// tile of FC1_TILE outputs, input after input, the FC1_TILE weights of one
+// input in FC1_TILE_WORDS consecutive words. Two on-chip tile buffers
+// (ping-pong): the load of tile t+1 has no dependence on the compute of tile t,
+// so both run concurrently. Per output the sum is bias + inputs in the order of
+// Fc1_40_400, so the results are identical.
+// ---------------------------------------------------------------------------
+
+void FcPackFc1Stream(
+    float weight[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],
+    AxiWord packed[FC1_STREAM_WORDS]
+){
+    const float *w = &weight[0][0][0][0];
+    for (int t = 0; t < FC1_NB_TILES; t++)
+        for (int i = 0; i < FC1_NBINPUT; i++)
+            for (int k = 0; k < FC1_TILE; k++)
+                packed[(t*FC1_NBINPUT + i)*FC1_TILE_WORDS + k/AXI_WORD_FLOATS].f[k%AXI_WORD_FLOATS] =
+                    w[(t*FC1_TILE + k)*FC1_NBINPUT + i];
+}
+
+// one tile, in bursts of at most AXI_MAX_BURST beats that do not cross a 4 KB
+// boundary (AXI4 rule; wmem is 4 KB aligned); traffic counted in stats when not NULL
+static void fc1_load_tile(AxiWord *wmem, int tile, AxiWord buf[FC1_NBINPUT*FC1_TILE_WORDS], AxiStats *stats){
+#pragma HLS INLINE off
+    const long base = (long)tile * FC1_NBINPUT * FC1_TILE_WORDS;
+    const int n = FC1_NBINPUT * FC1_TILE_WORDS;
+    const int page = 4096 / (int)sizeof(AxiWord);
+    int b = 0;
+
+    while (b < n){
+        int len = page - (int)((base + b) % page);
+        if (len > AXI_MAX_BURST) len = AXI_MAX_BURST;
+        if (len > n - b) len = n - b;
+        for (int k = 0; k < len; k++){
+#pragma HLS PIPELINE II=1
+            buf[b + k] = wmem[base + b + k];
+        }
+        if (stats){
+            stats->bursts++;
+            stats->beats += len;
+        }
+        b += len;
+    }
+    if (stats) stats->bytes += (unsigned long long)n * sizeof(AxiWord);
+}
+
+static void fc1_compute_tile(const float *in, AxiWord buf[FC1_NBINPUT*FC1_TILE_WORDS], float bias[FC1_NBOUTPUT],
+                             int tile, float output[FC1_NBOUTPUT]){
+#pragma HLS INLINE off
+    float acc[FC1_TILE];
+#pragma HLS ARRAY_PARTITION variable=acc complete
+
+    for (int k = 0; k < FC1_TILE; k++) acc[k] = bias[tile*FC1_TILE + k];
+    for (int i = 0; i < FC1_NBINPUT; i++){
+#pragma HLS PIPELINE II=1
+        const float v = in[i];
+        for (int k = 0; k < FC1_TILE; k++){
+#pragma HLS UNROLL
+            acc[k] += v * buf[i*FC1_TILE_WORDS + k/AXI_WORD_FLOATS].f[k%AXI_WORD_FLOATS];
+        }
+    }
+    for (int k = 0; k < FC1_TILE; k++) output[tile*FC1_TILE + k] = relu(acc[k]);
+}
+
+void Fc1_40_400_stream(
+    float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],     // IN  [40][4][4]
+    AxiWord wmem[FC1_STREAM_WORDS],                             // IN  packed weights, external memory
+    float bias[FC1_NBOUTPUT],                                   // IN
+    float output[FC1_NBOUTPUT],                                 // OUT
+    AxiStats *stats                                             // OUT host statistics, or NULL
+){
+#pragma HLS INLINE off
+#pragma HLS INTERFACE m_axi port=wmem offset=slave bundle=gmem max_read_burst_length=64
+    const float *in = &input[0][0][0];
+    AxiWord ping[FC1_NBINPUT*FC1_TILE_WORDS], pong[FC1_NBINPUT*FC1_TILE_WORDS];
+
+    fc1_load_tile(wmem, 0, ping, stats);
+    for (int t = 0; t < FC1_NB_TILES; t++){
+        if (t & 1){
+            if (t + 1 < FC1_NB_TILES) fc1_load_tile(wmem, t + 1, ping, stats);
+            fc1_compute_tile(in, pong, bias, t, output);
+        } else {
+            if (t + 1 < FC1_NB_TILES) fc1_load_tile(wmem, t + 1, pong, stats);
+            fc1_compute_tile(in, ping, bias, t, output);
+        }
+    }
+    if (stats) stats->calls++;
+}
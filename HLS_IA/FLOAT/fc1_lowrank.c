@@ -0,0 +1,212 @@
+/**
+  ******************************************************************************
+  * @file    fc1_lowrank.c
+  * @brief   Offline tool: factors the Fc1 weight (400 x 640) by truncated SVD
+  * @brief   The trained Fc1 spectrum is flat (rank 64 keeps ~39% of the energy of W),
+  * @brief   so the SVD is taken of W X, X the Pool2 activations of calibration images:
+  * @brief   its left singular vectors U are the eigenvectors of W (X X^T) W^T (400 x 400,
+  * @brief   cyclic Jacobi, double precision). The rank-r factors u = U_r, v = U_r^T W
+  * @brief   give the best rank-r approximation of the Fc1 outputs on that data.
+  * @brief   -w takes the plain SVD of W instead (U from W W^T).
+  * @brief   The rank is the smallest one whose test-set accuracy (10k MNIST images,
+  * @brief   run through the Fc1_40_400_lowrank runtime kernel) stays within the budget
+  * @brief   of the full model, and the factors are written for lenet_cnn_float -l.
+  * @brief   Usage: fc1_lowrank [-e budget_points] [-r rank] [-c calib_images] [-w] [-o fc1_lowrank.bin]
+  * @brief   -e accuracy drop allowed in percentage points (default 0.1), -r forces a rank,
+  * @brief   -c calibration images (the first ones of the test set, default 2000).
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lenet_cnn_float.h"
+
+#define N 	FC1_NBOUTPUT
+#define K 	FC1_NBINPUT
+
+// Jacobi sweeps before giving up (converges in about 10 for this size)
+#ifndef SVD_MAX_SWEEPS
+#define SVD_MAX_SWEEPS	50
+#endif
+
+static LenetWeights 	W;
+static Fc1LowRank 		F;
+static double 			A[N][N], V[N][N], WD[N][K], EIG[N], Y[N];
+static int 				ORDER[N];
+static float 			P2[MNIST_TEST_SIZE][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (p[i] < 0.0f) p[i] = 0.0f;
+}
+
+/* Cyclic Jacobi: A symmetric -> eigenvalues on its diagonal, eigenvectors in the columns of V */
+static int jacobi_eigen(void) {
+  int sweep, p, q, i;
+  double off, total, theta, t, c, s, tau, app, aqq, apq;
+
+  for (p = 0; p < N; p++) for (q = 0; q < N; q++) V[p][q] = (p == q);
+  for (total = 0, p = 0; p < N; p++) for (q = 0; q < N; q++) total += A[p][q] * A[p][q];
+
+  for (sweep = 0; sweep < SVD_MAX_SWEEPS; sweep++) {
+    for (off = 0, p = 0; p < N; p++) for (q = p+1; q < N; q++) off += 2 * A[p][q] * A[p][q];
+    if (off <= 1e-24 * total) return sweep;
+    for (p = 0; p < N; p++)
+      for (q = p+1; q < N; q++) {
+        apq = A[p][q];
+        if (fabs(apq) < 1e-300) continue;
+        app = A[p][p]; aqq = A[q][q];
+        theta = (aqq - app) / (2 * apq);
+        t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+        c = 1 / sqrt(t * t + 1); s = t * c; tau = s / (1 + c);
+        A[p][p] = app - t * apq;
+        A[q][q] = aqq + t * apq;
+        A[p][q] = A[q][p] = 0;
+        for (i = 0; i < N; i++) {
+          if (i != p && i != q) {
+            double aip = A[i][p], aiq = A[i][q];
+            A[i][p] = A[p][i] = aip - s * (aiq + tau * aip);
+            A[i][q] = A[q][i] = aiq + s * (aip - tau * aiq);
+          }
+          double vip = V[i][p], viq = V[i][q];
+          V[i][p] = vip - s * (viq + tau * vip);
+          V[i][q] = viq + s * (vip - tau * viq);
+        }
+      }
+  }
+  return sweep;
+}
+
+static int cmp_eig(const void *a, const void *b) {
+  double d = EIG[*(const int *)b] - EIG[*(const int *)a];
+  return (d > 0) - (d < 0);
+}
+
+/* rank-r factors: u = U_r, v = U_r^T W */
+static void factors(int r) {
+  int k, o, i;
+
+  F.rank = r;
+  for (k = 0; k < r; k++)
+    for (i = 0; i < K; i++) {
+      double acc = 0;
+      for (o = 0; o < N; o++) acc += V[o][ORDER[k]] * WD[o][i];
+      F.v[k][i] = (float)acc;
+    }
+  for (o = 0; o < N; o++)
+    for (k = 0; k < r; k++) F.u[o][k] = (float)V[o][ORDER[k]];
+}
+
+/* test-set accuracy (%), full Fc1 when r == 0 */
+static float accuracy(int r) {
+  float fc1[FC1_NBOUTPUT], out[FC2_NBOUTPUT];
+  int i, k, best, ok = 0;
+
+  for (i = 0; i < MNIST_TEST_SIZE; i++) {
+    if (r) Fc1_40_400_lowrank(P2[i], F.v, F.u, r, W.fc1_bias, fc1);
+    else   Fc1_40_400(P2[i], W.fc1_kernel, W.fc1_bias, fc1);
+    Fc2_400_10(fc1, W.fc2_kernel, W.fc2_bias, out);
+    for (best = 0, k = 1; k < FC2_NBOUTPUT; k++) if (out[k] > out[best]) best = k;
+    ok += (best == LABELS[i]);
+  }
+  return 100.0f * ok / MNIST_TEST_SIZE;
+}
+
+int main(int argc, char *argv[]) {
+  char 		*out_filename = "fc1_lowrank.bin", img_filename[120];
+  float 	budget = 0.1f, acc_full, acc = 0.0f;
+  int 		force = 0, ncalib = 2000, weights_only = 0, r, o, p, i, j, sweeps;
+  double 	energy, total;
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 	in[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 	c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float 	c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-e") && i+1 < argc) budget = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i+1 < argc) force = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) ncalib = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w")) weights_only = 1;
+    else if (!strcmp(argv[i], "-o") && i+1 < argc) out_filename = argv[++i];
+    else {
+      printf("Usage: %s [-e budget_points] [-r rank] [-c calib_images] [-w] [-o fc1_lowrank.bin]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (ncalib < 1 || ncalib > MNIST_TEST_SIZE) ncalib = MNIST_TEST_SIZE;
+  if (force < 0 || force > FC1_RANK_MAX) {
+    printf("Error: Rank must be in 1 .. %d (FC1_RANK_MAX).\n", FC1_RANK_MAX);
+    exit(1);
+  }
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+
+  // Fc1 inputs of the whole test set, once
+  printf("Pool2 activations of %d test images\n", MNIST_TEST_SIZE);
+  for (i = 0; i < MNIST_TEST_SIZE; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)in, IMG_WIDTH, IMG_HEIGHT);
+    Conv1_28x28x1_5x5x20_1_0(in, W.conv1_kernel, W.conv1_bias, c1);
+    relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(c1, p1);
+    Conv2_12x12x20_5x5x40_1_0(p1, W.conv2_kernel, W.conv2_bias, c2);
+    relu(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+    Pool2_8x8x40_2x2x40_2_0(c2, P2[i]);
+  }
+
+  // M M^T and its eigendecomposition (M = U S V^T, M M^T = U S^2 U^T), M = W X or W
+  for (o = 0; o < N; o++) for (i = 0; i < K; i++) WD[o][i] = (&W.fc1_kernel[o][0][0][0])[i];
+  if (weights_only)
+    for (o = 0; o < N; o++)
+      for (p = o; p < N; p++) {
+        double acc2 = 0;
+        for (i = 0; i < K; i++) acc2 += WD[o][i] * WD[p][i];
+        A[o][p] = A[p][o] = acc2;
+      }
+  else {
+    for (j = 0; j < ncalib; j++) {
+      const float *x = &P2[j][0][0][0];
+      for (o = 0; o < N; o++) {
+        double acc2 = 0;
+        for (i = 0; i < K; i++) acc2 += WD[o][i] * x[i];
+        Y[o] = acc2;
+      }
+      for (o = 0; o < N; o++) for (p = o; p < N; p++) A[o][p] += Y[o] * Y[p];
+    }
+    for (o = 0; o < N; o++) for (p = 0; p < o; p++) A[o][p] = A[p][o];
+  }
+  sweeps = jacobi_eigen();
+  for (total = 0, o = 0; o < N; o++) { EIG[o] = A[o][o] > 0 ? A[o][o] : 0; ORDER[o] = o; total += EIG[o]; }
+  qsort(ORDER, N, sizeof(int), cmp_eig);
+  if (weights_only) printf("Jacobi SVD of the Fc1 weight (%d x %d): %d sweeps\n", N, K, sweeps);
+  else printf("Jacobi SVD of the Fc1 weight times %d calibration activations (%d x %d): %d sweeps\n", ncalib, N, K, sweeps);
+
+  acc_full = accuracy(0);
+  printf("Full Fc1: %.2f%% (%d MACs, %lu KB)\n\n", acc_full, N*K, (unsigned long)(N*K*sizeof(float)/1024));
+  printf("rank \t energy \t accuracy \t MACs \t\t weights\n");
+
+  // smallest rank within the budget (ranks by 4), or the forced one
+  for (r = force ? force : 4; r <= FC1_RANK_MAX; r += 4) {
+    factors(r);
+    acc = accuracy(r);
+    for (energy = 0, i = 0; i < r; i++) energy += EIG[ORDER[i]];
+    printf("%4d \t %6.2f%% \t %6.2f%% \t %6d (x%.1f) \t %4lu KB\n", r, 100*energy/total, acc,
+           r*(N+K), (double)N*K/(r*(N+K)), (unsigned long)(r*(N+K)*sizeof(float)/1024));
+    if (force || acc >= acc_full - budget) break;
+  }
+  if (r > FC1_RANK_MAX) {
+    printf("Error: No rank up to %d (FC1_RANK_MAX) within %.2f points of the full model.\n", FC1_RANK_MAX, budget);
+    exit(1);
+  }
+
+  WriteFc1LowRank(out_filename, &F);
+  printf("\nRank %d written to %s (%.2f%% vs %.2f%% full, budget %.2f points)\n", F.rank, out_filename, acc, acc_full, budget);
+  return 0;
+}
@@ -0,0 +1,148 @@
+/**
+  ******************************************************************************
+  * @file    fcn.c
+  * @brief   Fully-convolutional LeNet over an arbitrarily sized page
+  * @brief   Conv1/Pool1/Conv2/Pool2 run once over the region of interest, FC1/FC2
+  * @brief   are then applied as a 4x4x40 convolution (+ 1x1) on the pooled map, which
+  * @brief   gives a dense map of class scores, one per 28x28 patch position.
+  * @brief   The pools take the exact float max, without the per-tensor int8 step of
+  * @brief   pool.c, so the map is close to but not the same as lenet_cnn() per patch.
+  * @brief   Host only (heap buffers sized by the page), not for HLS.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lenet_cnn_float.h"
+
+// pixels between two pooled-map positions (Pool1 x Pool2 stride)
+#define FCN_NATIVE_STRIDE	(POOL1_STRIDE*POOL2_STRIDE)
+
+/* Valid KxK convolution + ReLU over a C x H x W map. Per output pixel the sum runs
+   over c, ky, kx as in conv.c, so the values match the fixed-size kernels. */
+static void conv_relu(float *in, int C, int H, int W, float *kernel, float *bias, int M, int K, float *out) {
+  const int OH = H - K + 1, OW = W - K + 1;
+  int m, c, ky, kx, y, x;
+
+  for (m = 0; m < M; m++) {
+    float *o = out + (long)m*OH*OW;
+    for (y = 0; y < OH*OW; y++) o[y] = bias[m];
+    for (c = 0; c < C; c++)
+      for (ky = 0; ky < K; ky++)
+        for (kx = 0; kx < K; kx++) {
+          const float k = kernel[((m*C + c)*K + ky)*K + kx];
+          for (y = 0; y < OH; y++) {
+            const float *i = in + ((long)c*H + y + ky)*W + kx;
+            float *row = o + (long)y*OW;
+            for (x = 0; x < OW; x++) row[x] += i[x] * k;
+          }
+        }
+    for (y = 0; y < OH*OW; y++) if (o[y] < 0.0f) o[y] = 0.0f;
+  }
+}
+
+/* 2x2 stride 2 max-pool (floor), exact float max */
+static void pool2x2(float *in, int C, int H, int W, float *out) {
+  const int OH = H / 2, OW = W / 2;
+  int c, y, x;
+
+  for (c = 0; c < C; c++)
+    for (y = 0; y < OH; y++) {
+      const float *r0 = in + ((long)c*H + 2*y)*W, *r1 = r0 + W;
+      float *o = out + ((long)c*OH + y)*OW;
+      for (x = 0; x < OW; x++) {
+        float m = r0[2*x];
+        if (r0[2*x+1] > m) m = r0[2*x+1];
+        if (r1[2*x] > m) m = r1[2*x];
+        if (r1[2*x+1] > m) m = r1[2*x+1];
+        o[x] = m;
+      }
+    }
+}
+
+/* Score map size for a roi_w x roi_h region: one entry per patch position */
+int LenetFcnMapSize(int roi_w, int roi_h, int stride, int *nx, int *ny) {
+  if (stride < 1 || (stride < FCN_NATIVE_STRIDE && FCN_NATIVE_STRIDE % stride) ||
+      (stride > FCN_NATIVE_STRIDE && stride % FCN_NATIVE_STRIDE))
+    return -1;
+  if (roi_w < IMG_WIDTH || roi_h < IMG_HEIGHT) return -1;
+  *nx = (roi_w - IMG_WIDTH) / stride + 1;
+  *ny = (roi_h - IMG_HEIGHT) / stride + 1;
+  return 0;
+}
+
+/**
+  * Dense class-probability map of a page (8-bit pixels, row-major, width x height).
+  * Entry (i, j) of scores[ny][nx][FC2_NBOUTPUT] is the softmax output for the 28x28
+  * patch at (roi->x + j*stride, roi->y + i*stride). roi = NULL scans the whole page.
+  * stride: a divisor of 4 (shift-and-stitch, one conv pass per phase) or a multiple
+  * of 4 (pooled map subsampled). Pooling is exact float max, so the scores equal the
+  * per-patch lenet_cnn() ones up to its int8 pool rounding.
+  * Returns 0, or -1 for an invalid stride / ROI.
+  */
+int LenetFcn(unsigned char *page, int width, int height, FcnRoi *roi, int stride, LenetWeights *w,
+             float *scores, int *nx, int *ny) {
+  FcnRoi 	full = {0, 0, width, height};
+  int 		phase, py, px, sw, sh, h1, w1, hp1, wp1, h2, w2, hp2, wp2, i, j, x, y, c;
+  int 		step = stride > FCN_NATIVE_STRIDE ? stride / FCN_NATIVE_STRIDE : 1;
+  int 		nphase = stride < FCN_NATIVE_STRIDE ? FCN_NATIVE_STRIDE / stride : 1;
+  float 	*in, *c1, *p1, *c2, *p2;
+  float 	window[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+  float 	fc1[FC1_NBOUTPUT], logits[FC2_NBOUTPUT];
+
+  if (!roi) roi = &full;
+  if (roi->x < 0 || roi->y < 0 || roi->x + roi->width > width || roi->y + roi->height > height) return -1;
+  if (LenetFcnMapSize(roi->width, roi->height, stride, nx, ny)) return -1;
+
+  // buffers for the largest phase (0, 0)
+  h1 = roi->height - CONV1_DIM + 1;  w1 = roi->width - CONV1_DIM + 1;
+  hp1 = h1 / 2;  wp1 = w1 / 2;
+  h2 = hp1 - CONV2_DIM + 1;  w2 = wp1 - CONV2_DIM + 1;
+  in = (float *)malloc((long)roi->height*roi->width*sizeof(float));
+  c1 = (float *)malloc((long)CONV1_NBOUTPUT*h1*w1*sizeof(float));
+  p1 = (float *)malloc((long)POOL1_NBOUTPUT*hp1*wp1*sizeof(float));
+  c2 = (float *)malloc((long)CONV2_NBOUTPUT*h2*w2*sizeof(float));
+  p2 = (float *)malloc((long)POOL2_NBOUTPUT*(h2/2)*(w2/2)*sizeof(float));
+  if (!in || !c1 || !p1 || !c2 || !p2) {
+    printf("Error: Unable to allocate the FCN buffers (%dx%d ROI).\n", roi->width, roi->height);
+    exit(1);
+  }
+
+  for (phase = 0; phase < nphase*nphase; phase++) {
+    py = (phase / nphase) * stride;
+    px = (phase % nphase) * stride;
+    if (px > roi->width - IMG_WIDTH || py > roi->height - IMG_HEIGHT) continue;
+
+    // sub-region starting at the phase offset, normalized as NormalizeImg
+    sh = roi->height - py;  sw = roi->width - px;
+    for (y = 0; y < sh; y++)
+      for (x = 0; x < sw; x++)
+        in[(long)y*sw + x] = (float)page[(long)(roi->y + py + y)*width + roi->x + px + x] / 255;
+
+    h1 = sh - CONV1_DIM + 1;  w1 = sw - CONV1_DIM + 1;
+    conv_relu(in, IMG_DEPTH, sh, sw, &w->conv1_kernel[0][0][0][0], w->conv1_bias, CONV1_NBOUTPUT, CONV1_DIM, c1);
+    hp1 = h1 / 2;  wp1 = w1 / 2;
+    pool2x2(c1, CONV1_NBOUTPUT, h1, w1, p1);
+    h2 = hp1 - CONV2_DIM + 1;  w2 = wp1 - CONV2_DIM + 1;
+    conv_relu(p1, POOL1_NBOUTPUT, hp1, wp1, &w->conv2_kernel[0][0][0][0], w->conv2_bias, CONV2_NBOUTPUT, CONV2_DIM, c2);
+    hp2 = h2 / 2;  wp2 = w2 / 2;
+    pool2x2(c2, CONV2_NBOUTPUT, h2, w2, p2);
+
+    // FC1 as a 4x4x40 convolution, FC2 as 1x1, at the pooled positions of this phase
+    for (i = 0; i + POOL2_HEIGHT <= hp2; i += step)
+      for (j = 0; j + POOL2_WIDTH <= wp2; j += step) {
+        int oy = (py + i*FCN_NATIVE_STRIDE) / stride, ox = (px + j*FCN_NATIVE_STRIDE) / stride;
+        if (oy >= *ny || ox >= *nx) continue;
+        for (c = 0; c < POOL2_NBOUTPUT; c++)
+          for (y = 0; y < POOL2_HEIGHT; y++)
+            memcpy(window[c][y], p2 + ((long)c*hp2 + i + y)*wp2 + j, POOL2_WIDTH*sizeof(float));
+        Fc1_40_400(window, w->fc1_kernel, w->fc1_bias, fc1);
+        Fc2_400_10(fc1, w->fc2_kernel, w->fc2_bias, logits);
+        Softmax(logits, scores + ((long)oy*(*nx) + ox)*FC2_NBOUTPUT);
+      }
+  }
+
+  free(in); free(c1); free(p1); free(c2); free(p2);
+  return 0;
+}
@@ -0,0 +1,312 @@
+/**
+  ******************************************************************************
+  * @file    hls_estimate.c
+  * @brief   Static Vivado HLS latency / resource estimate of the LeNet top level (lenet_cnn.c)
+  * @brief   Layer dimensions come from lenet_cnn_float.h and the knobs from the same macros as
+  * @brief   conv.c (CONV1_UNROLL_C, CONV1_UNROLL_K, CONV2_UNROLL_C, CONV2_UNROLL_K, -D to override).
+  * @brief   Each weighted layer is a MAC loop nest: P MACs per pipelined iteration (P = K, the
+  * @brief   reduction length, when the pipeline sits at the output loop and the reduction is
+  * @brief   unrolled), input and weights cyclically partitioned in B banks (two ports each),
+  * @brief   and a target II. Achieved II = max(target, memory ports, accumulator recurrence);
+  * @brief   latency = outer trips x ((pipelined trips - 1) x II + depth); DSPs are shared over
+  * @brief   the II; BRAM18 counted per bank (banks of <= 1 Kbit go to LUTRAM). Operator
+  * @brief   latencies and costs are typical xc7 figures at 100 MHz, not a synthesis result.
+  * @brief   As written, PIPELINE at the pixel loop of conv.c unrolls c / ky / kx whatever the
+  * @brief   UNROLL knobs; they only change the kernel partitioning (UNROLL_K > 1: dims 3, 4).
+  * @brief   Usage: hls_estimate [-t float|fixed] [-w bits] [-c MHz] [-u] [-d] [-l layer=P/B/II]...
+  * @brief                       [-s] [-D dsp_budget] [-B bram_budget] [-n top]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lenet_cnn_float.h"
+
+// knobs, as in conv.c
+#ifndef CONV1_UNROLL_C
+#define CONV1_UNROLL_C IMG_DEPTH
+#endif
+#ifndef CONV2_UNROLL_C
+#define CONV2_UNROLL_C CONV1_NBOUTPUT
+#endif
+#ifndef CONV1_UNROLL_K
+#define CONV1_UNROLL_K 1
+#endif
+#ifndef CONV2_UNROLL_K
+#define CONV2_UNROLL_K 1
+#endif
+
+// operators (xc7, 100 MHz)
+#define FMUL_LAT		4
+#define FADD_LAT		5
+#define FMUL_DSP		3
+#define FADD_DSP		2
+#define IMUL_LAT		3 	// DSP48, pipelined
+#define IADD_LAT		1
+#define IMAC_DSP		1
+#define LOOP_OVERHEAD	2 	// loop entry / exit per outer trip
+
+#define LUTRAM_BITS		1024
+#define DEVICE_DSP		220 	// xc7z020
+#define DEVICE_BRAM		280
+
+#define NB_MAC		4 		// Conv1, Conv2, Fc1, Fc2
+#define NB_POOL		2
+#define MAX_CAND	4096
+#define MAX_TOP		64
+
+typedef struct {
+  const char 	*name;
+  int 			nout, k; 			// outputs, reduction length
+  long 			in_words, w_words; 	// input tensor, weights
+} MacLayer;
+
+typedef struct {
+  int 			p, b_in, b_w, ii; 	// MACs / iteration, banks, target II
+} MacKnobs;
+
+typedef struct {
+  MacKnobs 		k;
+  long 			outer, trip;
+  int 			ii, depth, dsp, bram;
+  char 			limit; 				// II limited by: '-' target, 'm' memory ports, 'r' recurrence
+  long 			cycles;
+} MacEstimate;
+
+static const MacLayer LAYERS[NB_MAC] = {
+  { "Conv1", CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH, IMG_DEPTH*CONV1_DIM*CONV1_DIM,
+    IMG_DEPTH*IMG_HEIGHT*IMG_WIDTH, CONV1_NBOUTPUT*IMG_DEPTH*CONV1_DIM*CONV1_DIM },
+  { "Conv2", CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH, POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM,
+    POOL1_NBOUTPUT*POOL1_HEIGHT*POOL1_WIDTH, CONV2_NBOUTPUT*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM },
+  { "Fc1", FC1_NBOUTPUT, FC1_NBINPUT, FC1_NBINPUT, (long)FC1_NBOUTPUT*FC1_NBINPUT },
+  { "Fc2", FC2_NBOUTPUT, FC1_NBOUTPUT, FC1_NBOUTPUT, FC2_NBOUTPUT*FC1_NBOUTPUT },
+};
+
+static int 		FIXED = 0, BITS = 0, BALANCED = 0, DATAFLOW = 0; 	// BITS 0: 32 float, 16 fixed
+static double 	MHZ = 100.0;
+
+static int cdiv(long a, long b) { return (int)((a + b - 1) / b); }
+
+static int clog2(int n) {
+  int k = 0;
+  while ((1 << k) < n) k++;
+  return k;
+}
+
+/* BRAM18 of an array of words of bits, split in banks (best aspect ratio per bank) */
+static int bram(long words, int bits, int banks) {
+  static const int width[] = { 1, 2, 4, 9, 18, 36 }, depth[] = { 16384, 8192, 4096, 2048, 1024, 512 };
+  const long 	bank = (words + banks - 1) / banks;
+  int 			i, n, best = 0;
+
+  if (bank * bits <= LUTRAM_BITS) return 0;
+  for (i = 0; i < 6; i++) {
+    n = cdiv(bank, depth[i]) * cdiv(bits, width[i]);
+    if (!best || n < best) best = n;
+  }
+  return best * banks;
+}
+
+static void estimate(const MacLayer *l, const MacKnobs *k, MacEstimate *e) {
+  const int full = k->p >= l->k; 	// reduction unrolled: no loop-carried accumulator
+  const int mul_lat = FIXED ? IMUL_LAT : FMUL_LAT, add_lat = FIXED ? IADD_LAT : FADD_LAT;
+  const int tree = FIXED || BALANCED; 	// adds reassociated into a tree (float: unsafe math)
+  int ii_mem, ii_rec;
+
+  e->k = *k;
+  if (full) { e->outer = 1; e->trip = l->nout; } 	// perfect output nest, flattened
+  else { e->outer = l->nout; e->trip = cdiv(l->k, k->p); }
+  ii_mem = cdiv(k->p, 2 * k->b_in);
+  if (cdiv(k->p, 2 * k->b_w) > ii_mem) ii_mem = cdiv(k->p, 2 * k->b_w);
+  ii_rec = full ? 1 : (tree ? add_lat : k->p * add_lat); 	// P adds chained on the accumulator
+  e->ii = k->ii; e->limit = '-';
+  if (ii_mem > e->ii) { e->ii = ii_mem; e->limit = 'm'; }
+  if (ii_rec > e->ii) { e->ii = ii_rec; e->limit = 'r'; }
+  e->depth = mul_lat + (tree ? clog2(k->p + 1) : k->p) * add_lat + 1; 	// + 1: read
+  e->cycles = e->outer * ((e->trip - 1) * e->ii + e->depth + LOOP_OVERHEAD);
+  e->dsp = cdiv(k->p, e->ii) * (FIXED ? IMAC_DSP : FMUL_DSP + FADD_DSP);
+  e->bram = bram(l->in_words, BITS, k->b_in) + bram(l->w_words, BITS, k->b_w);
+}
+
+/* ReLU + Pool (pool.c): max |x| pass, int8 quantization pass, 2x2 max-pool at II 2 (4 reads
+   of one in_q channel bank); conv output buffer and in_q (partitioned by channel) */
+static void estimate_pool(int c, int h, int w, long *cycles, int *dsp, int *bram_out) {
+  const long n_in = (long)c * h * w, n_out = n_in / 4;
+  const int mul_lat = FIXED ? IMUL_LAT : FMUL_LAT;
+  *cycles = (n_in + 3 + LOOP_OVERHEAD) 		// ReLU
+          + (n_in + 3 + LOOP_OVERHEAD) 		// max |x|
+          + (n_in + mul_lat + 4 + LOOP_OVERHEAD) 	// quantize
+          + ((n_out - 1) * 2 + mul_lat + 3 + LOOP_OVERHEAD);
+  *dsp = FIXED ? 2 : 2 * FMUL_DSP;
+  *bram_out = bram(n_in, BITS, 1) + bram(n_in, 8, c);
+}
+
+/* the kernels as written, from the knobs */
+static void as_written(MacKnobs k[NB_MAC]) {
+  k[0].p = LAYERS[0].k; k[0].b_in = 1; k[0].b_w = IMG_DEPTH * (CONV1_UNROLL_K > 1 ? CONV1_DIM*CONV1_DIM : 1); k[0].ii = 1;
+  k[1].p = LAYERS[1].k; k[1].b_in = 1; k[1].b_w = POOL1_NBOUTPUT * (CONV2_UNROLL_K > 1 ? CONV2_DIM*CONV2_DIM : 1); k[1].ii = 1;
+  k[2].p = POOL2_HEIGHT * POOL2_WIDTH; k[2].b_in = 1; k[2].b_w = 1; k[2].ii = 1; 	// PIPELINE at c, y / x unrolled
+  k[3].p = 1; k[3].b_in = 1; k[3].b_w = 1; k[3].ii = 1;
+}
+
+static long POOL_CYCLES;
+static int 	POOL_DSP, POOL_BRAM;
+
+static void pools(void) {
+  long c; int d, b;
+  estimate_pool(CONV1_NBOUTPUT, CONV1_HEIGHT, CONV1_WIDTH, &POOL_CYCLES, &POOL_DSP, &POOL_BRAM);
+  estimate_pool(CONV2_NBOUTPUT, CONV2_HEIGHT, CONV2_WIDTH, &c, &d, &b);
+  POOL_CYCLES += c; POOL_DSP += d; POOL_BRAM += b;
+}
+
+/* whole design: latency (sum) and interval (sum, or the slowest stage under DATAFLOW) */
+static long interval(const MacEstimate e[NB_MAC], long *latency, int *dsp, int *bram_total) {
+  long lat = POOL_CYCLES, worst = POOL_CYCLES / NB_POOL; 	// the two pools are separate dataflow stages
+  int i;
+  *dsp = POOL_DSP; *bram_total = POOL_BRAM;
+  for (i = 0; i < NB_MAC; i++) {
+    lat += e[i].cycles;
+    if (e[i].cycles > worst) worst = e[i].cycles;
+    *dsp += e[i].dsp; *bram_total += e[i].bram;
+  }
+  *latency = lat;
+  return DATAFLOW ? worst : lat;
+}
+
+static void print_design(const char *title, const MacEstimate e[NB_MAC]) {
+  long 	lat, ivl;
+  int 	dsp, br, i;
+
+  ivl = interval(e, &lat, &dsp, &br);
+  printf("%s\n", title);
+  printf("  %-6s %7s x %-5s %5s %4s %4s %6s %6s %10s %10s %5s %5s\n", "layer", "outer", "trip", "P", "Bin", "Bw",
+         "II", "depth", "cycles", "us", "DSP", "BRAM");
+  for (i = 0; i < NB_MAC; i++)
+    printf("  %-6s %7ld x %-5ld %5d %4d %4d %4d %c %6d %10ld %10.1f %5d %5d\n", LAYERS[i].name, e[i].outer, e[i].trip,
+           e[i].k.p, e[i].k.b_in, e[i].k.b_w, e[i].ii, e[i].limit, e[i].depth, e[i].cycles, e[i].cycles / MHZ,
+           e[i].dsp, e[i].bram);
+  printf("  %-6s %51s %10ld %10.1f %5d %5d\n", "Pools", "(ReLU, max |x|, int8, 2x2)", POOL_CYCLES, POOL_CYCLES / MHZ,
+         POOL_DSP, POOL_BRAM);
+  printf("  Total: latency %ld cycles (%.1f us), interval %ld cycles, %.0f images/s at %.0f MHz, "
+         "DSP %d / %d, BRAM18 %d / %d%s\n\n", lat, lat / MHZ, ivl, MHZ * 1e6 / ivl, MHZ, dsp, DEVICE_DSP, br, DEVICE_BRAM,
+         br > DEVICE_BRAM ? " (over: weights off-chip)" : "");
+}
+
+/* per-layer candidates: P a divisor of K, B a power of two up to P / 2 (and P / 2), II 1;
+   kept if faster than every cheaper candidate (Pareto on DSP, then latency) */
+static int candidates(const MacLayer *l, int bram_budget, MacEstimate *out) {
+  static MacEstimate all[MAX_CAND];
+  int 		n = 0, m = 0, p, b, i, j;
+  MacKnobs 	k;
+
+  for (p = 1; p <= l->k; p++) {
+    if (l->k % p) continue;
+    for (b = 1; ; b *= 2) {
+      const int bb = b < cdiv(p, 2) ? b : cdiv(p, 2);
+      k.p = p; k.b_in = k.b_w = bb; k.ii = 1;
+      if (n < MAX_CAND) estimate(l, &k, &all[n]);
+      if (n < MAX_CAND && (!bram_budget || all[n].bram <= bram_budget)) n++;
+      if (bb == cdiv(p, 2)) break;
+    }
+  }
+  for (i = 1; i < n; i++) 	// insertion sort: DSP, then cycles, then BRAM
+    for (j = i; j > 0 && (all[j].dsp < all[j-1].dsp || (all[j].dsp == all[j-1].dsp &&
+                          (all[j].cycles < all[j-1].cycles || (all[j].cycles == all[j-1].cycles && all[j].bram < all[j-1].bram)))); j--) {
+      MacEstimate t = all[j]; all[j] = all[j-1]; all[j-1] = t;
+    }
+  for (i = 0; i < n; i++)
+    if (!m || all[i].cycles < out[m-1].cycles) out[m++] = all[i];
+  return m;
+}
+
+#define BETTER(ivl, lat, ivl2, lat2)	((ivl) < (ivl2) || ((ivl) == (ivl2) && (lat) < (lat2)))
+
+static void sweep(int dsp_budget, int bram_budget, int ntop) {
+  static MacEstimate cand[NB_MAC][MAX_CAND];
+  static MacEstimate top[MAX_TOP][NB_MAC];
+  static long 		top_ivl[MAX_TOP], top_lat[MAX_TOP];
+  MacEstimate 		e[NB_MAC];
+  int 				nc[NB_MAC], idx[NB_MAC] = { 0 }, ntopn = 0, i, j, dsp, br;
+  long 				lat, ivl, nb = 1, evaluated = 0;
+  char 				title[128];
+
+  for (i = 0; i < NB_MAC; i++) { nc[i] = candidates(&LAYERS[i], bram_budget, cand[i]); nb *= nc[i]; }
+  printf("Sweep: %d / %d / %d / %d Pareto candidates per layer, %ld designs, DSP budget %d%s\n\n",
+         nc[0], nc[1], nc[2], nc[3], nb, dsp_budget, DATAFLOW ? ", DATAFLOW" : "");
+  for (;;) {
+    for (i = 0; i < NB_MAC; i++) e[i] = cand[i][idx[i]];
+    ivl = interval(e, &lat, &dsp, &br);
+    evaluated++;
+    if (dsp <= dsp_budget && (!bram_budget || br <= bram_budget) &&
+        (ntopn < ntop || BETTER(ivl, lat, top_ivl[ntopn-1], top_lat[ntopn-1]))) {
+      for (j = ntopn < ntop ? ntopn++ : ntopn - 1; j > 0 && BETTER(ivl, lat, top_ivl[j-1], top_lat[j-1]); j--) {
+        top_ivl[j] = top_ivl[j-1]; top_lat[j] = top_lat[j-1]; memcpy(top[j], top[j-1], sizeof(e));
+      }
+      top_ivl[j] = ivl; top_lat[j] = lat; memcpy(top[j], e, sizeof(e));
+    }
+    for (i = NB_MAC - 1; i >= 0 && ++idx[i] == nc[i]; i--) idx[i] = 0;
+    if (i < 0) break;
+  }
+  if (!ntopn) { printf("No design within %d DSP.\n", dsp_budget); return; }
+  for (i = 0; i < ntopn; i++) {
+    snprintf(title, sizeof(title), "#%d", i + 1);
+    print_design(title, top[i]);
+  }
+}
+
+static int layer_index(const char *name) {
+  for (int i = 0; i < NB_MAC; i++) if (!strcasecmp(name, LAYERS[i].name)) return i;
+  printf("Error: Unknown layer %s.\n", name);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  MacKnobs 		k[NB_MAC];
+  MacEstimate 	e[NB_MAC];
+  int 			do_sweep = 0, dsp_budget = DEVICE_DSP, bram_budget = 0, ntop = 5, custom = 0, i, l;
+  char 			name[16];
+
+  as_written(k);
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-t") && i+1 < argc) FIXED = !strcmp(argv[++i], "fixed");
+    else if (!strcmp(argv[i], "-w") && i+1 < argc) BITS = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) MHZ = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-u")) BALANCED = 1;
+    else if (!strcmp(argv[i], "-d")) DATAFLOW = 1;
+    else if (!strcmp(argv[i], "-s")) do_sweep = 1;
+    else if (!strcmp(argv[i], "-D") && i+1 < argc) dsp_budget = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-B") && i+1 < argc) bram_budget = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i+1 < argc) ntop = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-l") && i+1 < argc) {
+      MacKnobs c = { 1, 1, 1, 1 };
+      if (sscanf(argv[++i], "%15[^=]=%d/%d/%d", name, &c.p, &c.b_in, &c.ii) < 2 || c.p < 1 || c.b_in < 1 || c.ii < 1) {
+        printf("Error: Expected -l layer=P[/B[/II]], got %s.\n", argv[i]);
+        exit(1);
+      }
+      l = layer_index(name);
+      if (c.p > LAYERS[l].k) c.p = LAYERS[l].k;
+      c.b_w = c.b_in;
+      k[l] = c;
+      custom = 1;
+    }
+    else {
+      printf("Usage: %s [-t float|fixed] [-w bits] [-c MHz] [-u] [-d] [-l layer=P/B/II]...\n"
+             "       [-s] [-D dsp_budget] [-B bram_budget] [-n top]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (!BITS) BITS = FIXED ? 16 : 32;
+  if (BITS < 1 || MHZ <= 0.0 || ntop < 1) { printf("Error: Invalid -w / -c / -n.\n"); exit(1); }
+  if (ntop > MAX_TOP) ntop = MAX_TOP;
+
+  printf("%s datapath, %d bits, %.0f MHz%s%s; CONV1_UNROLL_C=%d CONV1_UNROLL_K=%d CONV2_UNROLL_C=%d CONV2_UNROLL_K=%d\n",
+         FIXED ? "Fixed-point" : "Float", BITS, MHZ, BALANCED ? ", balanced float adds" : "",
+         DATAFLOW ? ", DATAFLOW" : "", CONV1_UNROLL_C, CONV1_UNROLL_K, CONV2_UNROLL_C, CONV2_UNROLL_K);
+  printf("II: achieved (- target, m memory ports, r accumulator recurrence)\n\n");
+  pools();
+  for (l = 0; l < NB_MAC; l++) estimate(&LAYERS[l], &k[l], &e[l]);
+  print_design(custom ? "Configured design" : "As written (conv.c, fc.c)", e);
+  if (do_sweep) sweep(dsp_budget, bram_budget, ntop);
+  return 0;
+}
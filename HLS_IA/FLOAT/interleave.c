@@ -0,0 +1,112 @@
+/**
+  ******************************************************************************
+  * @file    interleave.c
+  * @brief   Image-interleaved Conv1 + Pool1, host only
+  * @brief   Conv1 has a single input channel and 24-wide rows, so neither the channels nor
+  * @brief   the rows fill the SIMD lanes. Here INTERLEAVE_LANES images are packed into an
+  * @brief   [H][W][lane] layout (InterleaveImages), and Conv1, ReLU and Pool1 run with every
+  * @brief   lane doing the same work on its own image: full vectors whatever the layer shape.
+  * @brief   Pool1 is fused: 2x2 max on the float rows as they are produced, then the per-image
+  * @brief   int8 quantization of pool.c (max commutes with the monotonic rounding, and the
+  * @brief   pooled maxima cover the whole Conv1 tensor, so the scale is the same), which is
+  * @brief   where the images are de-interleaved for Conv2. Each lane keeps conv.c's summation
+  * @brief   order: lenet_cnn_interleaved is bit-identical to lenet_cnn().
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lenet_cnn_float.h"
+
+#if (CONV1_STRIDE != 1) || (CONV1_PAD != 0) || (IMG_DEPTH != 1)
+#error "interleave.c expects Conv1 with one input channel, stride 1 and no padding"
+#endif
+
+#define ROUND_MAGIC	12582912.0f 	// 1.5 * 2^23: (v + ROUND_MAGIC) - ROUND_MAGIC == lrintf(v), |v| < 2^22
+
+/* inputs[0 .. n-1] -> output[y][x][lane], lanes n .. INTERLEAVE_LANES-1 zeroed */
+void InterleaveImages(float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n,
+                      float output[IMG_HEIGHT][IMG_WIDTH][INTERLEAVE_LANES]) {
+  int y, x, l;
+
+  for (y = 0; y < IMG_HEIGHT; y++)
+    for (x = 0; x < IMG_WIDTH; x++)
+      for (l = 0; l < INTERLEAVE_LANES; l++)
+        output[y][x][l] = l < n ? inputs[l][0][y][x] : 0.0f;
+}
+
+/* Conv1, ReLU and Pool1 of n <= INTERLEAVE_LANES interleaved images, output per image */
+void Conv1Pool1_interleaved(float input[IMG_HEIGHT][IMG_WIDTH][INTERLEAVE_LANES],
+                            float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],
+                            float bias[CONV1_NBOUTPUT], int n,
+                            float (*output)[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]) {
+  float 		pool[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH][INTERLEAVE_LANES];
+  float 		row[2][CONV1_WIDTH][INTERLEAVE_LANES], acc;
+  float 		mx[INTERLEAVE_LANES], sx[INTERLEAVE_LANES], inv_sx[INTERLEAVE_LANES], q;
+  int 			m, py, px, r, y, x, ky, kx, l;
+
+  for (l = 0; l < INTERLEAVE_LANES; l++) mx[l] = 0.0f;
+  for (m = 0; m < CONV1_NBOUTPUT; m++)
+    for (py = 0; py < POOL1_HEIGHT; py++) {
+      // the two Conv1 rows under pool row py, ReLU
+      for (r = 0; r < 2; r++) {
+        y = 2 * py + r;
+        for (x = 0; x < CONV1_WIDTH; x++)
+          for (l = 0; l < INTERLEAVE_LANES; l++) { 	// taps fully unrolled, vectorized over l
+            acc = bias[m];
+            for (ky = 0; ky < CONV1_DIM; ky++)
+              for (kx = 0; kx < CONV1_DIM; kx++) acc += input[y + ky][x + kx][l] * kernel[m][0][ky][kx];
+            row[r][x][l] = acc > 0.0f ? acc : 0.0f;
+          }
+      }
+      // 2x2 max in float, running max |x| per image (all >= 0 after ReLU)
+      for (px = 0; px < POOL1_WIDTH; px++)
+        for (l = 0; l < INTERLEAVE_LANES; l++) {
+          float a = row[0][2*px][l] > row[0][2*px+1][l] ? row[0][2*px][l] : row[0][2*px+1][l];
+          float b = row[1][2*px][l] > row[1][2*px+1][l] ? row[1][2*px][l] : row[1][2*px+1][l];
+          a = a > b ? a : b;
+          pool[m][py][px][l] = a;
+          mx[l] = a > mx[l] ? a : mx[l];
+        }
+    }
+
+  // per-image int8 scale of Pool1_24x24x20_2x2x20_2_0, then de-interleave
+  for (l = 0; l < INTERLEAVE_LANES; l++) {
+    if (mx[l] < 1e-8f) mx[l] = 1e-8f;
+    sx[l] = mx[l] / 127.0f;
+    inv_sx[l] = 1.0f / sx[l];
+  }
+  for (m = 0; m < POOL1_NBOUTPUT; m++)
+    for (py = 0; py < POOL1_HEIGHT; py++)
+      for (px = 0; px < POOL1_WIDTH; px++)
+        for (l = 0; l < n; l++) {
+          q = (pool[m][py][px][l] * inv_sx[l] + ROUND_MAGIC) - ROUND_MAGIC;
+          if (q > 127.0f) q = 127.0f;
+          output[l][m][py][px] = q * sx[l];
+        }
+}
+
+/* n images: interleaved Conv1 + Pool1 in groups of INTERLEAVE_LANES, then Conv2 .. Fc2 per image */
+void lenet_cnn_interleaved(float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, LenetWeights *w,
+                           float (*outputs)[FC2_NBOUTPUT]) {
+  float 		in[IMG_HEIGHT][IMG_WIDTH][INTERLEAVE_LANES];
+  float 		pool1_output[INTERLEAVE_LANES][POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float 		conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 		pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], fc1_output[FC1_NBOUTPUT], *p;
+  int 			b, nb, l, i;
+
+  for (b = 0; b < n; b += INTERLEAVE_LANES) {
+    nb = n - b < INTERLEAVE_LANES ? n - b : INTERLEAVE_LANES;
+    InterleaveImages(inputs + b, nb, in);
+    Conv1Pool1_interleaved(in, w->conv1_kernel, w->conv1_bias, nb, pool1_output);
+    for (l = 0; l < nb; l++) {
+      Conv2_12x12x20_5x5x40_1_0(pool1_output[l], w->conv2_kernel, w->conv2_bias, conv2_output);
+      for (p = &conv2_output[0][0][0], i = 0; i < CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH; i++) if (!(p[i] > 0.0f)) p[i] = 0.0f;
+      Pool2_8x8x40_2x2x40_2_0(conv2_output, pool2_output);
+      Fc1_40_400(pool2_output, w->fc1_kernel, w->fc1_bias, fc1_output);
+      for (i = 0; i < FC1_NBOUTPUT; i++) if (!(fc1_output[i] > 0.0f)) fc1_output[i] = 0.0f;
+      Fc2_400_10(fc1_output, w->fc2_kernel, w->fc2_bias, outputs[b + l]);
+    }
+  }
+}
@@ -0,0 +1,222 @@
+/**
+  ******************************************************************************
+  * @file    lenet_bin.c
+  * @brief   Ternary / binary LeNet (LenetTernary, converted by the ternarize tool)
+  * @brief   Conv1 stays float. ReLU + max-pool outputs are quantized to abits unsigned
+  * @brief   bit planes and packed (Pool1: one word per pixel, bit = channel; Pool2 and
+  * @brief   Fc1: flat bit vectors). Conv2 / Fc1 / Fc2 accumulate
+  * @brief   sum_b 2^b (popcount(a_b & pos) - popcount(a_b & neg)) and rescale by
+  * @brief   weight scale * activation step before the bias. Activations are post-ReLU,
+  * @brief   hence {0,1} planes and AND rather than the XNOR of +-1 activations; with
+  * @brief   binary weights neg = ~pos on the valid bits.
+  * @brief   Build with -mpopcnt for the POPCNT instruction. With -mavx512f -mavx512vpopcntdq
+  * @brief   Fc1 / Fc2 take the 8-word VPOPCNTQ path and the compiler vectorizes the
+  * @brief   Conv2 output-channel loop (VPOPCNTD, 16 channels per instruction).
+  */
+
+#include <stdint.h>
+
+#include "lenet_cnn_float.h"
+
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__) && !defined(__SYNTHESIS__)
+#include <immintrin.h>
+#define TERN_AVX512
+#endif
+
+// host: builtin (POPCNT with -mpopcnt), synthesis: adder tree on LUTs
+static inline int popcount32(uint32_t v) {
+#pragma HLS INLINE
+#ifdef __SYNTHESIS__
+  int n = 0;
+  for (int i = 0; i < 32; i++) {
+#pragma HLS UNROLL
+    n += (v >> i) & 1;
+  }
+  return n;
+#else
+  return __builtin_popcount(v);
+#endif
+}
+
+static inline int popcount64(uint64_t v) {
+#pragma HLS INLINE
+#ifdef __SYNTHESIS__
+  return popcount32((uint32_t)v) + popcount32((uint32_t)(v >> 32));
+#else
+  return __builtin_popcountll(v);
+#endif
+}
+
+// ReLU then quantization to 0 .. 2^abits - 1
+static inline int quantize(float x, float inv_step, int qmax) {
+#pragma HLS INLINE
+  int q;
+  if (x <= 0.0f) return 0;
+  q = (int)(x * inv_step + 0.5f);
+  return q > qmax ? qmax : q;
+}
+
+static inline float max4(float a, float b, float c, float d) {
+#pragma HLS INLINE
+  float m = a > b ? a : b;
+  if (c > m) m = c;
+  return d > m ? d : m;
+}
+
+// Conv1 output -> ReLU, Pool1, quantization, bit planes [b][y][x], bit c = channel c
+void TernaryPool1Pack(	float 		input[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], float step, int abits,
+						uint32_t 	output[TERN_ABITS_MAX][POOL1_HEIGHT][POOL1_WIDTH]) {
+#pragma HLS INLINE off
+  const float inv_step = 1.0f / step;
+  const int 	qmax = (1 << abits) - 1;
+  int 		b, c, y, x, q;
+  uint32_t 	w[TERN_ABITS_MAX];
+#pragma HLS ARRAY_PARTITION variable=w complete dim=1
+
+  for (y = 0; y < POOL1_HEIGHT; y++)
+    for (x = 0; x < POOL1_WIDTH; x++) {
+#pragma HLS PIPELINE II=1
+      for (b = 0; b < TERN_ABITS_MAX; b++) w[b] = 0;
+      for (c = 0; c < CONV1_NBOUTPUT; c++) {
+#pragma HLS UNROLL
+        q = quantize(max4(input[c][2*y][2*x], input[c][2*y][2*x+1], input[c][2*y+1][2*x], input[c][2*y+1][2*x+1]), inv_step, qmax);
+        for (b = 0; b < abits; b++) w[b] |= (uint32_t)((q >> b) & 1) << c;
+      }
+      for (b = 0; b < TERN_ABITS_MAX; b++) output[b][y][x] = w[b];
+    }
+}
+
+// Conv2 on packed Pool1 planes: each input word is ANDed with the tap's 40 output masks
+// (tap-major weights, the m loop is the parallel / vector dimension), two POPCNT per mask
+void Conv2_12x12x20_5x5x40_1_0_ternary(	uint32_t input[TERN_ABITS_MAX][POOL1_HEIGHT][POOL1_WIDTH], LenetTernary *t,
+										float 	 output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]) {
+#pragma HLS INLINE off
+  const int abits = t->abits;
+  int 		m, y, x, ky, kx, b;
+  int 		acc[CONV2_NBOUTPUT];
+#pragma HLS ARRAY_PARTITION variable=acc complete dim=1
+  uint32_t 	a;
+  float 	scale[CONV2_NBOUTPUT];
+
+  for (m = 0; m < CONV2_NBOUTPUT; m++) scale[m] = t->conv2_scale[m] * t->act_step[0];
+  for (y = 0; y < CONV2_HEIGHT; y++)
+    for (x = 0; x < CONV2_WIDTH; x++) {
+      for (m = 0; m < CONV2_NBOUTPUT; m++) acc[m] = 0;
+      for (ky = 0; ky < CONV2_DIM; ky++)
+        for (kx = 0; kx < CONV2_DIM; kx++)
+          for (b = 0; b < abits; b++) {
+#pragma HLS LOOP_TRIPCOUNT min=1 max=4
+#pragma HLS PIPELINE II=1
+            a = input[b][y+ky][x+kx];
+            for (m = 0; m < CONV2_NBOUTPUT; m++) {
+#pragma HLS UNROLL
+              acc[m] += (popcount32(a & t->conv2_pos[ky][kx][m]) - popcount32(a & t->conv2_neg[ky][kx][m])) << b;
+            }
+          }
+      for (m = 0; m < CONV2_NBOUTPUT; m++) output[m][y][x] = acc[m] * scale[m] + t->conv2_bias[m];
+    }
+}
+
+// Conv2 output -> ReLU, Pool2, quantization, bit planes of the flat [c][y][x] vector
+void TernaryPool2Pack(	float 		input[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], float step, int abits,
+						uint64_t 	output[TERN_ABITS_MAX][TERN_FC1_WORDS]) {
+#pragma HLS INLINE off
+  const float inv_step = 1.0f / step;
+  const int 	qmax = (1 << abits) - 1;
+  int 		b, c, y, x, i, q;
+
+  for (b = 0; b < TERN_ABITS_MAX; b++)
+    for (i = 0; i < TERN_FC1_WORDS; i++) output[b][i] = 0;
+  for (c = 0; c < POOL2_NBOUTPUT; c++)
+    for (y = 0; y < POOL2_HEIGHT; y++)
+      for (x = 0; x < POOL2_WIDTH; x++) {
+#pragma HLS PIPELINE II=1
+        i = (c * POOL2_HEIGHT + y) * POOL2_WIDTH + x;
+        q = quantize(max4(input[c][2*y][2*x], input[c][2*y][2*x+1], input[c][2*y+1][2*x], input[c][2*y+1][2*x+1]), inv_step, qmax);
+        for (b = 0; b < abits; b++) output[b][i >> 6] |= (uint64_t)((q >> b) & 1) << (i & 63);
+      }
+}
+
+// sum_b 2^b (popcount(a_b & pos) - popcount(a_b & neg)) over nwords 64-bit words
+static inline int ternary_dot(uint64_t *a, int stride, int abits, uint64_t *pos, uint64_t *neg, int nwords) {
+#pragma HLS INLINE
+  int b, i, acc = 0;
+#ifdef TERN_AVX512
+  __m512i 	vacc = _mm512_setzero_si512(), va, vp, vn, d;
+  __mmask8 	k;
+
+  for (i = 0; i < nwords; i += 8) {
+    k = nwords - i >= 8 ? 0xff : (__mmask8)((1 << (nwords - i)) - 1);
+    vp = _mm512_maskz_loadu_epi64(k, pos + i);
+    vn = _mm512_maskz_loadu_epi64(k, neg + i);
+    for (b = 0; b < abits; b++) {
+      va = _mm512_maskz_loadu_epi64(k, a + b * stride + i);
+      d = _mm512_sub_epi64(_mm512_popcnt_epi64(_mm512_and_si512(va, vp)), _mm512_popcnt_epi64(_mm512_and_si512(va, vn)));
+      vacc = _mm512_add_epi64(vacc, _mm512_slli_epi64(d, b));
+    }
+  }
+  acc = (int)_mm512_reduce_add_epi64(vacc);
+#else
+  uint64_t 	v;
+  for (b = 0; b < abits; b++)
+    for (i = 0; i < nwords; i++) {
+      v = a[b * stride + i];
+      acc += (popcount64(v & pos[i]) - popcount64(v & neg[i])) << b;
+    }
+#endif
+  return acc;
+}
+
+// Fc1 before ReLU (TernaryFc1Pack applies it)
+void Fc1_40_400_ternary(uint64_t input[TERN_ABITS_MAX][TERN_FC1_WORDS], LenetTernary *t, float output[FC1_NBOUTPUT]) {
+#pragma HLS INLINE off
+  for (int o = 0; o < FC1_NBOUTPUT; o++) {
+#pragma HLS PIPELINE II=1
+    int acc = ternary_dot(&input[0][0], TERN_FC1_WORDS, t->abits, t->fc1_pos[o], t->fc1_neg[o], TERN_FC1_WORDS);
+    output[o] = acc * t->fc1_scale[o] * t->act_step[1] + t->fc1_bias[o];
+  }
+}
+
+// Fc1 output -> ReLU, quantization, bit planes
+void TernaryFc1Pack(	float 		input[FC1_NBOUTPUT], float step, int abits,
+						uint64_t 	output[TERN_ABITS_MAX][TERN_FC2_WORDS]) {
+#pragma HLS INLINE off
+  const float inv_step = 1.0f / step;
+  const int 	qmax = (1 << abits) - 1;
+  int 		b, i, q;
+
+  for (b = 0; b < TERN_ABITS_MAX; b++)
+    for (i = 0; i < TERN_FC2_WORDS; i++) output[b][i] = 0;
+  for (i = 0; i < FC1_NBOUTPUT; i++) {
+#pragma HLS PIPELINE II=1
+    q = quantize(input[i], inv_step, qmax);
+    for (b = 0; b < abits; b++) output[b][i >> 6] |= (uint64_t)((q >> b) & 1) << (i & 63);
+  }
+}
+
+void Fc2_400_10_ternary(uint64_t input[TERN_ABITS_MAX][TERN_FC2_WORDS], LenetTernary *t, float output[FC2_NBOUTPUT]) {
+#pragma HLS INLINE off
+  for (int o = 0; o < FC2_NBOUTPUT; o++) {
+#pragma HLS PIPELINE II=1
+    int acc = ternary_dot(&input[0][0], TERN_FC2_WORDS, t->abits, t->fc2_pos[o], t->fc2_neg[o], TERN_FC2_WORDS);
+    output[o] = acc * t->fc2_scale[o] * t->act_step[2] + t->fc2_bias[o];
+  }
+}
+
+// Top level: float Conv1, then packed bit planes down to the logits
+void lenet_cnn_ternary(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetTernary *t, float output[FC2_NBOUTPUT]) {
+  float 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+  uint32_t 	pool1_bits[TERN_ABITS_MAX][POOL1_HEIGHT][POOL1_WIDTH];
+  float 	conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  uint64_t 	pool2_bits[TERN_ABITS_MAX][TERN_FC1_WORDS];
+  float 	fc1_output[FC1_NBOUTPUT];
+  uint64_t 	fc1_bits[TERN_ABITS_MAX][TERN_FC2_WORDS];
+
+  Conv1_28x28x1_5x5x20_1_0(input, t->conv1_kernel, t->conv1_bias, conv1_output);
+  TernaryPool1Pack(conv1_output, t->act_step[0], t->abits, pool1_bits);
+  Conv2_12x12x20_5x5x40_1_0_ternary(pool1_bits, t, conv2_output);
+  TernaryPool2Pack(conv2_output, t->act_step[1], t->abits, pool2_bits);
+  Fc1_40_400_ternary(pool2_bits, t, fc1_output);
+  TernaryFc1Pack(fc1_output, t->act_step[2], t->abits, fc1_bits);
+  Fc2_400_10_ternary(fc1_bits, t, output);
+}
@@ -0,0 +1,301 @@
+/**
+  ******************************************************************************
+  * @file    lenet_cnn.c
+  * @author  Sébastien Bilavarn, LEAT, CNRS, Université Côte d'Azur, France
+  * @version V1.0
+  * @date    04 february 2019
+  * @brief   LeNet top level HLS function
+  * @brief   Built twice: float kernels, and FIXED_POINT kernels with -DFIXED_POINT (lenet_cnn_fixed)
+  */
+
+#include <stdio.h>
+
+#include "lenet_cnn_float.h"
+
+// -DCONV_LINE_BUFFER: streaming line-buffer Conv1/Conv2 (float build only)
+#if defined(CONV_LINE_BUFFER) && !defined(FIXED_POINT)
+#define CONV1	Conv1_28x28x1_5x5x20_1_0_lb
+#define CONV2	Conv2_12x12x20_5x5x40_1_0_lb
+#else
+#define CONV1	Conv1_28x28x1_5x5x20_1_0
+#define CONV2	Conv2_12x12x20_5x5x40_1_0
+#endif
+
+/* === Ajout minimal pour l'accuracy : ReLU === */
+static inline float relu(float x){ return x > 0.0f ? x : 0.0f; }
+
+// Conv1 output to Pool1 output: ReLU, Pool1
+static void lenet_cnn_pool1(	float 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], 
+								float 	pool1_output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]) {
+#pragma HLS INLINE
+  /* === Ajout minimal : ReLU après Conv1 === */
+  for (int c=0;c<CONV1_NBOUTPUT;c++)
+    for (int y1=0;y1<CONV1_HEIGHT;y1++)
+      for (int x1=0;x1<CONV1_WIDTH;x1++)
+        conv1_output[c][y1][x1] = relu(conv1_output[c][y1][x1]);
+
+  Pool1_24x24x20_2x2x20_2_0(conv1_output, pool1_output); 
+}
+
+// Conv2 output to Pool2 output: ReLU, Pool2
+static void lenet_cnn_pool2(	float 	conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], 
+								float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]) {
+#pragma HLS INLINE
+  /* === Ajout minimal : ReLU après Conv2 === */
+  for (int c=0;c<CONV2_NBOUTPUT;c++)
+    for (int y2=0;y2<CONV2_HEIGHT;y2++)
+      for (int x2=0;x2<CONV2_WIDTH;x2++)
+        conv2_output[c][y2][x2] = relu(conv2_output[c][y2][x2]);
+
+  Pool2_8x8x40_2x2x40_2_0(conv2_output, pool2_output); 
+}
+
+// Conv1 output to Pool2 output: ReLU, Pool1, Conv2, ReLU, Pool2
+static void lenet_cnn_features(	float 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], 
+								float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+								float 	conv2_bias[CONV2_NBOUTPUT], 
+								float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]) {
+#pragma HLS INLINE
+  float 	pool1_output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]; 
+  float	 	conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]; 
+
+  lenet_cnn_pool1(conv1_output, pool1_output); 
+
+  CONV2(pool1_output, conv2_kernel, conv2_bias, conv2_output); 
+
+  lenet_cnn_pool2(conv2_output, pool2_output); 
+}
+
+// Pool2 output to the logits: Fc1, ReLU, Fc2
+static void lenet_cnn_classifier(	float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+									float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+									float 	fc1_bias[FC1_NBOUTPUT], 
+									float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 
+									float 	fc2_bias[FC2_NBOUTPUT], 
+									float 	output[FC2_NBOUTPUT]) {
+#pragma HLS INLINE
+  float 	fc1_output[FC1_NBOUTPUT]; 
+
+  Fc1_40_400(pool2_output, fc1_kernel, fc1_bias, fc1_output); 
+
+  /* === Ajout minimal : ReLU après Fc1 === */
+  for (int i=0;i<FC1_NBOUTPUT;i++)
+    fc1_output[i] = relu(fc1_output[i]);
+
+  /* (logs Fc1/Fc2 désactivés)
+  printf("\n\nFc1 output[0..%d]: \n", FC1_NBOUTPUT-1);
+  for (k = 0; k < FC1_NBOUTPUT; k++)
+    printf("%.2f ", fc1_output[k]);
+  */
+
+  Fc2_400_10(fc1_output, fc2_kernel, fc2_bias, output); 
+
+  /* (logs Fc1/Fc2 désactivés)
+  printf("\n\nFc2 output[0..%d]: \n", FC2_NBOUTPUT-1);
+  for (k = 0; k < FC2_NBOUTPUT; k++)
+    printf("%.2f ", output[k]); 
+  */
+}
+
+// Everything after Conv1: ReLU, Pool1, Conv2, ReLU, Pool2, Fc1, ReLU, Fc2
+static void lenet_cnn_tail(	float 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], 
+							float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+							float 	conv2_bias[CONV2_NBOUTPUT], 
+							float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+							float 	fc1_bias[FC1_NBOUTPUT], 
+							float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 
+							float 	fc2_bias[FC2_NBOUTPUT], 
+							float 	output[FC2_NBOUTPUT]) {
+#pragma HLS INLINE
+  float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+
+  lenet_cnn_features(conv1_output, conv2_kernel, conv2_bias, pool2_output); 
+
+  lenet_cnn_classifier(pool2_output, fc1_kernel, fc1_bias, fc2_kernel, fc2_bias, output); 
+}
+
+
+// Top Level HLS function
+void lenet_cnn(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 							// IN
+				float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],		// IN
+				float 	conv1_bias[CONV1_NBOUTPUT], 						                // IN
+				float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], // IN
+				float 	conv2_bias[CONV2_NBOUTPUT], 						                // IN
+				float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],// IN
+				float 	fc1_bias[FC1_NBOUTPUT],			 				                    // IN
+				float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 				            // IN
+				float 	fc2_bias[FC2_NBOUTPUT], 						                    // IN
+				float 	output[FC2_NBOUTPUT]) {							                    // OUT
+  
+  float	 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 
+
+  CONV1(input, conv1_kernel, conv1_bias, conv1_output); 
+
+  lenet_cnn_tail(conv1_output, conv2_kernel, conv2_bias, fc1_kernel, fc1_bias, fc2_kernel, fc2_bias, output); 
+}
+
+
+// Top Level HLS function, classification only: the SOFTMAX_TOPK best classes instead of the
+// logits, ranked by TopK on the Fc2 output (no softmax, one byte per class out)
+void lenet_cnn_topk(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 						// IN
+						float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],	// IN
+						float 	conv1_bias[CONV1_NBOUTPUT], 									// IN
+						float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], // IN
+						float 	conv2_bias[CONV2_NBOUTPUT], 									// IN
+						float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],// IN
+						float 	fc1_bias[FC1_NBOUTPUT], 										// IN
+						float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 						// IN
+						float 	fc2_bias[FC2_NBOUTPUT], 										// IN
+						unsigned char classes[SOFTMAX_TOPK]) { 									// OUT
+
+  float 	logits[FC2_NBOUTPUT]; 
+
+  lenet_cnn(input, conv1_kernel, conv1_bias, conv2_kernel, conv2_bias, fc1_kernel, fc1_bias, fc2_kernel, fc2_bias, logits); 
+  TopK(logits, SOFTMAX_TOPK, classes); 
+}
+
+
+#ifndef FIXED_POINT
+// Top Level HLS function, raw 8-bit pixels in (no NormalizeImg pass, 4x narrower input port).
+// conv1_kernel must be pre-scaled by 1/255 (FoldInputScale).
+void lenet_cnn_u8(	unsigned char 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 					// IN
+					float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],		// IN
+					float 	conv1_bias[CONV1_NBOUTPUT], 						                // IN
+					float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], // IN
+					float 	conv2_bias[CONV2_NBOUTPUT], 						                // IN
+					float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],// IN
+					float 	fc1_bias[FC1_NBOUTPUT],			 				                    // IN
+					float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 				            // IN
+					float 	fc2_bias[FC2_NBOUTPUT], 						                    // IN
+					float 	output[FC2_NBOUTPUT]) {							                    // OUT
+
+  float	 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 
+
+  Conv1_28x28x1_5x5x20_1_0_u8(input, conv1_kernel, conv1_bias, conv1_output); 
+
+  lenet_cnn_tail(conv1_output, conv2_kernel, conv2_bias, fc1_kernel, fc1_bias, fc2_kernel, fc2_bias, output); 
+}
+
+
+// Top Level HLS function, zero-skipping FC layers: fc*_kernel_t are the input-major
+// FC weights (FcTranspose*), only the nonzero ReLU outputs are accumulated
+void lenet_cnn_sparse(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 					// IN
+						float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],		// IN
+						float 	conv1_bias[CONV1_NBOUTPUT], 						                // IN
+						float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], // IN
+						float 	conv2_bias[CONV2_NBOUTPUT], 						                // IN
+						float 	fc1_kernel_t[FC1_NBINPUT][FC1_NBOUTPUT], 				            // IN
+						float 	fc1_bias[FC1_NBOUTPUT],			 				                    // IN
+						float 	fc2_kernel_t[FC1_NBOUTPUT][FC2_NBOUTPUT], 				            // IN
+						float 	fc2_bias[FC2_NBOUTPUT], 						                    // IN
+						float 	output[FC2_NBOUTPUT], 							                    // OUT
+						FcSparsity *stats) { 						                    		// OUT host statistics, or NULL
+
+  float	 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 
+  float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+  float 	fc1_output[FC1_NBOUTPUT]; 
+
+  CONV1(input, conv1_kernel, conv1_bias, conv1_output); 
+
+  lenet_cnn_features(conv1_output, conv2_kernel, conv2_bias, pool2_output); 
+
+  Fc1_40_400_sparse(pool2_output, fc1_kernel_t, fc1_bias, fc1_output, stats); 	// ReLU inside
+
+  Fc2_400_10_sparse(fc1_output, fc2_kernel_t, fc2_bias, output, stats); 
+}
+
+
+// Top Level HLS function, low-rank Fc1: fc1_v / fc1_u are the truncated SVD factors
+// of fc1_kernel (fc1_lowrank tool), Fc1 runs as two smaller GEMVs
+void lenet_cnn_lowrank(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 					// IN
+						float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],		// IN
+						float 	conv1_bias[CONV1_NBOUTPUT], 						                // IN
+						float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], // IN
+						float 	conv2_bias[CONV2_NBOUTPUT], 						                // IN
+						float 	fc1_v[FC1_RANK_MAX][FC1_NBINPUT], 				                    // IN
+						float 	fc1_u[FC1_NBOUTPUT][FC1_RANK_MAX], 				                    // IN
+						int 	fc1_rank, 						                                    // IN
+						float 	fc1_bias[FC1_NBOUTPUT],			 				                    // IN
+						float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 				            // IN
+						float 	fc2_bias[FC2_NBOUTPUT], 						                    // IN
+						float 	output[FC2_NBOUTPUT]) {							                    // OUT
+
+  float	 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 
+  float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+  float 	fc1_output[FC1_NBOUTPUT]; 
+
+  CONV1(input, conv1_kernel, conv1_bias, conv1_output); 
+
+  lenet_cnn_features(conv1_output, conv2_kernel, conv2_bias, pool2_output); 
+
+  Fc1_40_400_lowrank(pool2_output, fc1_v, fc1_u, fc1_rank, fc1_bias, fc1_output); 	// ReLU inside
+
+  Fc2_400_10(fc1_output, fc2_kernel, fc2_bias, output); 
+}
+#endif
+
+
+#ifndef FIXED_POINT
+// Top Level function, channel-pruned model (prune tool): p->nb_conv1 / p->nb_conv2
+// channels, pools with the same per-tensor scale arithmetic as Pool1 / Pool2
+void lenet_cnn_pruned(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 					// IN
+						LenetPruned *p, 													// IN
+						float 	output[FC2_NBOUTPUT]) {							            // OUT
+
+  LenetWeights *w = &p->w; 
+  float	 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 
+  float 	pool1_output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]; 
+  float	 	conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]; 
+  float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+  float 	fc1_output[FC1_NBOUTPUT]; 
+  int 		n1 = p->nb_conv1, n2 = p->nb_conv2; 
+
+  Conv1_28x28x1_5x5x20_1_0_pruned(input, w->conv1_kernel, w->conv1_bias, n1, conv1_output); 
+  for (int c=0;c<n1;c++)
+    for (int y1=0;y1<CONV1_HEIGHT;y1++)
+      for (int x1=0;x1<CONV1_WIDTH;x1++)
+        conv1_output[c][y1][x1] = relu(conv1_output[c][y1][x1]);
+  PoolChannels(&conv1_output[0][0][0], CONV1_HEIGHT, CONV1_WIDTH, 0, n1, 
+               PoolMaxAbs(&conv1_output[0][0][0], n1*CONV1_HEIGHT*CONV1_WIDTH), &pool1_output[0][0][0]); 
+
+  Conv2_12x12x20_5x5x40_1_0_pruned(pool1_output, w->conv2_kernel, w->conv2_bias, n1, n2, conv2_output); 
+  for (int c=0;c<n2;c++)
+    for (int y2=0;y2<CONV2_HEIGHT;y2++)
+      for (int x2=0;x2<CONV2_WIDTH;x2++)
+        conv2_output[c][y2][x2] = relu(conv2_output[c][y2][x2]);
+  PoolChannels(&conv2_output[0][0][0], CONV2_HEIGHT, CONV2_WIDTH, 0, n2, 
+               PoolMaxAbs(&conv2_output[0][0][0], n2*CONV2_HEIGHT*CONV2_WIDTH), &pool2_output[0][0][0]); 
+
+  Fc1_40_400_pruned(pool2_output, w->fc1_kernel, w->fc1_bias, n2, fc1_output); 	// ReLU inside
+
+  Fc2_400_10(fc1_output, w->fc2_kernel, w->fc2_bias, output); 
+}
+#endif
+
+
+#ifndef FIXED_POINT
+// Top Level function, Winograd convolutions (winograd.c) on the g->layers layers,
+// the rest of the graph shared with lenet_cnn()
+void lenet_cnn_winograd(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 					// IN
+							LenetWeights *w, 												// IN
+							const LenetWinograd *g, 										// IN  WinogradPrepare
+							float 	output[FC2_NBOUTPUT]) {							        // OUT
+
+  float	 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 
+  float 	pool1_output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]; 
+  float	 	conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]; 
+  float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+
+  if (g->layers & WINO_CONV1) Conv1_28x28x1_5x5x20_1_0_winograd(input, g, w->conv1_bias, conv1_output); 
+  else CONV1(input, w->conv1_kernel, w->conv1_bias, conv1_output); 
+
+  lenet_cnn_pool1(conv1_output, pool1_output); 
+
+  if (g->layers & WINO_CONV2) Conv2_12x12x20_5x5x40_1_0_winograd(pool1_output, g, w->conv2_bias, conv2_output); 
+  else CONV2(pool1_output, w->conv2_kernel, w->conv2_bias, conv2_output); 
+
+  lenet_cnn_pool2(conv2_output, pool2_output); 
+
+  lenet_cnn_classifier(pool2_output, w->fc1_kernel, w->fc1_bias, w->fc2_kernel, w->fc2_bias, output); 
+}
+#endif
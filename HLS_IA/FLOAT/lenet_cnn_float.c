@@ -26,90 +26,151 @@
 
 #include "lenet_cnn_float.h"
 
-/* === Ajout minimal pour l'accuracy : ReLU === */
-static inline float relu(float x){ return x > 0.0f ? x : 0.0f; }
-
-// Top Level HLS function
-void lenet_cnn(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 							// IN
-				float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],		// IN
-				float 	conv1_bias[CONV1_NBOUTPUT], 						                // IN
-				float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], // IN
-				float 	conv2_bias[CONV2_NBOUTPUT], 						                // IN
-				float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],// IN
-				float 	fc1_bias[FC1_NBOUTPUT],			 				                    // IN
-				float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 				            // IN
-				float 	fc2_bias[FC2_NBOUTPUT], 						                    // IN
-				float 	output[FC2_NBOUTPUT]) {							                    // OUT
-  
-  float	 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 
-  float 	pool1_output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]; 
-  float	 	conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]; 
-  float 	pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
-  float 	fc1_output[FC1_NBOUTPUT]; 
-  short 	k, y, x; 
-
-  Conv1_28x28x1_5x5x20_1_0(input, conv1_kernel, conv1_bias, conv1_output); 
-
-  /* === Ajout minimal : ReLU après Conv1 === */
-  for (int c=0;c<CONV1_NBOUTPUT;c++)
-    for (int y1=0;y1<CONV1_HEIGHT;y1++)
-      for (int x1=0;x1<CONV1_WIDTH;x1++)
-        conv1_output[c][y1][x1] = relu(conv1_output[c][y1][x1]);
-
-  Pool1_24x24x20_2x2x20_2_0(conv1_output, pool1_output); 
-
-  Conv2_12x12x20_5x5x40_1_0(pool1_output, conv2_kernel, conv2_bias, conv2_output); 
-
-  /* === Ajout minimal : ReLU après Conv2 === */
-  for (int c=0;c<CONV2_NBOUTPUT;c++)
-    for (int y2=0;y2<CONV2_HEIGHT;y2++)
-      for (int x2=0;x2<CONV2_WIDTH;x2++)
-        conv2_output[c][y2][x2] = relu(conv2_output[c][y2][x2]);
-
-  Pool2_8x8x40_2x2x40_2_0(conv2_output, pool2_output); 
-
-  Fc1_40_400(pool2_output, fc1_kernel, fc1_bias, fc1_output); 
-
-  /* === Ajout minimal : ReLU après Fc1 === */
-  for (int i=0;i<FC1_NBOUTPUT;i++)
-    fc1_output[i] = relu(fc1_output[i]);
-
-  /* (logs Fc1/Fc2 désactivés)
-  printf("\n\nFc1 output[0..%d]: \n", FC1_NBOUTPUT-1);
-  for (k = 0; k < FC1_NBOUTPUT; k++)
-    printf("%.2f ", fc1_output[k]);
-  */
-
-  Fc2_400_10(fc1_output, fc2_kernel, fc2_bias, output); 
-
-  /* (logs Fc1/Fc2 désactivés)
-  printf("\n\nFc2 output[0..%d]: \n", FC2_NBOUTPUT-1);
-  for (k = 0; k < FC2_NBOUTPUT; k++)
-    printf("%.2f ", output[k]); 
-  */
-}
-
-
 // GLOBAL VARIABLES
 unsigned char 	REF_IMG[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]; 
 float 			INPUT_NORM[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]; 
-float 			CONV1_KERNEL[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]; 
-float 			CONV1_BIAS[CONV1_NBOUTPUT]; 
-float 			CONV2_KERNEL[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM]; 
-float 			CONV2_BIAS[CONV2_NBOUTPUT]; 
-float 			FC1_KERNEL[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
-float 			FC1_BIAS[FC1_NBOUTPUT]; 
-float 			FC2_KERNEL[FC2_NBOUTPUT][FC1_NBOUTPUT]; 
-float 			FC2_BIAS[FC2_NBOUTPUT]; 
+LenetModel 		LOCAL_MODEL; 			// weights (CONV1_KERNEL ... FC2_BIAS), Conv1 / 255, int8 model
+LenetModel 		*MODEL = &LOCAL_MODEL; 	// LOCAL_MODEL, or the node's read-only shared copy (-s)
 float 			FC2_OUTPUT[FC2_NBOUTPUT]; 
-float			SOFTMAX_OUTPUT[FC2_NBOUTPUT]; 
+float			SOFTMAX_OUTPUT[FC2_NBOUTPUT]; 	// class scores: probabilities, or the logits with -k
+FcSparsity 		FC_SPARSITY; 	// FC input zeros seen by the sparse path (-z)
+int 			RAW_INPUT = 0; 	// feed REF_IMG straight into Conv1 (no NormalizeImg / INPUT_NORM)
+
+// class scores in SOFTMAX_OUTPUT
+#define SCORES_SOFTMAX	0	// Softmax, float
+#define SCORES_LOGITS	1	// Fc2 output as is, ranking only (-k)
+int 			SCORES = SCORES_SOFTMAX; 
+
+// inference paths
+#define PATH_FLOAT	0	// lenet_cnn, float reference
+#define PATH_FIXED	1	// lenet_cnn_fixed, FIXED_POINT drop-in kernels (float I/O per layer)
+#define PATH_INT8	2	// lenet_cnn_int8, integer-native pipeline
+#define PATH_SPARSE	3	// lenet_cnn_sparse, zero-skipping FC layers
+#define PATH_TUNED	4	// lenet_cnn_tuned, per-host autotuned kernels and threads (tune.c)
+#define PATH_LOWRANK	5	// lenet_cnn_lowrank, Fc1 as two smaller GEMVs (fc1_lowrank tool)
+#define PATH_PRUNED	6	// lenet_cnn_pruned, Conv1 / Conv2 channels removed (prune tool)
+#define PATH_TERNARY	7	// lenet_cnn_ternary, popcount Conv2 / Fc1 / Fc2 (ternarize tool)
+#define PATH_MIXED	8	// lenet_cnn_mixed, per-layer precision by name (mixed_explore tool)
+#define PATH_WINOGRAD	9	// lenet_cnn_winograd, Winograd Conv1 / Conv2 (winograd.c kernels)
+
+// images used to calibrate the int8 activation scales
+#ifndef INT8_CALIB_IMAGES
+#define INT8_CALIB_IMAGES	200
+#endif
+
+// autotuner: images timed per candidate, and the per-host configuration cache
+#ifndef TUNE_IMAGES
+#define TUNE_IMAGES		64
+#endif
+#ifndef TUNE_CACHE_FILE
+#define TUNE_CACHE_FILE	"lenet_tune.cache"
+#endif
+TuneConfig 		TUNE; 	// -a
+Fc1LowRank 		FC1_LR; // -l
+LenetPruned 		PRUNED; // -p
+LenetTernary 	TERNARY; // -t
+LenetMixed 		MIXED; 	// -x
+MixedConfig 	MIXED_CONFIG; 
+LenetWinograd 	WINOGRAD; 	// -w
+
+/* INPUT_NORM (or REF_IMG with RAW_INPUT) -> FC2_OUTPUT -> SOFTMAX_OUTPUT */
+static void Classify(int path) {
+  LenetWeights *w = &MODEL->w; 
+
+  if (path == PATH_INT8 && RAW_INPUT)
+    lenet_cnn_int8_u8(REF_IMG, &MODEL->int8, FC2_OUTPUT); 
+  else if (path == PATH_INT8)
+    lenet_cnn_int8(INPUT_NORM, &MODEL->int8, FC2_OUTPUT); 
+  else if (path == PATH_FLOAT && RAW_INPUT)
+    lenet_cnn_u8(REF_IMG, MODEL->conv1_kernel_u8, w->conv1_bias, w->conv2_kernel, w->conv2_bias, 
+                 w->fc1_kernel, w->fc1_bias, w->fc2_kernel, w->fc2_bias, FC2_OUTPUT); 
+  else if (path == PATH_TUNED)
+    lenet_cnn_tuned(&TUNE, MODEL, INPUT_NORM, FC2_OUTPUT); 
+  else if (path == PATH_LOWRANK)
+    lenet_cnn_lowrank(INPUT_NORM, w->conv1_kernel, w->conv1_bias, w->conv2_kernel, w->conv2_bias, 
+                      FC1_LR.v, FC1_LR.u, FC1_LR.rank, w->fc1_bias, w->fc2_kernel, w->fc2_bias, FC2_OUTPUT); 
+  else if (path == PATH_MIXED)
+    lenet_cnn_mixed(INPUT_NORM, &MIXED, &MIXED_CONFIG, FC2_OUTPUT); 
+  else if (path == PATH_WINOGRAD)
+    lenet_cnn_winograd(INPUT_NORM, w, &WINOGRAD, FC2_OUTPUT); 
+  else if (path == PATH_TERNARY)
+    lenet_cnn_ternary(INPUT_NORM, &TERNARY, FC2_OUTPUT); 
+  else if (path == PATH_PRUNED)
+    lenet_cnn_pruned(INPUT_NORM, &PRUNED, FC2_OUTPUT); 
+  else if (path == PATH_SPARSE)
+    lenet_cnn_sparse(INPUT_NORM, w->conv1_kernel, w->conv1_bias, w->conv2_kernel, w->conv2_bias, 
+                     MODEL->fc1_kernel_t, w->fc1_bias, MODEL->fc2_kernel_t, w->fc2_bias, FC2_OUTPUT, &FC_SPARSITY); 
+  else if (path == PATH_FIXED)
+    lenet_cnn_fixed(INPUT_NORM, w->conv1_kernel, w->conv1_bias, w->conv2_kernel, w->conv2_bias, 
+                    w->fc1_kernel, w->fc1_bias, w->fc2_kernel, w->fc2_bias, FC2_OUTPUT); 
+  else
+    lenet_cnn(	INPUT_NORM, 				
+				w->conv1_kernel, 		
+				w->conv1_bias, 		
+				w->conv2_kernel, 			
+				w->conv2_bias, 			
+				w->fc1_kernel, 				
+				w->fc1_bias, 				
+				w->fc2_kernel,					
+				w->fc2_bias,					
+				FC2_OUTPUT); 
+  if (SCORES == SCORES_LOGITS)
+    memcpy(SOFTMAX_OUTPUT, FC2_OUTPUT, sizeof(FC2_OUTPUT)); 	// softmax is monotonic, skip it
+  else
+    Softmax(FC2_OUTPUT, SOFTMAX_OUTPUT); 
+}
+
+/* Calibrates the activation scales on the first test images and quantizes the weights once */
+static void PrepareInt8Model(LenetModel *model) {
+  LenetWeights *w = &model->w; 
+  float 	(*calib)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]; 
+  float 	act_max[INT8_NB_ACT]; 
+  char 		img_filename[120]; 
+
+  calib = malloc(INT8_CALIB_IMAGES * sizeof(*calib)); 
+  for (int i = 0; i < INT8_CALIB_IMAGES; i++) {
+    MnistImgFilename(img_filename, i); 
+    ReadPgmFile(img_filename, (unsigned char *)REF_IMG); 
+    NormalizeImg((unsigned char *)REF_IMG, (float *)calib[i], IMG_WIDTH, IMG_HEIGHT); 
+  }
+  CalibrateInt8(calib, INT8_CALIB_IMAGES, w->conv1_kernel, w->conv1_bias, w->conv2_kernel, w->conv2_bias, 
+                w->fc1_kernel, w->fc1_bias, act_max); 
+  PrepareInt8(&model->int8, w->conv1_kernel, w->conv1_bias, w->conv2_kernel, w->conv2_bias, 
+              w->fc1_kernel, w->fc1_bias, w->fc2_kernel, w->fc2_bias, act_max); 
+  model->has_int8 = 1; 
+  free(calib); 
+}
 
 /**
   ******************************************************************************
   * @brief   main code deploying a LeNet inference CNN on MNIST dataset
+  * @brief   Options:
+  * @brief     -f           FIXED_POINT drop-in kernels (lenet_cnn_fixed)
+  * @brief     -q           integer-native int8 pipeline (lenet_cnn_int8)
+  * @brief     -z           zero-skipping FC layers (lenet_cnn_sparse), reports the FC input sparsity
+  * @brief     -a           autotuned kernels and threads (lenet_cnn_tuned), measured on the first
+  * @brief                  start and loaded from TUNE_CACHE_FILE afterwards
+  * @brief     -l <file>    low-rank Fc1 factors written by fc1_lowrank (lenet_cnn_lowrank)
+  * @brief     -p <file>    channel-pruned model written by prune (lenet_cnn_pruned)
+  * @brief     -t <file>    ternary / binary model written by ternarize (lenet_cnn_ternary)
+  * @brief     -x <config>  per-layer precisions, e.g. fp32-int8-int8-int4 (lenet_cnn_mixed,
+  * @brief                  see mixed_explore)
+  * @brief     -w <layers>  Winograd convolution on the listed layers: 1 (Conv1), 2 (Conv2) or 12
+  * @brief                  (lenet_cnn_winograd, see bench_winograd)
+  * @brief     -k <k>       classification only: no softmax, classes ranked on the logits (TopK),
+  * @brief                  also reports the top-k error rate
+  * @brief     -c <margin>  cascade mode: int8 pipeline first, float re-run when top1-top2 < margin
+  * @brief     -r           raw uint8 pixels straight into Conv1 (1/255 folded into the Conv1 kernel)
+  * @brief     -m <entries> prediction cache in front of lenet_cnn(), keyed by the REF_IMG content
+  * @brief     -s <name>    prepared model in shared memory, one read-only copy per NUMA node
+  * @brief                  (the first worker of the node publishes it, see lenet_launch)
+  * @brief     -H           with -s, put the shared model on huge pages
+  * @brief     -u <file>    hot-swap: watch a weight file (e.g. a new lenet_keras_20_40.py export) and
+  * @brief                  publish each new version while the loop runs (registry.c), per-version
+  * @brief                  latency and accuracy at the end; float, -f and -z paths only
   */
 
-void main() {
+int main(int argc, char *argv[]) {
   short 	x, y, z, k, m; 
   char 		*hdf5_filename = 		"lenet_weights.weights.h5";   /* === nom de poids mis à jour === */
   /* === chemins HDF5 mis à jour (d'après h5ls) === */
@@ -127,7 +188,9 @@ void main() {
   FILE* 	label_file;
   int ret; 
   unsigned char label, number; 
-  unsigned int 	error; 
+  unsigned int 	error, topk_error = 0; 
+  int 		topk = 1; 					// -k
+  unsigned char classes[FC2_NBOUTPUT]; 	// best first
   unsigned char labels_legend[10] = 		{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}; 
   char 		img_filename[120]; 
   char 		img_count[10]; 
@@ -135,19 +198,208 @@ void main() {
   struct timeval start, end; 
   double 	tdiff, tmin, tmax, tavg; 
   unsigned long long xilinx_start, xilinx_end, xilinx_time, xilinx_time_max, xilinx_time_min, xilinx_time_avg; 
+  int 		path = PATH_FLOAT; 	        // inference path
+  int 		cascade = 0; 	            // int8 fast path with float fallback
+  float 	cascade_margin = 0.0f; 	    // softmax top1-top2 margin below which we fall back
+  unsigned int 	fallback = 0; 	        // number of images re-run in float
+  unsigned int 	cache_entries = 0; 	    // prediction cache capacity (0 = disabled)
+  unsigned long long hits, misses, evictions; 
+  char 		*shm_name = NULL; 	        // shared model segment name (-s)
+  int 		shm_huge = 0, shm_node = 0, shm_created = 1; 
+  char 		*lowrank_filename = NULL; 	// low-rank Fc1 factors (-l)
+  char 		*pruned_filename = NULL; 	// channel-pruned model (-p)
+  char 		*ternary_filename = NULL; 	// ternary / binary model (-t)
+  int 		wino_layers = 0; 			// WINO_CONV1 | WINO_CONV2 (-w)
+  char 		*watch_filename = NULL; 	// hot-swapped weight file (-u)
+  ModelVersion *version = NULL; 		// version serving the current image
+  int 		version_id = 0; 
+  struct timeval t0, t1; 
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-f")) {
+      path = PATH_FIXED; 
+    }
+    else if (!strcmp(argv[i], "-q")) {
+      path = PATH_INT8; 
+    }
+    else if (!strcmp(argv[i], "-z")) {
+      path = PATH_SPARSE; 
+    }
+    else if (!strcmp(argv[i], "-a")) {
+      path = PATH_TUNED; 
+    }
+    else if (!strcmp(argv[i], "-l") && i+1 < argc) {
+      path = PATH_LOWRANK; 
+      lowrank_filename = argv[++i]; 
+    }
+    else if (!strcmp(argv[i], "-p") && i+1 < argc) {
+      path = PATH_PRUNED; 
+      pruned_filename = argv[++i]; 
+    }
+    else if (!strcmp(argv[i], "-t") && i+1 < argc) {
+      path = PATH_TERNARY; 
+      ternary_filename = argv[++i]; 
+    }
+    else if (!strcmp(argv[i], "-x") && i+1 < argc) {
+      path = PATH_MIXED; 
+      if (!MixedParseConfig(argv[++i], &MIXED_CONFIG)) {
+        printf("Error: Bad precision configuration %s (e.g. fp32-int8-int8-int4; fp32, fp16, int16, int8, int4).\n", argv[i]); 
+        exit(1); 
+      }
+    }
+    else if (!strcmp(argv[i], "-w") && i+1 < argc) {
+      path = PATH_WINOGRAD; 
+      for (char *l = argv[++i]; *l; l++) {
+        if (*l == '1') wino_layers |= WINO_CONV1; 
+        else if (*l == '2') wino_layers |= WINO_CONV2; 
+        else {
+          printf("Error: Bad Winograd layers %s (1, 2 or 12).\n", argv[i]); 
+          exit(1); 
+        }
+      }
+    }
+    else if (!strcmp(argv[i], "-k") && i+1 < argc) {
+      SCORES = SCORES_LOGITS; 
+      topk = atoi(argv[++i]); 
+      if (topk < 1 || topk > FC2_NBOUTPUT) {
+        printf("Error: -k expects 1 .. %d classes.\n", FC2_NBOUTPUT); 
+        exit(1); 
+      }
+    }
+    else if (!strcmp(argv[i], "-r")) {
+      RAW_INPUT = 1; 
+    }
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) {
+      cascade = 1; 
+      cascade_margin = atof(argv[++i]); 
+    }
+    else if (!strcmp(argv[i], "-m") && i+1 < argc) {
+      cache_entries = atoi(argv[++i]); 
+    }
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) {
+      shm_name = argv[++i]; 
+    }
+    else if (!strcmp(argv[i], "-H")) {
+      shm_huge = 1; 
+    }
+    else if (!strcmp(argv[i], "-u") && i+1 < argc) {
+      watch_filename = argv[++i]; 
+    }
+    else {
+      printf("Usage: %s [-f | -q | -z | -a | -l lowrank_file | -p pruned_file | -t ternary_file | -x config | -w layers | -c margin] [-k k] [-r] [-m cache_entries] [-s shm_name [-H]] [-u weights_file]\n", argv[0]); 
+      exit(1); 
+    }
+  }
+
+  if (cascade && SCORES == SCORES_LOGITS) {
+    printf("Error: -c needs the softmax probabilities, -k skips them.\n"); 
+    exit(1); 
+  }
+  /* the cascade always runs the int8 pipeline, then the float reference */
+  if (cascade && path != PATH_FLOAT) {
+    printf("Error: -c runs its own int8 and float passes, no -f, -q, -z, -a, -l, -p, -t, -x or -w.\n"); 
+    exit(1); 
+  }
+  /* other paths and modes keep state prepared once from the startup weights */
+  if (watch_filename && ((path != PATH_FLOAT && path != PATH_FIXED && path != PATH_SPARSE) || 
+                         cascade || cache_entries || shm_name)) {
+    printf("Error: -u works with the float, -f and -z paths only (no -c, -m or -s).\n"); 
+    exit(1); 
+  }
 
   printf("\e[1;1H\e[2J");
 
-  printf("\nReading weights \n"); 
-  ReadConv1Weights(hdf5_filename, conv1_weights, CONV1_KERNEL);
-  ReadConv1Bias   (hdf5_filename, conv1_bias,    CONV1_BIAS); 
-  ReadConv2Weights(hdf5_filename, conv2_weights, CONV2_KERNEL);
-  ReadConv2Bias   (hdf5_filename, conv2_bias,    CONV2_BIAS); 
-  ReadFc1Weights  (hdf5_filename, fc1_weights,   FC1_KERNEL);
-  ReadFc1Bias     (hdf5_filename, fc1_bias,      FC1_BIAS);
-  ReadFc2Weights  (hdf5_filename, fc2_weights,   FC2_KERNEL);
-  ReadFc2Bias     (hdf5_filename, fc2_bias,      FC2_BIAS);
-//WriteWeights("temp.txt", CONV1_KERNEL); 
+  if (shm_name) {
+    /* first worker of the node fills the segment, the others map it read-only */
+    shm_node = ShmCurrentNode(); 
+    MODEL = ShmOpenModel(shm_name, shm_node, shm_huge, &shm_created); 
+  }
+
+  if (shm_created) {
+    printf("\nReading weights \n"); 
+    ReadConv1Weights(hdf5_filename, conv1_weights, MODEL->w.conv1_kernel);
+    ReadConv1Bias   (hdf5_filename, conv1_bias,    MODEL->w.conv1_bias); 
+    ReadConv2Weights(hdf5_filename, conv2_weights, MODEL->w.conv2_kernel);
+    ReadConv2Bias   (hdf5_filename, conv2_bias,    MODEL->w.conv2_bias); 
+    ReadFc1Weights  (hdf5_filename, fc1_weights,   MODEL->w.fc1_kernel);
+    ReadFc1Bias     (hdf5_filename, fc1_bias,      MODEL->w.fc1_bias);
+    ReadFc2Weights  (hdf5_filename, fc2_weights,   MODEL->w.fc2_kernel);
+    ReadFc2Bias     (hdf5_filename, fc2_bias,      MODEL->w.fc2_bias);
+//  WriteWeights("temp.txt", CONV1_KERNEL); 
+    FoldInputScale(MODEL->w.conv1_kernel, MODEL->conv1_kernel_u8, 1.0f / 255); 
+    FcTransposeFc1(MODEL->w.fc1_kernel, MODEL->fc1_kernel_t); 
+    FcTransposeFc2(MODEL->w.fc2_kernel, MODEL->fc2_kernel_t); 
+
+    /* a shared model serves every worker, whatever its path */
+    if (path == PATH_INT8 || cascade || shm_name) {
+      printf("\nPreparing int8 model (%d calibration images) \n", INT8_CALIB_IMAGES); 
+      PrepareInt8Model(MODEL); 
+    }
+    if (shm_name) ShmPublishModel(MODEL); 
+  }
+  if (shm_name) {
+    ShmSegmentName(img_filename, sizeof(img_filename), shm_name, shm_node); 
+    printf("\nShared model %s (node %d, %lu KB): %s \n", img_filename, shm_node, 
+           (unsigned long)sizeof(LenetModel) / 1024, shm_created ? "published" : "attached read-only"); 
+  }
+  if (path == PATH_FIXED || path == PATH_SPARSE || path == PATH_TUNED || path == PATH_LOWRANK || 
+      path == PATH_PRUNED || path == PATH_TERNARY || path == PATH_MIXED || path == PATH_WINOGRAD) RAW_INPUT = 0; // float input only
+
+  if (path == PATH_LOWRANK) {
+    ReadFc1LowRank(lowrank_filename, &FC1_LR); 
+    printf("\nLow-rank Fc1 %s: rank %d, %d MACs instead of %d \n", lowrank_filename, FC1_LR.rank, 
+           FC1_LR.rank * (FC1_NBINPUT + FC1_NBOUTPUT), FC1_NBINPUT * FC1_NBOUTPUT); 
+  }
+
+  if (path == PATH_PRUNED) {
+    ReadLenetPruned(pruned_filename, &PRUNED); 
+    printf("\nPruned model %s: %d / %d Conv1 and %d / %d Conv2 channels kept \n", pruned_filename, 
+           PRUNED.nb_conv1, CONV1_NBOUTPUT, PRUNED.nb_conv2, CONV2_NBOUTPUT); 
+  }
+
+  if (path == PATH_TERNARY) {
+    ReadLenetTernary(ternary_filename, &TERNARY); 
+    printf("\nTernary model %s: %s weights, %d-bit activations \n", ternary_filename, 
+           TERNARY.binary ? "binary" : "ternary", TERNARY.abits); 
+  }
+
+  if (path == PATH_MIXED) {
+    MixedPrepare(&MODEL->w, &MIXED); 
+    MixedConfigName(&MIXED_CONFIG, img_filename); 
+    printf("\nMixed precision %s: %ld KB of weights \n", img_filename, MixedWeightBytes(&MIXED, &MIXED_CONFIG) / 1024); 
+  }
+
+  if (path == PATH_WINOGRAD) {
+    WinogradPrepare(&MODEL->w, wino_layers, &WINOGRAD); 
+    printf("\nWinograd F(%dx%d,5x5) on%s%s \n", WINO_M, WINO_M, wino_layers & WINO_CONV1 ? " Conv1" : "", 
+           wino_layers & WINO_CONV2 ? " Conv2" : ""); 
+  }
+
+  if (path == PATH_TUNED) {
+    /* one image at a time in the test loop: tune for batch 1 */
+    float (*tune_img)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH] = malloc(TUNE_IMAGES * sizeof(*tune_img)); 
+    for (k = 0; k < TUNE_IMAGES; k++) {
+      MnistImgFilename(img_filename, k); 
+      ReadPgmFile(img_filename, (unsigned char *)REF_IMG); 
+      NormalizeImg((unsigned char *)REF_IMG, (float *)tune_img[k], IMG_WIDTH, IMG_HEIGHT); 
+    }
+    printf("\nAutotuning (%s) \n", TUNE_CACHE_FILE); 
+    gettimeofday(&start, NULL); 
+    ret = LenetAutotune(TUNE_CACHE_FILE, MODEL, tune_img, TUNE_IMAGES, 1, 1, &TUNE); 
+    gettimeofday(&end, NULL); 
+    printf("%s in %.3f s: Conv1 %s, Conv2 %s, Fc1 %s, Fc2 %s, %d thread(s), %.1f us/image \n", 
+           ret ? "Loaded" : "Tuned", (double)(end.tv_sec-start.tv_sec) + (double)(end.tv_usec-start.tv_usec)/1000000.0, 
+           TUNE.conv1 == TUNE_LINEBUF ? "line-buffer" : "direct", TUNE.conv2 == TUNE_LINEBUF ? "line-buffer" : "direct", 
+           TUNE.fc1 == TUNE_SPARSE ? "sparse" : "dense", TUNE.fc2 == TUNE_SPARSE ? "sparse" : "dense", 
+           TUNE.threads, TUNE.image_us); 
+    free(tune_img); 
+  }
+
+  if (watch_filename) {
+    version_id = ModelPublish(MODEL, hdf5_filename); 
+    ModelWatch(watch_filename, MODEL_WATCH_MS); 
+    printf("\nServing model v%d, watching %s every %d ms \n", version_id, watch_filename, MODEL_WATCH_MS); 
+  }
 
   printf("\nOpening labels file \n"); 
   /* === lecture binaire robuste === */
@@ -159,6 +411,8 @@ void main() {
 
   for (k = 0; k < 8; k++) (void)fgetc(label_file); // Skip 8 first header bytes
   
+  if (cache_entries) CacheInit(cache_entries); 
+
   printf("\nProcessing \n");
   m = 0; 		        // test image counter
   tavg = 0; 		    // average processing time (us)
@@ -195,25 +449,38 @@ void main() {
     // printf("\033[%d;%dH%s\n", 7, 0, img_filename);
 
     ReadPgmFile(img_filename, (unsigned char *)REF_IMG); 
-    NormalizeImg((unsigned char *)REF_IMG, (float *)INPUT_NORM, IMG_WIDTH, IMG_WIDTH); 
+    /* a cache hit returns the stored softmax vector without recomputation */
+    if (!CacheLookup((unsigned char *)REF_IMG, SOFTMAX_OUTPUT)) {
+      if (!RAW_INPUT)
+        NormalizeImg((unsigned char *)REF_IMG, (float *)INPUT_NORM, IMG_WIDTH, IMG_WIDTH); 
 
 ////    xilinx_start = sds_clock_counter();
 
-    lenet_cnn(	INPUT_NORM, 				
-				CONV1_KERNEL, 		
-				CONV1_BIAS, 		
-				CONV2_KERNEL, 			
-				CONV2_BIAS, 			
-				FC1_KERNEL, 				
-				FC1_BIAS, 				
-				FC2_KERNEL,					
-				FC2_BIAS,					
-				FC2_OUTPUT); 
+      if (cascade) {
+        /* cheap int8 pass, float only when the prediction is not clear-cut */
+        Classify(PATH_INT8); 
+        if (SoftmaxMargin(SOFTMAX_OUTPUT) < cascade_margin) {
+          fallback++; 
+          Classify(PATH_FLOAT); 
+        }
+      }
+      else if (watch_filename) {
+        /* the version stays valid until ModelRelease, whatever gets published meanwhile */
+        version = ModelAcquire(0); 
+        MODEL = &version->model; 
+        version_id = version->id; 
+        gettimeofday(&t0, NULL); 
+        Classify(path); 
+        gettimeofday(&t1, NULL); 
+        ModelRelease(0, version); 
+        MODEL = &LOCAL_MODEL; 
+      }
+      else Classify(path); 
+      CacheInsert((unsigned char *)REF_IMG, SOFTMAX_OUTPUT); 
+    }
 
 ////    xilinx_end = sds_clock_counter(); 
 
-    Softmax(FC2_OUTPUT, SOFTMAX_OUTPUT); 
-
     /* Affichages Softmax prédiction désactivés */
     // printf("\n\nSoftmax output: \n");
     // max = 0; 
@@ -229,15 +496,12 @@ void main() {
     // printf("\n\nPredicted: %d \t Actual: %d\n", labels_legend[number], label); 
 
     /* conserve la mesure d'accuracy sans afficher */
-    max = 0.0f;
-    number = 0;
-    for (k = 0; k < FC2_NBOUTPUT; k++) {
-      if (SOFTMAX_OUTPUT[k] > max) {
-        max = SOFTMAX_OUTPUT[k];
-        number = (unsigned char)k;
-      }
-    }
+    number = (unsigned char)TopK(SOFTMAX_OUTPUT, topk, classes); 
     if (labels_legend[number] != label) error = error + 1; 
+    for (k = 0; k < topk && classes[k] != label; k++) ; 
+    if (k == topk) topk_error++; 
+    if (watch_filename)
+      ModelRecord(0, version_id, (t1.tv_sec-t0.tv_sec)*1e6 + (t1.tv_usec-t0.tv_usec), labels_legend[number] == label); 
 
     xilinx_time = xilinx_end - xilinx_start; 
     if (xilinx_time < xilinx_time_min) xilinx_time_min = xilinx_time; 
@@ -253,11 +517,34 @@ void main() {
 
   printf("\n\nErrors : %d / %d", error, m); 
   printf("\n\nSuccess rate = %f%%", (1-((float)error/m))*100); 
+  if (topk > 1)
+    printf("\n\nTop-%d errors : %d / %d (%f%%)", topk, topk_error, m, 100.0f*topk_error/m); 
+  if (cascade)
+    printf("\n\nCascade (margin %.3f) : %d / %d images fell back to float (%.2f%%)", cascade_margin, fallback, m, 100.0f*fallback/m); 
+  if (path == PATH_SPARSE) {
+    float zero[2]; 
+    FcSparsityStats(&FC_SPARSITY, zero); 
+    printf("\n\nFC input sparsity : Fc1 (pool2_output) %.1f%% zeros, Fc2 (fc1_output) %.1f%% zeros", 
+           100*zero[0], 100*zero[1]); 
+  }
+  if (cache_entries) {
+    CacheStats(&hits, &misses, &evictions); 
+    printf("\n\nCache (%u entries) : %llu hits, %llu misses, %llu evictions", cache_entries, hits, misses, evictions); 
+    CacheFree(); 
+  }
+  if (watch_filename) {
+    ModelPrintVersions(); 
+    ModelRegistryFree(); 
+  }
 
 ////  printf("\n\nThw_min = %lld cpu cycles \t Thw_max = %lld cpu cycles \t Thw_avg = %lld cpu cycles (Xilinx) ", xilinx_time_min, xilinx_time_max, xilinx_time_avg/m );
 
   printf("\n\n"); 
 
   fclose(label_file); 
+  if (path == PATH_TUNED && TeamSize() > 1) TeamFree(); 
+  if (path == PATH_MIXED) MixedFree(&MIXED); 
+  if (shm_name) ShmCloseModel(MODEL); 
 
+  return 0; 
 }
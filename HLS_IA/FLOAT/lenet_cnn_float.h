@@ -8,6 +8,10 @@
   * @brief   Designed to support Vivado HLS synthesis
   */
 
+#ifndef LENET_CNN_FLOAT_H_
+#define LENET_CNN_FLOAT_H_
+
+#include <stdint.h>
 
 #define IMG_WIDTH	28
 #define IMG_HEIGHT	28
@@ -45,11 +49,49 @@
 
 #define FC2_NBOUTPUT	10
 
+// FIXED_POINT kernels keep the float prototypes. Building them with -DFIXED_POINT
+// suffixes every layer (and the lenet_cnn top level) with _fixed so that the
+// int8 path can be linked next to the float one (see cascade mode in main).
+#ifdef FIXED_POINT
+#define lenet_cnn                   lenet_cnn_fixed
+#define lenet_cnn_topk              lenet_cnn_topk_fixed
+#define Conv1_28x28x1_5x5x20_1_0    Conv1_28x28x1_5x5x20_1_0_fixed
+#define Pool1_24x24x20_2x2x20_2_0   Pool1_24x24x20_2x2x20_2_0_fixed
+#define Conv2_12x12x20_5x5x40_1_0   Conv2_12x12x20_5x5x40_1_0_fixed
+#define Pool2_8x8x40_2x2x40_2_0     Pool2_8x8x40_2x2x40_2_0_fixed
+#define Fc1_40_400                  Fc1_40_400_fixed
+#define Fc2_400_10                  Fc2_400_10_fixed
+#endif
+
 void ReadPgmFile(char *filename, unsigned char *pix); 
 void WritePgmFile(char *filename, float *pix, short width, short height); 
 void ReadTestLabels(char *filename, short size); 
 void RescaleImg(unsigned char *input, short width,short height, float *output, short new_width, short new_height); 
 void NormalizeImg(unsigned char *input, float *output, short width, short height); 
+void FoldInputScale(float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], float folded[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], float scale); 
+
+// Fused decode -> resize -> normalize stage (preprocess.c)
+#define PREPROC_NEAREST		0
+#define PREPROC_BILINEAR	1
+#define PREPROC_MAX_DIM		8192
+
+typedef struct {
+  unsigned char 	*pix; 
+  short 			width, height, maxval; 
+} PgmImage; 
+
+typedef struct { 			// zero-initialize, tables are built on first use and per source size
+  short 	width, height, maxval, mode; 
+  short 	x0[IMG_WIDTH], x1[IMG_WIDTH], y0[IMG_HEIGHT], y1[IMG_HEIGHT]; 
+  float 	wx[IMG_WIDTH], wy[IMG_HEIGHT]; 
+  float 	lut[256]; 
+} PreprocPlan; 
+
+int  DecodePgm(unsigned char *buf, long len, unsigned char *scratch, long scratch_size, PgmImage *img); 
+void RawImage(unsigned char *pix, short width, short height, PgmImage *img); 
+void PreprocPlanInit(PreprocPlan *p, short width, short height, short maxval, int mode); 
+void PreprocessImg(PreprocPlan *p, PgmImage *img, int mode, float output[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]); 
+void PreprocessImgU8(PreprocPlan *p, PgmImage *img, int mode, unsigned char output[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]); 
 void ReadConv1Weights(char *filename, char *datasetname, float weight[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]); 
 void ReadConv1Bias(char *filename, char *datasetname, float *bias); 
 void ReadConv2Weights(char *filename, char *datasetname, float weight[CONV2_NBOUTPUT][CONV1_NBOUTPUT][CONV2_DIM][CONV2_DIM]); 
@@ -60,11 +102,55 @@ void ReadFc2Weights(char *filename, char *datasetname, float weight[FC2_NBOUTPUT
 void ReadFc2Bias(char *filename, char *datasetname, float *bias); 
 void WriteWeights(char *filename, short weight[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]); 
 
+// Whole model in one block: main (LenetModel.w), the tools and the benchmarks
+typedef struct {
+  float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]; 
+  float 	conv1_bias[CONV1_NBOUTPUT]; 
+  float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM]; 
+  float 	conv2_bias[CONV2_NBOUTPUT]; 
+  float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+  float 	fc1_bias[FC1_NBOUTPUT]; 
+  float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT]; 
+  float 	fc2_bias[FC2_NBOUTPUT]; 
+} LenetWeights; 
+
+#define MNIST_TEST_SIZE	10000
+
+void ReadLenetWeights(char *filename, LenetWeights *w); 
+void MnistImgFilename(char *filename, int m); 
+int  ReadMnistLabels(char *filename, unsigned char *labels, int size); 
+
 void Conv1_28x28x1_5x5x20_1_0(	float 			input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 	                // IN
 				                float 		    kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 	// IN
 				                float 		    bias[CONV1_NBOUTPUT],						                // IN
 				                float 		    output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 		// OUT
 
+// Raw 8-bit pixels in, kernel pre-scaled by 1/255 (FoldInputScale)
+void Conv1_28x28x1_5x5x20_1_0_u8(	unsigned char 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 	                // IN
+				                float 		    kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 	// IN
+				                float 		    bias[CONV1_NBOUTPUT],						                // IN
+				                float 		    output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 		// OUT
+
+// Streaming line-buffer variants (conv.c): each input pixel is read once, all output
+// channels per window position, bit-identical to the direct kernels
+void Conv1_28x28x1_5x5x20_1_0_lb(	float 		input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+				                float 		    kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+				                float 		    bias[CONV1_NBOUTPUT], 
+				                float 		    output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 
+void Conv2_12x12x20_5x5x40_1_0_lb(	float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], 
+				                float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+				                float bias[CONV2_NBOUTPUT], 
+				                float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]); 
+
+// Weight-specialized Conv1 / Conv2, generated by conv_codegen into conv_const.c: weights as
+// immediates, windows unrolled, products shared; conv*_const_kernel: the weights they were built from
+void Conv1_28x28x1_5x5x20_1_0_const(	float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+				                float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 
+void Conv2_12x12x20_5x5x40_1_0_const(	float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], 
+				                float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]); 
+extern const int conv_const_bits; 
+extern float conv1_const_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]; 
+extern float conv2_const_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM]; 
 
 void Pool1_24x24x20_2x2x20_2_0(	float 	input[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], 	    // IN
 				                float 	output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]);		// OUT
@@ -77,14 +163,588 @@ void Conv2_12x12x20_5x5x40_1_0(	float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_
 void Pool2_8x8x40_2x2x40_2_0(	float 	input[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], 	    // IN
 				                float 	output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]);		// OUT
 
+// Channel-range pieces of Pool1/Pool2 (pool.c), for channel-split callers
+float PoolMaxAbs(const float *input, int n); 
+void  PoolChannels(const float *input, int H, int W, int c0, int c1, float max_abs, float *output); 
+
 void Fc1_40_400(	float 	input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 			        // IN
 			        float 	kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],	// IN
 			        float 	bias[FC1_NBOUTPUT],							                        // IN
 			        float 	output[FC1_NBOUTPUT]); 							                    // OUT
-
 void Fc2_400_10(	float 	input[FC1_NBOUTPUT], 			        // IN
 			        float 	kernel[FC2_NBOUTPUT][FC1_NBOUTPUT],	    // IN
 			        float 	bias[FC2_NBOUTPUT],			            // IN
 			        float 	output[FC2_NBOUTPUT]); 			        // OUT
 
-void Softmax(float vector_in[FC2_NBOUTPUT], float vector_out[FC2_NBOUTPUT]); 
\ No newline at end of file
+// Input-sparsity FC path (fc.c): nonzero inputs only, input-major weights (FcTranspose*)
+#define FC1_NBINPUT	(POOL2_NBOUTPUT*POOL2_HEIGHT*POOL2_WIDTH)
+
+// zero / total inputs seen per FC layer, owned by the caller (one per thread)
+typedef struct { 
+  unsigned long long 	nonzero[2], inputs[2]; 
+} FcSparsity; 
+
+void FcTransposeFc1(float weight[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], float weight_t[FC1_NBINPUT][FC1_NBOUTPUT]); 
+void FcTransposeFc2(float weight[FC2_NBOUTPUT][FC1_NBOUTPUT], float weight_t[FC1_NBOUTPUT][FC2_NBOUTPUT]); 
+void Fc1_40_400_sparse(	float 	input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 	// IN
+						float 	weight_t[FC1_NBINPUT][FC1_NBOUTPUT], 				// IN
+						float 	bias[FC1_NBOUTPUT], 								// IN
+						float 	output[FC1_NBOUTPUT], 								// OUT
+						FcSparsity *stats); 										// OUT, or NULL
+void Fc2_400_10_sparse(	float 	input[FC1_NBOUTPUT], 								// IN
+						float 	weight_t[FC1_NBOUTPUT][FC2_NBOUTPUT], 				// IN
+						float 	bias[FC2_NBOUTPUT], 								// IN
+						float 	output[FC2_NBOUTPUT], 								// OUT
+						FcSparsity *stats); 										// OUT, or NULL
+void FcSparsityStats(const FcSparsity *s, float zero_fraction[2]); 
+
+// Streamed Fc1 (fc.c): weights in external memory as 512-bit AXI words, packed host-side in
+// consumption order (FcPackFc1Stream), FC1_TILE outputs per tile in ping-pong on-chip buffers
+#define AXI_WORD_BITS		512
+#define AXI_WORD_FLOATS		(AXI_WORD_BITS / 32)
+#define AXI_MAX_BURST		256 	// beats (AXI4), bursts also stop at 4 KB boundaries
+#ifndef FC1_TILE
+#define FC1_TILE			16 		// multiple of AXI_WORD_FLOATS, divides FC1_NBOUTPUT
+#endif
+#if (FC1_TILE % AXI_WORD_FLOATS) || (FC1_NBOUTPUT % FC1_TILE)
+#error "FC1_TILE must be a multiple of AXI_WORD_FLOATS and divide FC1_NBOUTPUT"
+#endif
+#define FC1_TILE_WORDS		(FC1_TILE / AXI_WORD_FLOATS) 	// AXI words per input
+#define FC1_NB_TILES		(FC1_NBOUTPUT / FC1_TILE)
+#define FC1_STREAM_WORDS	(FC1_NB_TILES * FC1_NBINPUT * FC1_TILE_WORDS)
+
+typedef struct { 
+  float 	f[AXI_WORD_FLOATS]; 	// ap_uint<512> on the m_axi port
+} AxiWord; 
+
+// external memory traffic of Fc1_40_400_stream, owned by the caller
+typedef struct { 
+  unsigned long long 	bytes, bursts, beats, calls; 
+} AxiStats; 
+
+void FcPackFc1Stream(float weight[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], AxiWord packed[FC1_STREAM_WORDS]); 
+void Fc1_40_400_stream(	float 	input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 	// IN
+						AxiWord wmem[FC1_STREAM_WORDS], 							// IN  external memory
+						float 	bias[FC1_NBOUTPUT], 								// IN
+						float 	output[FC1_NBOUTPUT], 								// OUT
+						AxiStats *stats); 											// OUT, or NULL
+
+// Low-rank Fc1 (fc.c): weight ~ u v by truncated SVD (fc1_lowrank tool),
+// rank * (FC1_NBINPUT + FC1_NBOUTPUT) MACs instead of FC1_NBINPUT * FC1_NBOUTPUT
+#ifndef FC1_RANK_MAX
+#define FC1_RANK_MAX	128
+#endif
+
+typedef struct {
+  int 		rank; 
+  float 	v[FC1_RANK_MAX][FC1_NBINPUT]; 		// first GEMV, rows 0 .. rank-1
+  float 	u[FC1_NBOUTPUT][FC1_RANK_MAX]; 		// second GEMV, columns 0 .. rank-1
+} Fc1LowRank; 
+
+void Fc1_40_400_lowrank(	float 	input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 	// IN
+							float 	v[FC1_RANK_MAX][FC1_NBINPUT], 						// IN
+							float 	u[FC1_NBOUTPUT][FC1_RANK_MAX], 						// IN
+							int 	rank, 												// IN
+							float 	bias[FC1_NBOUTPUT], 								// IN
+							float 	output[FC1_NBOUTPUT]); 								// OUT
+void ReadFc1LowRank(char *filename, Fc1LowRank *f); 
+void WriteFc1LowRank(char *filename, Fc1LowRank *f); 
+
+// Channel-pruned model (prune tool): whole Conv1 / Conv2 output channels removed, with
+// the matching Conv2 / Fc1 input slices. The kept channels are compacted at the front
+// of the LenetWeights arrays; nb_conv1 / nb_conv2 are the run-time channel counts.
+typedef struct {
+  int 		nb_conv1, nb_conv2; 
+  short 	conv1_index[CONV1_NBOUTPUT], conv2_index[CONV2_NBOUTPUT]; 	// original channel numbers
+  LenetWeights 	w; 
+} LenetPruned; 
+
+// Run-time sized Conv1 / Conv2 / Fc1 (conv.c, fc.c): output channels (neurons) [m0, m1)
+// over the first nb_input input channels, for the pruned model and channel-split callers
+void Conv1_28x28x1_5x5x20_1_0_range(	float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+				                float 		    kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+				                float 		    bias[CONV1_NBOUTPUT], 
+				                int 		    m0, 
+				                int 		    m1, 
+				                float 		    output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 
+void Conv2_12x12x20_5x5x40_1_0_range(	float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], 
+				                float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+				                float bias[CONV2_NBOUTPUT], 
+				                int   nb_input, 
+				                int   m0, 
+				                int   m1, 
+				                float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]); 
+void Fc1_40_400_range(	float 	input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 			// IN
+						float 	kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 	// IN
+						float 	bias[FC1_NBOUTPUT], 								// IN
+						int 	nb_channels, 										// IN
+						int 	o0, 												// IN
+						int 	o1, 												// IN
+						float 	output[FC1_NBOUTPUT]); 								// OUT
+void Conv1_28x28x1_5x5x20_1_0_pruned(	float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+				                float 		    kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+				                float 		    bias[CONV1_NBOUTPUT], 
+				                int 		    nb_output, 
+				                float 		    output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 
+void Conv2_12x12x20_5x5x40_1_0_pruned(	float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], 
+				                float kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+				                float bias[CONV2_NBOUTPUT], 
+				                int   nb_input, 
+				                int   nb_output, 
+				                float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]); 
+void Fc1_40_400_pruned(	float 	input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 			// IN
+						float 	kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 	// IN
+						float 	bias[FC1_NBOUTPUT], 								// IN
+						int 	nb_channels, 										// IN
+						float 	output[FC1_NBOUTPUT]); 								// OUT
+void ReadLenetPruned(char *filename, LenetPruned *p); 
+void WriteLenetPruned(char *filename, LenetPruned *p); 
+
+// Ternary / binary mode (lenet_bin.c, ternarize tool): Conv1 stays float, Conv2 / Fc1 / Fc2
+// weights in {-1, 0, +1} (or {-1, +1}) as pos / neg bit masks with a per-output-channel
+// scale, activations (post-ReLU) as abits unsigned bit planes. A dot product is
+// sum_b 2^b (popcount(a_b & pos) - popcount(a_b & neg)): AND + POPCNT, LUTs only on FPGA.
+#ifndef TERN_ABITS_MAX
+#define TERN_ABITS_MAX	4
+#endif
+#define TERN_FC1_WORDS	((FC1_NBINPUT + 63) / 64) 	// Pool2 bits, [c][y][x] order
+#define TERN_FC2_WORDS	((FC1_NBOUTPUT + 63) / 64)
+#define TERN_NB_ACT		3 							// activation steps: pool1, pool2, fc1
+
+typedef struct {
+  int 		abits; 							// activation bits, 1 .. TERN_ABITS_MAX (1 = binary)
+  int 		binary; 						// weights in {-1, +1} (no zero)
+  float 	act_step[TERN_NB_ACT]; 			// activation = q * step, q in 0 .. 2^abits - 1
+  float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]; 
+  float 	conv1_bias[CONV1_NBOUTPUT]; 
+  uint32_t 	conv2_pos[CONV2_DIM][CONV2_DIM][CONV2_NBOUTPUT], conv2_neg[CONV2_DIM][CONV2_DIM][CONV2_NBOUTPUT]; 	// tap-major, bit = input channel
+  float 	conv2_scale[CONV2_NBOUTPUT], conv2_bias[CONV2_NBOUTPUT]; 
+  uint64_t 	fc1_pos[FC1_NBOUTPUT][TERN_FC1_WORDS], fc1_neg[FC1_NBOUTPUT][TERN_FC1_WORDS]; 
+  float 	fc1_scale[FC1_NBOUTPUT], fc1_bias[FC1_NBOUTPUT]; 
+  uint64_t 	fc2_pos[FC2_NBOUTPUT][TERN_FC2_WORDS], fc2_neg[FC2_NBOUTPUT][TERN_FC2_WORDS]; 
+  float 	fc2_scale[FC2_NBOUTPUT], fc2_bias[FC2_NBOUTPUT]; 
+} LenetTernary; 
+
+void TernaryPool1Pack(	float 		input[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], float step, int abits, 
+						uint32_t 	output[TERN_ABITS_MAX][POOL1_HEIGHT][POOL1_WIDTH]); 
+void Conv2_12x12x20_5x5x40_1_0_ternary(	uint32_t input[TERN_ABITS_MAX][POOL1_HEIGHT][POOL1_WIDTH], LenetTernary *t, 
+										float 	 output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]); 
+void TernaryPool2Pack(	float 		input[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], float step, int abits, 
+						uint64_t 	output[TERN_ABITS_MAX][TERN_FC1_WORDS]); 
+void Fc1_40_400_ternary(uint64_t input[TERN_ABITS_MAX][TERN_FC1_WORDS], LenetTernary *t, float output[FC1_NBOUTPUT]); 
+void TernaryFc1Pack(	float 		input[FC1_NBOUTPUT], float step, int abits, 
+						uint64_t 	output[TERN_ABITS_MAX][TERN_FC2_WORDS]); 
+void Fc2_400_10_ternary(uint64_t input[TERN_ABITS_MAX][TERN_FC2_WORDS], LenetTernary *t, float output[FC2_NBOUTPUT]); 
+void lenet_cnn_ternary(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetTernary *t, float output[FC2_NBOUTPUT]); 
+void ReadLenetTernary(char *filename, LenetTernary *t); 
+void WriteLenetTernary(char *filename, LenetTernary *t); 
+
+void Softmax(float vector_in[FC2_NBOUTPUT], float vector_out[FC2_NBOUTPUT]);
+
+float SoftmaxMargin(float vector[FC2_NBOUTPUT]); 
+
+// Fixed-point softmax (softmax.c): exp from a 2^-f table, reciprocal by seed + Newton step.
+// HLS datapath only, the host keeps Softmax (see bench_softmax)
+#ifndef SOFTMAX_IN_FRAC
+#define SOFTMAX_IN_FRAC		10		// fraction bits of the SoftmaxQ logits
+#endif
+#define SOFTMAX_EXP_BITS	6		// 2^-f table of 1 << SOFTMAX_EXP_BITS entries
+#define SOFTMAX_ONE			32768	// probability 1.0, Q15
+void SoftmaxQ(const int32_t in[FC2_NBOUTPUT], uint16_t out[FC2_NBOUTPUT]); 
+void SoftmaxFixed(float vector_in[FC2_NBOUTPUT], float vector_out[FC2_NBOUTPUT]); 
+
+// Classification only, no softmax: class ranking straight from the logits
+#ifndef SOFTMAX_TOPK
+#define SOFTMAX_TOPK		1		// classes returned by lenet_cnn_topk
+#endif
+int  Argmax(float vector[FC2_NBOUTPUT]); 
+int  TopK(float vector[FC2_NBOUTPUT], int k, unsigned char classes[]); 
+
+// Fully-convolutional mode over a large page (fcn.c), host only. Not equivalent to
+// lenet_cnn() per patch: the pools take the exact float max instead of the per-tensor
+// int8 quantization of Pool1/Pool2 (~99% argmax agreement, score diffs up to ~0.04).
+typedef struct { 
+  int 		x, y, width, height; 	// region of interest, in page pixels
+} FcnRoi; 
+
+int  LenetFcnMapSize(int roi_w, int roi_h, int stride, int *nx, int *ny); 
+int  LenetFcn(unsigned char *page, int width, int height, FcnRoi *roi, int stride, LenetWeights *w, 
+              float *scores, int *nx, int *ny); 
+
+// Incremental inference over near-duplicate consecutive frames (delta.c), host only
+#ifndef DELTA_REFRESH
+#define DELTA_REFRESH	64	// sparse-delta mode: dense FC1 pass after DELTA_REFRESH sparse updates
+#endif
+#define DELTA_NB_LAYERS	4	// Conv1, Conv2, FC1, FC2
+
+typedef struct { 			// previous frame's activations (DeltaInit before the first frame)
+  int 		valid, exact_fc1, fc1_updates; 
+  float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]; 
+  float 	conv1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]; 	// after ReLU
+  float 	pool1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]; 
+  float 	conv2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]; 	// after ReLU
+  float 	pool2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+  float 	sx1, sx2; 											// pool int8 scales
+  float 	fc1_acc[FC1_NBOUTPUT]; 								// before ReLU
+  int 		fc1_idx[POOL2_NBOUTPUT*POOL2_HEIGHT*POOL2_WIDTH]; 	// changed Pool2 values
+  float 	fc1_dv[POOL2_NBOUTPUT*POOL2_HEIGHT*POOL2_WIDTH]; 
+  unsigned long long frames, scale_resets, macs[DELTA_NB_LAYERS]; 
+} DeltaState; 
+
+void  DeltaInit(DeltaState *s, int exact_fc1); 
+void  lenet_cnn_delta(DeltaState *s, float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetWeights *w, 
+                      float output[FC2_NBOUTPUT]); 
+float DeltaSkipped(DeltaState *s, float layer[DELTA_NB_LAYERS]); 
+
+// Persistent spinning thread team (team.c) and the low-latency lenet_cnn on it (lenet_par.c)
+#ifndef TEAM_MAX
+#define TEAM_MAX	64
+#endif
+typedef void (*TeamJob)(void *arg, int id, int nthreads); 
+
+void TeamInit(int nthreads); 
+void TeamRun(TeamJob job, void *arg); 
+void TeamBarrier(int id); 
+void TeamFree(void); 
+int  TeamSize(void); 
+void lenet_cnn_parallel(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetWeights *w, float output[FC2_NBOUTPUT]); 
+
+// Startup autotuner (tune.c), host only: kernel variant per layer and thread setup,
+// cached per CPU model, model hash and batch size
+#define TUNE_NB_LAYERS		4	// Conv1, Conv2, Fc1, Fc2
+#define TUNE_DIRECT			0	// Conv2 variants (Conv1 is always direct)
+#define TUNE_LINEBUF		1
+#define TUNE_DENSE			0	// Fc1 / Fc2 variants
+#define TUNE_SPARSE			1
+#define TUNE_SPLIT_IMAGE	0	// threads > 1: lenet_cnn_parallel, one image at a time
+#define TUNE_SPLIT_BATCH	1	// threads > 1: one image per team thread
+
+typedef struct {
+  int 		conv1, conv2, fc1, fc2; 	// kernel variant per layer
+  int 		threads, split, batch; 
+  float 	us[TUNE_NB_LAYERS]; 		// per-layer time of the chosen variants (0 when loaded)
+  float 	image_us; 					// whole network, per image
+} TuneConfig; 
+
+unsigned long long ModelHash(LenetWeights *w); 
+void TuneCpuModel(char *cpu, int size); 
+int  TuneLoad(const char *path, const char *cpu, unsigned long long hash, int batch, TuneConfig *c); 
+void TuneSave(const char *path, const char *cpu, unsigned long long hash, TuneConfig *c); 
+void TuneApply(TuneConfig *c); 
+
+// Per-layer mixed precision (mixed.c), host only: every weighted layer (Conv1, Conv2, Fc1,
+// Fc2) runs in fp32, fp16, int16, int8 or int4 independently. Integer layers use per-output
+// weight scales and a per-tensor dynamic activation scale (int4 weights with int8 activations).
+// A configuration is named by its four precisions, e.g. "fp32-int8-int8-int4".
+#define PREC_FP32		0
+#define PREC_FP16		1
+#define PREC_INT16		2
+#define PREC_INT8		3
+#define PREC_INT4		4
+#define PREC_NB			5
+#define MIXED_NB_LAYERS	4 	// Conv1, Conv2, Fc1, Fc2
+#define MIXED_NAME_SIZE	32
+
+typedef struct { 			// one weighted layer in every precision, nout rows of n weights
+  int 		nout, n; 
+  float 	*f32, *bias; 
+  uint16_t 	*f16; 						// IEEE half bits
+  int16_t 	*i16; 
+  int8_t 	*i8; 
+  uint8_t 	*i4; 						// rows of (n + 1) / 2 bytes, first half in the low nibbles
+  float 	*scale[PREC_NB]; 			// per-row weight scales of the integer formats
+} MixedLayer; 
+
+typedef struct { 
+  MixedLayer 	layer[MIXED_NB_LAYERS]; 
+} LenetMixed; 
+
+typedef struct { 
+  int 		prec[MIXED_NB_LAYERS]; 
+} MixedConfig; 
+
+void  MixedPrepare(LenetWeights *w, LenetMixed *m); 
+void  MixedFree(LenetMixed *m); 
+int   MixedParseConfig(const char *name, MixedConfig *c); 
+void  MixedConfigName(MixedConfig *c, char name[MIXED_NAME_SIZE]); 
+const char *MixedPrecName(int prec); 
+long  MixedWeightBytes(LenetMixed *m, MixedConfig *c); 
+void  MixedConv1(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetMixed *m, int prec, 
+                 float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 
+void  MixedConv2(float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], LenetMixed *m, int prec, 
+                 float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]); 
+void  MixedFc1(float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], LenetMixed *m, int prec, float output[FC1_NBOUTPUT]); 
+void  MixedFc2(float input[FC1_NBOUTPUT], LenetMixed *m, int prec, float output[FC2_NBOUTPUT]); 
+void  lenet_cnn_mixed(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetMixed *m, MixedConfig *c, float output[FC2_NBOUTPUT]); 
+
+// Bit-accurate ap_[u]fixed<W,I,Q,O> pipeline (FIXED_POINT/lenet_apfixed.c, formats emulated by
+// ap_fixed_emu.h), host only: per layer, one run-time format for the input, the weights and
+// the accumulator; raw values are int32 (tensors, weights) and int64 (accumulators, biases).
+#include "ap_fixed_emu.h"
+
+#define APF_NB_LAYERS	4 	// Conv1, Conv2, Fc1, Fc2
+
+typedef struct { 
+  ApFixedFmt 	in[APF_NB_LAYERS]; 		// layer inputs: pixels, Pool1, Pool2, Fc1 (after ReLU)
+  ApFixedFmt 	w[APF_NB_LAYERS]; 
+  ApFixedFmt 	acc[APF_NB_LAYERS]; 	// accumulators, biases are assigned to them
+} ApFixedConfig; 
+
+typedef struct { 
+  ApFixedConfig c; 
+  int 		fast[APF_NB_LAYERS], shift[APF_NB_LAYERS]; 	// exact modular accumulation (see lenet_apfixed.c)
+  int64_t 	add[APF_NB_LAYERS]; 
+  int32_t 	conv1_w[CONV1_NBOUTPUT][IMG_DEPTH*CONV1_DIM*CONV1_DIM]; 
+  int32_t 	conv2_w[CONV2_NBOUTPUT][POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM]; 
+  int32_t 	fc1_w[FC1_NBOUTPUT][FC1_NBINPUT]; 
+  int32_t 	fc2_w[FC2_NBOUTPUT][FC1_NBOUTPUT]; 
+  int64_t 	conv1_b[CONV1_NBOUTPUT], conv2_b[CONV2_NBOUTPUT], fc1_b[FC1_NBOUTPUT], fc2_b[FC2_NBOUTPUT]; 
+} LenetApFixed; 
+
+void  PrepareApFixed(LenetApFixed *m, LenetWeights *w, ApFixedConfig *c); 
+void  lenet_cnn_apfixed(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], const LenetApFixed *m, float output[FC2_NBOUTPUT]); 
+
+// Winograd F(WINO_M x WINO_M, 5x5) Conv1 / Conv2 (winograd.c), host only: kernels transformed
+// once by WinogradPrepare, WINO_TILES output blocks transformed together (SIMD over the tiles)
+#ifndef WINO_M
+#define WINO_M		2	// output block: 2 (6x6 input tiles) or 4 (8x8, fewer products, larger error)
+#endif
+#ifndef WINO_TILES
+#define WINO_TILES	16
+#endif
+#define WINO_N		(WINO_M + CONV2_DIM - 1) 	// input tile, CONV1_DIM == CONV2_DIM
+#define WINO_P		(WINO_N * WINO_N) 			// points of a transformed tile
+#define WINO_CONV1	1	// LenetWinograd.layers
+#define WINO_CONV2	2
+
+typedef struct {
+  int 		layers; 							// WINO_CONV1 | WINO_CONV2, the others run conv.c
+  float 	bt[WINO_N][WINO_N]; 				// input transform B^T
+  float 	at[WINO_M][WINO_N]; 				// output transform A^T
+  float 	conv1_u[WINO_P][CONV1_NBOUTPUT][IMG_DEPTH]; 		// G g G^T, point-major
+  float 	conv2_u[WINO_P][CONV2_NBOUTPUT][POOL1_NBOUTPUT]; 
+} LenetWinograd; 
+
+void  WinogradPrepare(LenetWeights *w, int layers, LenetWinograd *g); 
+void  WinogradOps(const LenetWinograd *g, int layer, long *products, long *transforms); 
+void  Conv1_28x28x1_5x5x20_1_0_winograd(	float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], const LenetWinograd *g, 
+										float bias[CONV1_NBOUTPUT], float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]); 
+void  Conv2_12x12x20_5x5x40_1_0_winograd(	float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], const LenetWinograd *g, 
+										float bias[CONV2_NBOUTPUT], float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]); 
+// lenet_cnn.c: lenet_cnn() with the Winograd kernels on g->layers
+void  lenet_cnn_winograd(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetWeights *w, const LenetWinograd *g, 
+                         float output[FC2_NBOUTPUT]); 
+
+// Image-interleaved Conv1 + Pool1 (interleave.c), host only: INTERLEAVE_LANES images in the
+// SIMD lanes ([H][W][lane]), de-interleaved at the Pool1 output; reentrant (~0.4 MB of stack)
+#ifndef INTERLEAVE_LANES
+#define INTERLEAVE_LANES	16	// 8: one AVX vector of floats, 16: one AVX-512 vector
+#endif
+void  InterleaveImages(float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, 
+                       float output[IMG_HEIGHT][IMG_WIDTH][INTERLEAVE_LANES]); 
+void  Conv1Pool1_interleaved(float input[IMG_HEIGHT][IMG_WIDTH][INTERLEAVE_LANES], 
+                             float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+                             float bias[CONV1_NBOUTPUT], int n, 
+                             float (*output)[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH]); 
+void  lenet_cnn_interleaved(float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, LenetWeights *w, 
+                            float (*outputs)[FC2_NBOUTPUT]); 
+
+// Prediction cache (cache.c), host only
+#ifndef CACHE_SHARDS
+#define CACHE_SHARDS	16	// power of two
+#endif
+unsigned long long ImgHash(unsigned char *img); 
+void CacheInit(unsigned int capacity); 
+void CacheFree(void); 
+int  CacheLookup(unsigned char *img, float prob[FC2_NBOUTPUT]); 
+void CacheInsert(unsigned char *img, float prob[FC2_NBOUTPUT]); 
+void CacheStats(unsigned long long *hits, unsigned long long *misses, unsigned long long *evictions); 
+
+// Top Level HLS function (lenet_cnn.c)
+void lenet_cnn(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 							// IN
+				float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM],		// IN
+				float 	conv1_bias[CONV1_NBOUTPUT], 						                // IN
+				float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], // IN
+				float 	conv2_bias[CONV2_NBOUTPUT], 						                // IN
+				float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH],// IN
+				float 	fc1_bias[FC1_NBOUTPUT],			 				                    // IN
+				float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 				            // IN
+				float 	fc2_bias[FC2_NBOUTPUT], 						                    // IN
+				float 	output[FC2_NBOUTPUT]); 							                    // OUT
+
+// Same graph, classification only: the SOFTMAX_TOPK best classes, best first, no softmax
+void lenet_cnn_topk(float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+					float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+					float 	conv1_bias[CONV1_NBOUTPUT], 
+					float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+					float 	conv2_bias[CONV2_NBOUTPUT], 
+					float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+					float 	fc1_bias[FC1_NBOUTPUT], 
+					float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 
+					float 	fc2_bias[FC2_NBOUTPUT], 
+					unsigned char classes[SOFTMAX_TOPK]); 
+
+// Same graph on raw 8-bit pixels, conv1_kernel pre-scaled by 1/255 (FoldInputScale)
+void lenet_cnn_u8(	unsigned char 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+					float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+					float 	conv1_bias[CONV1_NBOUTPUT], 
+					float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+					float 	conv2_bias[CONV2_NBOUTPUT], 
+					float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+					float 	fc1_bias[FC1_NBOUTPUT], 
+					float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 
+					float 	fc2_bias[FC2_NBOUTPUT], 
+					float 	output[FC2_NBOUTPUT]); 
+
+// Same graph with the input-sparsity FC kernels (transposed FC weights)
+void lenet_cnn_sparse(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+						float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+						float 	conv1_bias[CONV1_NBOUTPUT], 
+						float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+						float 	conv2_bias[CONV2_NBOUTPUT], 
+						float 	fc1_kernel_t[FC1_NBINPUT][FC1_NBOUTPUT], 
+						float 	fc1_bias[FC1_NBOUTPUT], 
+						float 	fc2_kernel_t[FC1_NBOUTPUT][FC2_NBOUTPUT], 
+						float 	fc2_bias[FC2_NBOUTPUT], 
+						float 	output[FC2_NBOUTPUT], 
+						FcSparsity *stats); 
+
+// Same graph with the low-rank Fc1 (Fc1LowRank factors)
+void lenet_cnn_lowrank(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+						float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+						float 	conv1_bias[CONV1_NBOUTPUT], 
+						float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+						float 	conv2_bias[CONV2_NBOUTPUT], 
+						float 	fc1_v[FC1_RANK_MAX][FC1_NBINPUT], 
+						float 	fc1_u[FC1_NBOUTPUT][FC1_RANK_MAX], 
+						int 	fc1_rank, 
+						float 	fc1_bias[FC1_NBOUTPUT], 
+						float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 
+						float 	fc2_bias[FC2_NBOUTPUT], 
+						float 	output[FC2_NBOUTPUT]); 
+
+// Same graph on a channel-pruned model (LenetPruned)
+void lenet_cnn_pruned(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetPruned *p, float output[FC2_NBOUTPUT]); 
+
+// Same graph built on the FIXED_POINT int8 kernels (lenet_cnn.c compiled with -DFIXED_POINT)
+void lenet_cnn_fixed(	float 	input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], 
+						float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+						float 	conv1_bias[CONV1_NBOUTPUT], 
+						float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+						float 	conv2_bias[CONV2_NBOUTPUT], 
+						float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+						float 	fc1_bias[FC1_NBOUTPUT], 
+						float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 
+						float 	fc2_bias[FC2_NBOUTPUT], 
+						float 	output[FC2_NBOUTPUT]); 
+
+// Integer-native pipeline (FIXED_POINT/lenet_int8.c): uint8 pixels in, int8 tensors from
+// Conv1 to Fc2, requantization fused with ReLU and max-pool, dequantization only at the logits
+#define INT8_NB_ACT	4	// activation scales: input, pool1, pool2, fc1
+
+typedef struct {
+  int8_t 	conv1_w[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]; 
+  int32_t 	conv1_b[CONV1_NBOUTPUT], conv1_mul[CONV1_NBOUTPUT]; 
+  int8_t 	conv1_shift[CONV1_NBOUTPUT]; 
+  int8_t 	conv2_w[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM]; 
+  int32_t 	conv2_b[CONV2_NBOUTPUT], conv2_mul[CONV2_NBOUTPUT]; 
+  int8_t 	conv2_shift[CONV2_NBOUTPUT]; 
+  int8_t 	fc1_w[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH]; 
+  int32_t 	fc1_b[FC1_NBOUTPUT], fc1_mul[FC1_NBOUTPUT]; 
+  int8_t 	fc1_shift[FC1_NBOUTPUT]; 
+  int8_t 	fc2_w[FC2_NBOUTPUT][FC1_NBOUTPUT]; 
+  int32_t 	fc2_b[FC2_NBOUTPUT]; 
+  float 	fc2_scale[FC2_NBOUTPUT]; 	// logits = acc * fc2_scale
+  float 	act_scale[INT8_NB_ACT]; 
+} LenetInt8; 
+
+void CalibrateInt8(	float 	input[][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, 
+					float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+					float 	conv1_bias[CONV1_NBOUTPUT], 
+					float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+					float 	conv2_bias[CONV2_NBOUTPUT], 
+					float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+					float 	fc1_bias[FC1_NBOUTPUT], 
+					float 	act_max[INT8_NB_ACT]); 
+void PrepareInt8(	LenetInt8 *q, 
+					float 	conv1_kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], 
+					float 	conv1_bias[CONV1_NBOUTPUT], 
+					float 	conv2_kernel[CONV2_NBOUTPUT][POOL1_NBOUTPUT][CONV2_DIM][CONV2_DIM], 
+					float 	conv2_bias[CONV2_NBOUTPUT], 
+					float 	fc1_kernel[FC1_NBOUTPUT][POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], 
+					float 	fc1_bias[FC1_NBOUTPUT], 
+					float 	fc2_kernel[FC2_NBOUTPUT][FC1_NBOUTPUT], 
+					float 	fc2_bias[FC2_NBOUTPUT], 
+					float 	act_max[INT8_NB_ACT]); 
+void lenet_cnn_int8(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetInt8 *q, float output[FC2_NBOUTPUT]); 
+void lenet_cnn_int8_u8(unsigned char input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetInt8 *q, float output[FC2_NBOUTPUT]); 
+
+// Prepared model: float weights, Conv1 kernel folded for raw input (FoldInputScale),
+// int8 model, transposed FC weights. Plain data, so that it can live in a shared-memory segment (shm.c).
+typedef struct {
+  LenetWeights 	w; 
+  float 		conv1_kernel_u8[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM]; 
+  LenetInt8 	int8; 
+  int 			has_int8; 
+  float 		fc1_kernel_t[FC1_NBINPUT][FC1_NBOUTPUT]; 	// input-major FC weights (sparse path)
+  float 		fc2_kernel_t[FC1_NBOUTPUT][FC2_NBOUTPUT]; 
+} LenetModel; 
+
+// Shared read-only model, one segment per NUMA node (shm.c), host only
+int  ShmCurrentNode(void); 
+void ShmSegmentName(char *segname, size_t size, const char *name, int node); 
+LenetModel *ShmOpenModel(const char *name, int node, int huge, int *created); 
+void ShmPublishModel(LenetModel *m); 
+void ShmCloseModel(LenetModel *m); 
+int  ShmUnlinkModel(const char *name, int node); 
+
+// Autotuned inference (tune.c): LenetAutotune loads or measures the configuration
+void TuneRun(LenetModel *m, float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, int batch, int verbose, TuneConfig *c); 
+int  LenetAutotune(const char *path, LenetModel *m, float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, int batch, 
+                   int verbose, TuneConfig *c); 
+void lenet_cnn_tuned(TuneConfig *c, LenetModel *m, float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], float output[FC2_NBOUTPUT]); 
+void lenet_cnn_tuned_batch(TuneConfig *c, LenetModel *m, float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, 
+                           float (*outputs)[FC2_NBOUTPUT]); 
+
+// Hot-swappable model versions (registry.c), host only: ModelLoad prepares a weight file
+// off the inference path and publishes it with one pointer exchange; readers bracket each
+// inference with ModelAcquire / ModelRelease (own slot each), the old version is freed
+// once no reader can still hold it. Counters are kept per version (ModelRecord).
+#ifndef MODEL_MAX_READERS
+#define MODEL_MAX_READERS	64		// reader slots, one cache line each
+#endif
+#ifndef MODEL_MAX_VERSIONS
+#define MODEL_MAX_VERSIONS	16		// versions whose counters are kept
+#endif
+#ifndef MODEL_WATCH_MS
+#define MODEL_WATCH_MS		500		// ModelWatch polling period
+#endif
+#define MODEL_NAME_SIZE		256
+#define MODEL_CURRENT		1
+#define MODEL_RETIRED		2		// replaced, waiting for its readers
+#define MODEL_FREED			3
+
+typedef struct {
+  LenetModel 	model; 
+  int 			id; 
+  char 			name[MODEL_NAME_SIZE]; 
+} ModelVersion; 
+
+typedef struct {
+  int 			id, state; 
+  char 			name[MODEL_NAME_SIZE]; 
+  double 		load_ms, grace_ms; 		// read + prepare, wait for the readers when replaced
+  unsigned long long inferences, ns_sum, ns_max, labelled, correct; 
+} ModelStats; 
+
+ModelVersion *ModelAcquire(int reader); 
+int  ModelRelease(int reader, ModelVersion *v); 
+void ModelRecord(int reader, int id, double us, int correct); 
+int  ModelPublish(LenetModel *m, const char *name); 
+int  ModelLoad(const char *path); 
+void ModelWatch(const char *path, int ms); 
+int  ModelVersions(ModelStats *s, int max, unsigned long *rejected); 
+void ModelPrintVersions(void); 
+void ModelRegistryFree(void); 
+
+#endif /* LENET_CNN_FLOAT_H_ */
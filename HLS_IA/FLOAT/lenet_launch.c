@@ -0,0 +1,155 @@
+/**
+  ******************************************************************************
+  * @file    lenet_launch.c
+  * @brief   Runs several lenet_cnn_float workers sharing one read-only model per NUMA node
+  * @brief   Workers are spread round-robin over the nodes, each pinned to one core of its
+  * @brief   node with its memory bound to that node, and started with -s <name>: the first
+  * @brief   worker of a node publishes the model segment, the others attach to it.
+  * @brief   Usage: lenet_launch [-n workers] [-s name] [-H] [-k] [-v] [-- lenet_cnn_float options]
+  * @brief   -k keeps the segments after the run, -v keeps the worker output.
+  */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "lenet_cnn_float.h"
+
+#define MAX_NODES		64
+#define MAX_WORKERS		256
+#define MAX_ARGS		64
+#define WORKER_PATH		"./lenet_cnn_float"
+
+static int 	node_id[MAX_NODES]; 			// sysfs node number
+static int 	node_cpus[MAX_NODES][CPU_SETSIZE]; 	// online cpus of each node
+static int 	node_ncpu[MAX_NODES];
+static int 	nnodes;
+
+/* Parses a sysfs cpulist ("0-3,8-11") */
+static int parse_cpulist(char *list, int *cpus) {
+  int n = 0, a, b;
+  char *p = list;
+
+  while (*p && *p != '\n') {
+    a = b = strtol(p, &p, 10);
+    if (*p == '-') b = strtol(p + 1, &p, 10);
+    for (; a <= b && n < CPU_SETSIZE; a++) cpus[n++] = a;
+    if (*p == ',') p++;
+  }
+  return n;
+}
+
+/* Nodes from /sys/devices/system/node, or a single node with every cpu */
+static void read_topology(void) {
+  char 	path[80], list[4096];
+  FILE 	*f;
+  int 	node, k;
+
+  nnodes = 0;
+  for (node = 0; node < MAX_NODES; node++) {
+    sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+    if (!(f = fopen(path, "r"))) continue;
+    if (fgets(list, sizeof(list), f)) {
+      node_ncpu[nnodes] = parse_cpulist(list, node_cpus[nnodes]);
+      if (node_ncpu[nnodes] > 0) node_id[nnodes++] = node;
+    }
+    fclose(f);
+  }
+  if (nnodes == 0) {
+    nnodes = 1;
+    node_ncpu[0] = sysconf(_SC_NPROCESSORS_ONLN);
+    for (k = 0; k < node_ncpu[0]; k++) node_cpus[0][k] = k;
+    node_id[0] = 0;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int 		nworkers = 2, huge = 0, keep = 0, verbose = 0;
+  char 		*name = "lenet_model";
+  char 		*wargv[MAX_ARGS + 8];
+  int 		wargc = 0, i, n, status, failed = 0;
+  pid_t 	pid[MAX_WORKERS];
+  struct timeval start, end;
+  double 	tdiff;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nworkers = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i+1 < argc) name = argv[++i];
+    else if (!strcmp(argv[i], "-H")) huge = 1;
+    else if (!strcmp(argv[i], "-k")) keep = 1;
+    else if (!strcmp(argv[i], "-v")) verbose = 1;
+    else if (!strcmp(argv[i], "--")) { i++; break; }
+    else {
+      printf("Usage: %s [-n workers] [-s name] [-H] [-k] [-v] [-- lenet_cnn_float options]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nworkers < 1) nworkers = 1;
+  if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+
+  wargv[wargc++] = WORKER_PATH;
+  for (; i < argc && wargc < MAX_ARGS; i++) wargv[wargc++] = argv[i];
+  wargv[wargc++] = "-s";
+  wargv[wargc++] = name;
+  if (huge) wargv[wargc++] = "-H";
+  wargv[wargc] = NULL;
+
+  read_topology();
+  printf("%d NUMA node(s), %d worker(s), model segment %s%s\n", nnodes, nworkers, name, huge ? " (huge pages)" : "");
+
+  gettimeofday(&start, NULL);
+  for (n = 0; n < nworkers; n++) {
+    int node_idx = n % nnodes;
+    int node = node_id[node_idx];
+    int cpu = node_cpus[node_idx][(n / nnodes) % node_ncpu[node_idx]];
+
+    pid[n] = fork();
+    if (pid[n] < 0) {
+      printf("Error: fork failed.\n");
+      exit(1);
+    }
+    if (pid[n] == 0) {
+      cpu_set_t set;
+      unsigned long nodemask = 1UL << node;
+
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        printf("Warning: worker %d could not be pinned to cpu %d\n", n, cpu);
+      // node-local scratch and stacks; the model pages are bound by the publisher
+      syscall(SYS_set_mempolicy, MPOL_BIND, &nodemask, sizeof(nodemask)*8);
+      if (!verbose) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, 1);
+        close(fd);
+      }
+      execv(WORKER_PATH, wargv);
+      printf("Error: Unable to run %s.\n", WORKER_PATH);
+      _exit(1);
+    }
+    printf("worker %d: pid %d, node %d, cpu %d\n", n, (int)pid[n], node, cpu);
+  }
+  for (n = 0; n < nworkers; n++) {
+    waitpid(pid[n], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+  }
+  gettimeofday(&end, NULL);
+  tdiff = (double)(end.tv_sec-start.tv_sec) + (double)(end.tv_usec-start.tv_usec)/1000000.0;
+
+  printf("Wall time %f s, %.0f img/s aggregate (%d x %d images), %d worker(s) failed\n",
+         tdiff, (double)nworkers * MNIST_TEST_SIZE / tdiff, nworkers, MNIST_TEST_SIZE, failed);
+  printf("Model copies in memory: %d x %lu KB (one per node), independent of the worker count\n",
+         nworkers < nnodes ? nworkers : nnodes, (unsigned long)sizeof(LenetModel) / 1024);
+
+  if (!keep)
+    for (n = 0; n < nnodes; n++) ShmUnlinkModel(name, node_id[n]);
+  return failed != 0;
+}
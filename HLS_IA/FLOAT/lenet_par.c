@@ -0,0 +1,95 @@
+/**
+  ******************************************************************************
+  * @file    lenet_par.c
+  * @brief   Low-latency LeNet: one inference split across the thread team (team.c)
+  * @brief   Conv1 / Conv2 output channels and Fc1 neurons are partitioned across the
+  * @brief   threads, layers are separated by team barriers. Each thread runs the
+  * @brief   channel-range kernels of conv.c / fc.c (*_range, same summation order) on
+  * @brief   its slice, and the pools use the global scale of pool.c, so the logits are
+  * @brief   bit-identical to lenet_cnn(). The activations live in a per-call ParState on
+  * @brief   the caller's stack. Host only, not for HLS.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lenet_cnn_float.h"
+
+typedef struct {
+  float 	(*input)[IMG_HEIGHT][IMG_WIDTH];
+  LenetWeights *w;
+  float 	*output;
+  float 	conv1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+  float 	pool1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float 	conv2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 	pool2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+  float 	fc1[FC1_NBOUTPUT];
+  float 	max_abs[TEAM_MAX]; 	// per-thread partial max for the pool scales
+} ParState;
+
+static void relu_n(float *p, int n) {
+  for (int i = 0; i < n; i++) p[i] = p[i] > 0.0f ? p[i] : 0.0f;
+}
+
+/* [begin, end) of thread id's share of n items */
+static inline void share(int n, int id, int nthreads, int *begin, int *end) {
+  *begin = n * id / nthreads;
+  *end = n * (id + 1) / nthreads;
+}
+
+static float reduce_max(ParState *s, int nthreads) {
+  float m = 0.0f;
+  for (int t = 0; t < nthreads; t++) if (s->max_abs[t] > m) m = s->max_abs[t];
+  return m;
+}
+
+static void lenet_job(void *arg, int id, int nthreads) {
+  ParState *s = arg;
+  LenetWeights *w = s->w;
+  int m0, m1;
+  float mx;
+
+  // Conv1 + ReLU, output channels [m0, m1)
+  share(CONV1_NBOUTPUT, id, nthreads, &m0, &m1);
+  Conv1_28x28x1_5x5x20_1_0_range(s->input, w->conv1_kernel, w->conv1_bias, m0, m1, s->conv1);
+  relu_n(&s->conv1[m0][0][0], (m1 - m0)*CONV1_HEIGHT*CONV1_WIDTH);
+  s->max_abs[id] = PoolMaxAbs(&s->conv1[m0][0][0], (m1 - m0)*CONV1_HEIGHT*CONV1_WIDTH);
+  TeamBarrier(id);
+
+  // Pool1 with the global scale, same channels
+  mx = reduce_max(s, nthreads);
+  PoolChannels((float *)s->conv1, CONV1_HEIGHT, CONV1_WIDTH, m0, m1, mx, (float *)s->pool1);
+  TeamBarrier(id);
+
+  // Conv2 + ReLU
+  share(CONV2_NBOUTPUT, id, nthreads, &m0, &m1);
+  Conv2_12x12x20_5x5x40_1_0_range(s->pool1, w->conv2_kernel, w->conv2_bias, POOL1_NBOUTPUT, m0, m1, s->conv2);
+  relu_n(&s->conv2[m0][0][0], (m1 - m0)*CONV2_HEIGHT*CONV2_WIDTH);
+  s->max_abs[id] = PoolMaxAbs(&s->conv2[m0][0][0], (m1 - m0)*CONV2_HEIGHT*CONV2_WIDTH);
+  TeamBarrier(id);
+
+  // Pool2
+  mx = reduce_max(s, nthreads);
+  PoolChannels((float *)s->conv2, CONV2_HEIGHT, CONV2_WIDTH, m0, m1, mx, (float *)s->pool2);
+  TeamBarrier(id);
+
+  // Fc1 + ReLU, neurons [m0, m1)
+  share(FC1_NBOUTPUT, id, nthreads, &m0, &m1);
+  Fc1_40_400_range(s->pool2, w->fc1_kernel, w->fc1_bias, POOL2_NBOUTPUT, m0, m1, s->fc1);
+  TeamBarrier(id);
+
+  // Fc2 is 4000 MACs: not worth another barrier, thread 0 alone
+  if (id == 0) Fc2_400_10(s->fc1, w->fc2_kernel, w->fc2_bias, s->output);
+}
+
+/* lenet_cnn() across the TeamInit threads (a team of 1 runs it serially); reentrant,
+   concurrent callers take turns on the team (TeamRun) */
+void lenet_cnn_parallel(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetWeights *w, float output[FC2_NBOUTPUT]) {
+  ParState s; 	// ~70 KB of stack
+
+  s.input = input;
+  s.w = w;
+  s.output = output;
+  TeamRun(lenet_job, &s);
+}
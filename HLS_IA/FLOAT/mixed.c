@@ -0,0 +1,313 @@
+/**
+  ******************************************************************************
+  * @file    mixed.c
+  * @brief   Per-layer mixed precision LeNet (host only)
+  * @brief   MixedPrepare converts every weighted layer to fp32, fp16, int16, int8 and
+  * @brief   int4 once, so that a MixedConfig picks the precision of each layer at no cost.
+  * @brief   Integer layers: symmetric per-row weight scales (max |w| / qmax), input
+  * @brief   tensor quantized per call with its max |x| (int16 activations for int16,
+  * @brief   int8 for int8 and int4), integer accumulation, then acc * w_scale * x_scale
+  * @brief   + bias. Convolutions gather each output pixel's patch ([c][ky][kx] order)
+  * @brief   and run the layer as rows of dot products. The all-fp32 configuration keeps
+  * @brief   lenet_cnn()'s summation order and is bit-identical to it.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lenet_cnn_float.h"
+
+#define CONV1_PATCH		(IMG_DEPTH * CONV1_DIM * CONV1_DIM)
+#define CONV2_PATCH		(POOL1_NBOUTPUT * CONV2_DIM * CONV2_DIM)
+
+static const char *PREC_NAMES[PREC_NB] = { "fp32", "fp16", "int16", "int8", "int4" };
+static const int 	PREC_QMAX[PREC_NB] = { 0, 0, 32767, 127, 7 };
+
+static float 	HALF_TABLE[65536]; 	// half bits -> float
+static int 		CONV1_INDEX[CONV1_HEIGHT*CONV1_WIDTH][CONV1_PATCH]; 	// patch element -> input offset
+static int 		CONV2_INDEX[CONV2_HEIGHT*CONV2_WIDTH][CONV2_PATCH];
+
+/* ---------------- fp16 ---------------- */
+
+static uint16_t float_to_half(float f) {
+  uint32_t 	x, sign, mant;
+  int 		exp;
+
+  memcpy(&x, &f, 4);
+  sign = (x >> 16) & 0x8000;
+  exp = (int)((x >> 23) & 0xff) - 127 + 15;
+  mant = x & 0x7fffff;
+  if (exp >= 31) return sign | 0x7c00; 				// overflow: inf
+  if (exp <= 0) { 									// subnormal or zero
+    if (exp < -10) return sign;
+    mant |= 0x800000;
+    uint32_t shift = 14 - exp, half = mant >> shift, rem = mant & ((1u << shift) - 1), mid = 1u << (shift - 1);
+    if (rem > mid || (rem == mid && (half & 1))) half++;
+    return sign | half;
+  }
+  uint32_t half = sign | (exp << 10) | (mant >> 13), rem = mant & 0x1fff; 	// round to nearest even
+  if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;
+  return half;
+}
+
+static float half_to_float(uint16_t h) {
+  uint32_t 	sign = (uint32_t)(h & 0x8000) << 16, exp = (h >> 10) & 0x1f, mant = h & 0x3ff, x;
+  float 	f;
+
+  if (exp == 0) { 									// subnormal: mant * 2^-24
+    f = mant * (1.0f / 16777216.0f);
+    return sign ? -f : f;
+  }
+  if (exp == 31) x = sign | 0x7f800000 | (mant << 13);
+  else x = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+  memcpy(&f, &x, 4);
+  return f;
+}
+
+/* ---------------- dot products, acc in lenet_cnn()'s order for fp32 ---------------- */
+
+static inline float dot_f32(const float *w, const float *x, int n, float acc) {
+  for (int i = 0; i < n; i++) acc += x[i] * w[i];
+  return acc;
+}
+
+static inline float dot_f16(const uint16_t *w, const float *x, int n, float acc) {
+  for (int i = 0; i < n; i++) acc += x[i] * HALF_TABLE[w[i]];
+  return acc;
+}
+
+static inline long long dot_i16(const int16_t *w, const int16_t *x, int n) {
+  long long acc = 0; 	// 640 products of 2^30 overflow int32
+  for (int i = 0; i < n; i++) acc += (int)w[i] * x[i];
+  return acc;
+}
+
+static inline int dot_i8(const int8_t *w, const int8_t *x, int n) {
+  int acc = 0;
+  for (int i = 0; i < n; i++) acc += (int)w[i] * x[i];
+  return acc;
+}
+
+// byte j: element j in the low nibble, element j + (n + 1) / 2 in the high one (both halves
+// contiguous, so the loop vectorizes)
+static inline int dot_i4(const uint8_t *w, const int8_t *x, int n) {
+  const int n4 = (n + 1) / 2;
+  int acc = 0, j;
+  for (j = 0; j < n - n4; j++) {
+    int8_t b = (int8_t)w[j];
+    acc += ((int8_t)(b << 4) >> 4) * x[j] + (b >> 4) * x[j + n4]; 	// sign-extended nibbles
+  }
+  if (j < n4) acc += ((int8_t)(w[j] << 4) >> 4) * x[j];
+  return acc;
+}
+
+/* all rows of l on one input vector x (float, int16 or int8 after quantize()), out[o * stride] */
+static void rows(MixedLayer *l, int prec, const void *x, float xscale, float *out, int stride) {
+  const int n = l->n, n4 = (n + 1) / 2;
+
+  for (int o = 0; o < l->nout; o++) {
+    switch (prec) {
+      case PREC_FP32: out[o * stride] = dot_f32(l->f32 + o * n, x, n, l->bias[o]); break;
+      case PREC_FP16: out[o * stride] = dot_f16(l->f16 + o * n, x, n, l->bias[o]); break;
+      case PREC_INT16: out[o * stride] = dot_i16(l->i16 + o * n, x, n) * l->scale[prec][o] * xscale + l->bias[o]; break;
+      case PREC_INT8: out[o * stride] = dot_i8(l->i8 + o * n, x, n) * l->scale[prec][o] * xscale + l->bias[o]; break;
+      default: out[o * stride] = dot_i4(l->i4 + o * n4, x, n) * l->scale[prec][o] * xscale + l->bias[o]; break;
+    }
+  }
+}
+
+/* input tensor for prec: as is (fp32 / fp16), or symmetric int16 / int8 with its max |x|, returns the scale */
+static float quantize(const float *x, int n, int prec, void *q) {
+  float 	m = 0.0f, a, s, inv;
+  int 		i, qmax = prec == PREC_INT16 ? 32767 : 127;
+
+  if (prec == PREC_FP32 || prec == PREC_FP16) {
+    memcpy(q, x, n * sizeof(float));
+    return 1.0f;
+  }
+  for (i = 0; i < n; i++) { a = fabsf(x[i]); if (a > m) m = a; }
+  if (m < 1e-8f) m = 1e-8f;
+  s = m / qmax;
+  inv = 1.0f / s;
+  for (i = 0; i < n; i++) {
+    int v = (int)lrintf(x[i] * inv);
+    if (v > qmax) v = qmax;
+    if (v < -qmax) v = -qmax;
+    if (prec == PREC_INT16) ((int16_t *)q)[i] = v;
+    else ((int8_t *)q)[i] = v;
+  }
+  return s;
+}
+
+/* patch of one output pixel, same element type as the quantized input */
+static void gather(const void *q, const int *index, int n, int prec, void *patch) {
+  int i;
+  if (prec == PREC_INT16) for (i = 0; i < n; i++) ((int16_t *)patch)[i] = ((const int16_t *)q)[index[i]];
+  else if (prec == PREC_INT8 || prec == PREC_INT4) for (i = 0; i < n; i++) ((int8_t *)patch)[i] = ((const int8_t *)q)[index[i]];
+  else for (i = 0; i < n; i++) ((float *)patch)[i] = ((const float *)q)[index[i]];
+}
+
+/* ---------------- layers ---------------- */
+
+void MixedConv1(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetMixed *m, int prec,
+                float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]) {
+  float 	q[IMG_DEPTH*IMG_HEIGHT*IMG_WIDTH], patch[CONV1_PATCH], s; 	// float-sized, holds any type
+  const int npix = CONV1_HEIGHT * CONV1_WIDTH;
+
+  s = quantize(&input[0][0][0], IMG_DEPTH*IMG_HEIGHT*IMG_WIDTH, prec, q);
+  for (int p = 0; p < npix; p++) {
+    gather(q, CONV1_INDEX[p], CONV1_PATCH, prec, patch);
+    rows(&m->layer[0], prec, patch, s, &output[0][0][p], npix);
+  }
+}
+
+void MixedConv2(float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], LenetMixed *m, int prec,
+                float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]) {
+  float 	q[POOL1_NBOUTPUT*POOL1_HEIGHT*POOL1_WIDTH], patch[CONV2_PATCH], s;
+  const int npix = CONV2_HEIGHT * CONV2_WIDTH;
+
+  s = quantize(&input[0][0][0], POOL1_NBOUTPUT*POOL1_HEIGHT*POOL1_WIDTH, prec, q);
+  for (int p = 0; p < npix; p++) {
+    gather(q, CONV2_INDEX[p], CONV2_PATCH, prec, patch);
+    rows(&m->layer[1], prec, patch, s, &output[0][0][p], npix);
+  }
+}
+
+// ReLU inside, as Fc1_40_400
+void MixedFc1(float input[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], LenetMixed *m, int prec, float output[FC1_NBOUTPUT]) {
+  float 	q[FC1_NBINPUT], s;
+
+  s = quantize(&input[0][0][0], FC1_NBINPUT, prec, q);
+  rows(&m->layer[2], prec, q, s, output, 1);
+  for (int o = 0; o < FC1_NBOUTPUT; o++) if (!(output[o] > 0.0f)) output[o] = 0.0f;
+}
+
+void MixedFc2(float input[FC1_NBOUTPUT], LenetMixed *m, int prec, float output[FC2_NBOUTPUT]) {
+  float 	q[FC1_NBOUTPUT], s;
+
+  s = quantize(input, FC1_NBOUTPUT, prec, q);
+  rows(&m->layer[3], prec, q, s, output, 1);
+}
+
+// Same graph as lenet_cnn(): ReLU, Pool1, ReLU, Pool2 in float between the mixed layers
+void lenet_cnn_mixed(float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], LenetMixed *m, MixedConfig *c, float output[FC2_NBOUTPUT]) {
+  float 	conv1_output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], pool1_output[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float 	conv2_output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], pool2_output[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+  float 	fc1_output[FC1_NBOUTPUT], *p;
+  int 		i;
+
+  MixedConv1(input, m, c->prec[0], conv1_output);
+  for (p = &conv1_output[0][0][0], i = 0; i < CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH; i++) if (!(p[i] > 0.0f)) p[i] = 0.0f;
+  Pool1_24x24x20_2x2x20_2_0(conv1_output, pool1_output);
+  MixedConv2(pool1_output, m, c->prec[1], conv2_output);
+  for (p = &conv2_output[0][0][0], i = 0; i < CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH; i++) if (!(p[i] > 0.0f)) p[i] = 0.0f;
+  Pool2_8x8x40_2x2x40_2_0(conv2_output, pool2_output);
+  MixedFc1(pool2_output, m, c->prec[2], fc1_output);
+  MixedFc2(fc1_output, m, c->prec[3], output);
+}
+
+/* ---------------- preparation and configurations ---------------- */
+
+static void prepare_layer(MixedLayer *l, const float *w, const float *bias, int nout, int n) {
+  int 		o, i, p, n4 = (n + 1) / 2;
+  float 	m, a;
+
+  l->nout = nout;
+  l->n = n;
+  l->f32 = malloc(nout * n * sizeof(float));
+  l->bias = malloc(nout * sizeof(float));
+  l->f16 = malloc(nout * n * sizeof(uint16_t));
+  l->i16 = malloc(nout * n * sizeof(int16_t));
+  l->i8 = malloc(nout * n);
+  l->i4 = calloc(nout * n4, 1);
+  for (p = 0; p < PREC_NB; p++) l->scale[p] = calloc(nout, sizeof(float));
+  if (!l->f32 || !l->bias || !l->f16 || !l->i16 || !l->i8 || !l->i4 || !l->scale[PREC_NB-1]) {
+    printf("Error: Unable to allocate the mixed-precision model.\n");
+    exit(1);
+  }
+  memcpy(l->f32, w, nout * n * sizeof(float));
+  memcpy(l->bias, bias, nout * sizeof(float));
+  for (i = 0; i < nout * n; i++) l->f16[i] = float_to_half(w[i]);
+
+  for (o = 0; o < nout; o++) {
+    for (m = 0.0f, i = 0; i < n; i++) { a = fabsf(w[o * n + i]); if (a > m) m = a; }
+    if (m < 1e-12f) m = 1e-12f;
+    for (p = PREC_INT16; p <= PREC_INT4; p++) {
+      float s = m / PREC_QMAX[p], inv = 1.0f / s;
+      l->scale[p][o] = s;
+      for (i = 0; i < n; i++) {
+        int v = (int)lrintf(w[o * n + i] * inv);
+        if (v > PREC_QMAX[p]) v = PREC_QMAX[p];
+        if (v < -PREC_QMAX[p]) v = -PREC_QMAX[p];
+        if (p == PREC_INT16) l->i16[o * n + i] = v;
+        else if (p == PREC_INT8) l->i8[o * n + i] = v;
+        else l->i4[o * n4 + i % n4] |= (uint8_t)((v & 0xf) << (i / n4 * 4));
+      }
+    }
+  }
+}
+
+void MixedPrepare(LenetWeights *w, LenetMixed *m) {
+  int y, x, c, ky, kx, k;
+
+  for (k = 0; k < 65536; k++) HALF_TABLE[k] = half_to_float(k);
+  for (y = 0; y < CONV1_HEIGHT; y++) for (x = 0; x < CONV1_WIDTH; x++)
+    for (k = 0, c = 0; c < IMG_DEPTH; c++) for (ky = 0; ky < CONV1_DIM; ky++) for (kx = 0; kx < CONV1_DIM; kx++)
+      CONV1_INDEX[y * CONV1_WIDTH + x][k++] = (c * IMG_HEIGHT + y + ky) * IMG_WIDTH + x + kx;
+  for (y = 0; y < CONV2_HEIGHT; y++) for (x = 0; x < CONV2_WIDTH; x++)
+    for (k = 0, c = 0; c < POOL1_NBOUTPUT; c++) for (ky = 0; ky < CONV2_DIM; ky++) for (kx = 0; kx < CONV2_DIM; kx++)
+      CONV2_INDEX[y * CONV2_WIDTH + x][k++] = (c * POOL1_HEIGHT + y + ky) * POOL1_WIDTH + x + kx;
+
+  prepare_layer(&m->layer[0], &w->conv1_kernel[0][0][0][0], w->conv1_bias, CONV1_NBOUTPUT, CONV1_PATCH);
+  prepare_layer(&m->layer[1], &w->conv2_kernel[0][0][0][0], w->conv2_bias, CONV2_NBOUTPUT, CONV2_PATCH);
+  prepare_layer(&m->layer[2], &w->fc1_kernel[0][0][0][0], w->fc1_bias, FC1_NBOUTPUT, FC1_NBINPUT);
+  prepare_layer(&m->layer[3], &w->fc2_kernel[0][0], w->fc2_bias, FC2_NBOUTPUT, FC1_NBOUTPUT);
+}
+
+void MixedFree(LenetMixed *m) {
+  for (int k = 0; k < MIXED_NB_LAYERS; k++) {
+    MixedLayer *l = &m->layer[k];
+    free(l->f32); free(l->bias); free(l->f16); free(l->i16); free(l->i8); free(l->i4);
+    for (int p = 0; p < PREC_NB; p++) free(l->scale[p]);
+  }
+  memset(m, 0, sizeof(*m));
+}
+
+const char *MixedPrecName(int prec) {
+  return prec >= 0 && prec < PREC_NB ? PREC_NAMES[prec] : "?";
+}
+
+/* "fp32-int8-int8-int4" -> c, 0 when malformed */
+int MixedParseConfig(const char *name, MixedConfig *c) {
+  char 		buf[MIXED_NAME_SIZE], *tok, *save;
+  int 		k = 0, p;
+
+  if (strlen(name) >= sizeof(buf)) return 0;
+  strcpy(buf, name);
+  for (tok = strtok_r(buf, "-", &save); tok; tok = strtok_r(NULL, "-", &save)) {
+    for (p = 0; p < PREC_NB && strcmp(tok, PREC_NAMES[p]); p++);
+    if (p == PREC_NB || k == MIXED_NB_LAYERS) return 0;
+    c->prec[k++] = p;
+  }
+  return k == MIXED_NB_LAYERS;
+}
+
+void MixedConfigName(MixedConfig *c, char name[MIXED_NAME_SIZE]) {
+  snprintf(name, MIXED_NAME_SIZE, "%s-%s-%s-%s", MixedPrecName(c->prec[0]), MixedPrecName(c->prec[1]),
+           MixedPrecName(c->prec[2]), MixedPrecName(c->prec[3]));
+}
+
+/* weight storage of a configuration (scales included) */
+long MixedWeightBytes(LenetMixed *m, MixedConfig *c) {
+  static const int bits[PREC_NB] = { 32, 16, 16, 8, 4 };
+  long bytes = 0;
+
+  for (int k = 0; k < MIXED_NB_LAYERS; k++) {
+    MixedLayer *l = &m->layer[k];
+    bytes += ((long)l->nout * l->n * bits[c->prec[k]] + 7) / 8 + l->nout * sizeof(float);
+    if (c->prec[k] >= PREC_INT16) bytes += l->nout * sizeof(float);
+  }
+  return bytes;
+}
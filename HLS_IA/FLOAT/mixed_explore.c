@@ -0,0 +1,216 @@
+/**
+  ******************************************************************************
+  * @file    mixed_explore.c
+  * @brief   Accuracy / latency Pareto explorer over the per-layer precisions (mixed.c)
+  * @brief   All PREC_NB^4 configurations are scored on the first -n test images in one
+  * @brief   depth-first pass per image (each Conv1 output feeds the PREC_NB Conv2 runs, and
+  * @brief   so on), and their latency is the sum of the measured per-layer, per-precision
+  * @brief   times. The Pareto frontier is then re-run end to end on the 10k test set
+  * @brief   (lenet_cnn_mixed, accuracy and us/image), and the fastest configuration
+  * @brief   within -e points of float lenet_cnn() is printed, runnable by name with
+  * @brief   lenet_cnn_float -x <name>.
+  * @brief   Usage: mixed_explore [-n screening_images] [-e budget_points] [-t timing_images]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+#define NB_CONFIGS	(PREC_NB * PREC_NB * PREC_NB * PREC_NB)
+
+static LenetWeights 	W;
+static LenetMixed 		M;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+static int 				CORRECT[NB_CONFIGS];
+static double 			LAYER_US[MIXED_NB_LAYERS][PREC_NB], GLUE_US; 	// glue: ReLU and pools
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (!(p[i] > 0.0f)) p[i] = 0.0f;
+}
+
+static void config(int id, MixedConfig *c) {
+  for (int k = MIXED_NB_LAYERS - 1; k >= 0; k--, id /= PREC_NB) c->prec[k] = id % PREC_NB;
+}
+
+static double latency(int id) {
+  MixedConfig c;
+  double us = GLUE_US;
+  config(id, &c);
+  for (int k = 0; k < MIXED_NB_LAYERS; k++) us += LAYER_US[k][c.prec[k]];
+  return us;
+}
+
+/* per-layer, per-precision time on the float activations of ntime images */
+static void time_layers(int ntime) {
+  static float c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  static float c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], p2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+  static float f1[FC1_NBOUTPUT], f2[FC2_NBOUTPUT];
+  double 	s, t[MIXED_NB_LAYERS][PREC_NB] = { { 0 } }, glue = 0;
+  int 		i, p;
+
+  for (i = 0; i < ntime; i++) {
+    for (p = PREC_NB - 1; p >= 0; p--) { s = now(); MixedConv1(IN[i], &M, p, c1); t[0][p] += now() - s; }
+    s = now();
+    relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(c1, p1);
+    glue += now() - s;
+    for (p = PREC_NB - 1; p >= 0; p--) { s = now(); MixedConv2(p1, &M, p, c2); t[1][p] += now() - s; }
+    s = now();
+    relu(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+    Pool2_8x8x40_2x2x40_2_0(c2, p2);
+    glue += now() - s;
+    for (p = PREC_NB - 1; p >= 0; p--) { s = now(); MixedFc1(p2, &M, p, f1); t[2][p] += now() - s; }
+    for (p = PREC_NB - 1; p >= 0; p--) { s = now(); MixedFc2(f1, &M, p, f2); t[3][p] += now() - s; }
+  }
+  for (i = 0; i < MIXED_NB_LAYERS; i++)
+    for (p = 0; p < PREC_NB; p++) LAYER_US[i][p] = t[i][p] / ntime * 1e6;
+  GLUE_US = glue / ntime * 1e6;
+}
+
+/* CORRECT[] of every configuration on image i, shared prefixes computed once */
+static void score(int i) {
+  float 	c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float 	c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], p2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+  float 	f1[FC1_NBOUTPUT], f2[FC2_NBOUTPUT];
+  int 		a, b, c, d;
+
+  for (a = 0; a < PREC_NB; a++) {
+    MixedConv1(IN[i], &M, a, c1);
+    relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(c1, p1);
+    for (b = 0; b < PREC_NB; b++) {
+      MixedConv2(p1, &M, b, c2);
+      relu(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+      Pool2_8x8x40_2x2x40_2_0(c2, p2);
+      for (c = 0; c < PREC_NB; c++) {
+        MixedFc1(p2, &M, c, f1);
+        for (d = 0; d < PREC_NB; d++) {
+          MixedFc2(f1, &M, d, f2);
+          CORRECT[((a * PREC_NB + b) * PREC_NB + c) * PREC_NB + d] += (argmax(f2) == LABELS[i]);
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  char 			img_filename[120], name[MIXED_NAME_SIZE];
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		ref[FC2_NBOUTPUT], out[FC2_NBOUTPUT], budget = 0.1f, acc, acc_ref;
+  int 			nscreen = 2000, ntime = 200, i, k, id, nfront = 0, best = -1, ok, mismatch = 0;
+  int 			order[NB_CONFIGS], front[NB_CONFIGS];
+  double 		s, us, us_ref, best_us = 0, best_acc = 0;
+  MixedConfig 	c;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i+1 < argc) nscreen = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-e") && i+1 < argc) budget = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i+1 < argc) ntime = atoi(argv[++i]);
+    else {
+      printf("Usage: %s [-n screening_images] [-e budget_points] [-t timing_images]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (nscreen < 1 || nscreen > MNIST_TEST_SIZE) nscreen = MNIST_TEST_SIZE;
+  if (ntime < 1 || ntime > MNIST_TEST_SIZE) ntime = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < MNIST_TEST_SIZE; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+  MixedPrepare(&W, &M);
+
+  // float reference, and the all-fp32 configuration must match it exactly
+  MixedParseConfig("fp32-fp32-fp32-fp32", &c);
+  s = now();
+  for (i = 0, ok = 0; i < MNIST_TEST_SIZE; i++) {
+    lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, ref);
+    ok += (argmax(ref) == LABELS[i]);
+    if (i < 100) {
+      lenet_cnn_mixed(IN[i], &M, &c, out);
+      mismatch += memcmp(ref, out, sizeof(out)) != 0;
+    }
+  }
+  us_ref = (now() - s) / MNIST_TEST_SIZE * 1e6;
+  acc_ref = 100.0f * ok / MNIST_TEST_SIZE;
+  if (mismatch) {
+    printf("Error: fp32-fp32-fp32-fp32 differs from lenet_cnn on %d / 100 images.\n", mismatch);
+    exit(1);
+  }
+
+  time_layers(ntime);
+  printf("Layer time (us, %d images) \t", ntime);
+  for (k = 0; k < PREC_NB; k++) printf("%8s", MixedPrecName(k));
+  printf("\n");
+  for (i = 0; i < MIXED_NB_LAYERS; i++) {
+    printf("  %-28s \t", i == 0 ? "Conv1" : i == 1 ? "Conv2" : i == 2 ? "Fc1" : "Fc2");
+    for (k = 0; k < PREC_NB; k++) printf("%8.1f", LAYER_US[i][k]);
+    printf("\n");
+  }
+  printf("  %-28s \t%8.1f\n\n", "ReLU + pools", GLUE_US);
+
+  printf("Screening %d configurations on %d images\n", NB_CONFIGS, nscreen);
+  s = now();
+  for (i = 0; i < nscreen; i++) score(i);
+  printf("  %.1f s\n\n", now() - s);
+
+  // Pareto frontier: by increasing latency, keep the configurations more accurate than all faster ones
+  for (id = 0; id < NB_CONFIGS; id++) order[id] = id;
+  for (i = 1; i < NB_CONFIGS; i++) 	// insertion sort on latency, then accuracy
+    for (k = i; k > 0 && (latency(order[k]) < latency(order[k-1]) ||
+                          (latency(order[k]) == latency(order[k-1]) && CORRECT[order[k]] > CORRECT[order[k-1]])); k--) {
+      id = order[k]; order[k] = order[k-1]; order[k-1] = id;
+    }
+  for (i = 0, ok = -1; i < NB_CONFIGS; i++)
+    if (CORRECT[order[i]] > ok) { ok = CORRECT[order[i]]; front[nfront++] = order[i]; }
+
+  printf("Pareto frontier (float lenet_cnn: %.2f%%, %.1f us/image on the 10k test set)\n", acc_ref, us_ref);
+  printf("%-24s \t screen \t est. us \t 10k acc \t us/image \t weights\n", "configuration");
+  for (i = 0; i < nfront; i++) {
+    config(front[i], &c);
+    MixedConfigName(&c, name);
+    s = now();
+    for (k = 0, ok = 0; k < MNIST_TEST_SIZE; k++) {
+      lenet_cnn_mixed(IN[k], &M, &c, out);
+      ok += (argmax(out) == LABELS[k]);
+    }
+    us = (now() - s) / MNIST_TEST_SIZE * 1e6;
+    acc = 100.0f * ok / MNIST_TEST_SIZE;
+    printf("%-24s \t %6.2f%% \t %7.1f \t %6.2f%% \t %8.1f \t %5ld KB\n", name, 100.0f * CORRECT[front[i]] / nscreen,
+           latency(front[i]), acc, us, MixedWeightBytes(&M, &c) / 1024);
+    if (acc >= acc_ref - budget && (best < 0 || us < best_us)) { best = front[i]; best_us = us; best_acc = acc; }
+  }
+
+  if (best < 0) printf("\nNo frontier configuration within %.2f points of float.\n", budget);
+  else {
+    config(best, &c);
+    MixedConfigName(&c, name);
+    printf("\nFastest within %.2f points of float: %s (%.2f%%, %.1f us/image, x%.2f)\n", budget, name, best_acc, best_us, us_ref / best_us);
+    printf("Run it with: lenet_cnn_float -x %s\n", name);
+  }
+  MixedFree(&M);
+  return 0;
+}
@@ -34,7 +34,7 @@ void Pool1_24x24x20_2x2x20_2_0(
     const float sx = maxabs_f(&input[0][0][0], n_in) / 127.0f;
     const float inv_sx = 1.0f / sx;
 
-    static int8_t in_q[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
+    int8_t in_q[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH];
 #pragma HLS ARRAY_PARTITION variable=in_q complete dim=1
 
     // quantize input to int8
@@ -85,7 +85,7 @@ void Pool2_8x8x40_2x2x40_2_0(
     const float sx = maxabs_f(&input[0][0][0], n_in) / 127.0f;
     const float inv_sx = 1.0f / sx;
 
-    static int8_t in_q[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+    int8_t in_q[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
 #pragma HLS ARRAY_PARTITION variable=in_q complete dim=1
 
     // quantize input to int8
@@ -124,3 +124,41 @@ void Pool2_8x8x40_2x2x40_2_0(
         }
     }
 }
+
+// ---------------------------------------------------------------------------
+// Channel-range pieces of the same pooling, for callers that split the channels
+// across threads: PoolMaxAbs over each range, max of the partial results, then
+// PoolChannels with that global max. Same arithmetic as Pool1 / Pool2.
+// ---------------------------------------------------------------------------
+
+float PoolMaxAbs(const float *input, int n){
+    float m = 0.0f;
+    for (int i=0;i<n;i++){
+        float a = input[i]; if (a < 0) a = -a;
+        if (a > m) m = a;
+    }
+    return m;
+}
+
+// input [c][H][W] -> output [c][H/2][W/2] for c in [c0, c1)
+void PoolChannels(const float *input, int H, int W, int c0, int c1, float max_abs, float *output){
+    const float sx = (max_abs < 1e-8f ? 1e-8f : max_abs) / 127.0f;
+    const float inv_sx = 1.0f / sx;
+    const int OH = H / 2, OW = W / 2;
+
+    for (int c = c0; c < c1; c++){
+        for (int y = 0; y < OH; y++){
+            for (int x = 0; x < OW; x++){
+                int m = -128;
+                for (int ky = 0; ky < 2; ky++){
+                    for (int kx = 0; kx < 2; kx++){
+                        int v = (int)lrintf(input[((long)c*H + 2*y+ky)*W + 2*x+kx] * inv_sx);
+                        v = clamp_i8(v);
+                        if (v > m) m = v;
+                    }
+                }
+                output[((long)c*OH + y)*OW + x] = (float)((int8_t)m) * sx;
+            }
+        }
+    }
+}
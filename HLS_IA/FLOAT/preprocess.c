@@ -0,0 +1,190 @@
+/**
+  ******************************************************************************
+  * @file    preprocess.c
+  * @brief   Fused decode -> resize -> normalize stage for arbitrary input sizes
+  * @brief   PGM (P2/P5) or raw 8-bit buffers, nearest or bilinear resize to
+  * @brief   IMG_WIDTH x IMG_HEIGHT through index tables built once per source size,
+  * @brief   normalization folded into the resize weights (or a 256-entry LUT).
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lenet_cnn_float.h"
+
+/* ---------------- In-memory PGM decoding ---------------- */
+
+static unsigned char *skip_blanks(unsigned char *p, unsigned char *end) {
+  while (p < end) {
+    if (*p == '#') { while (p < end && *p != '\n') p++; }
+    else if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    else break;
+  }
+  return p;
+}
+
+static unsigned char *read_uint(unsigned char *p, unsigned char *end, int *v) {
+  int n = 0, digits = 0;
+
+  p = skip_blanks(p, end);
+  while (p < end && *p >= '0' && *p <= '9' && digits < 6) { n = n*10 + (*p - '0'); p++; digits++; }
+  *v = digits ? n : -1;
+  return p;
+}
+
+/* Parses a PGM held in memory. P5 pixels are used in place (img->pix points into buf),
+   P2 pixels are decoded into scratch (scratch_size bytes). Returns 0, or -1 if malformed. */
+int DecodePgm(unsigned char *buf, long len, unsigned char *scratch, long scratch_size, PgmImage *img) {
+  unsigned char *p = buf, *end = buf + len;
+  int width, height, maxval, v, i, binary;
+
+  if (len < 2 || p[0] != 'P' || (p[1] != '2' && p[1] != '5')) return -1;
+  binary = (p[1] == '5');
+  p = read_uint(p + 2, end, &width);
+  p = read_uint(p, end, &height);
+  p = read_uint(p, end, &maxval);
+  if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 255 || width > PREPROC_MAX_DIM || height > PREPROC_MAX_DIM) return -1;
+
+  img->width = width;
+  img->height = height;
+  img->maxval = maxval;
+  if (binary) {
+    p++; // single whitespace after maxval
+    if (end - p < (long)width*height) return -1;
+    img->pix = p;
+  }
+  else {
+    if (scratch_size < (long)width*height) return -1;
+    for (i = 0; i < width*height; i++) {
+      p = read_uint(p, end, &v);
+      if (v < 0) return -1;
+      scratch[i] = (unsigned char)(v > maxval ? maxval : v);
+    }
+    img->pix = scratch;
+  }
+  return 0;
+}
+
+/* Wraps a raw 8-bit buffer (no header) */
+void RawImage(unsigned char *pix, short width, short height, PgmImage *img) {
+  img->pix = pix;
+  img->width = width;
+  img->height = height;
+  img->maxval = 255;
+}
+
+/* ---------------- Resize + normalize ---------------- */
+
+/* Index/weight tables for one source size. Nearest uses the RescaleImg mapping,
+   bilinear maps pixel centres. The 1/maxval normalization is folded into wy (bilinear)
+   or into lut (nearest). */
+void PreprocPlanInit(PreprocPlan *p, short width, short height, short maxval, int mode) {
+  int i;
+
+  p->width = width;
+  p->height = height;
+  p->maxval = maxval;
+  p->mode = mode;
+  for (i = 0; i < 256; i++) p->lut[i] = (float)i / maxval; // same rounding as NormalizeImg
+
+  for (i = 0; i < IMG_WIDTH; i++) {
+    if (mode == PREPROC_NEAREST) {
+      short s = (short)( ((float)i/(float)IMG_WIDTH)*(float)width + 0.5 );
+      p->x0[i] = p->x1[i] = s < width-1 ? s : width-1;
+      p->wx[i] = 0.0f;
+    }
+    else {
+      float s = ((float)i + 0.5f) * width / IMG_WIDTH - 0.5f;
+      if (s < 0) s = 0;
+      p->x0[i] = (short)s;
+      p->x1[i] = p->x0[i] + 1 < width ? p->x0[i] + 1 : width - 1;
+      p->wx[i] = s - p->x0[i];
+    }
+  }
+  for (i = 0; i < IMG_HEIGHT; i++) {
+    if (mode == PREPROC_NEAREST) {
+      short s = (short)( ((float)i/(float)IMG_HEIGHT)*(float)height + 0.5 );
+      p->y0[i] = p->y1[i] = s < height-1 ? s : height-1;
+      p->wy[i] = 0.0f;
+    }
+    else {
+      float s = ((float)i + 0.5f) * height / IMG_HEIGHT - 0.5f;
+      if (s < 0) s = 0;
+      p->y0[i] = (short)s;
+      p->y1[i] = p->y0[i] + 1 < height ? p->y0[i] + 1 : height - 1;
+      p->wy[i] = s - p->y0[i];
+    }
+  }
+}
+
+static void replan(PreprocPlan *p, PgmImage *img, int mode) {
+  if (p->width != img->width || p->height != img->height || p->maxval != img->maxval || p->mode != mode)
+    PreprocPlanInit(p, img->width, img->height, img->maxval, mode);
+}
+
+/* One pass from source pixels to the Conv1 input layout [IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH],
+   normalized to [0,1]. Tables are rebuilt only when the source size changes. */
+void PreprocessImg(PreprocPlan *p, PgmImage *img, int mode, float output[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]) {
+  int x, y;
+
+  replan(p, img, mode);
+
+  if (img->width == IMG_WIDTH && img->height == IMG_HEIGHT) { // no resize, LUT normalize
+    const unsigned char *src = img->pix;
+    float *dst = &output[0][0][0];
+    for (x = 0; x < IMG_WIDTH*IMG_HEIGHT; x++) dst[x] = p->lut[src[x]];
+    return;
+  }
+
+  if (mode == PREPROC_NEAREST) {
+    for (y = 0; y < IMG_HEIGHT; y++) {
+      const unsigned char *row = img->pix + (long)p->y0[y] * img->width;
+      for (x = 0; x < IMG_WIDTH; x++)
+        output[0][y][x] = p->lut[row[p->x0[x]]];
+    }
+    return;
+  }
+
+  // bilinear: horizontal gather into two float rows, then a vectorizable vertical blend
+  {
+    const float norm = 1.0f / img->maxval;
+    float h0[IMG_WIDTH], h1[IMG_WIDTH];
+    for (y = 0; y < IMG_HEIGHT; y++) {
+      const unsigned char *r0 = img->pix + (long)p->y0[y] * img->width;
+      const unsigned char *r1 = img->pix + (long)p->y1[y] * img->width;
+      const float wy1 = p->wy[y] * norm, wy0 = norm - wy1;
+      for (x = 0; x < IMG_WIDTH; x++) {
+        const float wx1 = p->wx[x], wx0 = 1.0f - wx1;
+        h0[x] = r0[p->x0[x]] * wx0 + r0[p->x1[x]] * wx1;
+        h1[x] = r1[p->x0[x]] * wx0 + r1[p->x1[x]] * wx1;
+      }
+      for (x = 0; x < IMG_WIDTH; x++)
+        output[0][y][x] = h0[x] * wy0 + h1[x] * wy1;
+    }
+  }
+}
+
+/* Same stage for the raw uint8 Conv1 input (lenet_cnn_u8 / lenet_cnn_int8_u8): resized pixels,
+   rescaled to 0..255 only when maxval != 255 */
+void PreprocessImgU8(PreprocPlan *p, PgmImage *img, int mode, unsigned char output[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH]) {
+  int x, y;
+
+  replan(p, img, mode);
+
+  for (y = 0; y < IMG_HEIGHT; y++) {
+    const unsigned char *r0 = img->pix + (long)p->y0[y] * img->width;
+    const unsigned char *r1 = img->pix + (long)p->y1[y] * img->width;
+    for (x = 0; x < IMG_WIDTH; x++) {
+      float v;
+      if (mode == PREPROC_NEAREST) v = r0[p->x0[x]];
+      else {
+        const float wx1 = p->wx[x], wy1 = p->wy[y];
+        v = (r0[p->x0[x]] * (1.0f - wx1) + r0[p->x1[x]] * wx1) * (1.0f - wy1)
+          + (r1[p->x0[x]] * (1.0f - wx1) + r1[p->x1[x]] * wx1) * wy1;
+      }
+      if (img->maxval != 255) v = v * 255.0f / img->maxval;
+      output[0][y][x] = (unsigned char)(v + 0.5f);
+    }
+  }
+}
@@ -0,0 +1,247 @@
+/**
+  ******************************************************************************
+  * @file    prune.c
+  * @brief   Offline tool: structured channel pruning of Conv1 / Conv2 with model compaction
+  * @brief   Filters are ranked by importance, either the L1 norm of the filter (-m l1) or
+  * @brief   its contribution over calibration images (-m act, default): mean ReLU output
+  * @brief   of the channel times the L1 norm of the weights that read it (Conv2 input
+  * @brief   slice for a Conv1 channel, Fc1 input slice for a Conv2 channel).
+  * @brief   -k n1,n2 keeps the n1 / n2 most important channels. Otherwise channels are
+  * @brief   removed greedily, least important first, taking at each step the layer whose
+  * @brief   next removal costs the least accuracy on -n images, as long as the drop stays
+  * @brief   within -e points of the full model. The pruned model (LenetPruned, compacted
+  * @brief   Conv2 / Fc1 input slices) is written for lenet_cnn_float -p and checked on the
+  * @brief   10k test set.
+  * @brief   Usage: prune [-m l1|act] [-k n1,n2] [-e budget_points] [-n search_images]
+  * @brief                [-c calib_images] [-o lenet_pruned.bin]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+static LenetWeights 	W;
+static LenetPruned 		P;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+static float 			IMP1[CONV1_NBOUTPUT], IMP2[CONV2_NBOUTPUT];
+static int 				RANK1[CONV1_NBOUTPUT], RANK2[CONV2_NBOUTPUT]; 	// most important first
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static float absf(float x) { return x < 0 ? -x : x; }
+
+static void relu(float *p, int n) {
+  for (int i = 0; i < n; i++) if (p[i] < 0.0f) p[i] = 0.0f;
+}
+
+/* Channel importance, IMP1 / IMP2 */
+static void importance(int by_activation, int ncalib) {
+  float c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  double act1[CONV1_NBOUTPUT] = { 0 }, act2[CONV2_NBOUTPUT] = { 0 }, out1, out2;
+  int i, m, c, y, x, o;
+
+  for (m = 0; m < CONV1_NBOUTPUT; m++)
+    for (IMP1[m] = 0, y = 0; y < CONV1_DIM; y++) for (x = 0; x < CONV1_DIM; x++) IMP1[m] += absf(W.conv1_kernel[m][0][y][x]);
+  for (m = 0; m < CONV2_NBOUTPUT; m++)
+    for (IMP2[m] = 0, c = 0; c < POOL1_NBOUTPUT; c++)
+      for (y = 0; y < CONV2_DIM; y++) for (x = 0; x < CONV2_DIM; x++) IMP2[m] += absf(W.conv2_kernel[m][c][y][x]);
+  if (!by_activation) return;
+
+  for (i = 0; i < ncalib; i++) {
+    Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, c1);
+    relu(&c1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    for (m = 0; m < CONV1_NBOUTPUT; m++) for (y = 0; y < CONV1_HEIGHT; y++) for (x = 0; x < CONV1_WIDTH; x++) act1[m] += c1[m][y][x];
+    Pool1_24x24x20_2x2x20_2_0(c1, p1);
+    Conv2_12x12x20_5x5x40_1_0(p1, W.conv2_kernel, W.conv2_bias, c2);
+    relu(&c2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+    for (m = 0; m < CONV2_NBOUTPUT; m++) for (y = 0; y < CONV2_HEIGHT; y++) for (x = 0; x < CONV2_WIDTH; x++) act2[m] += c2[m][y][x];
+  }
+  for (m = 0; m < CONV1_NBOUTPUT; m++) {
+    for (out1 = 0, o = 0; o < CONV2_NBOUTPUT; o++)
+      for (y = 0; y < CONV2_DIM; y++) for (x = 0; x < CONV2_DIM; x++) out1 += absf(W.conv2_kernel[o][m][y][x]);
+    IMP1[m] = act1[m] / ncalib * out1;
+  }
+  for (m = 0; m < CONV2_NBOUTPUT; m++) {
+    for (out2 = 0, o = 0; o < FC1_NBOUTPUT; o++)
+      for (y = 0; y < POOL2_HEIGHT; y++) for (x = 0; x < POOL2_WIDTH; x++) out2 += absf(W.fc1_kernel[o][m][y][x]);
+    IMP2[m] = act2[m] / ncalib * out2;
+  }
+}
+
+static void rank_channels(float *imp, int n, int *rank) {
+  int i, j, t;
+  for (i = 0; i < n; i++) rank[i] = i;
+  for (i = 1; i < n; i++) 	// insertion sort, descending importance
+    for (j = i; j > 0 && imp[rank[j]] > imp[rank[j-1]]; j--) { t = rank[j]; rank[j] = rank[j-1]; rank[j-1] = t; }
+}
+
+/* P = W restricted to the n1 / n2 most important channels, kept in their original order */
+static void compact(int n1, int n2) {
+  int keep1[CONV1_NBOUTPUT], keep2[CONV2_NBOUTPUT], i, j, o, t;
+
+  memcpy(keep1, RANK1, sizeof(keep1));
+  memcpy(keep2, RANK2, sizeof(keep2));
+  for (i = 1; i < n1; i++) for (j = i; j > 0 && keep1[j] < keep1[j-1]; j--) { t = keep1[j]; keep1[j] = keep1[j-1]; keep1[j-1] = t; }
+  for (i = 1; i < n2; i++) for (j = i; j > 0 && keep2[j] < keep2[j-1]; j--) { t = keep2[j]; keep2[j] = keep2[j-1]; keep2[j-1] = t; }
+
+  memset(&P, 0, sizeof(P));
+  P.nb_conv1 = n1;
+  P.nb_conv2 = n2;
+  for (i = 0; i < n1; i++) {
+    P.conv1_index[i] = keep1[i];
+    memcpy(P.w.conv1_kernel[i], W.conv1_kernel[keep1[i]], sizeof(W.conv1_kernel[0]));
+    P.w.conv1_bias[i] = W.conv1_bias[keep1[i]];
+  }
+  for (i = 0; i < n2; i++) {
+    P.conv2_index[i] = keep2[i];
+    for (j = 0; j < n1; j++) memcpy(P.w.conv2_kernel[i][j], W.conv2_kernel[keep2[i]][keep1[j]], sizeof(W.conv2_kernel[0][0]));
+    P.w.conv2_bias[i] = W.conv2_bias[keep2[i]];
+  }
+  for (o = 0; o < FC1_NBOUTPUT; o++)
+    for (i = 0; i < n2; i++) memcpy(P.w.fc1_kernel[o][i], W.fc1_kernel[o][keep2[i]], sizeof(W.fc1_kernel[0][0]));
+  memcpy(P.w.fc1_bias, W.fc1_bias, sizeof(W.fc1_bias));
+  memcpy(P.w.fc2_kernel, W.fc2_kernel, sizeof(W.fc2_kernel));
+  memcpy(P.w.fc2_bias, W.fc2_bias, sizeof(W.fc2_bias));
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+/* accuracy (%) of P on the first n images */
+static float accuracy(int n) {
+  float out[FC2_NBOUTPUT];
+  int i, ok = 0;
+  for (i = 0; i < n; i++) {
+    lenet_cnn_pruned(IN[i], &P, out);
+    ok += (argmax(out) == LABELS[i]);
+  }
+  return 100.0f * ok / n;
+}
+
+static long macs(int n1, int n2) {
+  return (long)n1*CONV1_HEIGHT*CONV1_WIDTH*IMG_DEPTH*CONV1_DIM*CONV1_DIM + (long)n2*CONV2_HEIGHT*CONV2_WIDTH*n1*CONV2_DIM*CONV2_DIM
+         + (long)FC1_NBOUTPUT*n2*POOL2_HEIGHT*POOL2_WIDTH + FC2_NBOUTPUT*FC1_NBOUTPUT;
+}
+
+static long params(int n1, int n2) {
+  return (long)n1*(IMG_DEPTH*CONV1_DIM*CONV1_DIM + 1) + (long)n2*(n1*CONV2_DIM*CONV2_DIM + 1)
+         + (long)FC1_NBOUTPUT*(n2*POOL2_HEIGHT*POOL2_WIDTH + 1) + FC2_NBOUTPUT*(FC1_NBOUTPUT + 1);
+}
+
+int main(int argc, char *argv[]) {
+  char 		*out_filename = "lenet_pruned.bin", img_filename[120], *method = "act";
+  float 	budget = 0.2f, acc_full, acc_search, a1, a2, acc;
+  int 		n1 = 0, n2 = 0, nsearch = 1000, ncalib = 500, i, k, mismatch = 0;
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 	ref[FC2_NBOUTPUT], out[FC2_NBOUTPUT];
+  double 	t_full, t_pruned;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-m") && i+1 < argc) method = argv[++i];
+    else if (!strcmp(argv[i], "-k") && i+1 < argc && sscanf(argv[i+1], "%d,%d", &n1, &n2) == 2) i++;
+    else if (!strcmp(argv[i], "-e") && i+1 < argc) budget = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i+1 < argc) nsearch = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) ncalib = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-o") && i+1 < argc) out_filename = argv[++i];
+    else {
+      printf("Usage: %s [-m l1|act] [-k n1,n2] [-e budget_points] [-n search_images] [-c calib_images] [-o lenet_pruned.bin]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (strcmp(method, "l1") && strcmp(method, "act")) {
+    printf("Error: Unknown importance method %s (l1 or act).\n", method);
+    exit(1);
+  }
+  if ((n1 || n2) && (n1 < 1 || n1 > CONV1_NBOUTPUT || n2 < 1 || n2 > CONV2_NBOUTPUT)) {
+    printf("Error: -k needs 1 <= n1 <= %d and 1 <= n2 <= %d.\n", CONV1_NBOUTPUT, CONV2_NBOUTPUT);
+    exit(1);
+  }
+  if (nsearch < 1 || nsearch > MNIST_TEST_SIZE) nsearch = MNIST_TEST_SIZE;
+  if (ncalib < 1 || ncalib > MNIST_TEST_SIZE) ncalib = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < MNIST_TEST_SIZE; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+
+  importance(!strcmp(method, "act"), ncalib);
+  rank_channels(IMP1, CONV1_NBOUTPUT, RANK1);
+  rank_channels(IMP2, CONV2_NBOUTPUT, RANK2);
+  printf("Importance (%s), least important first:\n  Conv1:", method);
+  for (i = CONV1_NBOUTPUT-1; i >= 0; i--) printf(" %d", RANK1[i]);
+  printf("\n  Conv2:");
+  for (i = CONV2_NBOUTPUT-1; i >= 0; i--) printf(" %d", RANK2[i]);
+  printf("\n\n");
+
+  // the unpruned compaction must reproduce lenet_cnn() exactly
+  compact(CONV1_NBOUTPUT, CONV2_NBOUTPUT);
+  for (i = 0; i < 100; i++) {
+    lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, ref);
+    lenet_cnn_pruned(IN[i], &P, out);
+    if (memcmp(ref, out, sizeof(out))) mismatch++;
+  }
+  if (mismatch) {
+    printf("Error: Unpruned lenet_cnn_pruned differs from lenet_cnn on %d / 100 images.\n", mismatch);
+    exit(1);
+  }
+  acc_full = accuracy(MNIST_TEST_SIZE);
+  acc_search = nsearch == MNIST_TEST_SIZE ? acc_full : accuracy(nsearch);
+
+  if (!n1) {
+    // greedy: drop the next channel of the layer that loses the least, while within the budget
+    printf("Greedy search on %d images (full model %.2f%%, budget %.2f points)\n", nsearch, acc_search, budget);
+    printf("conv1 \t conv2 \t accuracy\n");
+    n1 = CONV1_NBOUTPUT;
+    n2 = CONV2_NBOUTPUT;
+    while (1) {
+      a1 = a2 = -1.0f;
+      if (n1 > 1) { compact(n1 - 1, n2); a1 = accuracy(nsearch); }
+      if (n2 > 1) { compact(n1, n2 - 1); a2 = accuracy(nsearch); }
+      acc = a1 > a2 ? a1 : a2;
+      if (acc < acc_search - budget) break;
+      if (a1 > a2) n1--; else n2--;
+      printf("%3d \t %3d \t %6.2f%%\n", n1, n2, acc);
+    }
+  }
+  compact(n1, n2);
+  WriteLenetPruned(out_filename, &P);
+
+  // 10k test set: accuracy and time, full vs pruned
+  t_full = now();
+  for (i = 0, k = 0; i < MNIST_TEST_SIZE; i++) {
+    lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+              W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, out);
+    k += (argmax(out) == LABELS[i]);
+  }
+  t_full = now() - t_full;
+  t_pruned = now();
+  acc = accuracy(MNIST_TEST_SIZE);
+  t_pruned = now() - t_pruned;
+
+  printf("\n\t\t channels \t accuracy \t MACs \t\t params \t us/image\n");
+  printf("Full \t\t %2d, %2d \t %6.2f%% \t %7ld \t %7ld \t %7.1f\n", CONV1_NBOUTPUT, CONV2_NBOUTPUT, 100.0f*k/MNIST_TEST_SIZE,
+         macs(CONV1_NBOUTPUT, CONV2_NBOUTPUT), params(CONV1_NBOUTPUT, CONV2_NBOUTPUT), t_full/MNIST_TEST_SIZE*1e6);
+  printf("Pruned \t\t %2d, %2d \t %6.2f%% \t %7ld \t %7ld \t %7.1f \t (x%.2f MACs, x%.2f time)\n", n1, n2, acc,
+         macs(n1, n2), params(n1, n2), t_pruned/MNIST_TEST_SIZE*1e6, (double)macs(CONV1_NBOUTPUT, CONV2_NBOUTPUT)/macs(n1, n2), t_full/t_pruned);
+  printf("\nPruned model written to %s\n", out_filename);
+  return 0;
+}
@@ -0,0 +1,311 @@
+/**
+  ******************************************************************************
+  * @file    registry.c
+  * @brief   Hot-swappable model versions (RCU-style), host only
+  * @brief   The current version is one pointer. ModelLoad reads and prepares a weight file
+  * @brief   (FoldInputScale, FC transposes) off the inference path, checks it, then
+  * @brief   publishes it with an atomic exchange: inferences already running finish on the
+  * @brief   old version, new ones get the new one. Readers mark their critical section with
+  * @brief   the global epoch in their own slot (ModelAcquire / ModelRelease); after the
+  * @brief   exchange the publisher bumps the epoch and waits until every slot is idle or
+  * @brief   newer (grace period), then frees the old version. Counters (inferences,
+  * @brief   latency, accuracy on labelled inputs) are kept per version and outlive the
+  * @brief   model, so versions can be compared live (ModelVersions). ModelWatch reloads a
+  * @brief   file on a background thread when it changes. Not for HLS.
+  */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "hdf5.h"
+
+#include "lenet_cnn_float.h"
+
+typedef struct {
+  volatile unsigned long 	epoch; 		// 0: not in a critical section
+  char 						pad[56]; 	// one cache line per reader
+} ReaderSlot;
+
+static ModelVersion 		*current;
+static volatile unsigned long epoch = 1;
+static ReaderSlot 			reader[MODEL_MAX_READERS];
+static ModelStats 			stats[MODEL_MAX_VERSIONS]; 	// ring, by version id
+static int 					last_id;
+static pthread_mutex_t 		publish_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long 		rejected; 	// atomic
+
+static pthread_t 			watch_tid;
+static volatile int 		watch_stop, watching;
+static char 				watch_path[MODEL_NAME_SIZE];
+static int 					watch_ms;
+
+static double now_ms(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static ModelStats *stats_of(int id) {
+  return &stats[id % MODEL_MAX_VERSIONS];
+}
+
+/* ---------------- readers ---------------- */
+
+ModelVersion *ModelAcquire(int r) {
+  __atomic_store_n(&reader[r].epoch, __atomic_load_n(&epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+}
+
+/* ends reader r's critical section; -1 if v was freed meanwhile (grace period violated) */
+int ModelRelease(int r, ModelVersion *v) {
+  int freed = __atomic_load_n(&stats_of(v->id)->state, __ATOMIC_ACQUIRE) == MODEL_FREED;
+  __atomic_store_n(&reader[r].epoch, 0, __ATOMIC_RELEASE);
+  return freed ? -1 : 0;
+}
+
+/* one inference of version id on reader r: latency in us, correct 1 / 0, or -1 without a label.
+   Counts under r's slot (or its current section), so that publish cannot clear the stats slot
+   meanwhile; dropped once the slot has been handed to version id + MODEL_MAX_VERSIONS. */
+void ModelRecord(int r, int id, double us, int correct) {
+  ModelStats 		*s = stats_of(id);
+  unsigned long long ns = (unsigned long long)(us * 1e3), old;
+  int 				held = __atomic_load_n(&reader[r].epoch, __ATOMIC_RELAXED) != 0;
+
+  if (!held) __atomic_store_n(&reader[r].epoch, __atomic_load_n(&epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&s->id, __ATOMIC_SEQ_CST) != id) {
+    if (!held) __atomic_store_n(&reader[r].epoch, 0, __ATOMIC_RELEASE);
+    return;
+  }
+  __atomic_fetch_add(&s->inferences, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&s->ns_sum, ns, __ATOMIC_RELAXED);
+  old = __atomic_load_n(&s->ns_max, __ATOMIC_RELAXED);
+  while (ns > old && !__atomic_compare_exchange_n(&s->ns_max, &old, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) ;
+  if (correct >= 0) {
+    __atomic_fetch_add(&s->labelled, 1, __ATOMIC_RELAXED);
+    if (correct) __atomic_fetch_add(&s->correct, 1, __ATOMIC_RELAXED);
+  }
+  if (!held) __atomic_store_n(&reader[r].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* ---------------- publication ---------------- */
+
+/* waits until every reader is idle or entered after the epoch bump */
+static void synchronize(void) {
+  struct timespec 	pause = { 0, 100000 }; 	// 100 us
+  unsigned long 	e = __atomic_add_fetch(&epoch, 1, __ATOMIC_SEQ_CST), re;
+  int 				r;
+
+  for (r = 0; r < MODEL_MAX_READERS; r++)
+    while ((re = __atomic_load_n(&reader[r].epoch, __ATOMIC_SEQ_CST)) != 0 && re < e)
+      nanosleep(&pause, NULL);
+}
+
+/* v prepared and counted: make it current, retire and free the previous version */
+static int publish(ModelVersion *v, double load_ms) {
+  ModelVersion 	*old;
+  ModelStats 	*s, *so;
+  double 		t;
+
+  pthread_mutex_lock(&publish_lock);
+  v->id = ++last_id;
+  s = stats_of(v->id);
+  if (s->id) {
+    // slot of version id - MODEL_MAX_VERSIONS: stop its late ModelRecord calls, wait for the running ones
+    __atomic_store_n(&s->id, v->id, __ATOMIC_SEQ_CST);
+    synchronize();
+  }
+  memset(s, 0, sizeof(*s));
+  snprintf(s->name, sizeof(s->name), "%s", v->name);
+  s->load_ms = load_ms;
+  __atomic_store_n(&s->id, v->id, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&s->state, MODEL_CURRENT, __ATOMIC_RELEASE);
+
+  old = __atomic_exchange_n(&current, v, __ATOMIC_SEQ_CST);
+  if (old) {
+    so = stats_of(old->id);
+    __atomic_store_n(&so->state, MODEL_RETIRED, __ATOMIC_RELEASE);
+    t = now_ms();
+    synchronize();
+    so->grace_ms = now_ms() - t;
+    __atomic_store_n(&so->state, MODEL_FREED, __ATOMIC_RELEASE);
+    free(old);
+  }
+  pthread_mutex_unlock(&publish_lock);
+  return v->id;
+}
+
+static ModelVersion *alloc_version(const char *name) {
+  ModelVersion *v = malloc(sizeof(ModelVersion));
+  if (!v) {
+    printf("Error: Unable to allocate a model version.\n");
+    exit(1);
+  }
+  memset(v, 0, sizeof(*v));
+  snprintf(v->name, sizeof(v->name), "%s", name);
+  return v;
+}
+
+static void prepare(LenetModel *m) {
+  FoldInputScale(m->w.conv1_kernel, m->conv1_kernel_u8, 1.0f / 255);
+  FcTransposeFc1(m->w.fc1_kernel, m->fc1_kernel_t);
+  FcTransposeFc2(m->w.fc2_kernel, m->fc2_kernel_t);
+  m->has_int8 = 0;
+}
+
+/* publishes a copy of an already prepared model (e.g. the one read at startup) */
+int ModelPublish(LenetModel *m, const char *name) {
+  ModelVersion *v = alloc_version(name);
+  memcpy(&v->model, m, sizeof(LenetModel));
+  return publish(v, 0.0);
+}
+
+/* every dataset of ReadLenetWeights present with the expected size (the readers do not check) */
+static int weights_readable(const char *path) {
+  static const char *names[8] = { "/layers/conv2d/vars/0", "/layers/conv2d/vars/1", "/layers/conv2d_1/vars/0",
+                                  "/layers/conv2d_1/vars/1", "/layers/dense/vars/0", "/layers/dense/vars/1",
+                                  "/layers/dense_1/vars/0", "/layers/dense_1/vars/1" };
+  static const long sizes[8] = { CONV1_NBOUTPUT*IMG_DEPTH*CONV1_DIM*CONV1_DIM, CONV1_NBOUTPUT,
+                                 CONV2_NBOUTPUT*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM, CONV2_NBOUTPUT,
+                                 FC1_NBOUTPUT*FC1_NBINPUT, FC1_NBOUTPUT, FC2_NBOUTPUT*FC1_NBOUTPUT, FC2_NBOUTPUT };
+  H5E_auto2_t 	func;
+  void 			*data;
+  hid_t 		file, set, space;
+  int 			i, ok = 1;
+
+  H5Eget_auto2(H5E_DEFAULT, &func, &data);
+  H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+  file = H5Fopen(path, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file < 0) ok = 0;
+  for (i = 0; ok && i < 8; i++) {
+    set = H5Dopen(file, names[i], H5P_DEFAULT);
+    if (set < 0) { ok = 0; break; }
+    space = H5Dget_space(set);
+    ok = space >= 0 && H5Sget_simple_extent_npoints(space) == sizes[i];
+    if (space >= 0) H5Sclose(space);
+    H5Dclose(set);
+  }
+  if (file >= 0) H5Fclose(file);
+  H5Eset_auto2(H5E_DEFAULT, func, data);
+  return ok;
+}
+
+static int weights_finite(LenetWeights *w) {
+  const float 	*p = (const float *)w;
+  long 			i, n = sizeof(LenetWeights) / sizeof(float);
+  for (i = 0; i < n; i++) if (!isfinite(p[i])) return 0;
+  return 1;
+}
+
+/* reads, checks and prepares path, then publishes it and frees the previous version once
+   quiescent. Must not be called inside a ModelAcquire / ModelRelease section. Returns the
+   new version id, or 0 when the file is rejected (the current version keeps serving). */
+int ModelLoad(const char *path) {
+  ModelVersion 	*v;
+  double 		t = now_ms();
+
+  if (strlen(path) >= MODEL_NAME_SIZE || !weights_readable(path)) {
+    __atomic_fetch_add(&rejected, 1, __ATOMIC_RELAXED);
+    return 0;
+  }
+  v = alloc_version(path);
+  ReadLenetWeights((char *)path, &v->model.w);
+  if (!weights_finite(&v->model.w)) {
+    free(v);
+    __atomic_fetch_add(&rejected, 1, __ATOMIC_RELAXED);
+    return 0;
+  }
+  prepare(&v->model);
+  return publish(v, now_ms() - t);
+}
+
+/* ---------------- file watcher ---------------- */
+
+/* reloads watch_path when its size or mtime changed and stayed the same for one period */
+static void *watch_loop(void *arg) {
+  struct stat 		st;
+  struct timespec 	period = { watch_ms / 1000, (watch_ms % 1000) * 1000000L };
+  long long 		seen = -1, pending = -1, sig;
+
+  (void)arg;
+  if (stat(watch_path, &st) == 0) seen = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec + st.st_size;
+  while (!watch_stop) {
+    nanosleep(&period, NULL);
+    if (stat(watch_path, &st) != 0) continue;
+    sig = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec + st.st_size;
+    if (sig == seen) { pending = -1; continue; }
+    if (sig != pending) { pending = sig; continue; } 	// still being written
+    seen = sig;
+    pending = -1;
+    ModelLoad(watch_path);
+  }
+  return NULL;
+}
+
+void ModelWatch(const char *path, int ms) {
+  if (strlen(path) >= MODEL_NAME_SIZE) {
+    printf("Error: Watched path longer than %d characters: %s\n", MODEL_NAME_SIZE - 1, path);
+    exit(1);
+  }
+  snprintf(watch_path, sizeof(watch_path), "%s", path);
+  watch_ms = ms > 0 ? ms : MODEL_WATCH_MS;
+  watch_stop = 0;
+  if (pthread_create(&watch_tid, NULL, watch_loop, NULL) != 0) {
+    printf("Error: Unable to start the model watcher.\n");
+    exit(1);
+  }
+  watching = 1;
+}
+
+/* ---------------- counters ---------------- */
+
+/* snapshot of the counters of the last versions, oldest first; returns their number */
+int ModelVersions(ModelStats *s, int max, unsigned long *nrejected) {
+  int id, n = 0, first;
+
+  pthread_mutex_lock(&publish_lock);
+  first = last_id - MODEL_MAX_VERSIONS + 1;
+  if (first < 1) first = 1;
+  for (id = first; id <= last_id && n < max; id++) s[n++] = *stats_of(id);
+  pthread_mutex_unlock(&publish_lock);
+  if (nrejected) *nrejected = __atomic_load_n(&rejected, __ATOMIC_RELAXED);
+  return n;
+}
+
+void ModelPrintVersions(void) {
+  static const char *state[] = { "", "current", "retired", "freed" };
+  ModelStats 		s[MODEL_MAX_VERSIONS];
+  unsigned long 	nrej;
+  int 				n = ModelVersions(s, MODEL_MAX_VERSIONS, &nrej), i;
+
+  printf("\n\nModel versions (%lu rejected file(s)):", nrej);
+  for (i = 0; i < n; i++) {
+    printf("\n  v%-3d %-8s %-32s load %7.1f ms, grace %6.2f ms, %8llu inferences, %7.1f us avg, %7.1f us max",
+           s[i].id, state[s[i].state], s[i].name, s[i].load_ms, s[i].grace_ms, s[i].inferences,
+           s[i].inferences ? s[i].ns_sum / 1e3 / s[i].inferences : 0.0, s[i].ns_max / 1e3);
+    if (s[i].labelled)
+      printf(", accuracy %.2f%% (%llu)", 100.0 * s[i].correct / s[i].labelled, s[i].labelled);
+  }
+}
+
+/* stops the watcher and frees the current version: no reader may be active */
+void ModelRegistryFree(void) {
+  ModelVersion *v;
+
+  if (watching) {
+    watch_stop = 1;
+    pthread_join(watch_tid, NULL);
+    watching = 0;
+  }
+  pthread_mutex_lock(&publish_lock);
+  v = __atomic_exchange_n(&current, NULL, __ATOMIC_SEQ_CST);
+  if (v) {
+    __atomic_store_n(&stats_of(v->id)->state, MODEL_FREED, __ATOMIC_RELEASE);
+    free(v);
+  }
+  pthread_mutex_unlock(&publish_lock);
+}
@@ -0,0 +1,192 @@
+/**
+  ******************************************************************************
+  * @file    shm.c
+  * @brief   Prepared model (LenetModel) in a shared-memory segment, one per NUMA node
+  * @brief   The first worker of a node creates and fills the segment, the others
+  * @brief   attach read-only. Optional huge pages (hugetlbfs, else THP advice).
+  * @brief   Host only (Linux), not for HLS.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "lenet_cnn_float.h"
+
+#define SHM_MAGIC			0x4C454E54	// "LENT"
+#define SHM_HUGE_DIR		"/dev/hugepages"
+#define SHM_HUGE_PAGE		(2UL << 20)
+#define SHM_HEADER			4096UL		// header page, the model starts page-aligned after it
+#ifndef SHM_ATTACH_TIMEOUT
+#define SHM_ATTACH_TIMEOUT	120			// seconds to wait for the publisher
+#endif
+
+typedef struct {
+  unsigned int 			magic;
+  unsigned int 			model_size;
+  int 					node;
+  volatile int 			ready; 			// set last by the publisher
+} ShmHeader;
+
+typedef struct {
+  void 					*base;
+  size_t 				len;
+} ShmMapping;
+
+static ShmMapping 	mapping; 			// one model segment per process
+
+static size_t segment_size(int huge) {
+  size_t len = SHM_HEADER + sizeof(LenetModel);
+  if (huge) len = (len + SHM_HUGE_PAGE - 1) & ~(SHM_HUGE_PAGE - 1);
+  return len;
+}
+
+/* Node the calling thread runs on (0 when unknown) */
+int ShmCurrentNode(void) {
+  unsigned int cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) return 0;
+  return (int)node;
+}
+
+/* Segment name of a node: /<name>.node<N>, in a buffer of size chars */
+void ShmSegmentName(char *segname, size_t size, const char *name, int node) {
+  if ((size_t)snprintf(segname, size, "/%s.node%d", name, node) >= size) {
+    printf("Error: Shared model name %s is too long.\n", name);
+    exit(1);
+  }
+}
+
+static int open_segment(const char *segname, int flags, int huge) {
+  char path[160];
+
+  if (huge) {
+    snprintf(path, sizeof(path), "%s%s", SHM_HUGE_DIR, segname);
+    return open(path, flags, 0644);
+  }
+  return shm_open(segname, flags, 0644);
+}
+
+/**
+  * Opens the model segment of a node. If it does not exist yet it is created (mapped
+  * read-write, pages bound to the node) and *created is set: the caller fills the model
+  * and calls ShmPublishModel. Otherwise waits until the publisher is done and maps it
+  * read-only (from either backing). With huge = 1 a new segment lives on hugetlbfs,
+  * or on tmpfs with transparent huge page advice when hugetlbfs is not mounted.
+  */
+LenetModel *ShmOpenModel(const char *name, int node, int huge, int *created) {
+  char 			segname[128];
+  int 			fd, waited;
+  size_t 		len;
+  ShmHeader 	*h;
+
+  ShmSegmentName(segname, sizeof(segname), name, node);
+  *created = 0;
+
+  fd = open_segment(segname, O_RDWR | O_CREAT | O_EXCL, huge);
+  if (fd < 0 && huge && errno != EEXIST) {
+    printf("Warning: no hugetlbfs at %s, using %s with THP advice\n", SHM_HUGE_DIR, "/dev/shm");
+    huge = 0;
+    fd = open_segment(segname, O_RDWR | O_CREAT | O_EXCL, huge);
+  }
+  len = segment_size(huge);
+
+  if (fd >= 0) {
+    // publisher
+    unsigned long nodemask = 1UL << node;
+    if (ftruncate(fd, len) != 0) {
+      printf("Error: Unable to size shared segment %s.\n", segname);
+      exit(1);
+    }
+    mapping.base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping.base == MAP_FAILED) {
+      printf("Error: Unable to map shared segment %s (no free huge pages?).\n", segname);
+      exit(1);
+    }
+    mapping.len = len;
+    if (!huge) madvise(mapping.base, len, MADV_HUGEPAGE);
+    // bind before the first touch, so that the pages land on the node (best effort)
+    syscall(SYS_mbind, mapping.base, len, MPOL_BIND, &nodemask, sizeof(nodemask)*8, 0);
+    // the segment is visible (zero-filled) from the ftruncate on: magic goes in last
+    h = (ShmHeader *)mapping.base;
+    h->model_size = sizeof(LenetModel);
+    h->node = node;
+    h->ready = 0;
+    __sync_synchronize();
+    h->magic = SHM_MAGIC;
+    *created = 1;
+    return (LenetModel *)((char *)mapping.base + SHM_HEADER);
+  }
+  if (errno != EEXIST) {
+    printf("Error: Unable to create shared segment %s.\n", segname);
+    exit(1);
+  }
+
+  // attach: wait for the segment to be sized and published
+  for (waited = 0; ; waited++) {
+    struct stat st;
+    fd = open_segment(segname, O_RDONLY, huge = 0); 		// whichever backing the publisher got
+    if (fd < 0) fd = open_segment(segname, O_RDONLY, huge = 1);
+    len = segment_size(huge);
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= len) {
+      mapping.base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (mapping.base == MAP_FAILED) {
+        printf("Error: Unable to map shared segment %s.\n", segname);
+        exit(1);
+      }
+      mapping.len = len;
+      h = (ShmHeader *)mapping.base;
+      // magic 0: sized but the publisher has not written the header yet, keep polling
+      if ((h->magic && h->magic != SHM_MAGIC) || (h->ready && h->model_size != sizeof(LenetModel))) {
+        printf("Error: %s is not a model segment of this build (remove it).\n", segname);
+        exit(1);
+      }
+      if (h->magic && h->ready) break;
+      munmap(mapping.base, len);
+    }
+    else if (fd >= 0) close(fd);
+    if (waited >= SHM_ATTACH_TIMEOUT*100) {
+      printf("Error: shared model %s was never published.\n", segname);
+      exit(1);
+    }
+    usleep(10000);
+  }
+  __sync_synchronize();
+  return (LenetModel *)((char *)mapping.base + SHM_HEADER);
+}
+
+/* Marks the model filled, then drops the write permission of the publisher too */
+void ShmPublishModel(LenetModel *m) {
+  ShmHeader *h = (ShmHeader *)mapping.base;
+
+  (void)m;
+  __sync_synchronize();
+  h->ready = 1;
+  mprotect(mapping.base, mapping.len, PROT_READ);
+}
+
+void ShmCloseModel(LenetModel *m) {
+  (void)m;
+  if (mapping.base) munmap(mapping.base, mapping.len);
+  mapping.base = NULL;
+}
+
+/* Removes the segment of a node (either backing), returns 0 if one was removed */
+int ShmUnlinkModel(const char *name, int node) {
+  char segname[128], path[160];
+  int ret;
+
+  ShmSegmentName(segname, sizeof(segname), name, node);
+  ret = shm_unlink(segname);
+  snprintf(path, sizeof(path), "%s%s", SHM_HUGE_DIR, segname);
+  if (unlink(path) == 0) ret = 0;
+  return ret;
+}
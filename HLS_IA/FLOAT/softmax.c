@@ -1,5 +1,6 @@
 // softmax.c - stable softmax
 #include <math.h>
+#include <stdint.h>
 #include "lenet_cnn_float.h"
 
 void Softmax(float in[FC2_NBOUTPUT], float out[FC2_NBOUTPUT]){
@@ -17,3 +18,130 @@ void Softmax(float in[FC2_NBOUTPUT], float out[FC2_NBOUTPUT]){
     for (int i = 0; i < FC2_NBOUTPUT; ++i)
         out[i] /= sum;
 }
+
+// top-1 minus top-2 probability, used to gate the int8 -> float cascade
+float SoftmaxMargin(float in[FC2_NBOUTPUT]){
+    float top1 = in[0], top2 = -1.0f;
+    for (int i = 1; i < FC2_NBOUTPUT; ++i){
+        if (in[i] > top1){ top2 = top1; top1 = in[i]; }
+        else if (in[i] > top2) top2 = in[i];
+    }
+    return top1 - top2;
+}
+
+// ---------------- Fixed-point softmax (HLS and host) ----------------
+// exp(in - max) = 2^-t with t = (max - in) * log2(e), rounded to 1/64: a 64-entry Q16
+// table of 2^-f for the fraction of t, a right shift for its integer part. 1/sum: the sum
+// normalized to m in [1, 2), a 32-entry Q15 seed of 1/m, one Newton step y = y*(2 - m*y)
+// (relative error < 3e-4). Probabilities in Q15, SOFTMAX_ONE = 1.0.
+
+#define LOG2E_Q16	94548	// log2(e) * 2^16
+
+#if SOFTMAX_IN_FRAC < SOFTMAX_EXP_BITS
+#error "SOFTMAX_IN_FRAC must be >= SOFTMAX_EXP_BITS"
+#endif
+
+static const uint32_t EXP2_NEG_Q16[1 << SOFTMAX_EXP_BITS] = {   // 2^(-i/64) * 2^16
+    65536, 64830, 64132, 63441, 62757, 62081, 61413, 60751,
+    60097, 59449, 58809, 58176, 57549, 56929, 56316, 55709,
+    55109, 54515, 53928, 53347, 52773, 52204, 51642, 51085,
+    50535, 49991, 49452, 48920, 48393, 47871, 47356, 46846,
+    46341, 45842, 45348, 44859, 44376, 43898, 43425, 42958,
+    42495, 42037, 41584, 41136, 40693, 40255, 39821, 39392,
+    38968, 38548, 38133, 37722, 37316, 36914, 36516, 36123,
+    35734, 35349, 34968, 34591, 34219, 33850, 33486, 33125
+};
+
+static const uint16_t RECIP_SEED_Q15[32] = {   // 2^15 / (1 + (i + 0.5) / 32)
+    32264, 31301, 30394, 29537, 28728, 27962, 27236, 26546,
+    25891, 25267, 24672, 24105, 23564, 23046, 22550, 22075,
+    21620, 21183, 20764, 20361, 19973, 19600, 19240, 18893,
+    18559, 18236, 17924, 17623, 17332, 17050, 16777, 16513
+};
+
+// logits in Q(SOFTMAX_IN_FRAC) -> probabilities in Q15
+void SoftmaxQ(const int32_t in[FC2_NBOUTPUT], uint16_t out[FC2_NBOUTPUT]){
+#pragma HLS INLINE off
+    int32_t maxv = in[0];
+    for (int i = 1; i < FC2_NBOUTPUT; ++i)
+        if (in[i] > maxv) maxv = in[i];
+
+    uint32_t e[FC2_NBOUTPUT], sum = 0;
+    for (int i = 0; i < FC2_NBOUTPUT; ++i){
+#pragma HLS PIPELINE II=1
+        const int sh = SOFTMAX_IN_FRAC - SOFTMAX_EXP_BITS;
+        int64_t t = ((int64_t)(maxv - in[i]) * LOG2E_Q16) >> 16;    // Q(SOFTMAX_IN_FRAC)
+        t = (t + ((1 << sh) >> 1)) >> sh;                           // Q(SOFTMAX_EXP_BITS)
+        const int64_t k = t >> SOFTMAX_EXP_BITS;
+        e[i] = k > 16 ? 0 : EXP2_NEG_Q16[t & ((1 << SOFTMAX_EXP_BITS) - 1)] >> k;
+        sum += e[i];
+    }
+
+    // the max contributes 2^16, so sum is in [2^16, 10 * 2^16)
+    int n = 16;
+    for (int b = 17; b < 20; ++b){
+#pragma HLS UNROLL
+        if (sum >> b) n = b;
+    }
+    const uint32_t m = sum >> (n - 15);                             // Q15 in [1, 2)
+    uint32_t y = RECIP_SEED_Q15[(m >> 10) & 31];                    // Q15 ~ 1 / m
+    const uint32_t my = (m * y) >> 15;
+    y = (uint32_t)(((uint64_t)y * (65536 - my)) >> 15);
+
+    for (int i = 0; i < FC2_NBOUTPUT; ++i){
+#pragma HLS PIPELINE II=1
+        uint32_t v = (uint32_t)(((uint64_t)e[i] * y + (1u << (n - 1))) >> n);
+        out[i] = v > SOFTMAX_ONE ? SOFTMAX_ONE : v;
+    }
+}
+
+// float I/O around SoftmaxQ, for bench_softmax / bench_layers. HLS only: on the host it is
+// slower than expf and the Q15 output moves 2 of the 10000 test predictions.
+void SoftmaxFixed(float in[FC2_NBOUTPUT], float out[FC2_NBOUTPUT]){
+    int32_t  q[FC2_NBOUTPUT];
+    uint16_t p[FC2_NBOUTPUT];
+
+    for (int i = 0; i < FC2_NBOUTPUT; ++i){
+        float v = in[i] * (float)(1 << SOFTMAX_IN_FRAC);
+        if (v > 16777216.0f) v = 16777216.0f;
+        if (v < -16777216.0f) v = -16777216.0f;
+        q[i] = (int32_t)lrintf(v);
+    }
+    SoftmaxQ(q, p);
+    for (int i = 0; i < FC2_NBOUTPUT; ++i)
+        out[i] = (float)p[i] * (1.0f / SOFTMAX_ONE);
+}
+
+// ---------------- Classification only: no softmax ----------------
+// Softmax is monotonic, so the logits rank the classes as the probabilities do.
+
+int Argmax(float in[FC2_NBOUTPUT]){
+    int best = 0;
+    for (int i = 1; i < FC2_NBOUTPUT; ++i)
+        if (in[i] > in[best]) best = i;
+    return best;
+}
+
+// k best classes, best first (ties: lower class first), returns classes[0].
+// Insertion through a chain of k compare-and-swap slots, one class per cycle on HLS.
+int TopK(float in[FC2_NBOUTPUT], int k, unsigned char classes[]){
+#pragma HLS INLINE off
+    float best[FC2_NBOUTPUT];
+    for (int j = 0; j < k; ++j){ best[j] = 0.0f; classes[j] = 0; }
+
+    for (int i = 0; i < FC2_NBOUTPUT; ++i){
+#pragma HLS PIPELINE II=1
+        float v = in[i];
+        unsigned char c = (unsigned char)i;
+        for (int j = 0; j < FC2_NBOUTPUT; ++j){
+#pragma HLS UNROLL
+            if (j < k && (j >= i || v > best[j])){   // slots j >= i are still empty
+                float tv = best[j];
+                unsigned char tc = classes[j];
+                best[j] = v; classes[j] = c;
+                v = tv; c = tc;
+            }
+        }
+    }
+    return classes[0];
+}
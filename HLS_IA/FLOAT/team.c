@@ -0,0 +1,125 @@
+/**
+  ******************************************************************************
+  * @file    team.c
+  * @brief   Persistent spinning thread team for intra-image parallelism
+  * @brief   Workers are created once (TeamInit) and spin on a generation counter;
+  * @brief   TeamRun hands them a job and the caller takes part as thread 0. Layers
+  * @brief   are separated by a sense-reversing barrier (TeamBarrier), no thread
+  * @brief   creation per inference. Concurrent TeamRun callers take turns on the team.
+  * @brief   Host only, not for HLS.
+  */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "lenet_cnn_float.h"
+
+// spins before yielding the core (keeps oversubscribed runs usable)
+#ifndef TEAM_SPIN
+#define TEAM_SPIN	4096
+#endif
+
+typedef struct {
+  volatile int 		sense; 		// own barrier sense
+  char 				pad[60]; 	// one cache line per thread
+} TeamSlot;
+
+static pthread_t 		team_tid[TEAM_MAX];
+static TeamSlot 		team_slot[TEAM_MAX];
+static int 				team_size = 1;
+static volatile int 	team_generation, team_stop;
+static volatile int 	bar_count, bar_sense;
+static TeamJob 			team_job;
+static void 			*team_arg;
+static pthread_mutex_t 	team_lock = PTHREAD_MUTEX_INITIALIZER; 	// one job in flight
+
+static inline void spin_wait(int *spins) {
+  if (++(*spins) >= TEAM_SPIN) { sched_yield(); *spins = 0; }
+  else __asm__ __volatile__("" ::: "memory");
+}
+
+/* Centralized sense-reversing barrier over the whole team */
+void TeamBarrier(int id) {
+  int spins = 0;
+  int sense = team_slot[id].sense = !team_slot[id].sense;
+
+  if (__sync_add_and_fetch(&bar_count, 1) == team_size) {
+    bar_count = 0;
+    __sync_synchronize();
+    bar_sense = sense;
+  }
+  else
+    while (bar_sense != sense) spin_wait(&spins);
+  __sync_synchronize();
+}
+
+static void *worker(void *arg) {
+  int id = (int)(long)arg, seen = 0, spins;
+
+  while (1) {
+    spins = 0;
+    while (team_generation == seen) spin_wait(&spins);
+    seen = team_generation;
+    __sync_synchronize();
+    if (team_stop) break;
+    team_job(team_arg, id, team_size);
+    TeamBarrier(id);
+  }
+  return NULL;
+}
+
+/* Starts nthreads-1 workers (the caller is thread 0), pinned round-robin on the online cpus */
+void TeamInit(int nthreads) {
+  int ncpu = sysconf(_SC_NPROCESSORS_ONLN), t;
+  cpu_set_t set;
+
+  if (nthreads < 1) nthreads = 1;
+  if (nthreads > TEAM_MAX) nthreads = TEAM_MAX;
+  team_size = nthreads;
+  team_stop = 0;
+  team_generation = 0; 		// workers start from seen = 0
+  bar_count = 0;
+  bar_sense = 0;
+  for (t = 0; t < nthreads; t++) team_slot[t].sense = 0;
+  for (t = 1; t < nthreads; t++) {
+    if (pthread_create(&team_tid[t], NULL, worker, (void *)(long)t)) {
+      printf("Error: Unable to create team thread %d.\n", t);
+      exit(1);
+    }
+    if (ncpu > 1) {
+      CPU_ZERO(&set);
+      CPU_SET(t % ncpu, &set);
+      pthread_setaffinity_np(team_tid[t], sizeof(set), &set);
+    }
+  }
+}
+
+/* Runs job(arg, id, n) on every team thread, returns when all are done */
+void TeamRun(TeamJob job, void *arg) {
+  pthread_mutex_lock(&team_lock);
+  team_job = job;
+  team_arg = arg;
+  __sync_synchronize();
+  team_generation++;
+  job(arg, 0, team_size);
+  TeamBarrier(0);
+  pthread_mutex_unlock(&team_lock);
+}
+
+void TeamFree(void) {
+  int t;
+
+  team_stop = 1;
+  __sync_synchronize();
+  team_generation++;
+  for (t = 1; t < team_size; t++) pthread_join(team_tid[t], NULL);
+  team_size = 1;
+}
+
+int TeamSize(void) {
+  return team_size;
+}
@@ -0,0 +1,353 @@
+/**
+  ******************************************************************************
+  * @file    ternarize.c
+  * @brief   Offline tool: converts the float LeNet into a LenetTernary (lenet_bin.c)
+  * @brief   Conv2 / Fc1 / Fc2 weights become t * alpha per output channel, t in {-1, 0, +1}
+  * @brief   (|w| > delta) or {-1, +1} with -B; delta and alpha minimize the channel's L2
+  * @brief   error. Layer after layer on the ternary pipeline itself, the input activation
+  * @brief   step (Pool1, Pool2, Fc1) is chosen for the least quantization error, then the
+  * @brief   per-channel scale and bias are refitted by least squares on the float layer
+  * @brief   output over the calibration images. No retraining.
+  * @brief   Reports accuracy and time per image on the 10k test set for binary / ternary
+  * @brief   weights and 1 .. TERN_ABITS_MAX activation bits against float lenet_cnn(),
+  * @brief   then writes the requested configuration for lenet_cnn_float -t.
+  * @brief   Usage: ternarize [-a activation_bits] [-B] [-c calib_images] [-o lenet_ternary.bin]
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+// clip candidates per activation step search, fractions of the observed maximum
+#ifndef TERN_CLIP_STEPS
+#define TERN_CLIP_STEPS	100
+#endif
+
+static LenetWeights 	W;
+static LenetTernary 	T;
+static float 			IN[MNIST_TEST_SIZE][IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+static unsigned char 	LABELS[MNIST_TEST_SIZE];
+static float 			*ACT; 	// calibration activations of the layer being calibrated
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+/* per-channel ternary (or binary) weights of n values: pos / neg bits, returns alpha */
+static float ternarize(const float *w, int n, int binary, int *t) {
+  double 	mean = 0, best_err = -1, err, alpha, best_alpha = 0;
+  int 		i, r, cnt;
+
+  for (i = 0; i < n; i++) mean += fabs(w[i]);
+  mean /= n;
+  for (r = binary ? 0 : 1; r <= (binary ? 0 : 30); r++) { 	// delta = 0.05 .. 1.5 mean |w|
+    double delta = binary ? -1.0 : 0.05 * r * mean;
+    for (alpha = 0, cnt = 0, i = 0; i < n; i++) if (fabs(w[i]) > delta) { alpha += fabs(w[i]); cnt++; }
+    if (!cnt) continue;
+    alpha /= cnt;
+    for (err = 0, i = 0; i < n; i++) {
+      double q = fabs(w[i]) > delta ? (w[i] > 0 ? alpha : -alpha) : 0;
+      err += (w[i] - q) * (w[i] - q);
+    }
+    if (best_err < 0 || err < best_err) {
+      best_err = err;
+      best_alpha = alpha;
+      for (i = 0; i < n; i++) t[i] = fabs(w[i]) > delta ? (w[i] > 0 ? 1 : -1) : 0;
+    }
+  }
+  return (float)best_alpha;
+}
+
+static void weights(int binary) {
+  float 	buf[FC1_NBINPUT];
+  int 		t[FC1_NBINPUT], m, c, y, x, i;
+
+  memcpy(T.conv1_kernel, W.conv1_kernel, sizeof(W.conv1_kernel));
+  memcpy(T.conv1_bias, W.conv1_bias, sizeof(W.conv1_bias));
+  memcpy(T.conv2_bias, W.conv2_bias, sizeof(W.conv2_bias));
+  memcpy(T.fc1_bias, W.fc1_bias, sizeof(W.fc1_bias));
+  memcpy(T.fc2_bias, W.fc2_bias, sizeof(W.fc2_bias));
+  T.binary = binary;
+
+  for (m = 0; m < CONV2_NBOUTPUT; m++) {
+    T.conv2_scale[m] = ternarize(&W.conv2_kernel[m][0][0][0], POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM, binary, t);
+    for (y = 0; y < CONV2_DIM; y++)
+      for (x = 0; x < CONV2_DIM; x++) {
+        T.conv2_pos[y][x][m] = T.conv2_neg[y][x][m] = 0;
+        for (c = 0; c < POOL1_NBOUTPUT; c++) {
+          i = (c * CONV2_DIM + y) * CONV2_DIM + x;
+          if (t[i] > 0) T.conv2_pos[y][x][m] |= 1u << c;
+          if (t[i] < 0) T.conv2_neg[y][x][m] |= 1u << c;
+        }
+      }
+  }
+  for (m = 0; m < FC1_NBOUTPUT; m++) {
+    T.fc1_scale[m] = ternarize(&W.fc1_kernel[m][0][0][0], FC1_NBINPUT, binary, t);
+    memset(T.fc1_pos[m], 0, sizeof(T.fc1_pos[m]));
+    memset(T.fc1_neg[m], 0, sizeof(T.fc1_neg[m]));
+    for (i = 0; i < FC1_NBINPUT; i++) {
+      if (t[i] > 0) T.fc1_pos[m][i >> 6] |= 1ull << (i & 63);
+      if (t[i] < 0) T.fc1_neg[m][i >> 6] |= 1ull << (i & 63);
+    }
+  }
+  for (m = 0; m < FC2_NBOUTPUT; m++) {
+    for (i = 0; i < FC1_NBOUTPUT; i++) buf[i] = W.fc2_kernel[m][i];
+    T.fc2_scale[m] = ternarize(buf, FC1_NBOUTPUT, binary, t);
+    memset(T.fc2_pos[m], 0, sizeof(T.fc2_pos[m]));
+    memset(T.fc2_neg[m], 0, sizeof(T.fc2_neg[m]));
+    for (i = 0; i < FC1_NBOUTPUT; i++) {
+      if (t[i] > 0) T.fc2_pos[m][i >> 6] |= 1ull << (i & 63);
+      if (t[i] < 0) T.fc2_neg[m][i >> 6] |= 1ull << (i & 63);
+    }
+  }
+}
+
+/* activation step with the least quantization error on ACT[0 .. n-1] (post-ReLU values) */
+static float act_step(long n, int abits) {
+  const int qmax = (1 << abits) - 1;
+  double 	best_err = -1, err, e;
+  float 	vmax = 1e-8f, best = 1.0f, step;
+  long 		i;
+  int 		f, q;
+
+  for (i = 0; i < n; i++) if (ACT[i] > vmax) vmax = ACT[i];
+  for (f = 1; f <= TERN_CLIP_STEPS; f++) {
+    step = vmax * f / TERN_CLIP_STEPS / qmax;
+    for (err = 0, i = 0; i < n; i++) {
+      q = (int)(ACT[i] / step + 0.5f);
+      e = (q > qmax ? qmax : q) * step - ACT[i];
+      err += e * e;
+    }
+    if (best_err < 0 || err < best_err) { best_err = err; best = step; }
+  }
+  return best;
+}
+
+static float max4(float a, float b, float c, float d) {
+  float m = a > b ? a : b;
+  if (c > m) m = c;
+  if (d > m) m = d;
+  return m > 0.0f ? m : 0.0f; 	// ReLU
+}
+
+/* float reference of the layers being approximated: Pool1 / Pool2 without int8 rounding,
+   Conv2 / Fc1 / Fc2 before ReLU */
+static void reference(int i, float p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], float c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH],
+                      float f1[FC1_NBOUTPUT], float f2[FC2_NBOUTPUT]) {
+  float 	c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], p2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH], r1[FC1_NBOUTPUT];
+  int 		c, y, x, o;
+
+  Conv1_28x28x1_5x5x20_1_0(IN[i], W.conv1_kernel, W.conv1_bias, c1);
+  for (c = 0; c < CONV1_NBOUTPUT; c++) for (y = 0; y < POOL1_HEIGHT; y++) for (x = 0; x < POOL1_WIDTH; x++)
+    p1[c][y][x] = max4(c1[c][2*y][2*x], c1[c][2*y][2*x+1], c1[c][2*y+1][2*x], c1[c][2*y+1][2*x+1]);
+  Conv2_12x12x20_5x5x40_1_0(p1, W.conv2_kernel, W.conv2_bias, c2);
+  for (c = 0; c < CONV2_NBOUTPUT; c++) for (y = 0; y < POOL2_HEIGHT; y++) for (x = 0; x < POOL2_WIDTH; x++)
+    p2[c][y][x] = max4(c2[c][2*y][2*x], c2[c][2*y][2*x+1], c2[c][2*y+1][2*x], c2[c][2*y+1][2*x+1]);
+  for (o = 0; o < FC1_NBOUTPUT; o++) {
+    double acc = W.fc1_bias[o];
+    for (c = 0; c < FC1_NBINPUT; c++) acc += (&p2[0][0][0])[c] * (&W.fc1_kernel[o][0][0][0])[c];
+    f1[o] = (float)acc;
+    r1[o] = acc > 0 ? (float)acc : 0.0f;
+  }
+  Fc2_400_10(r1, W.fc2_kernel, W.fc2_bias, f2);
+}
+
+/* raw accumulators out of a layer: scale = 1 / step, bias = 0, the weight-only alpha and bias kept */
+static float KEEP_SCALE[FC1_NBOUTPUT], KEEP_BIAS[FC1_NBOUTPUT];
+
+static void raw(int n, float step, float *scale, float *bias) {
+  memcpy(KEEP_SCALE, scale, n * sizeof(float));
+  memcpy(KEEP_BIAS, bias, n * sizeof(float));
+  for (int m = 0; m < n; m++) { scale[m] = 1.0f / step; bias[m] = 0.0f; }
+}
+
+/* least-squares y ~ s acc + c per output channel: sums n, acc, y, acc^2, acc y */
+static void fit(double *sums, int n, float step, float *scale, float *bias) {
+  for (int m = 0; m < n; m++, sums += 5) {
+    double var = sums[0] * sums[3] - sums[1] * sums[1], s = 0;
+    if (var > 0) s = (sums[0] * sums[4] - sums[1] * sums[2]) / var;
+    if (s <= 0) { scale[m] = KEEP_SCALE[m]; bias[m] = KEEP_BIAS[m]; continue; } 	// dead channel
+    scale[m] = (float)(s / step);
+    bias[m] = (float)((sums[2] - s * sums[1]) / sums[0]);
+  }
+}
+
+static void accumulate(double *sums, float acc, float y) {
+  sums[0] += 1; sums[1] += acc; sums[2] += y; sums[3] += (double)acc * acc; sums[4] += (double)acc * y;
+}
+
+/* Layer after layer on the quantized pipeline: the input activation step (least quantization
+   error), then the output scale and bias fitted on the float reference */
+static void calibrate(int abits, int ncalib) {
+  float 	c1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 	r_p1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], r_c2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH];
+  float 	r_f1[FC1_NBOUTPUT], r_f2[FC2_NBOUTPUT], f1[FC1_NBOUTPUT], f2[FC2_NBOUTPUT];
+  uint32_t 	p1[TERN_ABITS_MAX][POOL1_HEIGHT][POOL1_WIDTH];
+  uint64_t 	p2[TERN_ABITS_MAX][TERN_FC1_WORDS], q1[TERN_ABITS_MAX][TERN_FC2_WORDS];
+  static double sums[FC1_NBOUTPUT][5];
+  float 	*a;
+  int 		i, c, y, x;
+
+  T.abits = abits;
+  // Conv2
+  for (a = ACT, i = 0; i < ncalib; i++) {
+    Conv1_28x28x1_5x5x20_1_0(IN[i], T.conv1_kernel, T.conv1_bias, c1);
+    for (c = 0; c < CONV1_NBOUTPUT; c++) for (y = 0; y < POOL1_HEIGHT; y++) for (x = 0; x < POOL1_WIDTH; x++)
+      *a++ = max4(c1[c][2*y][2*x], c1[c][2*y][2*x+1], c1[c][2*y+1][2*x], c1[c][2*y+1][2*x+1]);
+  }
+  T.act_step[0] = act_step(a - ACT, abits);
+  raw(CONV2_NBOUTPUT, T.act_step[0], T.conv2_scale, T.conv2_bias);
+  memset(sums, 0, sizeof(sums));
+  for (i = 0; i < ncalib; i++) {
+    reference(i, r_p1, r_c2, r_f1, r_f2);
+    Conv1_28x28x1_5x5x20_1_0(IN[i], T.conv1_kernel, T.conv1_bias, c1);
+    TernaryPool1Pack(c1, T.act_step[0], abits, p1);
+    Conv2_12x12x20_5x5x40_1_0_ternary(p1, &T, c2);
+    for (c = 0; c < CONV2_NBOUTPUT; c++) for (y = 0; y < CONV2_HEIGHT; y++) for (x = 0; x < CONV2_WIDTH; x++)
+      accumulate(sums[c], c2[c][y][x], r_c2[c][y][x]);
+  }
+  fit(&sums[0][0], CONV2_NBOUTPUT, T.act_step[0], T.conv2_scale, T.conv2_bias);
+
+  // Fc1
+  for (a = ACT, i = 0; i < ncalib; i++) {
+    Conv1_28x28x1_5x5x20_1_0(IN[i], T.conv1_kernel, T.conv1_bias, c1);
+    TernaryPool1Pack(c1, T.act_step[0], abits, p1);
+    Conv2_12x12x20_5x5x40_1_0_ternary(p1, &T, c2);
+    for (c = 0; c < CONV2_NBOUTPUT; c++) for (y = 0; y < POOL2_HEIGHT; y++) for (x = 0; x < POOL2_WIDTH; x++)
+      *a++ = max4(c2[c][2*y][2*x], c2[c][2*y][2*x+1], c2[c][2*y+1][2*x], c2[c][2*y+1][2*x+1]);
+  }
+  T.act_step[1] = act_step(a - ACT, abits);
+  raw(FC1_NBOUTPUT, T.act_step[1], T.fc1_scale, T.fc1_bias);
+  memset(sums, 0, sizeof(sums));
+  for (i = 0; i < ncalib; i++) {
+    reference(i, r_p1, r_c2, r_f1, r_f2);
+    Conv1_28x28x1_5x5x20_1_0(IN[i], T.conv1_kernel, T.conv1_bias, c1);
+    TernaryPool1Pack(c1, T.act_step[0], abits, p1);
+    Conv2_12x12x20_5x5x40_1_0_ternary(p1, &T, c2);
+    TernaryPool2Pack(c2, T.act_step[1], abits, p2);
+    Fc1_40_400_ternary(p2, &T, f1);
+    for (c = 0; c < FC1_NBOUTPUT; c++) accumulate(sums[c], f1[c], r_f1[c]);
+  }
+  fit(&sums[0][0], FC1_NBOUTPUT, T.act_step[1], T.fc1_scale, T.fc1_bias);
+
+  // Fc2
+  for (a = ACT, i = 0; i < ncalib; i++) {
+    Conv1_28x28x1_5x5x20_1_0(IN[i], T.conv1_kernel, T.conv1_bias, c1);
+    TernaryPool1Pack(c1, T.act_step[0], abits, p1);
+    Conv2_12x12x20_5x5x40_1_0_ternary(p1, &T, c2);
+    TernaryPool2Pack(c2, T.act_step[1], abits, p2);
+    Fc1_40_400_ternary(p2, &T, a);
+    for (c = 0; c < FC1_NBOUTPUT; c++, a++) if (*a < 0.0f) *a = 0.0f;
+  }
+  T.act_step[2] = act_step(a - ACT, abits);
+  raw(FC2_NBOUTPUT, T.act_step[2], T.fc2_scale, T.fc2_bias);
+  memset(sums, 0, sizeof(sums));
+  for (i = 0; i < ncalib; i++) {
+    reference(i, r_p1, r_c2, r_f1, r_f2);
+    Conv1_28x28x1_5x5x20_1_0(IN[i], T.conv1_kernel, T.conv1_bias, c1);
+    TernaryPool1Pack(c1, T.act_step[0], abits, p1);
+    Conv2_12x12x20_5x5x40_1_0_ternary(p1, &T, c2);
+    TernaryPool2Pack(c2, T.act_step[1], abits, p2);
+    Fc1_40_400_ternary(p2, &T, f1);
+    TernaryFc1Pack(f1, T.act_step[2], abits, q1);
+    Fc2_400_10_ternary(q1, &T, f2);
+    for (c = 0; c < FC2_NBOUTPUT; c++) accumulate(sums[c], f2[c], r_f2[c]);
+  }
+  fit(&sums[0][0], FC2_NBOUTPUT, T.act_step[2], T.fc2_scale, T.fc2_bias);
+}
+
+static int argmax(float *p) {
+  int k, best = 0;
+  for (k = 1; k < FC2_NBOUTPUT; k++) if (p[k] > p[best]) best = k;
+  return best;
+}
+
+/* 10k accuracy (%) and us/image of lenet_cnn_ternary (T), or of lenet_cnn when ref */
+static float evaluate(int ref, double *us) {
+  float 	out[FC2_NBOUTPUT];
+  int 		i, ok = 0;
+  double 	s = now();
+
+  for (i = 0; i < MNIST_TEST_SIZE; i++) {
+    if (ref) lenet_cnn(IN[i], W.conv1_kernel, W.conv1_bias, W.conv2_kernel, W.conv2_bias,
+                       W.fc1_kernel, W.fc1_bias, W.fc2_kernel, W.fc2_bias, out);
+    else lenet_cnn_ternary(IN[i], &T, out);
+    ok += (argmax(out) == LABELS[i]);
+  }
+  *us = (now() - s) / MNIST_TEST_SIZE * 1e6;
+  return 100.0f * ok / MNIST_TEST_SIZE;
+}
+
+int main(int argc, char *argv[]) {
+  char 		*out_filename = "lenet_ternary.bin", img_filename[120];
+  int 		abits = 2, binary = 0, ncalib = 500, i, b, bin;
+  unsigned char img[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 	acc_ref, acc;
+  double 	us_ref, us;
+  long 		wbits;
+
+  for (i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-a") && i+1 < argc) abits = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-B")) binary = 1;
+    else if (!strcmp(argv[i], "-c") && i+1 < argc) ncalib = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-o") && i+1 < argc) out_filename = argv[++i];
+    else {
+      printf("Usage: %s [-a activation_bits] [-B] [-c calib_images] [-o lenet_ternary.bin]\n", argv[0]);
+      exit(1);
+    }
+  }
+  if (abits < 1 || abits > TERN_ABITS_MAX) {
+    printf("Error: Activation bits must be in 1 .. %d (TERN_ABITS_MAX).\n", TERN_ABITS_MAX);
+    exit(1);
+  }
+  if (ncalib < 1 || ncalib > MNIST_TEST_SIZE) ncalib = MNIST_TEST_SIZE;
+
+  ReadLenetWeights("lenet_weights.weights.h5", &W);
+  if (ReadMnistLabels("mnist/t10k-labels-idx1-ubyte", LABELS, MNIST_TEST_SIZE) != MNIST_TEST_SIZE) {
+    printf("Error: Expected %d test labels.\n", MNIST_TEST_SIZE);
+    exit(1);
+  }
+  for (i = 0; i < MNIST_TEST_SIZE; i++) {
+    MnistImgFilename(img_filename, i);
+    ReadPgmFile(img_filename, (unsigned char *)img);
+    NormalizeImg((unsigned char *)img, (float *)IN[i], IMG_WIDTH, IMG_HEIGHT);
+  }
+  ACT = malloc((size_t)ncalib * POOL1_NBOUTPUT * POOL1_HEIGHT * POOL1_WIDTH * sizeof(float));
+  if (!ACT) {
+    printf("Error: Unable to allocate the calibration activations.\n");
+    exit(1);
+  }
+
+  // Conv2 + Fc1 + Fc2 weights: 32 bits each in float, 2 bits (pos / neg) when ternary, 1 when binary
+  wbits = (long)CONV2_NBOUTPUT*POOL1_NBOUTPUT*CONV2_DIM*CONV2_DIM + (long)FC1_NBOUTPUT*FC1_NBINPUT + FC2_NBOUTPUT*FC1_NBOUTPUT;
+  acc_ref = evaluate(1, &us_ref);
+#ifdef __AVX512VPOPCNTDQ__
+  printf("Popcount: AVX-512 VPOPCNTQ (Fc1 / Fc2), %d calibration images\n\n", ncalib);
+#else
+  printf("Popcount: scalar, %d calibration images\n\n", ncalib);
+#endif
+  printf("weights \t act bits \t accuracy \t us/image \t speedup \t Conv2+Fc weights\n");
+  printf("float   \t    32    \t %6.2f%% \t %8.1f \t   x1.00 \t %6ld KB\n", acc_ref, us_ref, wbits * 4 / 1024);
+  for (bin = 1; bin >= 0; bin--)
+    for (b = 1; b <= TERN_ABITS_MAX; b++) {
+      weights(bin);
+      calibrate(b, ncalib);
+      acc = evaluate(0, &us);
+      printf("%-7s \t %5d    \t %6.2f%% \t %8.1f \t   x%.2f \t %6ld KB\n", bin ? "binary" : "ternary", b, acc, us,
+             us_ref / us, wbits * (bin ? 1 : 2) / 8 / 1024);
+    }
+
+  weights(binary);
+  calibrate(abits, ncalib);
+  WriteLenetTernary(out_filename, &T);
+  printf("\n%s weights, %d-bit activations (steps %.4f %.4f %.4f) written to %s\n", binary ? "Binary" : "Ternary", abits,
+         T.act_step[0], T.act_step[1], T.act_step[2], out_filename);
+  free(ACT);
+  return 0;
+}
@@ -0,0 +1,330 @@
+/**
+  ******************************************************************************
+  * @file    tune.c
+  * @brief   Startup autotuner: picks the fastest kernel variant per layer and the
+  * @brief   thread configuration on the actual host, for a target batch size
+  * @brief   Candidates: Conv2 direct or line-buffer (conv.c; Conv1 stays direct, its
+  * @brief   line-buffer kernel is for HLS only), Fc1/Fc2 dense or zero-skipping (fc.c),
+  * @brief   then serial, intra-image team (lenet_par.c) or, for batches, one image per
+  * @brief   team thread. All candidates are bit-identical, a candidate whose logits
+  * @brief   differ from lenet_cnn() is discarded.
+  * @brief   The result is cached in a text file keyed by CPU model, model hash and
+  * @brief   batch size, so later runs load it without re-tuning. Host only, not for HLS.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "lenet_cnn_float.h"
+
+// timed passes per candidate (the fastest one counts)
+#ifndef TUNE_REPEAT
+#define TUNE_REPEAT	5
+#endif
+
+static double now(void) {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return (double)t.tv_sec + (double)t.tv_usec/1000000.0;
+}
+
+static inline float relu(float x) { return x > 0.0f ? x : 0.0f; }
+
+static void relu_n(float *p, int n) {
+  for (int i = 0; i < n; i++) p[i] = relu(p[i]);
+}
+
+/* 64-bit hash of the float weights (same mixer as ImgHash) */
+unsigned long long ModelHash(LenetWeights *w) {
+  const unsigned char *p = (const unsigned char *)w;
+  unsigned long long h = 0x9E3779B97F4A7C15ULL, v;
+  size_t i;
+
+  for (i = 0; i + 8 <= sizeof(LenetWeights); i += 8) {
+    memcpy(&v, &p[i], 8);
+    h ^= v * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 31)) * 0x94D049BB133111EBULL;
+  }
+  for (; i < sizeof(LenetWeights); i++) h = (h ^ p[i]) * 0x100000001B3ULL;
+  return h ^ (h >> 29);
+}
+
+/* "model name" of /proc/cpuinfo, blanks and separators replaced by '_' */
+void TuneCpuModel(char *cpu, int size) {
+  FILE *f = fopen("/proc/cpuinfo", "r");
+  char line[256], *p = NULL;
+
+  snprintf(cpu, size, "unknown");
+  if (!f) return;
+  while (fgets(line, sizeof(line), f))
+    if (!strncmp(line, "model name", 10) && (p = strchr(line, ':'))) break;
+  fclose(f);
+  if (!p) return;
+  for (p++; *p == ' '; p++);
+  p[strcspn(p, "\n")] = 0;
+  snprintf(cpu, size, "%s", p);
+  for (p = cpu; *p; p++) if (*p == ' ' || *p == '\t') *p = '_';
+}
+
+/* One image with the per-layer variants of c (serial) */
+static void lenet_cnn_variants(TuneConfig *c, LenetModel *m, float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], float output[FC2_NBOUTPUT]) {
+  LenetWeights *w = &m->w;
+  float conv1[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH], pool1[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH];
+  float conv2[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH], pool2[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH];
+  float fc1[FC1_NBOUTPUT];
+
+  Conv1_28x28x1_5x5x20_1_0(input, w->conv1_kernel, w->conv1_bias, conv1);
+  relu_n(&conv1[0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+  Pool1_24x24x20_2x2x20_2_0(conv1, pool1);
+  if (c->conv2 == TUNE_LINEBUF) Conv2_12x12x20_5x5x40_1_0_lb(pool1, w->conv2_kernel, w->conv2_bias, conv2);
+  else                          Conv2_12x12x20_5x5x40_1_0(pool1, w->conv2_kernel, w->conv2_bias, conv2);
+  relu_n(&conv2[0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+  Pool2_8x8x40_2x2x40_2_0(conv2, pool2);
+  if (c->fc1 == TUNE_SPARSE) Fc1_40_400_sparse(pool2, m->fc1_kernel_t, w->fc1_bias, fc1, NULL);
+  else                       Fc1_40_400(pool2, w->fc1_kernel, w->fc1_bias, fc1);
+  relu_n(fc1, FC1_NBOUTPUT);
+  if (c->fc2 == TUNE_SPARSE) Fc2_400_10_sparse(fc1, m->fc2_kernel_t, w->fc2_bias, output, NULL);
+  else                       Fc2_400_10(fc1, w->fc2_kernel, w->fc2_bias, output);
+}
+
+typedef struct {
+  TuneConfig 	*c;
+  LenetModel 	*m;
+  float 		(*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH];
+  float 		(*outputs)[FC2_NBOUTPUT];
+  int 			n;
+} BatchJob;
+
+static void batch_job(void *arg, int id, int nthreads) {
+  BatchJob *b = (BatchJob *)arg;
+  for (int i = id; i < b->n; i += nthreads) lenet_cnn_variants(b->c, b->m, b->inputs[i], b->outputs[i]);
+}
+
+/* Classifies n images with configuration c (TuneApply must have started its team) */
+void lenet_cnn_tuned_batch(TuneConfig *c, LenetModel *m, float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, float (*outputs)[FC2_NBOUTPUT]) {
+  int i;
+
+  if (c->threads > 1 && c->split == TUNE_SPLIT_IMAGE)
+    for (i = 0; i < n; i++) lenet_cnn_parallel(inputs[i], &m->w, outputs[i]);
+  else if (c->threads > 1 && n > 1) {
+    BatchJob b = { c, m, inputs, outputs, n };
+    TeamRun(batch_job, &b);
+  }
+  else
+    for (i = 0; i < n; i++) lenet_cnn_variants(c, m, inputs[i], outputs[i]);
+}
+
+void lenet_cnn_tuned(TuneConfig *c, LenetModel *m, float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], float output[FC2_NBOUTPUT]) {
+  lenet_cnn_tuned_batch(c, m, (float (*)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH])input, 1, (float (*)[FC2_NBOUTPUT])output);
+}
+
+/* Starts the thread team the configuration needs */
+void TuneApply(TuneConfig *c) {
+  if (TeamSize() > 1) TeamFree();
+  if (c->threads > 1) TeamInit(c->threads);
+}
+
+/* ---------------------------------------------------------------- cache file */
+
+static void cache_key(char *key, int size, const char *cpu, unsigned long long hash, int batch) {
+  snprintf(key, size, "%s\t%016llx\t%d\t", cpu, hash, batch);
+}
+
+/* Looks up the configuration for (cpu, hash, batch) in path, returns 1 when found */
+int TuneLoad(const char *path, const char *cpu, unsigned long long hash, int batch, TuneConfig *c) {
+  FILE *f = fopen(path, "r");
+  char line[512], key[320];
+  int found = 0;
+
+  memset(c, 0, sizeof(*c));
+  if (!f) return 0;
+  cache_key(key, sizeof(key), cpu, hash, batch);
+  while (!found && fgets(line, sizeof(line), f)) {
+    if (strncmp(line, key, strlen(key))) continue;
+    found = sscanf(line + strlen(key), "conv1=%d conv2=%d fc1=%d fc2=%d threads=%d split=%d us=%f",
+                   &c->conv1, &c->conv2, &c->fc1, &c->fc2, &c->threads, &c->split, &c->image_us) == 7
+            && c->conv1 == TUNE_DIRECT; 	// older entries may hold the Conv1 line buffer: re-tune
+  }
+  fclose(f);
+  c->batch = batch;
+  return found;
+}
+
+/* Stores c under (cpu, hash, c->batch), replacing a previous entry with the same key */
+void TuneSave(const char *path, const char *cpu, unsigned long long hash, TuneConfig *c) {
+  FILE *f = fopen(path, "r"), *out;
+  char line[512], key[320], tmp[256];
+  int  n = 0, cap = 0, i;
+  char **keep = NULL;
+
+  cache_key(key, sizeof(key), cpu, hash, c->batch);
+  if (f) {
+    while (fgets(line, sizeof(line), f)) {
+      if (!strncmp(line, key, strlen(key))) continue;
+      if (n == cap) keep = realloc(keep, (cap = cap ? 2*cap : 16) * sizeof(char *));
+      keep[n++] = strdup(line);
+    }
+    fclose(f);
+  }
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  out = fopen(tmp, "w");
+  if (!out) {
+    printf("Error: Unable to write tuning cache %s.\n", tmp);
+    exit(1);
+  }
+  for (i = 0; i < n; i++) { fputs(keep[i], out); free(keep[i]); }
+  fprintf(out, "%sconv1=%d conv2=%d fc1=%d fc2=%d threads=%d split=%d us=%.2f\n", key,
+          c->conv1, c->conv2, c->fc1, c->fc2, c->threads, c->split, c->image_us);
+  fclose(out);
+  free(keep);
+  rename(tmp, path);
+}
+
+/* ---------------------------------------------------------------- tuning */
+
+/* n images in groups of c->batch, best of TUNE_REPEAT passes, us per image */
+static double time_batch(TuneConfig *c, LenetModel *m, float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n,
+                         float (*outputs)[FC2_NBOUTPUT]) {
+  double best = 1e30, s;
+  int r, i;
+
+  TuneApply(c);
+  for (r = 0; r <= TUNE_REPEAT; r++) {
+    s = now();
+    for (i = 0; i < n; i += c->batch)
+      lenet_cnn_tuned_batch(c, m, inputs + i, n - i < c->batch ? n - i : c->batch, outputs + i);
+    s = now() - s;
+    if (r && s < best) best = s; 	// pass 0 warms up
+  }
+  return best / n * 1e6;
+}
+
+/* per-layer time of one variant over n images' activations, us per image */
+static double time_layer(int layer, int variant, LenetModel *m, int n, void *in, void *out) {
+  LenetWeights *w = &m->w;
+  double best = 1e30, s;
+  int r, i;
+
+  for (r = 0; r <= TUNE_REPEAT; r++) {
+    s = now();
+    for (i = 0; i < n; i++)
+      switch (layer) {
+      case 0: {
+        float (*x)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH] = in;
+        float (*y)[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH] = out;
+        Conv1_28x28x1_5x5x20_1_0(x[i], w->conv1_kernel, w->conv1_bias, y[i]);
+        break; }
+      case 1: {
+        float (*x)[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH] = in;
+        float (*y)[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH] = out;
+        if (variant) Conv2_12x12x20_5x5x40_1_0_lb(x[i], w->conv2_kernel, w->conv2_bias, y[i]);
+        else         Conv2_12x12x20_5x5x40_1_0(x[i], w->conv2_kernel, w->conv2_bias, y[i]);
+        break; }
+      case 2: {
+        float (*x)[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH] = in;
+        float (*y)[FC1_NBOUTPUT] = out;
+        if (variant) Fc1_40_400_sparse(x[i], m->fc1_kernel_t, w->fc1_bias, y[i], NULL);
+        else         Fc1_40_400(x[i], w->fc1_kernel, w->fc1_bias, y[i]);
+        break; }
+      default: {
+        float (*x)[FC1_NBOUTPUT] = in;
+        float (*y)[FC2_NBOUTPUT] = out;
+        if (variant) Fc2_400_10_sparse(x[i], m->fc2_kernel_t, w->fc2_bias, y[i], NULL);
+        else         Fc2_400_10(x[i], w->fc2_kernel, w->fc2_bias, y[i]);
+        break; }
+      }
+    s = now() - s;
+    if (r && s < best) best = s; 	// pass 0 warms up
+  }
+  return best / n * 1e6;
+}
+
+/* Times every candidate on inputs[0 .. n-1], fed in groups of batch images, and fills c with the fastest */
+void TuneRun(LenetModel *m, float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, int batch, int verbose, TuneConfig *c) {
+  LenetWeights *w = &m->w;
+  float 	(*conv1)[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH] = malloc(n * sizeof(*conv1));
+  float 	(*pool1)[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH] = malloc(n * sizeof(*pool1));
+  float 	(*conv2)[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH] = malloc(n * sizeof(*conv2));
+  float 	(*pool2)[POOL2_NBOUTPUT][POOL2_HEIGHT][POOL2_WIDTH] = malloc(n * sizeof(*pool2));
+  float 	(*fc1)[FC1_NBOUTPUT] = malloc(n * sizeof(*fc1));
+  float 	(*ref)[FC2_NBOUTPUT] = malloc(n * sizeof(*ref));
+  float 	(*out)[FC2_NBOUTPUT] = malloc(n * sizeof(*out));
+  void 		*layer_in[TUNE_NB_LAYERS] = { inputs, pool1, pool2, fc1 };
+  size_t 	layer_out[TUNE_NB_LAYERS] = { sizeof(*conv1), sizeof(*conv2), sizeof(*fc1), sizeof(*out) };
+  int 		*choice[TUNE_NB_LAYERS] = { &c->conv1, &c->conv2, &c->fc1, &c->fc2 };
+  const char *name[TUNE_NB_LAYERS] = { "Conv1", "Conv2", "Fc1", "Fc2" };
+  const char *variant[TUNE_NB_LAYERS][2] = { { "direct", NULL }, { "direct", "line-buffer" },
+                                             { "dense", "sparse" }, { "dense", "sparse" } };
+  int 		ncpu = sysconf(_SC_NPROCESSORS_ONLN), l, v, i, t, split;
+  double 	us, tv[2];
+  TuneConfig cand;
+
+  memset(c, 0, sizeof(*c));
+  c->batch = batch;
+  c->threads = 1;
+
+  // reference activations, for the per-layer timings and the checks
+  for (i = 0; i < n; i++) {
+    Conv1_28x28x1_5x5x20_1_0(inputs[i], w->conv1_kernel, w->conv1_bias, conv1[i]);
+    relu_n(&conv1[i][0][0][0], CONV1_NBOUTPUT*CONV1_HEIGHT*CONV1_WIDTH);
+    Pool1_24x24x20_2x2x20_2_0(conv1[i], pool1[i]);
+    Conv2_12x12x20_5x5x40_1_0(pool1[i], w->conv2_kernel, w->conv2_bias, conv2[i]);
+    relu_n(&conv2[i][0][0][0], CONV2_NBOUTPUT*CONV2_HEIGHT*CONV2_WIDTH);
+    Pool2_8x8x40_2x2x40_2_0(conv2[i], pool2[i]);
+    Fc1_40_400(pool2[i], w->fc1_kernel, w->fc1_bias, fc1[i]);
+    relu_n(fc1[i], FC1_NBOUTPUT);
+    lenet_cnn(inputs[i], w->conv1_kernel, w->conv1_bias, w->conv2_kernel, w->conv2_bias,
+              w->fc1_kernel, w->fc1_bias, w->fc2_kernel, w->fc2_bias, ref[i]);
+  }
+
+  // per layer: fastest kernel variant, fed with the reference activations
+  for (l = 0; l < TUNE_NB_LAYERS; l++) {
+    void *scratch = malloc(n * layer_out[l]);
+    for (v = 0; v < 2 && variant[l][v]; v++) tv[v] = time_layer(l, v, m, n, layer_in[l], scratch);
+    *choice[l] = variant[l][1] && tv[1] < tv[0];
+    c->us[l] = tv[*choice[l]];
+    if (verbose && variant[l][1]) printf("  %-5s : %-11s %8.2f us \t %-11s %8.2f us\n", name[l], variant[l][0], tv[0], variant[l][1], tv[1]);
+    else if (verbose)             printf("  %-5s : %-11s %8.2f us\n", name[l], variant[l][0], tv[0]);
+    free(scratch);
+  }
+
+  // whole network: serial, intra-image team, one image per team thread
+  c->image_us = time_batch(c, m, inputs, n, out);
+  if (verbose) printf("  serial, tuned kernels : %8.2f us/image\n", c->image_us);
+  for (t = 2; t <= ncpu && t <= TEAM_MAX; t = (t < ncpu && 2*t > ncpu) ? ncpu : 2*t)
+    for (split = TUNE_SPLIT_IMAGE; split <= TUNE_SPLIT_BATCH; split++) {
+      if (split == TUNE_SPLIT_BATCH && batch < 2) continue;
+      cand = *c;
+      cand.threads = t;
+      cand.split = split;
+      us = time_batch(&cand, m, inputs, n, out);
+      for (i = 0; i < n; i++) if (memcmp(out[i], ref[i], sizeof(out[i]))) break;
+      if (verbose) printf("  %2d threads, %-12s : %8.2f us/image%s\n", t, split == TUNE_SPLIT_IMAGE ? "split image" : "split batch",
+                          us, i < n ? " (mismatch, discarded)" : "");
+      if (i == n && us < c->image_us) { cand.image_us = us; *c = cand; }
+    }
+  if (TeamSize() > 1) TeamFree();
+
+  free(conv1); free(pool1); free(conv2); free(pool2); free(fc1); free(ref); free(out);
+}
+
+/* Loads the cached configuration for this host, model and batch, or tunes and caches it.
+   Returns 1 when loaded from path. The configuration's team is started (TuneApply). */
+int LenetAutotune(const char *path, LenetModel *m, float (*inputs)[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], int n, int batch,
+                  int verbose, TuneConfig *c) {
+  char 		cpu[200];
+  unsigned long long hash = ModelHash(&m->w);
+  int 		cached;
+
+  TuneCpuModel(cpu, sizeof(cpu));
+  cached = TuneLoad(path, cpu, hash, batch, c);
+  if (!cached) {
+    TuneRun(m, inputs, n, batch, verbose, c);
+    TuneSave(path, cpu, hash, c);
+  }
+  TuneApply(c);
+  return cached;
+}
@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "lenet_cnn_float.h"
 #include "hdf5.h"
@@ -30,6 +31,7 @@ void ReadPgmFile(char *filename, unsigned char *pix) {
   ret = fscanf (pgm_file, "%d", &width);
   ret = fscanf (pgm_file, "%d", &height);
   ret = fscanf (pgm_file, "%d", &max);
+  (void)fgetc(pgm_file); // single whitespace before the pixel data, not a pixel
 //  printf("Reading PGM file %s \t -> Type %s, width %d, height %d, max %d\n", filename, readChars, width, height, max);
 //  if (width != IMG_WIDTH) printf("Warning: Image width mismatch (%d, expecting %d) \t -> Consider rescaling\n", width, IMG_WIDTH); 
 //  if (height != IMG_HEIGHT) printf("Warning: Image height mismatch(%d, expecting %d) \t -> Consider rescaling\n", height, IMG_HEIGHT); 
@@ -307,3 +309,201 @@ void ReadFc2Bias(char *filename, char *datasetname, float *bias) {
 
 
 
+
+
+/* Reads the whole model (same HDF5 dataset names as main) */
+void ReadLenetWeights(char *filename, LenetWeights *w) {
+  ReadConv1Weights(filename, "/layers/conv2d/vars/0",   w->conv1_kernel);
+  ReadConv1Bias   (filename, "/layers/conv2d/vars/1",   w->conv1_bias); 
+  ReadConv2Weights(filename, "/layers/conv2d_1/vars/0", w->conv2_kernel);
+  ReadConv2Bias   (filename, "/layers/conv2d_1/vars/1", w->conv2_bias); 
+  ReadFc1Weights  (filename, "/layers/dense/vars/0",    w->fc1_kernel);
+  ReadFc1Bias     (filename, "/layers/dense/vars/1",    w->fc1_bias);
+  ReadFc2Weights  (filename, "/layers/dense_1/vars/0",  w->fc2_kernel);
+  ReadFc2Bias     (filename, "/layers/dense_1/vars/1",  w->fc2_bias);
+}
+
+
+// Low-rank Fc1 factors (fc1_lowrank tool): "LRF1", rank, FC1_NBINPUT, FC1_NBOUTPUT (int32),
+// then v[rank][FC1_NBINPUT] and u[FC1_NBOUTPUT][rank], float
+void ReadFc1LowRank(char *filename, Fc1LowRank *f) {
+  FILE *file; 
+  char magic[4]; 
+  int hdr[3], k, o, ok; 
+
+  file = fopen(filename, "rb"); 
+  if (!file) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  ok = fread(magic, 1, 4, file) == 4 && !memcmp(magic, "LRF1", 4) && fread(hdr, sizeof(int), 3, file) == 3 
+       && hdr[0] >= 1 && hdr[0] <= FC1_RANK_MAX && hdr[1] == FC1_NBINPUT && hdr[2] == FC1_NBOUTPUT; 
+  if (ok) {
+    f->rank = hdr[0]; 
+    for (k = 0; ok && k < f->rank; k++) ok = fread(f->v[k], sizeof(float), FC1_NBINPUT, file) == FC1_NBINPUT; 
+    for (o = 0; ok && o < FC1_NBOUTPUT; o++) ok = fread(f->u[o], sizeof(float), f->rank, file) == (size_t)f->rank; 
+  }
+  fclose(file); 
+  if (!ok) {
+    printf("Error: %s is not a low-rank Fc1 file for this model (rank <= %d).\n", filename, FC1_RANK_MAX);
+    exit(1);
+  }
+}
+
+
+void WriteFc1LowRank(char *filename, Fc1LowRank *f) {
+  FILE *file; 
+  int hdr[3] = { f->rank, FC1_NBINPUT, FC1_NBOUTPUT }, k, o; 
+
+  file = fopen(filename, "wb"); 
+  if (!file) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  fwrite("LRF1", 1, 4, file); 
+  fwrite(hdr, sizeof(int), 3, file); 
+  for (k = 0; k < f->rank; k++) fwrite(f->v[k], sizeof(float), FC1_NBINPUT, file); 
+  for (o = 0; o < FC1_NBOUTPUT; o++) fwrite(f->u[o], sizeof(float), f->rank, file); 
+  fclose(file); 
+}
+
+
+// Channel-pruned model (prune tool): "LPR1", nb_conv1, nb_conv2 (int32), the kept
+// channel numbers (int16), then the compacted tensors, float: conv1 kernel / bias,
+// conv2 kernel [nb_conv2][nb_conv1] / bias, fc1 kernel [400][nb_conv2][4][4] / bias, fc2
+void ReadLenetPruned(char *filename, LenetPruned *p) {
+  FILE *file; 
+  char magic[4]; 
+  int hdr[2], m, o, ok; 
+  LenetWeights *w = &p->w; 
+
+  file = fopen(filename, "rb"); 
+  if (!file) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  memset(p, 0, sizeof(*p)); 
+  ok = fread(magic, 1, 4, file) == 4 && !memcmp(magic, "LPR1", 4) && fread(hdr, sizeof(int), 2, file) == 2 
+       && hdr[0] >= 1 && hdr[0] <= CONV1_NBOUTPUT && hdr[1] >= 1 && hdr[1] <= CONV2_NBOUTPUT; 
+  if (ok) {
+    p->nb_conv1 = hdr[0]; 
+    p->nb_conv2 = hdr[1]; 
+    ok = fread(p->conv1_index, sizeof(short), p->nb_conv1, file) == (size_t)p->nb_conv1 
+         && fread(p->conv2_index, sizeof(short), p->nb_conv2, file) == (size_t)p->nb_conv2 
+         && fread(w->conv1_kernel, sizeof(w->conv1_kernel[0]), p->nb_conv1, file) == (size_t)p->nb_conv1 
+         && fread(w->conv1_bias, sizeof(float), p->nb_conv1, file) == (size_t)p->nb_conv1; 
+    for (m = 0; ok && m < p->nb_conv2; m++) 
+      ok = fread(w->conv2_kernel[m], sizeof(w->conv2_kernel[0][0]), p->nb_conv1, file) == (size_t)p->nb_conv1; 
+    ok = ok && fread(w->conv2_bias, sizeof(float), p->nb_conv2, file) == (size_t)p->nb_conv2; 
+    for (o = 0; ok && o < FC1_NBOUTPUT; o++) 
+      ok = fread(w->fc1_kernel[o], sizeof(w->fc1_kernel[0][0]), p->nb_conv2, file) == (size_t)p->nb_conv2; 
+    ok = ok && fread(w->fc1_bias, sizeof(w->fc1_bias), 1, file) == 1 
+            && fread(w->fc2_kernel, sizeof(w->fc2_kernel), 1, file) == 1 
+            && fread(w->fc2_bias, sizeof(w->fc2_bias), 1, file) == 1; 
+  }
+  fclose(file); 
+  if (!ok) {
+    printf("Error: %s is not a pruned LeNet model.\n", filename);
+    exit(1);
+  }
+}
+
+
+void WriteLenetPruned(char *filename, LenetPruned *p) {
+  FILE *file; 
+  int hdr[2] = { p->nb_conv1, p->nb_conv2 }, m, o; 
+  LenetWeights *w = &p->w; 
+
+  file = fopen(filename, "wb"); 
+  if (!file) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  fwrite("LPR1", 1, 4, file); 
+  fwrite(hdr, sizeof(int), 2, file); 
+  fwrite(p->conv1_index, sizeof(short), p->nb_conv1, file); 
+  fwrite(p->conv2_index, sizeof(short), p->nb_conv2, file); 
+  fwrite(w->conv1_kernel, sizeof(w->conv1_kernel[0]), p->nb_conv1, file); 
+  fwrite(w->conv1_bias, sizeof(float), p->nb_conv1, file); 
+  for (m = 0; m < p->nb_conv2; m++) fwrite(w->conv2_kernel[m], sizeof(w->conv2_kernel[0][0]), p->nb_conv1, file); 
+  fwrite(w->conv2_bias, sizeof(float), p->nb_conv2, file); 
+  for (o = 0; o < FC1_NBOUTPUT; o++) fwrite(w->fc1_kernel[o], sizeof(w->fc1_kernel[0][0]), p->nb_conv2, file); 
+  fwrite(w->fc1_bias, sizeof(w->fc1_bias), 1, file); 
+  fwrite(w->fc2_kernel, sizeof(w->fc2_kernel), 1, file); 
+  fwrite(w->fc2_bias, sizeof(w->fc2_bias), 1, file); 
+  fclose(file); 
+}
+
+
+void MnistImgFilename(char *filename, int m) {
+  sprintf(filename, "mnist/t10k-images-idx3-ubyte[%05d].pgm", m); 
+}
+
+
+/* Reads up to size labels (8 header bytes skipped), returns the number read */
+int ReadMnistLabels(char *filename, unsigned char *labels, int size) {
+  FILE* label_file; 
+  int k, lab; 
+
+  label_file = fopen( filename, "rb" );
+  if (!label_file) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  for (k = 0; k < 8; k++) (void)fgetc(label_file); 
+  for (k = 0; k < size && (lab = fgetc(label_file)) != EOF; k++)
+    labels[k] = (unsigned char)lab; 
+
+  fclose(label_file); 
+  return k; 
+}
+
+
+/* Folds NormalizeImg's 1/255 (or any input scale) into the Conv1 kernel, for Conv1_..._u8 */
+void FoldInputScale(float kernel[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], float folded[CONV1_NBOUTPUT][IMG_DEPTH][CONV1_DIM][CONV1_DIM], float scale) {
+  short 	i, j, k, l; 
+
+  for (i = 0; i < CONV1_NBOUTPUT; i++)
+    for (j = 0; j < IMG_DEPTH; j++)
+      for (k = 0; k < CONV1_DIM; k++)
+        for (l = 0; l < CONV1_DIM; l++)
+          folded[i][j][k][l] = kernel[i][j][k][l] * scale; 
+}
+
+
+void ReadLenetTernary(char *filename, LenetTernary *t) {
+  FILE *file; 
+  char magic[4]; 
+  int size, ok; 
+
+  file = fopen(filename, "rb"); 
+  if (!file) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  // plain data, written whole: the size guards against a TERN_ABITS_MAX / layout mismatch
+  ok = fread(magic, 1, 4, file) == 4 && !memcmp(magic, "LTB1", 4) && fread(&size, sizeof(int), 1, file) == 1 
+       && size == (int)sizeof(*t) && fread(t, sizeof(*t), 1, file) == 1 
+       && t->abits >= 1 && t->abits <= TERN_ABITS_MAX; 
+  fclose(file); 
+  if (!ok) {
+    printf("Error: %s is not a ternary LeNet model.\n", filename);
+    exit(1);
+  }
+}
+
+
+void WriteLenetTernary(char *filename, LenetTernary *t) {
+  FILE *file; 
+  int size = sizeof(*t); 
+
+  file = fopen(filename, "wb"); 
+  if (!file) {
+    printf("Error: Unable to open file %s.\n", filename);
+    exit(1);
+  }
+  fwrite("LTB1", 1, 4, file); 
+  fwrite(&size, sizeof(int), 1, file); 
+  fwrite(t, sizeof(*t), 1, file); 
+  fclose(file); 
+}
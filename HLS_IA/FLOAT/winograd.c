@@ -0,0 +1,203 @@
+/**
+  ******************************************************************************
+  * @file    winograd.c
+  * @brief   Winograd F(m x m, 5x5) Conv1 / Conv2, host only
+  * @brief   Y = A^T [ (G g G^T) . (B^T d B) ] A on (m+4) x (m+4) input tiles, m = WINO_M
+  * @brief   (2: F(2x2,5x5), 36 products per 2x2 block instead of 100; 4: F(4x4,5x5),
+  * @brief   64 instead of 400, at a larger rounding error). The Cook-Toom matrices are
+  * @brief   built from the interpolation points 0, +-1, +-2 (+-1/2), and WinogradPrepare
+  * @brief   transforms the kernels once (G g G^T, in double). WINO_TILES output blocks are
+  * @brief   transformed together, the tile index innermost, so that the input / output
+  * @brief   transforms and the per-point channel products are SIMD loops over the tiles.
+  * @brief   Not bit-identical to conv.c (different summation order): see bench_winograd.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lenet_cnn_float.h"
+
+#if (CONV1_HEIGHT % WINO_M) || (CONV1_WIDTH % WINO_M) || (CONV2_HEIGHT % WINO_M) || (CONV2_WIDTH % WINO_M)
+#error "WINO_M must divide the Conv1 and Conv2 output sizes"
+#endif
+
+#define MAX_C	POOL1_NBOUTPUT 	// input channels of the largest layer
+#define MAX_M	CONV2_NBOUTPUT 	// output channels
+
+#if WINO_M == 2
+static const double POINTS[WINO_N-1] = { 0.0, 1.0, -1.0, 2.0, -2.0 };
+#elif WINO_M == 4
+static const double POINTS[WINO_N-1] = { 0.0, 1.0, -1.0, 2.0, -2.0, 0.5, -0.5 };
+#else
+#error "WINO_M must be 2 or 4"
+#endif
+
+/* Cook-Toom F(WINO_M, 5) for correlation, points a_j and infinity:
+   A^T[i][j] = a_j^i, G[j][k] = a_j^k / prod_{l!=j}(a_j - a_l), B^T[j] = coefficients of
+   M(x) / (x - a_j) with M(x) = prod_j (x - a_j), last rows from the point at infinity */
+static void matrices(double at[WINO_M][WINO_N], double g[WINO_N][CONV2_DIM], double bt[WINO_N][WINO_N]) {
+  double 	mc[WINO_N], f, p;
+  int 		i, j, k, l;
+
+  memset(at, 0, WINO_M * WINO_N * sizeof(double));
+  memset(g, 0, WINO_N * CONV2_DIM * sizeof(double));
+  memset(bt, 0, WINO_N * WINO_N * sizeof(double));
+
+  for (k = 0; k < WINO_N; k++) mc[k] = 0.0;
+  mc[0] = 1.0;
+  for (l = 0; l < WINO_N-1; l++) 				// mc *= (x - a_l)
+    for (k = l + 1; k >= 0; k--) mc[k] = (k ? mc[k-1] : 0.0) - POINTS[l] * mc[k];
+
+  for (j = 0; j < WINO_N-1; j++) {
+    for (i = 0, p = 1.0; i < WINO_M; i++, p *= POINTS[j]) at[i][j] = p;
+    for (l = 0, f = 1.0; l < WINO_N-1; l++) if (l != j) f *= POINTS[j] - POINTS[l];
+    for (k = 0, p = 1.0; k < CONV2_DIM; k++, p *= POINTS[j]) g[j][k] = p / f;
+    bt[j][WINO_N-2] = mc[WINO_N-1]; 			// synthetic division by (x - a_j)
+    for (k = WINO_N-2; k > 0; k--) bt[j][k-1] = mc[k] + POINTS[j] * bt[j][k];
+  }
+  at[WINO_M-1][WINO_N-1] = 1.0;
+  g[WINO_N-1][CONV2_DIM-1] = 1.0;
+  for (k = 0; k < WINO_N; k++) bt[WINO_N-1][k] = mc[k];
+}
+
+/* u[p][m][c] = (G kernel[m][c] G^T)[p] */
+static void transform_kernel(const float *kernel, int nm, int nc, double g[WINO_N][CONV2_DIM], float *u) {
+  double 	t[WINO_N][CONV2_DIM], s;
+  int 		m, c, i, j, k;
+
+  for (m = 0; m < nm; m++)
+    for (c = 0; c < nc; c++) {
+      const float *w = kernel + (m * nc + c) * CONV2_DIM * CONV2_DIM;
+      for (i = 0; i < WINO_N; i++)
+        for (j = 0; j < CONV2_DIM; j++) {
+          for (k = 0, s = 0.0; k < CONV2_DIM; k++) s += g[i][k] * w[k * CONV2_DIM + j];
+          t[i][j] = s;
+        }
+      for (i = 0; i < WINO_N; i++)
+        for (j = 0; j < WINO_N; j++) {
+          for (k = 0, s = 0.0; k < CONV2_DIM; k++) s += t[i][k] * g[j][k];
+          u[((i * WINO_N + j) * nm + m) * nc + c] = (float)s;
+        }
+    }
+}
+
+void WinogradPrepare(LenetWeights *w, int layers, LenetWinograd *g) {
+  double 	at[WINO_M][WINO_N], gm[WINO_N][CONV2_DIM], bt[WINO_N][WINO_N];
+  int 		i, j;
+
+  matrices(at, gm, bt);
+  g->layers = layers;
+  for (i = 0; i < WINO_N; i++)
+    for (j = 0; j < WINO_N; j++) g->bt[i][j] = (float)bt[i][j];
+  for (i = 0; i < WINO_M; i++)
+    for (j = 0; j < WINO_N; j++) g->at[i][j] = (float)at[i][j];
+  transform_kernel(&w->conv1_kernel[0][0][0][0], CONV1_NBOUTPUT, IMG_DEPTH, gm, &g->conv1_u[0][0][0]);
+  transform_kernel(&w->conv2_kernel[0][0][0][0], CONV2_NBOUTPUT, POOL1_NBOUTPUT, gm, &g->conv2_u[0][0][0]);
+}
+
+/* input [nc][ih][iw], u [WINO_P][nm][nc] -> output [nm][oh][ow] */
+static void conv(const float *input, int nc, int ih, int iw, const float *u, const float *bias,
+                 int nm, int oh, int ow, const LenetWinograd *g, float *output) {
+  float 	v[WINO_P][MAX_C][WINO_TILES], mp[WINO_P][MAX_M][WINO_TILES];
+  float 	d[WINO_N][WINO_N][WINO_TILES], t1[WINO_N][WINO_N][WINO_TILES];
+  float 	acc[WINO_TILES], b;
+  int 		y0[WINO_TILES], x0[WINO_TILES];
+  const int tx = ow / WINO_M, ntiles = (oh / WINO_M) * tx;
+  int 		t0, nt, t, c, m, p, i, j, k;
+
+  for (t0 = 0; t0 < ntiles; t0 += WINO_TILES) {
+    nt = ntiles - t0 < WINO_TILES ? ntiles - t0 : WINO_TILES;
+    for (t = 0; t < nt; t++) {
+      y0[t] = (t0 + t) / tx * WINO_M;
+      x0[t] = (t0 + t) % tx * WINO_M;
+    }
+
+    // input transform B^T d B, one channel at a time
+    for (c = 0; c < nc; c++) {
+      const float *in = input + c * ih * iw;
+      for (i = 0; i < WINO_N; i++)
+        for (j = 0; j < WINO_N; j++)
+          for (t = 0; t < WINO_TILES; t++)
+            d[i][j][t] = t < nt ? in[(y0[t] + i) * iw + x0[t] + j] : 0.0f;
+      for (i = 0; i < WINO_N; i++) {
+        for (j = 0; j < WINO_N; j++)
+          for (t = 0; t < WINO_TILES; t++) t1[i][j][t] = 0.0f;
+        for (k = 0; k < WINO_N; k++) {
+          if ((b = g->bt[i][k]) == 0.0f) continue;
+          for (j = 0; j < WINO_N; j++)
+            for (t = 0; t < WINO_TILES; t++) t1[i][j][t] += b * d[k][j][t];
+        }
+      }
+      for (i = 0; i < WINO_N; i++)
+        for (j = 0; j < WINO_N; j++) {
+          for (t = 0; t < WINO_TILES; t++) acc[t] = 0.0f;
+          for (k = 0; k < WINO_N; k++) {
+            if ((b = g->bt[j][k]) == 0.0f) continue;
+            for (t = 0; t < WINO_TILES; t++) acc[t] += b * t1[i][k][t];
+          }
+          for (t = 0; t < WINO_TILES; t++) v[i * WINO_N + j][c][t] = acc[t];
+        }
+    }
+
+    // per point: output channels x input channels products, the only nm * nc work
+    for (p = 0; p < WINO_P; p++)
+      for (m = 0; m < nm; m++) {
+        const float *w = u + (p * nm + m) * nc;
+        for (t = 0; t < WINO_TILES; t++) acc[t] = 0.0f;
+        for (c = 0; c < nc; c++)
+          for (t = 0; t < WINO_TILES; t++) acc[t] += w[c] * v[p][c][t];
+        for (t = 0; t < WINO_TILES; t++) mp[p][m][t] = acc[t];
+      }
+
+    // output transform A^T M A, plus bias
+    for (m = 0; m < nm; m++) {
+      for (i = 0; i < WINO_M; i++)
+        for (j = 0; j < WINO_N; j++) {
+          for (t = 0; t < WINO_TILES; t++) acc[t] = 0.0f;
+          for (k = 0; k < WINO_N; k++) {
+            if ((b = g->at[i][k]) == 0.0f) continue;
+            for (t = 0; t < WINO_TILES; t++) acc[t] += b * mp[k * WINO_N + j][m][t];
+          }
+          for (t = 0; t < WINO_TILES; t++) t1[i][j][t] = acc[t];
+        }
+      for (i = 0; i < WINO_M; i++)
+        for (j = 0; j < WINO_M; j++) {
+          for (t = 0; t < WINO_TILES; t++) acc[t] = bias[m];
+          for (k = 0; k < WINO_N; k++) {
+            if ((b = g->at[j][k]) == 0.0f) continue;
+            for (t = 0; t < WINO_TILES; t++) acc[t] += b * t1[i][k][t];
+          }
+          for (t = 0; t < nt; t++) output[(m * oh + y0[t] + i) * ow + x0[t] + j] = acc[t];
+        }
+    }
+  }
+}
+
+void Conv1_28x28x1_5x5x20_1_0_winograd(	float input[IMG_DEPTH][IMG_HEIGHT][IMG_WIDTH], const LenetWinograd *g,
+										float bias[CONV1_NBOUTPUT], float output[CONV1_NBOUTPUT][CONV1_HEIGHT][CONV1_WIDTH]) {
+  conv(&input[0][0][0], IMG_DEPTH, IMG_HEIGHT, IMG_WIDTH, &g->conv1_u[0][0][0], bias,
+       CONV1_NBOUTPUT, CONV1_HEIGHT, CONV1_WIDTH, g, &output[0][0][0]);
+}
+
+void Conv2_12x12x20_5x5x40_1_0_winograd(float input[POOL1_NBOUTPUT][POOL1_HEIGHT][POOL1_WIDTH], const LenetWinograd *g,
+										float bias[CONV2_NBOUTPUT], float output[CONV2_NBOUTPUT][CONV2_HEIGHT][CONV2_WIDTH]) {
+  conv(&input[0][0][0], POOL1_NBOUTPUT, POOL1_HEIGHT, POOL1_WIDTH, &g->conv2_u[0][0][0], bias,
+       CONV2_NBOUTPUT, CONV2_HEIGHT, CONV2_WIDTH, g, &output[0][0][0]);
+}
+
+/* multiplies of one layer: element-wise products, and the non-zero transform coefficients */
+void WinogradOps(const LenetWinograd *g, int layer, long *products, long *transforms) {
+  int 		nc = layer == WINO_CONV1 ? IMG_DEPTH : POOL1_NBOUTPUT;
+  int 		nm = layer == WINO_CONV1 ? CONV1_NBOUTPUT : CONV2_NBOUTPUT;
+  long 		tiles = layer == WINO_CONV1 ? (CONV1_HEIGHT / WINO_M) * (CONV1_WIDTH / WINO_M)
+                                        : (CONV2_HEIGHT / WINO_M) * (CONV2_WIDTH / WINO_M);
+  int 		nzb = 0, nza = 0, i, j;
+
+  for (i = 0; i < WINO_N; i++)
+    for (j = 0; j < WINO_N; j++) nzb += g->bt[i][j] != 0.0f;
+  for (i = 0; i < WINO_M; i++)
+    for (j = 0; j < WINO_N; j++) nza += g->at[i][j] != 0.0f;
+  *products = tiles * WINO_P * nm * nc;
+  *transforms = tiles * (nc * 2L * WINO_N * nzb + nm * (long)nza * (WINO_N + WINO_M));
+}